@@ -0,0 +1,172 @@
+//==============================================================================
+// Project  : Grape
+// Module   : IO
+// File     : CanPort.h
+// Brief    : CAN bus port over Linux SocketCAN
+//
+// Copyright (c) 2012, Vilas Chitrakaran
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//    * Redistributions of source code must retain the above copyright
+//      notice, this list of conditions and the following disclaimer.
+//    * Redistributions in binary form must reproduce the above copyright
+//      notice, this list of conditions and the following disclaimer in the
+//      documentation and/or other materials provided with the distribution.
+//    * Neither the name of the copyright holder nor the names of its
+//      contributors may be used to endorse or promote products derived from
+//      this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR ITS CONTRIBUTORS
+// BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF
+// THE POSSIBILITY OF SUCH DAMAGE.
+//==============================================================================
+
+#ifndef GRAPEIO_CANPORT_H
+#define GRAPEIO_CANPORT_H
+
+#include "IDataPort.h"
+#include <string>
+
+namespace grape
+{
+
+/// \class CanPort
+/// \ingroup io
+/// \brief CAN bus port over Linux SocketCAN (raw CAN_RAW socket)
+///
+/// Frames are exchanged in batches with readFrames() and writeFrames(), which use
+/// a single recvmmsg/sendmmsg system call for up to BATCH_SIZE frames, so a control
+/// cycle can exchange dozens of frames in two system calls. Each received frame
+/// carries its kernel receive timestamp. setFilters() installs acceptance filters
+/// in the kernel, so frames for other nodes never reach the application.
+///
+/// The IDataPort read and write methods transfer raw SocketCAN frames (struct
+/// can_frame, FRAME_SIZE bytes each, as used by candump -b); sizes must be a
+/// multiple of FRAME_SIZE.
+/// \code
+/// grape::CanPort port;
+/// port.open("can0");
+/// grape::CanPort::Filter filter = { 0x180, 0x780, false, false }; // PDO1 tx of all nodes
+/// port.setFilters(&filter, 1);
+///
+/// grape::CanPort::Frame frames[32];
+/// unsigned int n = port.readFrames(frames, 32, 10);
+/// \endcode
+///
+/// For testing without hardware, create a virtual bus:
+/// "ip link add dev vcan0 type vcan && ip link set up vcan0".
+/// Available on Linux only.
+class GRAPEIO_DLL_API CanPort : public IDataPort
+{
+public:
+    static const unsigned int FRAME_SIZE = 16;  //!< size of struct can_frame
+    static const unsigned int BATCH_SIZE = 64;  //!< frames per system call in readFrames() and writeFrames()
+
+    /// \brief A classic CAN frame
+    struct Frame
+    {
+        unsigned int id;            //!< 11 bit or 29 bit (extended) identifier
+        bool extended;              //!< 29 bit identifier
+        bool remote;                //!< remote transmission request
+        unsigned char length;       //!< data length, 0 to 8
+        unsigned char data[8];
+        long long timestampNs;      //!< receive time (CLOCK_REALTIME). Ignored on write.
+    };
+
+    /// \brief Acceptance filter. A frame is accepted if (frameId & mask) == (id & mask)
+    /// and its identifier format and frame type (data or remote) match.
+    struct Filter
+    {
+        unsigned int id;
+        unsigned int mask;
+        bool extended;              //!< match 29 bit identifiers instead of 11 bit ones
+        bool remote;                //!< match remote transmission requests instead of data frames
+    };
+
+public:
+    CanPort();
+    virtual ~CanPort() throw(/*nothing*/);
+
+    /// Open a CAN interface. All frames are accepted until setFilters() is called.
+    /// \param interfaceName Network interface name (eg: "can0", "vcan0")
+    /// \throw IoOpenException
+    void open(const std::string& interfaceName);
+
+    /// \return true if the port is open
+    bool isOpen() const;
+
+    /// Replace the acceptance filters. A frame is received if it matches any filter.
+    /// \param filters  Array of filters
+    /// \param count    Number of filters. 0 receives no frames.
+    /// \throw IoException
+    void setFilters(const Filter* filters, unsigned int count);
+
+    /// Remove acceptance filters, so that all frames are received
+    /// \throw IoException
+    void clearFilters();
+
+    /// Enable or disable reception of frames sent by other sockets on this host
+    /// (default enabled)
+    /// \throw IoException
+    void setLoopback(bool yes);
+
+    /// Receive a batch of frames. Waits until at least one frame is available, then
+    /// reads as many queued frames as fit without waiting further.
+    /// \param frames       Array of frames to fill
+    /// \param count        Size of the array
+    /// \param timeoutMs    Milliseconds to wait. Negative to wait indefinitely.
+    /// \throw IoReadException, IoEventHandlingException
+    /// \return number of frames received. 0 on timeout.
+    unsigned int readFrames(Frame* frames, unsigned int count, int timeoutMs);
+
+    /// Send a batch of frames
+    /// \param frames   Array of frames
+    /// \param count    Number of frames
+    /// \throw IoWriteException
+    /// \return number of frames sent. Less than count if the transmit queue is full.
+    unsigned int writeFrames(const Frame* frames, unsigned int count);
+
+    // ------------- Reimplemented from IDataPort -------------------
+
+    void close() throw(/*nothing*/);
+    unsigned int readAll(std::vector<unsigned char>& buffer);
+
+    /// \copydoc IDataPort::readn()
+    /// Reads whole frames. bytes must be a multiple of FRAME_SIZE.
+    unsigned int readn(std::vector<unsigned char>& buffer, unsigned int bytes);
+    unsigned int readn(unsigned char* pBuffer, unsigned int bytes);
+    /// \return FRAME_SIZE if a frame is queued, else 0. Raw CAN sockets can't
+    /// report the total queued, so only the next frame is counted.
+    unsigned int availableToRead();
+    Status waitForRead(int timeoutMs);
+    void flushRx();
+
+    /// \copydoc IDataPort::write()
+    /// Writes whole frames. bytes must be a multiple of FRAME_SIZE.
+    unsigned int write(const std::vector<unsigned char>& buffer);
+    unsigned int write(const unsigned char* pBuffer, unsigned int bytes);
+    Status waitForWrite(int timeoutMs);
+    void flushTx() {} //!< does nothing
+
+    int getFd() const;
+
+private:
+    CanPort(const CanPort&);              //!< disable copy
+    CanPort &operator=(const CanPort&);   //!< disable assignment
+private:
+    class CanPortP* _pImpl;               //!< platform specific private implementation
+}; // CanPort
+
+} // grape
+
+#endif // GRAPEIO_CANPORT_H
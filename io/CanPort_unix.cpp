@@ -0,0 +1,569 @@
+//==============================================================================
+// Project  : Grape
+// Module   : IO
+// File     : CanPort_unix.cpp
+//
+// Copyright (c) 2012, Vilas Chitrakaran
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//    * Redistributions of source code must retain the above copyright
+//      notice, this list of conditions and the following disclaimer.
+//    * Redistributions in binary form must reproduce the above copyright
+//      notice, this list of conditions and the following disclaimer in the
+//      documentation and/or other materials provided with the distribution.
+//    * Neither the name of the copyright holder nor the names of its
+//      contributors may be used to endorse or promote products derived from
+//      this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR ITS CONTRIBUTORS
+// BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF
+// THE POSSIBILITY OF SUCH DAMAGE.
+//==============================================================================
+
+#include "CanPort.h"
+#include <sys/socket.h>
+#include <sys/ioctl.h>
+#include <linux/can.h>
+#include <linux/can/raw.h>
+#include <net/if.h>
+#include <poll.h>
+#include <unistd.h>
+#include <time.h>
+#include <errno.h>
+#include <string.h>
+#include <sstream>
+
+namespace grape
+{
+
+//==============================================================================
+/// \class CanPortP
+/// \brief Linux specific private implementation
+//==============================================================================
+class CanPortP
+{
+public:
+    CanPortP() : _fd(-1) {}
+    void checkOpen(const char* location) const;
+    static void throwError(const char* location, int e);
+    bool poll(short events, int timeoutMs);
+    unsigned int receive(struct can_frame* pFrames, unsigned int count, int timeoutMs);
+    unsigned int send(const struct can_frame* pFrames, unsigned int count);
+    static void toFrame(const struct can_frame& cf, CanPort::Frame& frame);
+    static void fromFrame(const CanPort::Frame& frame, struct can_frame& cf);
+public:
+    int _fd;
+
+    // preallocated batch descriptors for recvmmsg/sendmmsg
+    struct mmsghdr _msgs[CanPort::BATCH_SIZE];
+    struct iovec _iov[CanPort::BATCH_SIZE];
+    union Control
+    {
+        struct cmsghdr align;
+        char buf[CMSG_SPACE(sizeof(struct timespec))];
+    } _control[CanPort::BATCH_SIZE];
+    struct can_frame _frames[CanPort::BATCH_SIZE];
+}; // CanPortP
+
+//------------------------------------------------------------------------------
+void CanPortP::checkOpen(const char* location) const
+//------------------------------------------------------------------------------
+{
+    if( _fd < 0 )
+    {
+        std::ostringstream str;
+        str << location << ": Port not open";
+        throw IoException(-1, str.str());
+    }
+}
+
+//------------------------------------------------------------------------------
+void CanPortP::throwError(const char* location, int e)
+//------------------------------------------------------------------------------
+{
+    std::ostringstream str;
+    str << location << ": " << strerror(e);
+    throw IoException(e, str.str());
+}
+
+//------------------------------------------------------------------------------
+bool CanPortP::poll(short events, int timeoutMs)
+//------------------------------------------------------------------------------
+{
+    struct pollfd pfd;
+    pfd.fd = _fd;
+    pfd.events = events;
+    pfd.revents = 0;
+    int ret = ::poll(&pfd, 1, timeoutMs);
+    if( ret < 0 )
+    {
+        if( errno == EINTR )
+        {
+            return false;
+        }
+        std::ostringstream str;
+        str << "[CanPort::poll]: " << strerror(errno);
+        throw IoEventHandlingException(errno, str.str());
+    }
+    return (ret > 0);
+}
+
+//------------------------------------------------------------------------------
+unsigned int CanPortP::receive(struct can_frame* pFrames, unsigned int count, int timeoutMs)
+//------------------------------------------------------------------------------
+{
+    // try first, so that a busy bus costs one system call per batch
+    unsigned int received = 0;
+    bool waited = false;
+    while( received < count )
+    {
+        unsigned int n = count - received;
+        if( n > CanPort::BATCH_SIZE )
+        {
+            n = CanPort::BATCH_SIZE;
+        }
+        for(unsigned int i = 0; i < n; ++i)
+        {
+            _iov[i].iov_base = &pFrames[received + i];
+            _iov[i].iov_len = sizeof(struct can_frame);
+            memset(&_msgs[i].msg_hdr, 0, sizeof(struct msghdr));
+            _msgs[i].msg_hdr.msg_iov = &_iov[i];
+            _msgs[i].msg_hdr.msg_iovlen = 1;
+            _msgs[i].msg_hdr.msg_control = _control[i].buf;
+            _msgs[i].msg_hdr.msg_controllen = sizeof(Control);
+            _msgs[i].msg_len = 0;
+        }
+
+        int ret = recvmmsg(_fd, _msgs, n, MSG_DONTWAIT, NULL);
+        if( ret < 0 )
+        {
+            if( (errno != EAGAIN) && (errno != EWOULDBLOCK) && (errno != EINTR) )
+            {
+                std::ostringstream str;
+                str << "[CanPort::receive(recvmmsg)]: " << strerror(errno);
+                throw IoReadException(errno, str.str());
+            }
+            if( (received > 0) || waited || (timeoutMs == 0) )
+            {
+                break;
+            }
+            waited = true;
+            if( !poll(POLLIN, timeoutMs) )
+            {
+                break;
+            }
+            continue;
+        }
+
+        received += ret;
+        if( (unsigned int)ret < n )
+        {
+            break;
+        }
+    }
+    return received;
+}
+
+//------------------------------------------------------------------------------
+unsigned int CanPortP::send(const struct can_frame* pFrames, unsigned int count)
+//------------------------------------------------------------------------------
+{
+    unsigned int sent = 0;
+    while( sent < count )
+    {
+        unsigned int n = count - sent;
+        if( n > CanPort::BATCH_SIZE )
+        {
+            n = CanPort::BATCH_SIZE;
+        }
+        for(unsigned int i = 0; i < n; ++i)
+        {
+            _iov[i].iov_base = (void*)&pFrames[sent + i];
+            _iov[i].iov_len = sizeof(struct can_frame);
+            memset(&_msgs[i].msg_hdr, 0, sizeof(struct msghdr));
+            _msgs[i].msg_hdr.msg_iov = &_iov[i];
+            _msgs[i].msg_hdr.msg_iovlen = 1;
+            _msgs[i].msg_len = 0;
+        }
+
+        int ret = sendmmsg(_fd, _msgs, n, 0);
+        if( ret < 0 )
+        {
+            // transmit queue full
+            if( (errno == ENOBUFS) || (errno == EAGAIN) || (errno == EWOULDBLOCK) )
+            {
+                break;
+            }
+            std::ostringstream str;
+            str << "[CanPort::send(sendmmsg)]: " << strerror(errno);
+            throw IoWriteException(errno, str.str());
+        }
+        sent += ret;
+        if( (unsigned int)ret < n )
+        {
+            break;
+        }
+    }
+    return sent;
+}
+
+//------------------------------------------------------------------------------
+void CanPortP::toFrame(const struct can_frame& cf, CanPort::Frame& frame)
+//------------------------------------------------------------------------------
+{
+    frame.extended = ((cf.can_id & CAN_EFF_FLAG) != 0);
+    frame.remote = ((cf.can_id & CAN_RTR_FLAG) != 0);
+    frame.id = cf.can_id & (frame.extended ? CAN_EFF_MASK : CAN_SFF_MASK);
+    frame.length = (cf.can_dlc > 8) ? 8 : cf.can_dlc;
+    memcpy(frame.data, cf.data, 8);
+}
+
+//------------------------------------------------------------------------------
+void CanPortP::fromFrame(const CanPort::Frame& frame, struct can_frame& cf)
+//------------------------------------------------------------------------------
+{
+    memset(&cf, 0, sizeof(cf));
+    cf.can_id = frame.extended ? ((frame.id & CAN_EFF_MASK) | CAN_EFF_FLAG) : (frame.id & CAN_SFF_MASK);
+    if( frame.remote )
+    {
+        cf.can_id |= CAN_RTR_FLAG;
+    }
+    cf.can_dlc = (frame.length > 8) ? 8 : frame.length;
+    memcpy(cf.data, frame.data, cf.can_dlc);
+}
+
+//==============================================================================
+CanPort::CanPort()
+//==============================================================================
+    : _pImpl(new CanPortP)
+{
+}
+
+//------------------------------------------------------------------------------
+CanPort::~CanPort() throw()
+//------------------------------------------------------------------------------
+{
+    close();
+    delete _pImpl;
+}
+
+//------------------------------------------------------------------------------
+void CanPort::open(const std::string& interfaceName)
+//------------------------------------------------------------------------------
+{
+    close();
+
+    int fd = socket(PF_CAN, SOCK_RAW, CAN_RAW);
+    if( fd < 0 )
+    {
+        std::ostringstream str;
+        str << "[CanPort::open(socket)]: " << strerror(errno);
+        throw IoOpenException(errno, str.str());
+    }
+
+    struct sockaddr_can addr;
+    memset(&addr, 0, sizeof(addr));
+    addr.can_family = AF_CAN;
+    addr.can_ifindex = if_nametoindex(interfaceName.c_str());
+    int one = 1;
+    const char* pFailed = NULL;
+    if( addr.can_ifindex == 0 )
+    {
+        pFailed = "[CanPort::open(if_nametoindex)]: ";
+    }
+    else if( setsockopt(fd, SOL_SOCKET, SO_TIMESTAMPNS, &one, sizeof(one)) < 0 )
+    {
+        pFailed = "[CanPort::open(SO_TIMESTAMPNS)]: ";
+    }
+    else if( bind(fd, (struct sockaddr*)&addr, sizeof(addr)) < 0 )
+    {
+        pFailed = "[CanPort::open(bind)]: ";
+    }
+    if( pFailed )
+    {
+        int e = errno;
+        ::close(fd);
+        std::ostringstream str;
+        str << pFailed << strerror(e) << " (" << interfaceName << ")";
+        throw IoOpenException(e, str.str());
+    }
+    _pImpl->_fd = fd;
+}
+
+//------------------------------------------------------------------------------
+bool CanPort::isOpen() const
+//------------------------------------------------------------------------------
+{
+    return (_pImpl->_fd >= 0);
+}
+
+//------------------------------------------------------------------------------
+int CanPort::getFd() const
+//------------------------------------------------------------------------------
+{
+    return _pImpl->_fd;
+}
+
+//------------------------------------------------------------------------------
+void CanPort::close() throw()
+//------------------------------------------------------------------------------
+{
+    if( _pImpl->_fd >= 0 )
+    {
+        ::close(_pImpl->_fd);
+        _pImpl->_fd = -1;
+    }
+}
+
+//------------------------------------------------------------------------------
+void CanPort::setFilters(const Filter* filters, unsigned int count)
+//------------------------------------------------------------------------------
+{
+    _pImpl->checkOpen("[CanPort::setFilters]");
+
+    std::vector<struct can_filter> cfs(count);
+    for(unsigned int i = 0; i < count; ++i)
+    {
+        // include the format flag and RTR bit in the match, so that 11 bit filters
+        // don't accept 29 bit frames with the same low bits, and data filters
+        // don't accept remote requests for the same identifier
+        if( filters[i].extended )
+        {
+            cfs[i].can_id = (filters[i].id & CAN_EFF_MASK) | CAN_EFF_FLAG;
+            cfs[i].can_mask = (filters[i].mask & CAN_EFF_MASK) | CAN_EFF_FLAG | CAN_RTR_FLAG;
+        }
+        else
+        {
+            cfs[i].can_id = filters[i].id & CAN_SFF_MASK;
+            cfs[i].can_mask = (filters[i].mask & CAN_SFF_MASK) | CAN_EFF_FLAG | CAN_RTR_FLAG;
+        }
+        if( filters[i].remote )
+        {
+            cfs[i].can_id |= CAN_RTR_FLAG;
+        }
+    }
+    if( setsockopt(_pImpl->_fd, SOL_CAN_RAW, CAN_RAW_FILTER, cfs.empty() ? NULL : &cfs[0],
+                   count * sizeof(struct can_filter)) < 0 )
+    {
+        CanPortP::throwError("[CanPort::setFilters(CAN_RAW_FILTER)]", errno);
+    }
+}
+
+//------------------------------------------------------------------------------
+void CanPort::clearFilters()
+//------------------------------------------------------------------------------
+{
+    _pImpl->checkOpen("[CanPort::clearFilters]");
+
+    // the kernel default: a zero mask matches every frame
+    struct can_filter all;
+    all.can_id = 0;
+    all.can_mask = 0;
+    if( setsockopt(_pImpl->_fd, SOL_CAN_RAW, CAN_RAW_FILTER, &all, sizeof(all)) < 0 )
+    {
+        CanPortP::throwError("[CanPort::clearFilters(CAN_RAW_FILTER)]", errno);
+    }
+}
+
+//------------------------------------------------------------------------------
+void CanPort::setLoopback(bool yes)
+//------------------------------------------------------------------------------
+{
+    _pImpl->checkOpen("[CanPort::setLoopback]");
+    int val = (yes ? 1 : 0);
+    if( setsockopt(_pImpl->_fd, SOL_CAN_RAW, CAN_RAW_LOOPBACK, &val, sizeof(val)) < 0 )
+    {
+        CanPortP::throwError("[CanPort::setLoopback(CAN_RAW_LOOPBACK)]", errno);
+    }
+}
+
+//------------------------------------------------------------------------------
+unsigned int CanPort::readFrames(Frame* frames, unsigned int count, int timeoutMs)
+//------------------------------------------------------------------------------
+{
+    _pImpl->checkOpen("[CanPort::readFrames]");
+
+    unsigned int total = 0;
+    while( total < count )
+    {
+        unsigned int n = count - total;
+        if( n > BATCH_SIZE )
+        {
+            n = BATCH_SIZE;
+        }
+        unsigned int got = _pImpl->receive(_pImpl->_frames, n, (total == 0) ? timeoutMs : 0);
+        for(unsigned int i = 0; i < got; ++i)
+        {
+            Frame& frame = frames[total + i];
+            CanPortP::toFrame(_pImpl->_frames[i], frame);
+            frame.timestampNs = 0;
+            struct msghdr& msg = _pImpl->_msgs[i].msg_hdr;
+            for(struct cmsghdr* cm = CMSG_FIRSTHDR(&msg); cm != NULL; cm = CMSG_NXTHDR(&msg, cm))
+            {
+                if( (cm->cmsg_level == SOL_SOCKET) && (cm->cmsg_type == SCM_TIMESTAMPNS) )
+                {
+                    struct timespec ts;
+                    memcpy(&ts, CMSG_DATA(cm), sizeof(ts));
+                    frame.timestampNs = (long long)ts.tv_sec * 1000000000LL + ts.tv_nsec;
+                }
+            }
+        }
+        total += got;
+        if( got < n )
+        {
+            break;
+        }
+    }
+    return total;
+}
+
+//------------------------------------------------------------------------------
+unsigned int CanPort::writeFrames(const Frame* frames, unsigned int count)
+//------------------------------------------------------------------------------
+{
+    _pImpl->checkOpen("[CanPort::writeFrames]");
+
+    unsigned int total = 0;
+    while( total < count )
+    {
+        unsigned int n = count - total;
+        if( n > BATCH_SIZE )
+        {
+            n = BATCH_SIZE;
+        }
+        for(unsigned int i = 0; i < n; ++i)
+        {
+            CanPortP::fromFrame(frames[total + i], _pImpl->_frames[i]);
+        }
+        unsigned int sent = _pImpl->send(_pImpl->_frames, n);
+        total += sent;
+        if( sent < n )
+        {
+            break;
+        }
+    }
+    return total;
+}
+
+//------------------------------------------------------------------------------
+unsigned int CanPort::availableToRead()
+//------------------------------------------------------------------------------
+{
+    _pImpl->checkOpen("[CanPort::availableToRead]");
+
+    // CAN_RAW sockets don't implement FIONREAD. Peek at the next frame instead
+    struct can_frame frame;
+    while( recv(_pImpl->_fd, &frame, sizeof(frame), MSG_PEEK | MSG_DONTWAIT) < 0 )
+    {
+        if( (errno == EAGAIN) || (errno == EWOULDBLOCK) )
+        {
+            return 0;
+        }
+        if( errno != EINTR )
+        {
+            CanPortP::throwError("[CanPort::availableToRead(recv)]", errno);
+        }
+    }
+    return FRAME_SIZE;
+}
+
+//------------------------------------------------------------------------------
+IDataPort::Status CanPort::waitForRead(int timeoutMs)
+//------------------------------------------------------------------------------
+{
+    _pImpl->checkOpen("[CanPort::waitForRead]");
+    return _pImpl->poll(POLLIN, timeoutMs) ? PORT_OK : PORT_TIMEOUT;
+}
+
+//------------------------------------------------------------------------------
+IDataPort::Status CanPort::waitForWrite(int timeoutMs)
+//------------------------------------------------------------------------------
+{
+    _pImpl->checkOpen("[CanPort::waitForWrite]");
+    return _pImpl->poll(POLLOUT, timeoutMs) ? PORT_OK : PORT_TIMEOUT;
+}
+
+//------------------------------------------------------------------------------
+void CanPort::flushRx()
+//------------------------------------------------------------------------------
+{
+    _pImpl->checkOpen("[CanPort::flushRx]");
+    while( _pImpl->receive(_pImpl->_frames, BATCH_SIZE, 0) == BATCH_SIZE ) {}
+}
+
+//------------------------------------------------------------------------------
+unsigned int CanPort::readAll(std::vector<unsigned char>& buffer)
+//------------------------------------------------------------------------------
+{
+    _pImpl->checkOpen("[CanPort::readAll]");
+
+    unsigned int total = 0;
+    while( true )
+    {
+        if( buffer.size() < total + BATCH_SIZE * FRAME_SIZE )
+        {
+            buffer.resize(total + BATCH_SIZE * FRAME_SIZE);
+        }
+        unsigned int got = _pImpl->receive((struct can_frame*)&buffer[total], BATCH_SIZE, 0);
+        total += got * FRAME_SIZE;
+        if( got < BATCH_SIZE )
+        {
+            break;
+        }
+    }
+    return total;
+}
+
+//------------------------------------------------------------------------------
+unsigned int CanPort::readn(std::vector<unsigned char>& buffer, unsigned int bytes)
+//------------------------------------------------------------------------------
+{
+    if( buffer.size() < bytes )
+    {
+        buffer.resize(bytes);
+    }
+    return readn(buffer.empty() ? NULL : &buffer[0], bytes);
+}
+
+//------------------------------------------------------------------------------
+unsigned int CanPort::readn(unsigned char* pBuffer, unsigned int bytes)
+//------------------------------------------------------------------------------
+{
+    _pImpl->checkOpen("[CanPort::readn]");
+    if( bytes % FRAME_SIZE )
+    {
+        throw IoReadException(EINVAL, "[CanPort::readn]: Size is not a multiple of FRAME_SIZE");
+    }
+    return _pImpl->receive((struct can_frame*)pBuffer, bytes / FRAME_SIZE, -1) * FRAME_SIZE;
+}
+
+//------------------------------------------------------------------------------
+unsigned int CanPort::write(const std::vector<unsigned char>& buffer)
+//------------------------------------------------------------------------------
+{
+    return write(buffer.empty() ? NULL : &buffer[0], buffer.size());
+}
+
+//------------------------------------------------------------------------------
+unsigned int CanPort::write(const unsigned char* pBuffer, unsigned int bytes)
+//------------------------------------------------------------------------------
+{
+    _pImpl->checkOpen("[CanPort::write]");
+    if( bytes % FRAME_SIZE )
+    {
+        throw IoWriteException(EINVAL, "[CanPort::write]: Size is not a multiple of FRAME_SIZE");
+    }
+    return _pImpl->send((const struct can_frame*)pBuffer, bytes / FRAME_SIZE) * FRAME_SIZE;
+}
+
+} // grape
@@ -0,0 +1,161 @@
+//==============================================================================
+// Project  : Grape
+// Module   : IO
+// File     : EvdevJoystickManager.h
+// Brief    : Event driven joysticks over the Linux evdev interface
+//
+// Copyright (c) 2012, Vilas Chitrakaran
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//    * Redistributions of source code must retain the above copyright
+//      notice, this list of conditions and the following disclaimer.
+//    * Redistributions in binary form must reproduce the above copyright
+//      notice, this list of conditions and the following disclaimer in the
+//      documentation and/or other materials provided with the distribution.
+//    * Neither the name of the copyright holder nor the names of its
+//      contributors may be used to endorse or promote products derived from
+//      this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR ITS CONTRIBUTORS
+// BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF
+// THE POSSIBILITY OF SUCH DAMAGE.
+//==============================================================================
+
+#ifndef GRAPEIO_EVDEVJOYSTICKMANAGER_H
+#define GRAPEIO_EVDEVJOYSTICKMANAGER_H
+
+#include "IoException.h"
+#include <string>
+
+namespace grape
+{
+
+/// \class EvdevJoystickManager
+/// \ingroup io
+/// \brief Event driven access to all joysticks and gamepads on a Linux host
+///
+/// Unlike SimpleJoystick, which must be polled, EvdevJoystickManager provides a
+/// single file descriptor that becomes readable when any connected device has
+/// input, or when a device is plugged in or removed. Register it with an
+/// IoReactor (or any poll/epoll loop) and call process() when it is readable, so
+/// that input is handled as soon as it arrives. Devices are read through the
+/// evdev interface (/dev/input/eventN) and hotplug is detected with inotify on
+/// the device directory.
+///
+/// Each device occupies one of MAX_DEVICES slots for as long as it is
+/// connected. Its state is updated once per evdev report (SYN_REPORT), so axes
+/// and buttons that change together are seen together, and carries the kernel
+/// timestamp of the report in microseconds on CLOCK_MONOTONIC. State is held in
+/// fixed size arrays; nothing is allocated while processing input. Axes are
+/// scaled to -32767 - +32767 from the range the device reports; hats are axes
+/// with values -32767, 0 or +32767.
+/// \code
+/// class Teleop : public grape::IoReactor::IHandler, public grape::EvdevJoystickManager::IListener
+/// {
+/// public:
+///     Teleop(grape::EvdevJoystickManager& sticks) : _sticks(sticks) { sticks.setListener(this); }
+///     void onEvent(int fd, unsigned int events) { _sticks.process(0); }
+///     void onConnected(unsigned int device) {}
+///     void onDisconnected(unsigned int device) { stopRobot(); }
+///     void onStateChanged(unsigned int device) { sendCommand(_sticks.getState(device)); }
+/// private:
+///     grape::EvdevJoystickManager& _sticks;
+/// };
+///
+/// grape::EvdevJoystickManager sticks;
+/// Teleop teleop(sticks);
+/// reactor.add(sticks.getFd(), &teleop, grape::IoReactor::READABLE | grape::IoReactor::LEVEL_TRIGGERED);
+/// reactor.run();
+/// \endcode
+///
+/// Reading input devices usually requires membership of the 'input' group.
+/// Devices that can't be opened are ignored until their permissions change.
+/// Not thread-safe.
+class GRAPEIO_DLL_API EvdevJoystickManager
+{
+public:
+    static const unsigned int MAX_DEVICES = 8;  //!< Devices connected at the same time
+    static const unsigned int MAX_AXES = 32;    //!< Axes per device. Further axes are ignored.
+    static const unsigned int MAX_BUTTONS = 80; //!< Buttons per device. Further buttons are ignored.
+
+    /// \brief Device state
+    struct State
+    {
+        long long       timestampUs;            //!< Time of the last report, CLOCK_MONOTONIC
+        unsigned int    numAxes;
+        unsigned int    numButtons;
+        int             axes[MAX_AXES];         //!< Analogue axes and hats. range: (-32767 - +32767)
+        unsigned char   buttons[MAX_BUTTONS];   //!< Buttons. (1 = pressed)
+    };
+
+    /// \brief Interface for notification of device changes. Methods are called from process().
+    class GRAPEIO_DLL_API IListener
+    {
+    public:
+        virtual ~IListener() {}
+        virtual void onConnected(unsigned int device) = 0;      //!< A device was opened into slot 'device'
+        virtual void onDisconnected(unsigned int device) = 0;   //!< The device in slot 'device' was removed
+        virtual void onStateChanged(unsigned int device) = 0;   //!< The device reported new state
+    };
+
+public:
+    /// Open all joysticks in the device directory and watch it for hotplug
+    /// \param directory    Directory of evdev device nodes
+    /// \throw IoOpenException
+    explicit EvdevJoystickManager(const std::string& directory = "/dev/input");
+    ~EvdevJoystickManager() throw();
+
+    /// Set the object to notify of device changes. Set NULL to disable.
+    void setListener(IListener* pListener);
+
+    /// Set dead zone for all analogue axes. (range 0 - 32767)
+    void setDeadZone(int val);
+    int getDeadZone() const;
+
+    /// \return a file descriptor that is readable while there is input or hotplug
+    /// activity to process. For use with IoReactor or poll(). Do not read from it.
+    int getFd() const;
+
+    /// Wait for input and hotplug activity, and process it
+    /// \param timeoutMs    Milliseconds to wait. 0 to process only what is pending.
+    ///                     Negative to wait indefinitely.
+    /// \return Number of state updates
+    /// \throw IoEventHandlingException
+    unsigned int process(int timeoutMs);
+
+    /// \return Number of connected devices
+    unsigned int getDeviceCount() const;
+
+    /// \return true if a device is connected in the slot
+    bool isConnected(unsigned int device) const;
+
+    /// \return Name reported by the device in the slot
+    std::string getName(unsigned int device) const;
+
+    /// \return Device node of the device in the slot (eg: /dev/input/event5)
+    std::string getPath(unsigned int device) const;
+
+    /// \return Last reported state of the device in the slot. It is retained
+    /// after the device is disconnected.
+    const State& getState(unsigned int device) const;
+
+private:
+    EvdevJoystickManager(const EvdevJoystickManager&);              //!< disable copy
+    EvdevJoystickManager &operator=(const EvdevJoystickManager&);   //!< disable assignment
+private:
+    class EvdevJoystickManagerP* _pImpl;    //!< platform specific private implementation
+}; // EvdevJoystickManager
+
+} // grape
+
+#endif // GRAPEIO_EVDEVJOYSTICKMANAGER_H
@@ -0,0 +1,618 @@
+//==============================================================================
+// Project  : Grape
+// Module   : IO
+// File     : EvdevJoystickManager_unix.cpp
+//
+// Copyright (c) 2012, Vilas Chitrakaran
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//    * Redistributions of source code must retain the above copyright
+//      notice, this list of conditions and the following disclaimer.
+//    * Redistributions in binary form must reproduce the above copyright
+//      notice, this list of conditions and the following disclaimer in the
+//      documentation and/or other materials provided with the distribution.
+//    * Neither the name of the copyright holder nor the names of its
+//      contributors may be used to endorse or promote products derived from
+//      this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR ITS CONTRIBUTORS
+// BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF
+// THE POSSIBILITY OF SUCH DAMAGE.
+//==============================================================================
+
+#include "EvdevJoystickManager.h"
+#include <linux/input.h>
+#include <sys/epoll.h>
+#include <sys/inotify.h>
+#include <sys/ioctl.h>
+#include <dirent.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <time.h>
+#include <errno.h>
+#include <limits.h>
+#include <string.h>
+#include <sstream>
+
+namespace grape
+{
+
+static const unsigned int INOTIFY_TAG = 0xFFFFFFFF;    // epoll data for the inotify descriptor
+static const unsigned char NO_INDEX = 0xFF;
+
+// kernel headers before 4.16 don't provide these accessors for the event time
+#ifndef input_event_sec
+#define input_event_sec     time.tv_sec
+#define input_event_usec    time.tv_usec
+#endif
+
+#define BITS_PER_LONG       (sizeof(unsigned long) * 8)
+#define NLONGS(n)           (((n) + BITS_PER_LONG - 1) / BITS_PER_LONG)
+#define TEST_BIT(bit, arr)  (((arr)[(bit) / BITS_PER_LONG] >> ((bit) % BITS_PER_LONG)) & 1)
+
+//==============================================================================
+/// \class EvdevJoystickManagerP
+/// \brief Linux specific private implementation
+//==============================================================================
+class EvdevJoystickManagerP
+{
+public:
+    /// an open device
+    struct Device
+    {
+        int fd;
+        bool dropped;                           //!< events lost. Ignore input until next report, then resync
+        std::string path;
+        std::string name;
+        unsigned char absIndex[ABS_CNT];        //!< evdev axis code to State::axes index
+        unsigned char keyIndex[KEY_CNT];        //!< evdev key code to State::buttons index
+        unsigned short absCode[EvdevJoystickManager::MAX_AXES];
+        int absMin[EvdevJoystickManager::MAX_AXES];
+        int absMax[EvdevJoystickManager::MAX_AXES];
+        EvdevJoystickManager::State pending;    //!< state being assembled from the current report
+        EvdevJoystickManager::State state;      //!< state as of the last report
+    };
+
+public:
+    EvdevJoystickManagerP(const std::string& directory);
+    ~EvdevJoystickManagerP();
+    static void throwError(const char* location, int e);
+    static bool isEventNode(const char* name) { return (0 == strncmp(name, "event", 5)); }
+    void scan();
+    void openDevice(const std::string& path);
+    void closeDevice(unsigned int slot);
+    void resync(Device& dev);
+    int scale(const Device& dev, unsigned int index, int value) const;
+    unsigned int readDevice(unsigned int slot);
+    void readHotplug();
+    void checkSlot(unsigned int slot) const;
+public:
+    std::string _directory;
+    int _epollFd;
+    int _inotifyFd;
+    int _deadZone;
+    EvdevJoystickManager::IListener* _pListener;
+    Device _devices[EvdevJoystickManager::MAX_DEVICES];
+}; // EvdevJoystickManagerP
+
+//==============================================================================
+EvdevJoystickManagerP::EvdevJoystickManagerP(const std::string& directory)
+//==============================================================================
+    : _directory(directory),
+      _epollFd(-1),
+      _inotifyFd(-1),
+      _deadZone(0),
+      _pListener(NULL)
+{
+    for(unsigned int i = 0; i < EvdevJoystickManager::MAX_DEVICES; ++i)
+    {
+        _devices[i].fd = -1;
+        memset(&_devices[i].state, 0, sizeof(_devices[i].state));
+    }
+}
+
+//------------------------------------------------------------------------------
+EvdevJoystickManagerP::~EvdevJoystickManagerP()
+//------------------------------------------------------------------------------
+{
+    for(unsigned int i = 0; i < EvdevJoystickManager::MAX_DEVICES; ++i)
+    {
+        if( _devices[i].fd >= 0 )
+        {
+            ::close(_devices[i].fd);
+        }
+    }
+    if( _inotifyFd >= 0 )
+    {
+        ::close(_inotifyFd);
+    }
+    if( _epollFd >= 0 )
+    {
+        ::close(_epollFd);
+    }
+}
+
+//------------------------------------------------------------------------------
+void EvdevJoystickManagerP::throwError(const char* location, int e)
+//------------------------------------------------------------------------------
+{
+    std::ostringstream str;
+    str << location << ": " << strerror(e);
+    throw IoOpenException(e, str.str());
+}
+
+//------------------------------------------------------------------------------
+void EvdevJoystickManagerP::checkSlot(unsigned int slot) const
+//------------------------------------------------------------------------------
+{
+    if( slot >= EvdevJoystickManager::MAX_DEVICES )
+    {
+        std::ostringstream str;
+        str << "[EvdevJoystickManager]: Device slot " << slot << " out of range";
+        throw IoException(EINVAL, str.str());
+    }
+}
+
+//------------------------------------------------------------------------------
+void EvdevJoystickManagerP::scan()
+//------------------------------------------------------------------------------
+{
+    DIR* pDir = opendir(_directory.c_str());
+    if( pDir == NULL )
+    {
+        return;
+    }
+    struct dirent* pEntry;
+    while( (pEntry = readdir(pDir)) != NULL )
+    {
+        if( isEventNode(pEntry->d_name) )
+        {
+            openDevice(_directory + "/" + pEntry->d_name);
+        }
+    }
+    closedir(pDir);
+}
+
+//------------------------------------------------------------------------------
+void EvdevJoystickManagerP::openDevice(const std::string& path)
+//------------------------------------------------------------------------------
+{
+    unsigned int slot = EvdevJoystickManager::MAX_DEVICES;
+    for(unsigned int i = 0; i < EvdevJoystickManager::MAX_DEVICES; ++i)
+    {
+        if( _devices[i].fd < 0 )
+        {
+            slot = (slot < i) ? slot : i;
+        }
+        else if( _devices[i].path == path )
+        {
+            return; // already open
+        }
+    }
+    if( slot == EvdevJoystickManager::MAX_DEVICES )
+    {
+        return;
+    }
+
+    // udev may not have set permissions yet. We retry when it does (IN_ATTRIB)
+    const int fd = ::open(path.c_str(), O_RDONLY | O_NONBLOCK | O_CLOEXEC);
+    if( fd < 0 )
+    {
+        return;
+    }
+
+    // a joystick reports absolute axes and has joystick or gamepad buttons
+    unsigned long evBits[NLONGS(EV_CNT)] = {0};
+    unsigned long absBits[NLONGS(ABS_CNT)] = {0};
+    unsigned long keyBits[NLONGS(KEY_CNT)] = {0};
+    ioctl(fd, EVIOCGBIT(0, sizeof(evBits)), evBits);
+    ioctl(fd, EVIOCGBIT(EV_ABS, sizeof(absBits)), absBits);
+    ioctl(fd, EVIOCGBIT(EV_KEY, sizeof(keyBits)), keyBits);
+    bool hasJoystickButtons = false;
+    for(unsigned int code = BTN_JOYSTICK; code <= BTN_THUMBR; ++code)
+    {
+        hasJoystickButtons = hasJoystickButtons || TEST_BIT(code, keyBits);
+    }
+    for(unsigned int code = BTN_TRIGGER_HAPPY; code <= BTN_TRIGGER_HAPPY40; ++code)
+    {
+        hasJoystickButtons = hasJoystickButtons || TEST_BIT(code, keyBits);
+    }
+    if( !TEST_BIT(EV_ABS, evBits) || !TEST_BIT(EV_KEY, evBits) || !hasJoystickButtons )
+    {
+        ::close(fd);
+        return;
+    }
+
+    Device& dev = _devices[slot];
+    memset(dev.absIndex, NO_INDEX, sizeof(dev.absIndex));
+    memset(dev.keyIndex, NO_INDEX, sizeof(dev.keyIndex));
+    memset(&dev.pending, 0, sizeof(dev.pending));
+
+    // compact the axes and buttons present into the state arrays, in code order.
+    // Multitouch axes are left out.
+    for(unsigned int code = 0; (code < ABS_MT_SLOT) && (dev.pending.numAxes < EvdevJoystickManager::MAX_AXES); ++code)
+    {
+        if( TEST_BIT(code, absBits) )
+        {
+            dev.absCode[dev.pending.numAxes] = (unsigned short)code;
+            dev.absIndex[code] = (unsigned char)dev.pending.numAxes++;
+        }
+    }
+    for(unsigned int code = BTN_MISC; (code < KEY_CNT) && (dev.pending.numButtons < EvdevJoystickManager::MAX_BUTTONS); ++code)
+    {
+        if( TEST_BIT(code, keyBits) )
+        {
+            dev.keyIndex[code] = (unsigned char)dev.pending.numButtons++;
+        }
+    }
+
+    char name[256] = {0};
+    ioctl(fd, EVIOCGNAME(sizeof(name) - 1), name);
+
+    // report timestamps on the same clock as the rest of the library
+    int clockId = CLOCK_MONOTONIC;
+    ioctl(fd, EVIOCSCLOCKID, &clockId);
+
+    struct epoll_event ev;
+    memset(&ev, 0, sizeof(ev));
+    ev.events = EPOLLIN;
+    ev.data.u32 = slot;
+    if( epoll_ctl(_epollFd, EPOLL_CTL_ADD, fd, &ev) < 0 )
+    {
+        ::close(fd);
+        return;
+    }
+
+    dev.fd = fd;
+    dev.dropped = false;
+    dev.path = path;
+    dev.name = name;
+    resync(dev);
+    dev.state = dev.pending;
+
+    if( _pListener )
+    {
+        _pListener->onConnected(slot);
+    }
+}
+
+//------------------------------------------------------------------------------
+void EvdevJoystickManagerP::closeDevice(unsigned int slot)
+//------------------------------------------------------------------------------
+{
+    Device& dev = _devices[slot];
+    epoll_ctl(_epollFd, EPOLL_CTL_DEL, dev.fd, NULL);
+    ::close(dev.fd);
+    dev.fd = -1;
+    dev.path.clear();
+
+    if( _pListener )
+    {
+        _pListener->onDisconnected(slot);
+    }
+}
+
+//------------------------------------------------------------------------------
+int EvdevJoystickManagerP::scale(const Device& dev, unsigned int index, int value) const
+//------------------------------------------------------------------------------
+{
+    // map [min, max] to [-32767, 32767] about the centre of the range
+    const long long range = (long long)dev.absMax[index] - dev.absMin[index];
+    if( range <= 0 )
+    {
+        return 0;
+    }
+    long long scaled = ((2LL * value - dev.absMin[index] - dev.absMax[index]) * 32767LL) / range;
+    scaled = (scaled > 32767) ? 32767 : ((scaled < -32767) ? -32767 : scaled);
+    return ((scaled > _deadZone) || (scaled < -_deadZone)) ? (int)scaled : 0;
+}
+
+//------------------------------------------------------------------------------
+void EvdevJoystickManagerP::resync(Device& dev)
+//------------------------------------------------------------------------------
+{
+    // read the full device state, after opening or when events were dropped
+    for(unsigned int i = 0; i < dev.pending.numAxes; ++i)
+    {
+        struct input_absinfo info;
+        memset(&info, 0, sizeof(info));
+        ioctl(dev.fd, EVIOCGABS(dev.absCode[i]), &info);
+        dev.absMin[i] = info.minimum;
+        dev.absMax[i] = info.maximum;
+        dev.pending.axes[i] = scale(dev, i, info.value);
+    }
+
+    unsigned long keyState[NLONGS(KEY_CNT)] = {0};
+    ioctl(dev.fd, EVIOCGKEY(sizeof(keyState)), keyState);
+    for(unsigned int code = BTN_MISC; code < KEY_CNT; ++code)
+    {
+        if( dev.keyIndex[code] != NO_INDEX )
+        {
+            dev.pending.buttons[dev.keyIndex[code]] = (unsigned char)TEST_BIT(code, keyState);
+        }
+    }
+
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    dev.pending.timestampUs = (long long)ts.tv_sec * 1000000LL + ts.tv_nsec / 1000;
+}
+
+//------------------------------------------------------------------------------
+unsigned int EvdevJoystickManagerP::readDevice(unsigned int slot)
+//------------------------------------------------------------------------------
+{
+    Device& dev = _devices[slot];
+    unsigned int updates = 0;
+    struct input_event events[64];
+    while( dev.fd >= 0 )
+    {
+        const ssize_t bytes = ::read(dev.fd, events, sizeof(events));
+        if( bytes < 0 )
+        {
+            if( errno == EINTR )
+            {
+                continue;
+            }
+            if( errno != EAGAIN )
+            {
+                closeDevice(slot); // ENODEV: unplugged
+            }
+            break;
+        }
+        if( bytes == 0 )
+        {
+            break;
+        }
+
+        const unsigned int n = (unsigned int)bytes / sizeof(struct input_event);
+        for(unsigned int i = 0; i < n; ++i)
+        {
+            const struct input_event& ev = events[i];
+            if( ev.type == EV_SYN )
+            {
+                if( ev.code == SYN_DROPPED )
+                {
+                    dev.dropped = true;
+                }
+                else if( ev.code == SYN_REPORT )
+                {
+                    if( dev.dropped )
+                    {
+                        dev.dropped = false;
+                        resync(dev);
+                    }
+                    dev.pending.timestampUs = (long long)ev.input_event_sec * 1000000LL + ev.input_event_usec;
+                    dev.state = dev.pending;
+                    ++updates;
+                    if( _pListener )
+                    {
+                        _pListener->onStateChanged(slot);
+                    }
+                }
+            }
+            else if( dev.dropped )
+            {
+                continue;
+            }
+            else if( (ev.type == EV_ABS) && (ev.code < ABS_CNT) && (dev.absIndex[ev.code] != NO_INDEX) )
+            {
+                const unsigned int index = dev.absIndex[ev.code];
+                dev.pending.axes[index] = scale(dev, index, ev.value);
+            }
+            else if( (ev.type == EV_KEY) && (ev.code < KEY_CNT) && (dev.keyIndex[ev.code] != NO_INDEX) )
+            {
+                dev.pending.buttons[dev.keyIndex[ev.code]] = (ev.value != 0);
+            }
+        }
+    }
+    return updates;
+}
+
+//------------------------------------------------------------------------------
+void EvdevJoystickManagerP::readHotplug()
+//------------------------------------------------------------------------------
+{
+    char buffer[4096] __attribute__ ((aligned(__alignof__(struct inotify_event))));
+    while( true )
+    {
+        const ssize_t bytes = ::read(_inotifyFd, buffer, sizeof(buffer));
+        if( bytes <= 0 )
+        {
+            if( (bytes < 0) && (errno == EINTR) )
+            {
+                continue;
+            }
+            break;
+        }
+
+        for(const char* p = buffer; p < buffer + bytes; )
+        {
+            const struct inotify_event* pEvent = (const struct inotify_event*)p;
+            p += sizeof(struct inotify_event) + pEvent->len;
+            if( (pEvent->len == 0) || !isEventNode(pEvent->name) )
+            {
+                continue;
+            }
+
+            const std::string path = _directory + "/" + pEvent->name;
+            if( pEvent->mask & IN_DELETE )
+            {
+                for(unsigned int i = 0; i < EvdevJoystickManager::MAX_DEVICES; ++i)
+                {
+                    if( (_devices[i].fd >= 0) && (_devices[i].path == path) )
+                    {
+                        closeDevice(i);
+                    }
+                }
+            }
+            else
+            {
+                openDevice(path);
+            }
+        }
+    }
+}
+
+//==============================================================================
+EvdevJoystickManager::EvdevJoystickManager(const std::string& directory)
+//==============================================================================
+    : _pImpl(new EvdevJoystickManagerP(directory))
+{
+    try
+    {
+        _pImpl->_epollFd = epoll_create1(EPOLL_CLOEXEC);
+        if( _pImpl->_epollFd < 0 )
+        {
+            EvdevJoystickManagerP::throwError("[EvdevJoystickManager::EvdevJoystickManager(epoll_create1)]", errno);
+        }
+
+        // watch before scanning, so that a device added in between is not missed
+        _pImpl->_inotifyFd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+        if( _pImpl->_inotifyFd < 0 )
+        {
+            EvdevJoystickManagerP::throwError("[EvdevJoystickManager::EvdevJoystickManager(inotify_init1)]", errno);
+        }
+        if( inotify_add_watch(_pImpl->_inotifyFd, directory.c_str(), IN_CREATE | IN_ATTRIB | IN_DELETE) < 0 )
+        {
+            EvdevJoystickManagerP::throwError("[EvdevJoystickManager::EvdevJoystickManager(inotify_add_watch)]", errno);
+        }
+
+        struct epoll_event ev;
+        memset(&ev, 0, sizeof(ev));
+        ev.events = EPOLLIN;
+        ev.data.u32 = INOTIFY_TAG;
+        if( epoll_ctl(_pImpl->_epollFd, EPOLL_CTL_ADD, _pImpl->_inotifyFd, &ev) < 0 )
+        {
+            EvdevJoystickManagerP::throwError("[EvdevJoystickManager::EvdevJoystickManager(epoll_ctl)]", errno);
+        }
+
+        _pImpl->scan();
+    }
+    catch(...)
+    {
+        delete _pImpl;
+        throw;
+    }
+}
+
+//------------------------------------------------------------------------------
+EvdevJoystickManager::~EvdevJoystickManager() throw()
+//------------------------------------------------------------------------------
+{
+    delete _pImpl;
+}
+
+//------------------------------------------------------------------------------
+void EvdevJoystickManager::setListener(IListener* pListener)
+//------------------------------------------------------------------------------
+{
+    _pImpl->_pListener = pListener;
+}
+
+//------------------------------------------------------------------------------
+void EvdevJoystickManager::setDeadZone(int val)
+//------------------------------------------------------------------------------
+{
+    _pImpl->_deadZone = (val < 0) ? -val : val;
+}
+
+//------------------------------------------------------------------------------
+int EvdevJoystickManager::getDeadZone() const
+//------------------------------------------------------------------------------
+{
+    return _pImpl->_deadZone;
+}
+
+//------------------------------------------------------------------------------
+int EvdevJoystickManager::getFd() const
+//------------------------------------------------------------------------------
+{
+    return _pImpl->_epollFd;
+}
+
+//------------------------------------------------------------------------------
+unsigned int EvdevJoystickManager::process(int timeoutMs)
+//------------------------------------------------------------------------------
+{
+    struct epoll_event events[MAX_DEVICES + 1];
+    const int n = epoll_wait(_pImpl->_epollFd, events, MAX_DEVICES + 1, timeoutMs);
+    if( n < 0 )
+    {
+        if( errno == EINTR )
+        {
+            return 0;
+        }
+        std::ostringstream str;
+        str << "[EvdevJoystickManager::process(epoll_wait)]: " << strerror(errno);
+        throw IoEventHandlingException(errno, str.str());
+    }
+
+    unsigned int updates = 0;
+    for(int i = 0; i < n; ++i)
+    {
+        if( events[i].data.u32 == INOTIFY_TAG )
+        {
+            _pImpl->readHotplug();
+        }
+        else
+        {
+            updates += _pImpl->readDevice(events[i].data.u32);
+        }
+    }
+    return updates;
+}
+
+//------------------------------------------------------------------------------
+unsigned int EvdevJoystickManager::getDeviceCount() const
+//------------------------------------------------------------------------------
+{
+    unsigned int count = 0;
+    for(unsigned int i = 0; i < MAX_DEVICES; ++i)
+    {
+        count += (_pImpl->_devices[i].fd >= 0);
+    }
+    return count;
+}
+
+//------------------------------------------------------------------------------
+bool EvdevJoystickManager::isConnected(unsigned int device) const
+//------------------------------------------------------------------------------
+{
+    return (device < MAX_DEVICES) && (_pImpl->_devices[device].fd >= 0);
+}
+
+//------------------------------------------------------------------------------
+std::string EvdevJoystickManager::getName(unsigned int device) const
+//------------------------------------------------------------------------------
+{
+    _pImpl->checkSlot(device);
+    return _pImpl->_devices[device].name;
+}
+
+//------------------------------------------------------------------------------
+std::string EvdevJoystickManager::getPath(unsigned int device) const
+//------------------------------------------------------------------------------
+{
+    _pImpl->checkSlot(device);
+    return _pImpl->_devices[device].path;
+}
+
+//------------------------------------------------------------------------------
+const EvdevJoystickManager::State& EvdevJoystickManager::getState(unsigned int device) const
+//------------------------------------------------------------------------------
+{
+    _pImpl->checkSlot(device);
+    return _pImpl->_devices[device].state;
+}
+
+} // grape
@@ -0,0 +1,494 @@
+//==============================================================================
+// Project  : Grape
+// Module   : IO
+// File     : HostResolver.cpp
+//
+// Copyright (c) 2012, Vilas Chitrakaran
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//    * Redistributions of source code must retain the above copyright
+//      notice, this list of conditions and the following disclaimer.
+//    * Redistributions in binary form must reproduce the above copyright
+//      notice, this list of conditions and the following disclaimer in the
+//      documentation and/or other materials provided with the distribution.
+//    * Neither the name of the copyright holder nor the names of its
+//      contributors may be used to endorse or promote products derived from
+//      this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR ITS CONTRIBUTORS
+// BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF
+// THE POSSIBILITY OF SUCH DAMAGE.
+//==============================================================================
+
+#include "HostResolver.h"
+#include <map>
+#include <deque>
+#include <sstream>
+#include <string.h>
+
+#ifdef _MSC_VER
+#include <process.h>
+#else
+#include <netdb.h>
+#include <pthread.h>
+#include <time.h>
+#endif
+
+namespace grape
+{
+
+static const unsigned int FAILURE_TTL_MS = 5000; // failed lookups are retried after this, at most
+
+//==============================================================================
+/// \class HostResolverP
+/// \brief Private implementation. Cache, and a worker thread for background lookups
+//==============================================================================
+class HostResolverP
+{
+public:
+    typedef std::pair<std::string, int> Key; // host, family
+
+    struct Entry
+    {
+        Entry() : valid(false), error(0), expiresMs(0), pending(false) {}
+        bool valid;                     //!< address is set
+        HostResolver::Address address;
+        int error;                      //!< last lookup error, if not valid
+        std::string errorMsg;
+        long long expiresMs;
+        bool pending;                   //!< queued for background lookup
+    };
+    typedef std::map<Key, Entry> Cache;
+
+public:
+    HostResolverP(unsigned int ttlMs, unsigned int maxEntries);
+    ~HostResolverP() throw();
+    void lock();
+    void unlock();
+    Entry& entry(const Key& key); // call locked
+    void evict(); // call locked
+    void enqueue(const Key& key, Entry& entry); // call locked
+    Entry& store(const Key& key, bool ok, const HostResolver::Address& address, int error, const std::string& errorMsg); // call locked
+    static long long nowMs();
+    static bool lookup(const Key& key, HostResolver::Address& address, int& error, std::string& errorMsg);
+    static void setPort(HostResolver::Address& address, int port);
+    void work();
+#ifdef _MSC_VER
+    static unsigned __stdcall worker(void* pArg) { ((HostResolverP*)pArg)->work(); return 0; }
+#else
+    static void* worker(void* pArg) { ((HostResolverP*)pArg)->work(); return NULL; }
+#endif
+
+public:
+    Cache _cache;
+    std::deque<Key> _queue;
+    unsigned int _ttlMs;
+    unsigned int _maxEntries;
+    bool _stop;
+    bool _workerStarted;
+#ifdef _MSC_VER
+    SRWLOCK _lock;
+    CONDITION_VARIABLE _cond;
+    HANDLE _thread;
+#else
+    pthread_mutex_t _lock;
+    pthread_cond_t _cond;
+    pthread_t _thread;
+#endif
+}; // HostResolverP
+
+//------------------------------------------------------------------------------
+HostResolverP::HostResolverP(unsigned int ttlMs, unsigned int maxEntries)
+//------------------------------------------------------------------------------
+    : _ttlMs(ttlMs), _maxEntries(maxEntries), _stop(false), _workerStarted(false)
+{
+#ifdef _MSC_VER
+    InitializeSRWLock(&_lock);
+    InitializeConditionVariable(&_cond);
+#else
+    pthread_mutex_init(&_lock, NULL);
+    pthread_cond_init(&_cond, NULL);
+#endif
+}
+
+//------------------------------------------------------------------------------
+HostResolverP::~HostResolverP() throw()
+//------------------------------------------------------------------------------
+{
+    lock();
+    _stop = true;
+    unlock();
+#ifdef _MSC_VER
+    WakeConditionVariable(&_cond);
+    if( _workerStarted )
+    {
+        WaitForSingleObject(_thread, INFINITE);
+        CloseHandle(_thread);
+    }
+#else
+    pthread_cond_signal(&_cond);
+    if( _workerStarted )
+    {
+        pthread_join(_thread, NULL);
+    }
+    pthread_cond_destroy(&_cond);
+    pthread_mutex_destroy(&_lock);
+#endif
+}
+
+//------------------------------------------------------------------------------
+void HostResolverP::lock()
+//------------------------------------------------------------------------------
+{
+#ifdef _MSC_VER
+    AcquireSRWLockExclusive(&_lock);
+#else
+    pthread_mutex_lock(&_lock);
+#endif
+}
+
+//------------------------------------------------------------------------------
+void HostResolverP::unlock()
+//------------------------------------------------------------------------------
+{
+#ifdef _MSC_VER
+    ReleaseSRWLockExclusive(&_lock);
+#else
+    pthread_mutex_unlock(&_lock);
+#endif
+}
+
+//------------------------------------------------------------------------------
+long long HostResolverP::nowMs()
+//------------------------------------------------------------------------------
+{
+#ifdef _MSC_VER
+    return (long long)GetTickCount64();
+#else
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (long long)ts.tv_sec * 1000LL + ts.tv_nsec / 1000000L;
+#endif
+}
+
+//------------------------------------------------------------------------------
+bool HostResolverP::lookup(const Key& key, HostResolver::Address& address, int& error, std::string& errorMsg)
+//------------------------------------------------------------------------------
+{
+    struct addrinfo hints;
+    memset(&hints, 0, sizeof(hints));
+    hints.ai_family = (key.second == HostResolver::IPV4) ? AF_INET : ((key.second == HostResolver::IPV6) ? AF_INET6 : AF_UNSPEC);
+    hints.ai_socktype = SOCK_STREAM;
+
+    struct addrinfo* pResult = NULL;
+    error = getaddrinfo(key.first.c_str(), NULL, &hints, &pResult);
+    if( (error != 0) || (pResult == NULL) )
+    {
+        std::ostringstream str;
+        str << "[HostResolver::resolve(getaddrinfo)]: " << key.first << ": " << gai_strerror(error);
+        errorMsg = str.str();
+        return false;
+    }
+
+    memset(&address.storage, 0, sizeof(address.storage));
+    memcpy(&address.storage, pResult->ai_addr, pResult->ai_addrlen);
+    address.length = (socklen_t)pResult->ai_addrlen;
+    freeaddrinfo(pResult);
+    return true;
+}
+
+//------------------------------------------------------------------------------
+void HostResolverP::setPort(HostResolver::Address& address, int port)
+//------------------------------------------------------------------------------
+{
+    if( address.family() == AF_INET6 )
+    {
+        ((struct sockaddr_in6*)&address.storage)->sin6_port = htons(port);
+    }
+    else
+    {
+        ((struct sockaddr_in*)&address.storage)->sin_port = htons(port);
+    }
+}
+
+//------------------------------------------------------------------------------
+HostResolverP::Entry& HostResolverP::entry(const Key& key)
+//------------------------------------------------------------------------------
+{
+    Cache::iterator it = _cache.find(key);
+    if( it != _cache.end() )
+    {
+        return it->second;
+    }
+    if( _cache.size() >= _maxEntries )
+    {
+        evict();
+    }
+    return _cache[key];
+}
+
+//------------------------------------------------------------------------------
+void HostResolverP::evict()
+//------------------------------------------------------------------------------
+{
+    // drop expired entries. If there are none, drop the one expiring first.
+    // entries queued for lookup must stay, to track their pending state
+    const long long now = nowMs();
+    bool erased = false;
+    Cache::iterator oldest = _cache.end();
+    Cache::iterator it = _cache.begin();
+    while( it != _cache.end() )
+    {
+        if( it->second.pending )
+        {
+            ++it;
+        }
+        else if( now >= it->second.expiresMs )
+        {
+            _cache.erase(it++);
+            erased = true;
+        }
+        else
+        {
+            if( (oldest == _cache.end()) || (it->second.expiresMs < oldest->second.expiresMs) )
+            {
+                oldest = it;
+            }
+            ++it;
+        }
+    }
+    if( !erased && (oldest != _cache.end()) )
+    {
+        _cache.erase(oldest);
+    }
+}
+
+//------------------------------------------------------------------------------
+HostResolverP::Entry& HostResolverP::store(const Key& key, bool ok, const HostResolver::Address& address, int error, const std::string& errorMsg)
+//------------------------------------------------------------------------------
+{
+    // a failed refresh drops the previous address, so stale entries are not
+    // served for longer than one lookup past their expiry. Failures are cached
+    // for a shorter time, so that an unreachable host is not looked up on every call
+    Entry& e = entry(key);
+    e.valid = ok;
+    if( ok )
+    {
+        e.address = address;
+    }
+    e.error = error;
+    e.errorMsg = errorMsg;
+    e.expiresMs = nowMs() + ((ok || (_ttlMs < FAILURE_TTL_MS)) ? _ttlMs : FAILURE_TTL_MS);
+    return e;
+}
+
+//------------------------------------------------------------------------------
+void HostResolverP::enqueue(const Key& key, Entry& entry)
+//------------------------------------------------------------------------------
+{
+    if( entry.pending )
+    {
+        return;
+    }
+    entry.pending = true;
+    _queue.push_back(key);
+
+    if( !_workerStarted )
+    {
+#ifdef _MSC_VER
+        _thread = (HANDLE)_beginthreadex(NULL, 0, worker, this, 0, NULL);
+        _workerStarted = (_thread != 0);
+#else
+        _workerStarted = (pthread_create(&_thread, NULL, worker, this) == 0);
+#endif
+        if( !_workerStarted )
+        {
+            _queue.pop_back();
+            entry.pending = false;
+            return;
+        }
+    }
+#ifdef _MSC_VER
+    WakeConditionVariable(&_cond);
+#else
+    pthread_cond_signal(&_cond);
+#endif
+}
+
+//------------------------------------------------------------------------------
+void HostResolverP::work()
+//------------------------------------------------------------------------------
+{
+    lock();
+    while( !_stop )
+    {
+        if( _queue.empty() )
+        {
+#ifdef _MSC_VER
+            SleepConditionVariableSRW(&_cond, &_lock, INFINITE, 0);
+#else
+            pthread_cond_wait(&_cond, &_lock);
+#endif
+            continue;
+        }
+
+        Key key = _queue.front();
+        _queue.pop_front();
+        unlock();
+
+        HostResolver::Address address;
+        int error = 0;
+        std::string errorMsg;
+        bool ok = lookup(key, address, error, errorMsg);
+
+        lock();
+        store(key, ok, address, error, errorMsg).pending = false;
+    }
+    unlock();
+}
+
+//==============================================================================
+HostResolver::HostResolver(unsigned int ttlMs, unsigned int maxEntries)
+//==============================================================================
+    : _pImpl(new HostResolverP(ttlMs, maxEntries))
+{
+}
+
+//------------------------------------------------------------------------------
+HostResolver::~HostResolver() throw()
+//------------------------------------------------------------------------------
+{
+    delete _pImpl;
+}
+
+//------------------------------------------------------------------------------
+HostResolver& HostResolver::instance()
+//------------------------------------------------------------------------------
+{
+    // never destroyed: the worker may be blocked in getaddrinfo at exit, and
+    // joining it from a static destructor would hang the process
+    static HostResolver* pResolver = new HostResolver;
+    return *pResolver;
+}
+
+//------------------------------------------------------------------------------
+HostResolver::Address HostResolver::resolve(const std::string& host, int port, Family family)
+//------------------------------------------------------------------------------
+{
+    HostResolverP::Key key(host, family);
+    Address address;
+
+    _pImpl->lock();
+    HostResolverP::Cache::iterator it = _pImpl->_cache.find(key);
+    if( (it != _pImpl->_cache.end()) && it->second.valid && (HostResolverP::nowMs() < it->second.expiresMs) )
+    {
+        address = it->second.address;
+        _pImpl->unlock();
+        HostResolverP::setPort(address, port);
+        return address;
+    }
+    _pImpl->unlock();
+
+    int error = 0;
+    std::string errorMsg;
+    bool ok = HostResolverP::lookup(key, address, error, errorMsg);
+
+    _pImpl->lock();
+    _pImpl->store(key, ok, address, error, errorMsg);
+    _pImpl->unlock();
+
+    if( !ok )
+    {
+        throw HostInfoException(error, errorMsg);
+    }
+    HostResolverP::setPort(address, port);
+    return address;
+}
+
+//------------------------------------------------------------------------------
+bool HostResolver::tryResolve(const std::string& host, int port, Address& address, Family family)
+//------------------------------------------------------------------------------
+{
+    HostResolverP::Key key(host, family);
+
+    _pImpl->lock();
+    HostResolverP::Entry& entry = _pImpl->entry(key);
+    bool found = entry.valid;
+    if( found )
+    {
+        address = entry.address;
+    }
+    if( !entry.pending && (HostResolverP::nowMs() >= entry.expiresMs) )
+    {
+        _pImpl->enqueue(key, entry);
+    }
+    _pImpl->unlock();
+
+    if( found )
+    {
+        HostResolverP::setPort(address, port);
+    }
+    return found;
+}
+
+//------------------------------------------------------------------------------
+void HostResolver::prefetch(const std::string& host, Family family)
+//------------------------------------------------------------------------------
+{
+    HostResolverP::Key key(host, family);
+    _pImpl->lock();
+    _pImpl->enqueue(key, _pImpl->entry(key));
+    _pImpl->unlock();
+}
+
+//------------------------------------------------------------------------------
+void HostResolver::setTtl(unsigned int ttlMs)
+//------------------------------------------------------------------------------
+{
+    _pImpl->lock();
+    _pImpl->_ttlMs = ttlMs;
+    _pImpl->unlock();
+}
+
+//------------------------------------------------------------------------------
+void HostResolver::clear()
+//------------------------------------------------------------------------------
+{
+    _pImpl->lock();
+    // entries queued for lookup must stay, to track their pending state
+    HostResolverP::Cache::iterator it = _pImpl->_cache.begin();
+    while( it != _pImpl->_cache.end() )
+    {
+        if( it->second.pending )
+        {
+            ++it;
+        }
+        else
+        {
+            _pImpl->_cache.erase(it++);
+        }
+    }
+    _pImpl->unlock();
+}
+
+//------------------------------------------------------------------------------
+unsigned int HostResolver::cacheSize()
+//------------------------------------------------------------------------------
+{
+    _pImpl->lock();
+    unsigned int size = (unsigned int)_pImpl->_cache.size();
+    _pImpl->unlock();
+    return size;
+}
+
+} // grape
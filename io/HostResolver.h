@@ -0,0 +1,141 @@
+//==============================================================================
+// Project  : Grape
+// Module   : IO
+// File     : HostResolver.h
+// Brief    : Caching host name resolver
+//
+// Copyright (c) 2012, Vilas Chitrakaran
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//    * Redistributions of source code must retain the above copyright
+//      notice, this list of conditions and the following disclaimer.
+//    * Redistributions in binary form must reproduce the above copyright
+//      notice, this list of conditions and the following disclaimer in the
+//      documentation and/or other materials provided with the distribution.
+//    * Neither the name of the copyright holder nor the names of its
+//      contributors may be used to endorse or promote products derived from
+//      this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR ITS CONTRIBUTORS
+// BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF
+// THE POSSIBILITY OF SUCH DAMAGE.
+//==============================================================================
+
+#ifndef GRAPE_HOSTRESOLVER_H
+#define GRAPE_HOSTRESOLVER_H
+
+#include "IpSocket.h"
+#include <string>
+
+namespace grape
+{
+
+/// \brief Thread-safe host name resolver with a result cache
+/// \ingroup io
+///
+/// Resolves host names with getaddrinfo, for IPv4 and IPv6, and caches results
+/// for a configurable time-to-live so that repeated connections to the same
+/// host do not repeat the lookup. The cache holds a bounded number of hosts;
+/// when it is full, expired entries are evicted first, then the oldest.
+///
+/// Lookups can also run on a background thread: tryResolve() never blocks, and
+/// returns a cached address (refreshing it in the background when it has
+/// expired) or starts a lookup and returns false.
+/// \code
+/// // reconnect loop that never blocks on DNS
+/// grape::HostResolver::Address addr;
+/// if( grape::HostResolver::instance().tryResolve("supervisor", 5000, addr) )
+/// {
+///     socket.connect(addr);
+/// }
+/// \endcode
+///
+/// All methods are thread-safe. IpSocket uses the shared instance(), which is
+/// never destroyed so that exit does not wait for a pending lookup. On Windows,
+/// Winsock must be initialised (by creating any socket) before resolving.
+class GRAPEIO_DLL_API HostResolver
+{
+public:
+
+    /// \brief Address families to resolve
+    enum Family
+    {
+        IPV4,           //!< IPv4 addresses only
+        IPV6,           //!< IPv6 addresses only
+        ANY_FAMILY      //!< Whichever the system prefers for the host
+    };
+
+    /// \brief A resolved socket address
+    struct Address
+    {
+        struct sockaddr_storage storage;    //!< sockaddr_in or sockaddr_in6
+        socklen_t length;                   //!< Valid length of storage
+
+        int family() const { return storage.ss_family; }
+        const struct sockaddr* get() const { return (const struct sockaddr*)&storage; }
+    };
+
+public:
+
+    /// \param ttlMs       Time for which results are cached, in milliseconds
+    /// \param maxEntries  Maximum number of hosts kept in the cache
+    explicit HostResolver(unsigned int ttlMs = 60000, unsigned int maxEntries = 1024);
+    ~HostResolver() throw();
+
+    /// \return Resolver shared by all sockets in the process
+    static HostResolver& instance();
+
+    /// Resolve a host name, using the cache where possible. Blocks on a cache miss.
+    /// \param host     Host name or numeric address
+    /// \param port     Port number to fill into the address
+    /// \param family   Address family to resolve
+    /// \return The first address found for the host
+    /// \throw HostInfoException if the host cannot be resolved
+    Address resolve(const std::string& host, int port, Family family = IPV4);
+
+    /// Resolve a host name without blocking. If the host is cached, returns the
+    /// cached address. An expired entry is refreshed in the background and served
+    /// until the refresh completes; if the refresh fails, the entry is dropped and
+    /// this returns false until a later lookup succeeds. Otherwise, a background
+    /// lookup is started. Failed lookups are retried after the TTL or 5 seconds,
+    /// whichever is shorter.
+    /// \param host     Host name or numeric address
+    /// \param port     Port number to fill into the address
+    /// \param address  Resolved address, if available
+    /// \param family   Address family to resolve
+    /// \return true if address was set. false if the lookup is in progress or failed;
+    ///         call again later.
+    bool tryResolve(const std::string& host, int port, Address& address, Family family = IPV4);
+
+    /// Start a background lookup to populate the cache ahead of use
+    void prefetch(const std::string& host, Family family = IPV4);
+
+    /// Set the time for which results are cached
+    void setTtl(unsigned int ttlMs);
+
+    /// Discard all cached results
+    void clear();
+
+    /// \return Number of hosts in the cache, including failed and pending lookups
+    unsigned int cacheSize();
+
+private:
+    HostResolver(const HostResolver&);              //!< disable copy
+    HostResolver &operator=(const HostResolver&);   //!< disable assignment
+private:
+    class HostResolverP* _pImpl;                    //!< private implementation
+}; // HostResolver
+
+} // grape
+
+#endif // GRAPE_HOSTRESOLVER_H
@@ -0,0 +1,105 @@
+//==============================================================================
+// Project  : Grape
+// Module   : IO
+// File     : IDataPort.cpp
+//
+// Copyright (c) 2012, Vilas Chitrakaran
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//    * Redistributions of source code must retain the above copyright
+//      notice, this list of conditions and the following disclaimer.
+//    * Redistributions in binary form must reproduce the above copyright
+//      notice, this list of conditions and the following disclaimer in the
+//      documentation and/or other materials provided with the distribution.
+//    * Neither the name of the copyright holder nor the names of its
+//      contributors may be used to endorse or promote products derived from
+//      this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR ITS CONTRIBUTORS
+// BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF
+// THE POSSIBILITY OF SUCH DAMAGE.
+//==============================================================================
+
+#include "IDataPort.h"
+#include <errno.h>
+
+#ifdef _MSC_VER
+#include <Winsock2.h>
+#else
+#include <poll.h>
+#include <time.h>
+#endif
+
+namespace grape
+{
+
+//------------------------------------------------------------------------------
+unsigned int IDataPort::waitForAny(IDataPort* const* ports, unsigned int count, bool* ready, long long timeoutNs)
+//------------------------------------------------------------------------------
+{
+    static const unsigned int MAX_STACK_FDS = 64;
+    struct pollfd stackFds[MAX_STACK_FDS];
+    std::vector<struct pollfd> heapFds;
+    struct pollfd* fds = stackFds;
+    if( count > MAX_STACK_FDS )
+    {
+        heapFds.resize(count);
+        fds = &heapFds[0];
+    }
+
+    for(unsigned int i = 0; i < count; ++i)
+    {
+        fds[i].fd = ports[i]->getFd();
+        if( fds[i].fd < 0 )
+        {
+            throw IoEventHandlingException(EBADF, "[IDataPort::waitForAny]: Port has no file descriptor");
+        }
+        fds[i].events = POLLIN;
+        fds[i].revents = 0;
+    }
+
+#ifdef _MSC_VER
+    int ret = WSAPoll(fds, count, (timeoutNs < 0) ? -1 : (int)(timeoutNs / 1000000LL));
+#else
+    struct timespec ts;
+    struct timespec* pTs = NULL;
+    if( timeoutNs >= 0 )
+    {
+        ts.tv_sec = timeoutNs / 1000000000LL;
+        ts.tv_nsec = timeoutNs % 1000000000LL;
+        pTs = &ts;
+    }
+    int ret = ppoll(fds, count, pTs, NULL);
+#endif
+
+    if( ret < 0 )
+    {
+        if( errno == EINTR )
+        {
+            ret = 0;
+        }
+        else
+        {
+            throw IoEventHandlingException(errno, "[IDataPort::waitForAny(poll)] failed");
+        }
+    }
+
+    for(unsigned int i = 0; i < count; ++i)
+    {
+        // end-of-stream and errors count as ready, so the next read reports them
+        ready[i] = (ret > 0) && (fds[i].revents != 0);
+    }
+    return ret;
+}
+
+} // grape
@@ -55,6 +55,16 @@ public:
         PORT_TIMEOUT,
         PORT_ERROR
     };
+
+    /// \brief A contiguous block of data. Used for gather writes. See writev()
+    struct Buffer
+    {
+        const unsigned char* pData;
+        unsigned int size;
+    };
+
+    /// Maximum number of buffers passed to the system in one gather write. See writev()
+    static const unsigned int MAX_WRITEV_BUFFERS = 64;
 public:
 
     virtual ~IDataPort() throw(/*nothing*/) {}
@@ -82,6 +92,14 @@ public:
     /// \throw IoReadException, IoEventHandlingException
     virtual unsigned int readn(std::vector<unsigned char>& buffer, unsigned int bytes) = 0;
 
+    /// Read specified number of data bytes from the port into caller provided memory.
+    /// \param pBuffer  Buffer for read data. Must have space for at least 'bytes' bytes.
+    /// \param bytes    Number of bytes to read
+    /// \return         The number of bytes read.
+    /// \see waitForRead, availableToRead
+    /// \throw IoReadException, IoEventHandlingException
+    virtual unsigned int readn(unsigned char* pBuffer, unsigned int bytes) = 0;
+
     /// Find the number of bytes available and waiting to be read
     /// without actually reading them.
     /// \return The number of bytes available to read.
@@ -107,6 +125,30 @@ public:
     /// \throw IoWriteException, IoEventHandlingException
     virtual unsigned int write(const std::vector<unsigned char>& buffer) = 0;
 
+    /// Write data from caller provided memory to the port
+    /// \param pBuffer  Data to be written.
+    /// \param bytes    Number of bytes to write. Note that not all data may get
+    ///                 written. Return value for number of bytes actually written.
+    /// \return         Number of bytes written.
+    /// \see waitForWrite
+    /// \throw IoWriteException, IoEventHandlingException
+    virtual unsigned int write(const unsigned char* pBuffer, unsigned int bytes) = 0;
+
+    /// Gather write. Write data from several buffers in a single operation, as if
+    /// they were concatenated. The default implementation calls write() for each
+    /// buffer in turn; ports override this with a single system call where possible.
+    ///
+    /// Stream ports accept any number of buffers and pass them to the system
+    /// MAX_WRITEV_BUFFERS at a time, stopping at the first partial write. Datagram
+    /// ports send all buffers as one datagram and throw if count is larger than
+    /// MAX_WRITEV_BUFFERS; they never send a truncated message.
+    /// \param buffers  Array of buffers
+    /// \param count    Number of buffers in the array
+    /// \return         Total number of bytes written. Note that not all data may get written.
+    /// \see waitForWrite
+    /// \throw IoWriteException, IoEventHandlingException
+    virtual unsigned int writev(const Buffer* buffers, unsigned int count);
+
     /// Wait until all bytes from last write operation have been transmitted
     /// \param timeoutMs    Milliseconds to wait before returning.
     ///                     Specify negative number for infinite wait period.
@@ -118,11 +160,45 @@ public:
     /// Flush data written but not transmitted
     virtual void flushTx() = 0;
 
+    /// \return The native file descriptor of the port on POSIX platforms, for use
+    ///         with event demultiplexers such as IoReactor. Returns -1 if the port
+    ///         is not open or has no file descriptor.
+    virtual int getFd() const { return -1; }
+
+    /// Wait until at least one of several ports is ready for a read operation.
+    /// Uses a single poll() call, so there is no limit on descriptor values.
+    /// \param ports       Array of ports. Every port must provide a file descriptor
+    ///                    (see getFd()); on Windows, only sockets are supported.
+    /// \param count       Number of ports in the array
+    /// \param ready       Array of count flags. On return, ready[i] is true if ports[i]
+    ///                    has data, or has been closed or failed (the next read reports it).
+    /// \param timeoutNs   Nanoseconds to wait before returning. Negative for infinite wait.
+    /// \return            The number of ready ports. 0 on timeout or signal interruption.
+    /// \throw IoEventHandlingException
+    static unsigned int waitForAny(IDataPort* const* ports, unsigned int count, bool* ready, long long timeoutNs);
+
 protected:
     IDataPort() {}
 
 }; // IDataPort
 
+//------------------------------------------------------------------------------
+inline unsigned int IDataPort::writev(const Buffer* buffers, unsigned int count)
+//------------------------------------------------------------------------------
+{
+    unsigned int total = 0;
+    for(unsigned int i = 0; i < count; ++i)
+    {
+        unsigned int n = write(buffers[i].pData, buffers[i].size);
+        total += n;
+        if( n < buffers[i].size )
+        {
+            break;
+        }
+    }
+    return total;
+}
+
 } // grape
 
 #endif // GRAPEIO_IDATAPORT_H
@@ -0,0 +1,165 @@
+//==============================================================================
+// Project  : Grape
+// Module   : IO
+// File     : IoReactor.h
+// Brief    : Event demultiplexer for data ports
+//
+// Copyright (c) 2012, Vilas Chitrakaran
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//    * Redistributions of source code must retain the above copyright
+//      notice, this list of conditions and the following disclaimer.
+//    * Redistributions in binary form must reproduce the above copyright
+//      notice, this list of conditions and the following disclaimer in the
+//      documentation and/or other materials provided with the distribution.
+//    * Neither the name of the copyright holder nor the names of its
+//      contributors may be used to endorse or promote products derived from
+//      this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR ITS CONTRIBUTORS
+// BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF
+// THE POSSIBILITY OF SUCH DAMAGE.
+//==============================================================================
+
+#ifndef GRAPEIO_IOREACTOR_H
+#define GRAPEIO_IOREACTOR_H
+
+#include "IDataPort.h"
+
+namespace grape
+{
+
+/// \class IoReactor
+/// \ingroup io
+/// \brief Services many data ports from a single thread
+///
+/// IoReactor waits for readiness events on any number of registered ports
+/// (TcpSocket, UdpSocket, SerialPort, or any other IDataPort that provides a
+/// file descriptor) and dispatches them to user supplied handlers. It is built on
+/// Linux epoll, so the cost of a wait does not grow with the number of ports.
+///
+/// Ports are registered edge-triggered by default: a handler is notified once
+/// when a port becomes readable, and must drain the port before the next
+/// notification is generated. For example:
+/// \code
+/// class EchoHandler : public grape::IoReactor::IHandler
+/// {
+/// public:
+///     EchoHandler(grape::TcpSocket& socket) : _socket(socket) {}
+///     void onEvent(int fd, unsigned int events)
+///     {
+///         while( _socket.availableToRead() )
+///         {
+///             _socket.readAll(_buffer);
+///             _socket.write(_buffer);
+///         }
+///     }
+/// private:
+///     grape::TcpSocket& _socket;
+///     std::vector<unsigned char> _buffer;
+/// };
+///
+/// grape::IoReactor reactor;
+/// EchoHandler handler(socket);
+/// reactor.add(socket, &handler);
+/// reactor.run(); // until reactor.stop() is called from another thread
+/// \endcode
+///
+/// Methods throw IoEventHandlingException on error. Registration methods are
+/// not thread-safe and must be called from the thread that runs dispatch();
+/// stop() may be called from any thread.
+class GRAPEIO_DLL_API IoReactor
+{
+public:
+
+    /// \brief Event flags
+    enum Event
+    {
+        READABLE        = 0x01, //!< Port has data to read
+        WRITABLE        = 0x02, //!< Port can accept data for writing
+        HANGUP          = 0x04, //!< Remote end closed the connection (reported only)
+        FAULT           = 0x08, //!< Error condition on port (reported only)
+        LEVEL_TRIGGERED = 0x10  //!< Registration flag. Notify as long as the port is ready, not just on change
+    };
+
+    /// \brief Interface for event handlers
+    class GRAPEIO_DLL_API IHandler
+    {
+    public:
+        virtual ~IHandler() {}
+
+        /// Called from dispatch() when a registered port is ready
+        /// \param fd       File descriptor of the port
+        /// \param events   Bitwise OR of Event flags that are set
+        virtual void onEvent(int fd, unsigned int events) = 0;
+    };
+
+public:
+
+    /// Create the reactor
+    /// \param maxEventsPerWait Maximum number of events collected by a single
+    ///                         wait in dispatch()
+    /// \throw IoEventHandlingException
+    explicit IoReactor(unsigned int maxEventsPerWait = 64);
+    ~IoReactor() throw();
+
+    /// Register a port
+    /// \param port     An open port. The port must remain open until removed.
+    /// \param pHandler Handler to be notified of events on the port.
+    /// \param events   Bitwise OR of READABLE, WRITABLE and LEVEL_TRIGGERED
+    /// \throw IoEventHandlingException
+    void add(IDataPort& port, IHandler* pHandler, unsigned int events = READABLE);
+
+    /// Register a file descriptor. Use this for devices that are not data ports.
+    /// \copydetails add(IDataPort&, IHandler*, unsigned int)
+    void add(int fd, IHandler* pHandler, unsigned int events = READABLE);
+
+    /// Change the events of interest for a registered port
+    /// \throw IoEventHandlingException
+    void modify(IDataPort& port, unsigned int events) { modify(port.getFd(), events); }
+    void modify(int fd, unsigned int events);
+
+    /// Unregister a port. Remove ports before closing them. It is safe to call
+    /// this from within a handler, including for a port other than the one being
+    /// serviced.
+    /// \throw IoEventHandlingException
+    void remove(IDataPort& port) { remove(port.getFd()); }
+    void remove(int fd);
+
+    /// \return Number of registered ports
+    unsigned int size() const;
+
+    /// Wait for events and dispatch them to handlers
+    /// \param timeoutMs    Milliseconds to wait for events. Set negative number
+    ///                     for infinite wait period.
+    /// \return Number of events dispatched. 0 on timeout or if stop() was called.
+    /// \throw IoEventHandlingException
+    unsigned int dispatch(int timeoutMs);
+
+    /// Dispatch events continuously until stop() is called
+    /// \throw IoEventHandlingException
+    void run();
+
+    /// Unblock dispatch() and make run() return. Thread-safe.
+    void stop() throw();
+
+private:
+    IoReactor(const IoReactor&);            //!< disable copy
+    IoReactor &operator=(const IoReactor&); //!< disable assignment
+private:
+    class IoReactorP* _pImpl;               //!< platform specific private implementation
+}; // IoReactor
+
+} // grape
+
+#endif // GRAPEIO_IOREACTOR_H
@@ -0,0 +1,337 @@
+//==============================================================================
+// Project  : Grape
+// Module   : IO
+// File     : IoReactor_unix.cpp
+//
+// Copyright (c) 2012, Vilas Chitrakaran
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//    * Redistributions of source code must retain the above copyright
+//      notice, this list of conditions and the following disclaimer.
+//    * Redistributions in binary form must reproduce the above copyright
+//      notice, this list of conditions and the following disclaimer in the
+//      documentation and/or other materials provided with the distribution.
+//    * Neither the name of the copyright holder nor the names of its
+//      contributors may be used to endorse or promote products derived from
+//      this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR ITS CONTRIBUTORS
+// BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF
+// THE POSSIBILITY OF SUCH DAMAGE.
+//==============================================================================
+
+#include "IoReactor.h"
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <unistd.h>
+#include <errno.h>
+#include <string.h>
+#include <map>
+#include <vector>
+#include <sstream>
+
+namespace grape
+{
+
+//==============================================================================
+/// \class IoReactorP
+/// \brief Linux specific private implementation
+//==============================================================================
+class IoReactorP
+{
+public:
+    /// registration record. epoll_event::data.ptr points to one of these
+    struct Registration
+    {
+        int fd;
+        IoReactor::IHandler* pHandler;
+    };
+    typedef std::map<int, Registration*> RegistrationMap;
+public:
+    IoReactorP(unsigned int maxEvents);
+    ~IoReactorP() throw();
+    static unsigned int toEpoll(unsigned int events);
+    static unsigned int fromEpoll(unsigned int events);
+    void throwException(int code, const std::string& location);
+    void releaseRemoved() throw();
+public:
+    int _epollFd;
+    int _wakeFd;                                //!< eventfd used by stop()
+    int _stopRequested;
+    std::vector<struct epoll_event> _events;
+    RegistrationMap _registrations;
+    std::vector<Registration*> _removed;        //!< released after current dispatch
+}; // IoReactorP
+
+//==============================================================================
+IoReactorP::IoReactorP(unsigned int maxEvents)
+//==============================================================================
+    : _epollFd(-1), _wakeFd(-1), _stopRequested(0), _events(maxEvents > 0 ? maxEvents : 1)
+{
+    _epollFd = epoll_create1(EPOLL_CLOEXEC);
+    if( _epollFd == -1 )
+    {
+        throwException(errno, "[IoReactor::IoReactor(epoll_create1)]");
+    }
+
+    _wakeFd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    if( _wakeFd == -1 )
+    {
+        int e = errno;
+        ::close(_epollFd);
+        throwException(e, "[IoReactor::IoReactor(eventfd)]");
+    }
+
+    struct epoll_event ev;
+    memset(&ev, 0, sizeof(ev));
+    ev.events = EPOLLIN;
+    ev.data.ptr = NULL; // identifies the wakeup descriptor
+    if( epoll_ctl(_epollFd, EPOLL_CTL_ADD, _wakeFd, &ev) == -1 )
+    {
+        int e = errno;
+        ::close(_wakeFd);
+        ::close(_epollFd);
+        throwException(e, "[IoReactor::IoReactor(epoll_ctl)]");
+    }
+}
+
+//------------------------------------------------------------------------------
+IoReactorP::~IoReactorP() throw()
+//------------------------------------------------------------------------------
+{
+    releaseRemoved();
+    for(RegistrationMap::iterator it = _registrations.begin(); it != _registrations.end(); ++it)
+    {
+        delete it->second;
+    }
+    ::close(_wakeFd);
+    ::close(_epollFd);
+}
+
+//------------------------------------------------------------------------------
+unsigned int IoReactorP::toEpoll(unsigned int events)
+//------------------------------------------------------------------------------
+{
+    unsigned int ev = EPOLLRDHUP;
+    if( events & IoReactor::READABLE ) { ev |= EPOLLIN; }
+    if( events & IoReactor::WRITABLE ) { ev |= EPOLLOUT; }
+    if( !(events & IoReactor::LEVEL_TRIGGERED) ) { ev |= EPOLLET; }
+    return ev;
+}
+
+//------------------------------------------------------------------------------
+unsigned int IoReactorP::fromEpoll(unsigned int ev)
+//------------------------------------------------------------------------------
+{
+    unsigned int events = 0;
+    if( ev & EPOLLIN ) { events |= IoReactor::READABLE; }
+    if( ev & EPOLLOUT ) { events |= IoReactor::WRITABLE; }
+    if( ev & (EPOLLHUP | EPOLLRDHUP) ) { events |= IoReactor::HANGUP; }
+    if( ev & EPOLLERR ) { events |= IoReactor::FAULT; }
+    return events;
+}
+
+//------------------------------------------------------------------------------
+void IoReactorP::throwException(int code, const std::string& location)
+//------------------------------------------------------------------------------
+{
+    std::ostringstream str;
+    str << location << ": " << strerror(code);
+    throw IoEventHandlingException(code, str.str());
+}
+
+//------------------------------------------------------------------------------
+void IoReactorP::releaseRemoved() throw()
+//------------------------------------------------------------------------------
+{
+    for(size_t i = 0; i < _removed.size(); ++i)
+    {
+        delete _removed[i];
+    }
+    _removed.clear();
+}
+
+//==============================================================================
+IoReactor::IoReactor(unsigned int maxEventsPerWait)
+//==============================================================================
+    : _pImpl(new IoReactorP(maxEventsPerWait))
+{
+}
+
+//------------------------------------------------------------------------------
+IoReactor::~IoReactor() throw()
+//------------------------------------------------------------------------------
+{
+    delete _pImpl;
+}
+
+//------------------------------------------------------------------------------
+void IoReactor::add(IDataPort& port, IHandler* pHandler, unsigned int events)
+//------------------------------------------------------------------------------
+{
+    int fd = port.getFd();
+    if( fd < 0 )
+    {
+        throw IoEventHandlingException(-1, "[IoReactor::add]: Port is not open or has no file descriptor");
+    }
+    add(fd, pHandler, events);
+}
+
+//------------------------------------------------------------------------------
+void IoReactor::add(int fd, IHandler* pHandler, unsigned int events)
+//------------------------------------------------------------------------------
+{
+    if( pHandler == NULL )
+    {
+        throw IoEventHandlingException(-1, "[IoReactor::add]: Handler not specified");
+    }
+
+    if( _pImpl->_registrations.find(fd) != _pImpl->_registrations.end() )
+    {
+        throw IoEventHandlingException(EEXIST, "[IoReactor::add]: Descriptor already registered");
+    }
+
+    IoReactorP::Registration* pReg = new IoReactorP::Registration;
+    pReg->fd = fd;
+    pReg->pHandler = pHandler;
+
+    struct epoll_event ev;
+    memset(&ev, 0, sizeof(ev));
+    ev.events = IoReactorP::toEpoll(events);
+    ev.data.ptr = pReg;
+    if( epoll_ctl(_pImpl->_epollFd, EPOLL_CTL_ADD, fd, &ev) == -1 )
+    {
+        int e = errno;
+        delete pReg;
+        _pImpl->throwException(e, "[IoReactor::add(epoll_ctl)]");
+    }
+
+    _pImpl->_registrations[fd] = pReg;
+}
+
+//------------------------------------------------------------------------------
+void IoReactor::modify(int fd, unsigned int events)
+//------------------------------------------------------------------------------
+{
+    IoReactorP::RegistrationMap::iterator it = _pImpl->_registrations.find(fd);
+    if( it == _pImpl->_registrations.end() )
+    {
+        throw IoEventHandlingException(ENOENT, "[IoReactor::modify]: Descriptor not registered");
+    }
+
+    struct epoll_event ev;
+    memset(&ev, 0, sizeof(ev));
+    ev.events = IoReactorP::toEpoll(events);
+    ev.data.ptr = it->second;
+    if( epoll_ctl(_pImpl->_epollFd, EPOLL_CTL_MOD, fd, &ev) == -1 )
+    {
+        _pImpl->throwException(errno, "[IoReactor::modify(epoll_ctl)]");
+    }
+}
+
+//------------------------------------------------------------------------------
+void IoReactor::remove(int fd)
+//------------------------------------------------------------------------------
+{
+    IoReactorP::RegistrationMap::iterator it = _pImpl->_registrations.find(fd);
+    if( it == _pImpl->_registrations.end() )
+    {
+        return;
+    }
+
+    IoReactorP::Registration* pReg = it->second;
+    _pImpl->_registrations.erase(it);
+
+    // events for this descriptor may still be pending in the current dispatch
+    // batch. Disable the record now and free it once the batch is done
+    pReg->pHandler = NULL;
+    _pImpl->_removed.push_back(pReg);
+
+    if( (epoll_ctl(_pImpl->_epollFd, EPOLL_CTL_DEL, fd, NULL) == -1) && (errno != EBADF) )
+    {
+        _pImpl->throwException(errno, "[IoReactor::remove(epoll_ctl)]");
+    }
+}
+
+//------------------------------------------------------------------------------
+unsigned int IoReactor::size() const
+//------------------------------------------------------------------------------
+{
+    return _pImpl->_registrations.size();
+}
+
+//------------------------------------------------------------------------------
+unsigned int IoReactor::dispatch(int timeoutMs)
+//------------------------------------------------------------------------------
+{
+    int nEvents = epoll_wait(_pImpl->_epollFd, &_pImpl->_events[0], _pImpl->_events.size(), (timeoutMs < 0) ? -1 : timeoutMs);
+    if( nEvents == -1 )
+    {
+        if( errno == EINTR )
+        {
+            return 0;
+        }
+        _pImpl->throwException(errno, "[IoReactor::dispatch(epoll_wait)]");
+    }
+
+    unsigned int nDispatched = 0;
+    try
+    {
+        for(int i = 0; i < nEvents; ++i)
+        {
+            IoReactorP::Registration* pReg = (IoReactorP::Registration*)_pImpl->_events[i].data.ptr;
+            if( pReg == NULL )
+            {
+                // woken up by stop()
+                eventfd_t val;
+                eventfd_read(_pImpl->_wakeFd, &val);
+                continue;
+            }
+            if( pReg->pHandler == NULL )
+            {
+                continue; // removed by an earlier handler in this batch
+            }
+            pReg->pHandler->onEvent(pReg->fd, IoReactorP::fromEpoll(_pImpl->_events[i].events));
+            ++nDispatched;
+        }
+    }
+    catch(...)
+    {
+        _pImpl->releaseRemoved();
+        throw;
+    }
+
+    _pImpl->releaseRemoved();
+    return nDispatched;
+}
+
+//------------------------------------------------------------------------------
+void IoReactor::run()
+//------------------------------------------------------------------------------
+{
+    while( !__atomic_load_n(&_pImpl->_stopRequested, __ATOMIC_ACQUIRE) )
+    {
+        dispatch(-1);
+    }
+    __atomic_store_n(&_pImpl->_stopRequested, 0, __ATOMIC_RELEASE);
+}
+
+//------------------------------------------------------------------------------
+void IoReactor::stop() throw()
+//------------------------------------------------------------------------------
+{
+    __atomic_store_n(&_pImpl->_stopRequested, 1, __ATOMIC_RELEASE);
+    eventfd_write(_pImpl->_wakeFd, 1);
+}
+
+} // grape
@@ -0,0 +1,191 @@
+//==============================================================================
+// Project  : Grape
+// Module   : IO
+// File     : IoUring.h
+// Brief    : Asynchronous socket IO using Linux io_uring
+//
+// Copyright (c) 2012, Vilas Chitrakaran
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//    * Redistributions of source code must retain the above copyright
+//      notice, this list of conditions and the following disclaimer.
+//    * Redistributions in binary form must reproduce the above copyright
+//      notice, this list of conditions and the following disclaimer in the
+//      documentation and/or other materials provided with the distribution.
+//    * Neither the name of the copyright holder nor the names of its
+//      contributors may be used to endorse or promote products derived from
+//      this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR ITS CONTRIBUTORS
+// BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF
+// THE POSSIBILITY OF SUCH DAMAGE.
+//==============================================================================
+
+#ifndef GRAPEIO_IOURING_H
+#define GRAPEIO_IOURING_H
+
+#include "IpSocket.h"
+
+struct msghdr;
+
+namespace grape
+{
+
+/// \class IoUring
+/// \ingroup io
+/// \brief Batched asynchronous IO on sockets using Linux io_uring
+///
+/// IoUring queues read and write requests on any number of sockets and hands
+/// them to the kernel in a single system call. Completions are collected from
+/// a ring shared with the kernel without further system calls. This moves
+/// high-rate telemetry with far fewer kernel transitions than one blocking
+/// readn()/write() per message.
+///
+/// Usage:
+/// - Queue requests with submitRecv(), submitSend() and friends. Each request
+///   carries a user defined tag returned with its completion. Buffers must
+///   remain valid until the request completes.
+/// - Call submit() to pass all queued requests to the kernel. Optionally wait
+///   for completions in the same call.
+/// - Call reap() to collect completions.
+/// - For lowest overhead, register frequently used sockets (registerSockets())
+///   and buffers (registerBuffers()). Requests on registered sockets
+///   automatically use the fixed file table. Registered buffers are used with
+///   submitReadFixed() and submitWriteFixed().
+///
+/// \code
+/// grape::IoUring ring(64);
+/// ring.submitRecv(socket, rxBuffer, sizeof(rxBuffer), RX_TAG);
+/// ring.submitSend(socket, txBuffer, txLength, TX_TAG);
+/// ring.submit(1); // submit both and wait for at least one completion
+///
+/// grape::IoUring::Completion done[16];
+/// unsigned int n = ring.reap(done, 16);
+/// \endcode
+///
+/// Requires Linux 5.6 or later. Methods throw IoException on error.
+class GRAPEIO_DLL_API IoUring
+{
+public:
+
+    /// \brief Result of a completed request
+    struct Completion
+    {
+        unsigned long long tag; //!< User tag given when the request was queued
+        int result;             //!< Bytes transferred, or -errno on failure
+    };
+
+    /// \brief A memory region for registration with registerBuffers()
+    struct Buffer
+    {
+        unsigned char* pData;
+        unsigned int size;
+    };
+
+public:
+
+    /// Create the submission and completion rings
+    /// \param queueDepth Maximum number of requests that can be queued before
+    ///                   submit(). Rounded up to a power of 2 by the kernel.
+    /// \throw IoException if io_uring is unavailable
+    explicit IoUring(unsigned int queueDepth = 128);
+    ~IoUring() throw();
+
+    /// \return true if the running kernel supports io_uring
+    static bool isSupported();
+
+    /// Register sockets with the kernel, so that requests on them avoid per
+    /// request file reference counting. Replaces any earlier registration.
+    /// \throw IoException
+    void registerSockets(IpSocket* const* sockets, unsigned int count);
+
+    /// Remove a socket from the registration. Call this before closing a
+    /// registered socket that is to be reopened (eg: reconnected) while the
+    /// ring is in use: the kernel keeps the registered file open, so requests
+    /// would otherwise go to the old connection. Sockets not registered are
+    /// ignored.
+    /// \throw IoException
+    void unregisterSocket(IpSocket& socket);
+
+    /// Register buffers with the kernel, so that they are pinned once instead
+    /// of being mapped on every request. Replaces any earlier registration.
+    /// \throw IoException
+    void registerBuffers(const Buffer* buffers, unsigned int count);
+
+    /// Queue a receive request. (This, and other submit methods, submit queued
+    /// requests implicitly if the submission queue is full)
+    /// \param socket   Socket to read from
+    /// \param pBuffer  Destination buffer
+    /// \param bytes    Maximum number of bytes to receive
+    /// \param tag      User value returned in the completion
+    /// \throw IoException
+    void submitRecv(IpSocket& socket, unsigned char* pBuffer, unsigned int bytes, unsigned long long tag);
+
+    /// Queue a send request
+    /// \param socket   Socket to write to. For UDP, the socket must be connected
+    ///                 or use submitSendMsg() instead
+    /// \param pBuffer  Data to send
+    /// \param bytes    Number of bytes to send
+    /// \param tag      User value returned in the completion
+    /// \throw IoException
+    void submitSend(IpSocket& socket, const unsigned char* pBuffer, unsigned int bytes, unsigned long long tag);
+
+    /// Queue a recvmsg request. Use for datagrams when the source address is required.
+    /// \param pMsg Message header. Must remain valid until the request completes.
+    /// \throw IoException
+    void submitRecvMsg(IpSocket& socket, struct msghdr* pMsg, unsigned long long tag);
+
+    /// Queue a sendmsg request. Use for datagrams to a specific destination.
+    /// \param pMsg Message header. Must remain valid until the request completes.
+    /// \throw IoException
+    void submitSendMsg(IpSocket& socket, const struct msghdr* pMsg, unsigned long long tag);
+
+    /// Queue a read into a registered buffer
+    /// \param bufferIndex  Index of buffer given to registerBuffers()
+    /// \param offset       Offset into the buffer to read into
+    /// \param bytes        Maximum number of bytes to read
+    /// \throw IoException
+    void submitReadFixed(IpSocket& socket, unsigned int bufferIndex, unsigned int offset, unsigned int bytes, unsigned long long tag);
+
+    /// Queue a write from a registered buffer
+    /// \param bufferIndex  Index of buffer given to registerBuffers()
+    /// \param offset       Offset into the buffer to write from
+    /// \param bytes        Number of bytes to write
+    /// \throw IoException
+    void submitWriteFixed(IpSocket& socket, unsigned int bufferIndex, unsigned int offset, unsigned int bytes, unsigned long long tag);
+
+    /// \return Number of requests queued but not yet submitted
+    unsigned int pending() const;
+
+    /// Submit all queued requests to the kernel with a single system call
+    /// \param waitFor  Block until at least this many completions are available
+    /// \return Number of requests submitted
+    /// \throw IoException
+    unsigned int submit(unsigned int waitFor = 0);
+
+    /// Collect completed requests without a system call
+    /// \param completions  Array to receive completions
+    /// \param max          Size of array
+    /// \return Number of completions copied into the array
+    unsigned int reap(Completion* completions, unsigned int max);
+
+private:
+    IoUring(const IoUring&);            //!< disable copy
+    IoUring &operator=(const IoUring&); //!< disable assignment
+private:
+    class IoUringP* _pImpl;             //!< platform specific private implementation
+}; // IoUring
+
+} // grape
+
+#endif // GRAPEIO_IOURING_H
@@ -0,0 +1,532 @@
+//==============================================================================
+// Project  : Grape
+// Module   : IO
+// File     : IoUring_unix.cpp
+//
+// Copyright (c) 2012, Vilas Chitrakaran
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//    * Redistributions of source code must retain the above copyright
+//      notice, this list of conditions and the following disclaimer.
+//    * Redistributions in binary form must reproduce the above copyright
+//      notice, this list of conditions and the following disclaimer in the
+//      documentation and/or other materials provided with the distribution.
+//    * Neither the name of the copyright holder nor the names of its
+//      contributors may be used to endorse or promote products derived from
+//      this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR ITS CONTRIBUTORS
+// BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF
+// THE POSSIBILITY OF SUCH DAMAGE.
+//==============================================================================
+
+#include "IoUring.h"
+#include <linux/io_uring.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <sys/uio.h>
+#include <unistd.h>
+#include <errno.h>
+#include <string.h>
+#include <vector>
+#include <sstream>
+
+namespace grape
+{
+
+//==============================================================================
+/// \class IoUringP
+/// \brief Linux specific private implementation
+///
+/// Talks to the kernel directly through the io_uring system calls, so that
+/// there is no dependency on liburing.
+//==============================================================================
+class IoUringP
+{
+public:
+    IoUringP(unsigned int queueDepth);
+    ~IoUringP() throw();
+    void unmap() throw();
+    struct io_uring_sqe* getSqe();
+    void prepare(int op, IpSocket& socket, const void* addr, unsigned int len, unsigned long long tag);
+    void prepareFixed(int op, IpSocket& socket, unsigned int bufferIndex, unsigned int offset, unsigned int len, unsigned long long tag);
+    unsigned int flush();
+    static void throwException(int code, const std::string& location);
+    static int setup(unsigned int entries, struct io_uring_params* p) { return (int)syscall(__NR_io_uring_setup, entries, p); }
+    int enter(unsigned int toSubmit, unsigned int minComplete, unsigned int flags)
+    {
+        return (int)syscall(__NR_io_uring_enter, _ringFd, toSubmit, minComplete, flags, NULL, 0);
+    }
+    int registerOp(unsigned int opcode, const void* arg, unsigned int nArgs)
+    {
+        return (int)syscall(__NR_io_uring_register, _ringFd, opcode, arg, nArgs);
+    }
+public:
+    int _ringFd;
+
+    // submission queue
+    void* _sqRing;
+    size_t _sqRingSize;
+    unsigned int* _sqHead;
+    unsigned int* _sqTail;
+    unsigned int* _sqMask;
+    unsigned int* _sqEntries;
+    unsigned int* _sqArray;
+    struct io_uring_sqe* _sqes;
+    size_t _sqesSize;
+    unsigned int _sqeHead;      //!< first sqe not yet published to the kernel
+    unsigned int _sqeTail;      //!< next free sqe
+
+    // completion queue
+    void* _cqRing;
+    size_t _cqRingSize;
+    unsigned int* _cqHead;
+    unsigned int* _cqTail;
+    unsigned int* _cqMask;
+    struct io_uring_cqe* _cqes;
+
+    std::vector<int> _fixedIndex;   //!< registered file index for each fd, -1 if not registered
+    std::vector<IpSocket*> _fixedSockets;   //!< socket registered in each file index, NULL once unregistered
+    std::vector<IoUring::Buffer> _buffers; //!< registered buffers
+    bool _hasFiles;
+}; // IoUringP
+
+//==============================================================================
+IoUringP::IoUringP(unsigned int queueDepth)
+//==============================================================================
+    : _ringFd(-1),
+      _sqRing(MAP_FAILED), _sqRingSize(0), _sqHead(0), _sqTail(0), _sqMask(0), _sqEntries(0), _sqArray(0),
+      _sqes((struct io_uring_sqe*)MAP_FAILED), _sqesSize(0), _sqeHead(0), _sqeTail(0),
+      _cqRing(MAP_FAILED), _cqRingSize(0), _cqHead(0), _cqTail(0), _cqMask(0), _cqes(0),
+      _hasFiles(false)
+{
+    struct io_uring_params p;
+    memset(&p, 0, sizeof(p));
+
+    _ringFd = setup(queueDepth, &p);
+    if( _ringFd < 0 )
+    {
+        throwException(errno, "[IoUring::IoUring(io_uring_setup)]");
+    }
+
+    _sqRingSize = p.sq_off.array + p.sq_entries * sizeof(unsigned int);
+    _cqRingSize = p.cq_off.cqes + p.cq_entries * sizeof(struct io_uring_cqe);
+    bool singleMap = (p.features & IORING_FEAT_SINGLE_MMAP);
+    if( singleMap && (_cqRingSize > _sqRingSize) )
+    {
+        _sqRingSize = _cqRingSize;
+    }
+
+    _sqRing = mmap(NULL, _sqRingSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, _ringFd, IORING_OFF_SQ_RING);
+    if( _sqRing == MAP_FAILED )
+    {
+        int e = errno;
+        unmap();
+        throwException(e, "[IoUring::IoUring(mmap SQ)]");
+    }
+
+    if( singleMap )
+    {
+        _cqRing = _sqRing;
+    }
+    else
+    {
+        _cqRing = mmap(NULL, _cqRingSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, _ringFd, IORING_OFF_CQ_RING);
+        if( _cqRing == MAP_FAILED )
+        {
+            int e = errno;
+            unmap();
+            throwException(e, "[IoUring::IoUring(mmap CQ)]");
+        }
+    }
+
+    _sqesSize = p.sq_entries * sizeof(struct io_uring_sqe);
+    _sqes = (struct io_uring_sqe*)mmap(NULL, _sqesSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, _ringFd, IORING_OFF_SQES);
+    if( _sqes == MAP_FAILED )
+    {
+        int e = errno;
+        unmap();
+        throwException(e, "[IoUring::IoUring(mmap SQEs)]");
+    }
+
+    unsigned char* sq = (unsigned char*)_sqRing;
+    _sqHead = (unsigned int*)(sq + p.sq_off.head);
+    _sqTail = (unsigned int*)(sq + p.sq_off.tail);
+    _sqMask = (unsigned int*)(sq + p.sq_off.ring_mask);
+    _sqEntries = (unsigned int*)(sq + p.sq_off.ring_entries);
+    _sqArray = (unsigned int*)(sq + p.sq_off.array);
+
+    unsigned char* cq = (unsigned char*)_cqRing;
+    _cqHead = (unsigned int*)(cq + p.cq_off.head);
+    _cqTail = (unsigned int*)(cq + p.cq_off.tail);
+    _cqMask = (unsigned int*)(cq + p.cq_off.ring_mask);
+    _cqes = (struct io_uring_cqe*)(cq + p.cq_off.cqes);
+
+    _sqeHead = _sqeTail = *_sqTail;
+}
+
+//------------------------------------------------------------------------------
+IoUringP::~IoUringP() throw()
+//------------------------------------------------------------------------------
+{
+    unmap();
+}
+
+//------------------------------------------------------------------------------
+void IoUringP::unmap() throw()
+//------------------------------------------------------------------------------
+{
+    if( _sqes != MAP_FAILED )
+    {
+        munmap(_sqes, _sqesSize);
+        _sqes = (struct io_uring_sqe*)MAP_FAILED;
+    }
+    if( (_cqRing != MAP_FAILED) && (_cqRing != _sqRing) )
+    {
+        munmap(_cqRing, _cqRingSize);
+    }
+    _cqRing = MAP_FAILED;
+    if( _sqRing != MAP_FAILED )
+    {
+        munmap(_sqRing, _sqRingSize);
+        _sqRing = MAP_FAILED;
+    }
+    if( _ringFd != -1 )
+    {
+        ::close(_ringFd);
+        _ringFd = -1;
+    }
+}
+
+//------------------------------------------------------------------------------
+void IoUringP::throwException(int code, const std::string& location)
+//------------------------------------------------------------------------------
+{
+    std::ostringstream str;
+    str << location << ": " << strerror(code);
+    throw IoException(code, str.str());
+}
+
+//------------------------------------------------------------------------------
+struct io_uring_sqe* IoUringP::getSqe()
+//------------------------------------------------------------------------------
+{
+    unsigned int head = __atomic_load_n(_sqHead, __ATOMIC_ACQUIRE);
+    if( _sqeTail - head >= *_sqEntries )
+    {
+        return NULL;
+    }
+    struct io_uring_sqe* sqe = &_sqes[_sqeTail & *_sqMask];
+    ++_sqeTail;
+    memset(sqe, 0, sizeof(*sqe));
+    return sqe;
+}
+
+//------------------------------------------------------------------------------
+void IoUringP::prepare(int op, IpSocket& socket, const void* addr, unsigned int len, unsigned long long tag)
+//------------------------------------------------------------------------------
+{
+    struct io_uring_sqe* sqe = getSqe();
+    if( sqe == NULL )
+    {
+        // submission queue full. Hand queued requests to the kernel and retry
+        if( enter(flush(), 0, 0) < 0 )
+        {
+            throwException(errno, "[IoUring::submit(io_uring_enter)]");
+        }
+        sqe = getSqe();
+        if( sqe == NULL )
+        {
+            throw IoException(EBUSY, "[IoUring::submit]: Submission queue full");
+        }
+    }
+
+    int fd = socket.getFd();
+    sqe->opcode = (unsigned char)op;
+    sqe->fd = fd;
+    // the fd number may have been reused by another socket since registration
+    if( (fd >= 0) && ((size_t)fd < _fixedIndex.size()) && (_fixedIndex[fd] >= 0)
+        && (_fixedSockets[_fixedIndex[fd]] == &socket) )
+    {
+        sqe->fd = _fixedIndex[fd];
+        sqe->flags |= IOSQE_FIXED_FILE;
+    }
+    sqe->addr = (unsigned long long)(unsigned long)addr;
+    sqe->len = len;
+    sqe->user_data = tag;
+}
+
+//------------------------------------------------------------------------------
+void IoUringP::prepareFixed(int op, IpSocket& socket, unsigned int bufferIndex, unsigned int offset, unsigned int len, unsigned long long tag)
+//------------------------------------------------------------------------------
+{
+    if( (bufferIndex >= _buffers.size()) || (offset + len > _buffers[bufferIndex].size) )
+    {
+        throw IoException(EINVAL, "[IoUring::submitFixed]: Request outside registered buffer");
+    }
+    prepare(op, socket, _buffers[bufferIndex].pData + offset, len, tag);
+    _sqes[(_sqeTail - 1) & *_sqMask].buf_index = (unsigned short)bufferIndex;
+}
+
+//------------------------------------------------------------------------------
+unsigned int IoUringP::flush()
+//------------------------------------------------------------------------------
+{
+    unsigned int tail = *_sqTail;
+    unsigned int nFlushed = _sqeTail - _sqeHead;
+    while( _sqeHead != _sqeTail )
+    {
+        _sqArray[tail & *_sqMask] = _sqeHead & *_sqMask;
+        ++tail;
+        ++_sqeHead;
+    }
+    __atomic_store_n(_sqTail, tail, __ATOMIC_RELEASE);
+    return nFlushed;
+}
+
+//==============================================================================
+IoUring::IoUring(unsigned int queueDepth)
+//==============================================================================
+    : _pImpl(new IoUringP(queueDepth))
+{
+}
+
+//------------------------------------------------------------------------------
+IoUring::~IoUring() throw()
+//------------------------------------------------------------------------------
+{
+    delete _pImpl;
+}
+
+//------------------------------------------------------------------------------
+bool IoUring::isSupported()
+//------------------------------------------------------------------------------
+{
+    struct io_uring_params p;
+    memset(&p, 0, sizeof(p));
+    int fd = IoUringP::setup(1, &p);
+    if( fd < 0 )
+    {
+        return false;
+    }
+    ::close(fd);
+    return true;
+}
+
+//------------------------------------------------------------------------------
+void IoUring::registerSockets(IpSocket* const* sockets, unsigned int count)
+//------------------------------------------------------------------------------
+{
+    if( _pImpl->_hasFiles )
+    {
+        _pImpl->registerOp(IORING_UNREGISTER_FILES, NULL, 0);
+        _pImpl->_hasFiles = false;
+        _pImpl->_fixedIndex.clear();
+        _pImpl->_fixedSockets.clear();
+    }
+
+    if( count == 0 )
+    {
+        return;
+    }
+
+    std::vector<int> fds(count);
+    int maxFd = -1;
+    for(unsigned int i = 0; i < count; ++i)
+    {
+        fds[i] = sockets[i]->getFd();
+        if( fds[i] > maxFd )
+        {
+            maxFd = fds[i];
+        }
+    }
+
+    if( _pImpl->registerOp(IORING_REGISTER_FILES, &fds[0], count) < 0 )
+    {
+        IoUringP::throwException(errno, "[IoUring::registerSockets(io_uring_register)]");
+    }
+
+    _pImpl->_fixedIndex.assign(maxFd + 1, -1);
+    _pImpl->_fixedSockets.assign(sockets, sockets + count);
+    for(unsigned int i = 0; i < count; ++i)
+    {
+        if( fds[i] >= 0 )
+        {
+            _pImpl->_fixedIndex[fds[i]] = i;
+        }
+    }
+    _pImpl->_hasFiles = true;
+}
+
+//------------------------------------------------------------------------------
+void IoUring::unregisterSocket(IpSocket& socket)
+//------------------------------------------------------------------------------
+{
+    for(size_t slot = 0; slot < _pImpl->_fixedSockets.size(); ++slot)
+    {
+        if( _pImpl->_fixedSockets[slot] != &socket )
+        {
+            continue;
+        }
+
+        // release the kernel's reference to the file, so the slot can't be used
+        // after the socket is closed
+        int empty = -1;
+        struct io_uring_files_update update;
+        memset(&update, 0, sizeof(update));
+        update.offset = (unsigned int)slot;
+        update.fds = (unsigned long long)(unsigned long)&empty;
+        if( _pImpl->registerOp(IORING_REGISTER_FILES_UPDATE, &update, 1) < 0 )
+        {
+            IoUringP::throwException(errno, "[IoUring::unregisterSocket(io_uring_register)]");
+        }
+
+        _pImpl->_fixedSockets[slot] = NULL;
+        for(size_t fd = 0; fd < _pImpl->_fixedIndex.size(); ++fd)
+        {
+            if( _pImpl->_fixedIndex[fd] == (int)slot )
+            {
+                _pImpl->_fixedIndex[fd] = -1;
+            }
+        }
+    }
+}
+
+//------------------------------------------------------------------------------
+void IoUring::registerBuffers(const Buffer* buffers, unsigned int count)
+//------------------------------------------------------------------------------
+{
+    if( !_pImpl->_buffers.empty() )
+    {
+        _pImpl->registerOp(IORING_UNREGISTER_BUFFERS, NULL, 0);
+        _pImpl->_buffers.clear();
+    }
+
+    if( count == 0 )
+    {
+        return;
+    }
+
+    std::vector<struct iovec> iov(count);
+    for(unsigned int i = 0; i < count; ++i)
+    {
+        iov[i].iov_base = buffers[i].pData;
+        iov[i].iov_len = buffers[i].size;
+    }
+
+    if( _pImpl->registerOp(IORING_REGISTER_BUFFERS, &iov[0], count) < 0 )
+    {
+        IoUringP::throwException(errno, "[IoUring::registerBuffers(io_uring_register)]");
+    }
+    _pImpl->_buffers.assign(buffers, buffers + count);
+}
+
+//------------------------------------------------------------------------------
+void IoUring::submitRecv(IpSocket& socket, unsigned char* pBuffer, unsigned int bytes, unsigned long long tag)
+//------------------------------------------------------------------------------
+{
+    _pImpl->prepare(IORING_OP_RECV, socket, pBuffer, bytes, tag);
+}
+
+//------------------------------------------------------------------------------
+void IoUring::submitSend(IpSocket& socket, const unsigned char* pBuffer, unsigned int bytes, unsigned long long tag)
+//------------------------------------------------------------------------------
+{
+    _pImpl->prepare(IORING_OP_SEND, socket, pBuffer, bytes, tag);
+    _pImpl->_sqes[(_pImpl->_sqeTail - 1) & *_pImpl->_sqMask].msg_flags = MSG_NOSIGNAL;
+}
+
+//------------------------------------------------------------------------------
+void IoUring::submitRecvMsg(IpSocket& socket, struct msghdr* pMsg, unsigned long long tag)
+//------------------------------------------------------------------------------
+{
+    _pImpl->prepare(IORING_OP_RECVMSG, socket, pMsg, 1, tag);
+}
+
+//------------------------------------------------------------------------------
+void IoUring::submitSendMsg(IpSocket& socket, const struct msghdr* pMsg, unsigned long long tag)
+//------------------------------------------------------------------------------
+{
+    _pImpl->prepare(IORING_OP_SENDMSG, socket, pMsg, 1, tag);
+    _pImpl->_sqes[(_pImpl->_sqeTail - 1) & *_pImpl->_sqMask].msg_flags = MSG_NOSIGNAL;
+}
+
+//------------------------------------------------------------------------------
+void IoUring::submitReadFixed(IpSocket& socket, unsigned int bufferIndex, unsigned int offset, unsigned int bytes, unsigned long long tag)
+//------------------------------------------------------------------------------
+{
+    _pImpl->prepareFixed(IORING_OP_READ_FIXED, socket, bufferIndex, offset, bytes, tag);
+}
+
+//------------------------------------------------------------------------------
+void IoUring::submitWriteFixed(IpSocket& socket, unsigned int bufferIndex, unsigned int offset, unsigned int bytes, unsigned long long tag)
+//------------------------------------------------------------------------------
+{
+    _pImpl->prepareFixed(IORING_OP_WRITE_FIXED, socket, bufferIndex, offset, bytes, tag);
+}
+
+//------------------------------------------------------------------------------
+unsigned int IoUring::pending() const
+//------------------------------------------------------------------------------
+{
+    return _pImpl->_sqeTail - _pImpl->_sqeHead;
+}
+
+//------------------------------------------------------------------------------
+unsigned int IoUring::submit(unsigned int waitFor)
+//------------------------------------------------------------------------------
+{
+    unsigned int toSubmit = _pImpl->flush();
+    if( (toSubmit == 0) && (waitFor == 0) )
+    {
+        return 0;
+    }
+
+    int ret = 0;
+    while( ((ret = _pImpl->enter(toSubmit, waitFor, (waitFor > 0) ? IORING_ENTER_GETEVENTS : 0)) < 0) && (errno == EINTR) )
+    {
+        // interrupted. Retry with whatever the kernel has not consumed yet
+        toSubmit = *_pImpl->_sqTail - __atomic_load_n(_pImpl->_sqHead, __ATOMIC_ACQUIRE);
+    }
+
+    if( ret < 0 )
+    {
+        IoUringP::throwException(errno, "[IoUring::submit(io_uring_enter)]");
+    }
+
+    return ret;
+}
+
+//------------------------------------------------------------------------------
+unsigned int IoUring::reap(Completion* completions, unsigned int max)
+//------------------------------------------------------------------------------
+{
+    unsigned int head = *_pImpl->_cqHead;
+    unsigned int tail = __atomic_load_n(_pImpl->_cqTail, __ATOMIC_ACQUIRE);
+    unsigned int mask = *_pImpl->_cqMask;
+
+    unsigned int n = 0;
+    while( (head != tail) && (n < max) )
+    {
+        const struct io_uring_cqe& cqe = _pImpl->_cqes[head & mask];
+        completions[n].tag = cqe.user_data;
+        completions[n].result = cqe.res;
+        ++head;
+        ++n;
+    }
+
+    __atomic_store_n(_pImpl->_cqHead, head, __ATOMIC_RELEASE);
+    return n;
+}
+
+} // grape
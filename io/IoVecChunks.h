@@ -0,0 +1,115 @@
+//==============================================================================
+// Project  : Grape
+// Module   : IO
+// File     : IoVecChunks.h
+// Brief    : Splits a gather list into writev-sized chunks (internal)
+//
+// Copyright (c) 2012, Vilas Chitrakaran
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//    * Redistributions of source code must retain the above copyright
+//      notice, this list of conditions and the following disclaimer.
+//    * Redistributions in binary form must reproduce the above copyright
+//      notice, this list of conditions and the following disclaimer in the
+//      documentation and/or other materials provided with the distribution.
+//    * Neither the name of the copyright holder nor the names of its
+//      contributors may be used to endorse or promote products derived from
+//      this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR ITS CONTRIBUTORS
+// BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF
+// THE POSSIBILITY OF SUCH DAMAGE.
+//==============================================================================
+
+#ifndef GRAPEIO_IOVECCHUNKS_H
+#define GRAPEIO_IOVECCHUNKS_H
+
+#include "IDataPort.h"
+#include <sys/uio.h>
+
+namespace grape
+{
+
+/// \class IoVecChunks
+/// \ingroup io
+/// \brief Internal helper for the writev() implementations of stream ports
+///
+/// Converts an array of IDataPort::Buffer into iovec arrays of at most
+/// IDataPort::MAX_WRITEV_BUFFERS entries, one system call's worth at a time,
+/// and keeps count of the bytes written. Writing stops at the first partial
+/// write, so that the caller can continue with the rest later.
+/// \code
+/// IoVecChunks chunks(buffers, count);
+/// while( chunks.next() )
+/// {
+///     ssize_t len = ::writev(fd, chunks.iov(), chunks.size());
+///     if( len < 0 ) throw ...;
+///     if( !chunks.advance(len) ) break;
+/// }
+/// return chunks.total();
+/// \endcode
+class IoVecChunks
+{
+public:
+    IoVecChunks(const IDataPort::Buffer* buffers, unsigned int count)
+        : _buffers(buffers), _remaining(count), _size(0), _requested(0), _total(0) {}
+
+    /// Fill the iovec array with the next chunk of buffers
+    /// \return false if all buffers have been written
+    bool next()
+    {
+        if( _remaining == 0 )
+        {
+            return false;
+        }
+        _size = (_remaining > IDataPort::MAX_WRITEV_BUFFERS) ? IDataPort::MAX_WRITEV_BUFFERS : _remaining;
+        _requested = 0;
+        for(unsigned int i = 0; i < _size; ++i)
+        {
+            _iov[i].iov_base = (void*)_buffers[i].pData;
+            _iov[i].iov_len = _buffers[i].size;
+            _requested += _buffers[i].size;
+        }
+        return true;
+    }
+
+    /// Account for bytes written from the current chunk
+    /// \return false if the chunk was written partially, and writing should stop
+    bool advance(size_t written)
+    {
+        _total += (unsigned int)written;
+        if( written < _requested )
+        {
+            return false;
+        }
+        _buffers += _size;
+        _remaining -= _size;
+        return true;
+    }
+
+    struct iovec* iov() { return _iov; }            //!< current chunk
+    unsigned int size() const { return _size; }     //!< number of entries in the current chunk
+    unsigned int total() const { return _total; }   //!< bytes written so far
+
+private:
+    const IDataPort::Buffer* _buffers;
+    unsigned int _remaining;
+    unsigned int _size;
+    size_t _requested;
+    unsigned int _total;
+    struct iovec _iov[IDataPort::MAX_WRITEV_BUFFERS];
+}; // IoVecChunks
+
+} // grape
+
+#endif // GRAPEIO_IOVECCHUNKS_H
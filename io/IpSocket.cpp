@@ -31,6 +31,7 @@
 //==============================================================================
 
 #include "IpSocket.h"
+#include "HostResolver.h"
 
 #ifndef _MSC_VER // UNIX platforms?
 #define CLOSESOCKET(fd) ::close(fd)
@@ -41,6 +42,9 @@
 #include <netdb.h>
 #include <unistd.h>
 #include <sys/ioctl.h>
+#include <poll.h>
+#include <fcntl.h>
+#include <time.h>
 #endif
 
 #ifdef _MSC_VER
@@ -80,27 +84,11 @@ IpSocket::IpSocket()
 struct sockaddr_in IpSocket::getSocketAddress(const std::string& serverIp, int port)
 //--------------------------------------------------------------------------
 {
-    // get network server entry
-    struct hostent* pHost = NULL;
-    pHost = gethostbyname(serverIp.c_str());
-    if( pHost == NULL )
-    {
-#ifdef _MSC_VER
-        throw HostInfoException(WSAGetLastError(), "[IpClient::init(gethostbyname)]");
-#else
-        std::ostringstream str;
-        str << "[IpSocket::IpClient(gethostbyname)]: " << hstrerror(h_errno);
-        throw HostInfoException(h_errno, str.str());
-#endif
-    }
+    // cached, thread-safe lookup
+    HostResolver::Address addr = HostResolver::instance().resolve(serverIp, port, HostResolver::IPV4);
 
-    // server socket info
     struct sockaddr_in remoteEndpoint;
-    remoteEndpoint.sin_family = AF_INET;
-    remoteEndpoint.sin_port = htons(port);
-    remoteEndpoint.sin_addr.s_addr = *((in_addr_t *)pHost->h_addr);
-    memset(&(remoteEndpoint.sin_zero), '\0', 8);
-
+    memcpy(&remoteEndpoint, &addr.storage, sizeof(remoteEndpoint));
     return remoteEndpoint;
 }
 
@@ -166,6 +154,41 @@ void IpSocket::allowPortReuse(bool yes)
     }
 }
 
+//--------------------------------------------------------------------------
+void IpSocket::allowPortSharing(bool yes)
+//--------------------------------------------------------------------------
+{
+#ifdef SO_REUSEPORT
+    int val = (yes?1:0);
+    if( setsockopt(_sockFd, SOL_SOCKET, SO_REUSEPORT, (const char *)&val, sizeof(int)) == SOCKET_ERROR)
+    {
+        throwSocketException("[IpSocket::allowPortSharing](setsockopt)");
+    }
+#else
+    if( yes )
+    {
+        throw SocketException(ENOSYS, "[IpSocket::allowPortSharing]: Not supported on this platform");
+    }
+#endif
+}
+
+//--------------------------------------------------------------------------
+void IpSocket::setNonBlocking(bool yes)
+//--------------------------------------------------------------------------
+{
+#ifdef _MSC_VER
+    u_long val = (yes?1:0);
+    if( ioctlsocket(_sockFd, FIONBIO, &val) == SOCKET_ERROR )
+#else
+    int flags = fcntl(_sockFd, F_GETFL);
+    flags = yes ? (flags | O_NONBLOCK) : (flags & ~O_NONBLOCK);
+    if( (flags < 0) || (fcntl(_sockFd, F_SETFL, flags) == SOCKET_ERROR) )
+#endif
+    {
+        throwSocketException("[IpSocket::setNonBlocking]");
+    }
+}
+
 //--------------------------------------------------------------------------
 void IpSocket::setBufSize(unsigned int sz)
 //--------------------------------------------------------------------------
@@ -249,37 +272,84 @@ unsigned int IpSocket::availableToRead()
     return bytes;
 }
 
+//--------------------------------------------------------------------------
+static int pollSocket(SOCKET fd, short events, int timeoutMs, short& revents)
+//--------------------------------------------------------------------------
+{
+    struct pollfd pfd;
+    pfd.fd = fd;
+    pfd.events = events;
+    pfd.revents = 0;
+#ifdef _MSC_VER
+    int ret = WSAPoll(&pfd, 1, timeoutMs);
+#else
+    struct timespec ts;
+    struct timespec* pTs = NULL;
+    if( timeoutMs >= 0 )
+    {
+        ts.tv_sec = timeoutMs / 1000;
+        ts.tv_nsec = (timeoutMs % 1000) * 1000000L;
+        pTs = &ts;
+    }
+    int ret = ppoll(&pfd, 1, pTs, NULL);
+#endif
+    revents = pfd.revents;
+    return ret;
+}
+
 //--------------------------------------------------------------------------
 IDataPort::Status IpSocket::waitForRead(int timeoutMs)
 //--------------------------------------------------------------------------
 {
-    fd_set fds;
-    FD_ZERO(&fds);
-    FD_SET(_sockFd, &fds);
+#ifdef POLLRDHUP
+    const short events = POLLIN | POLLRDHUP;
+    const short hangup = POLLHUP | POLLRDHUP;
+#else
+    const short events = POLLIN;
+    const short hangup = POLLHUP;
+#endif
 
-    // indefinite wait
-    int ret = 0;
-    if( timeoutMs < 0 )
+    short revents = 0;
+    int ret = pollSocket(_sockFd, events, timeoutMs, revents);
+
+    IDataPort::Status st = IDataPort::PORT_ERROR;
+    // ret == 0: timeout, ret == 1: ready, ret == -1: error
+    if (ret > 0)
     {
-        ret = select(_sockFd+1, &fds, NULL, NULL, NULL);
+        // a closed socket polls readable, but there is nothing to read. Only
+        // check for remaining data when the peer has hung up.
+        if( revents & hangup )
+        {
+            st = availableToRead() ? IDataPort::PORT_OK : IDataPort::PORT_ERROR;
+        }
+        else if( revents & POLLIN )
+        {
+            st = IDataPort::PORT_OK;
+        }
+    }
+    else if (ret == 0)
+    {
+        st = IDataPort::PORT_TIMEOUT;
     }
-
-    // wait with timeout
     else
     {
-        long long int secs = timeoutMs/1000;
-        long long int usecs = (timeoutMs * 1000) - (secs * 1000000);
-        struct timeval timeout = {secs, usecs};
-        ret = select(_sockFd+1, &fds, NULL, NULL, &timeout);
+        throw IoEventHandlingException(errno, "[IpSocket::waitForRead(poll)] failed");
     }
 
+    return st;
+}
+
+//--------------------------------------------------------------------------
+IDataPort::Status IpSocket::waitForWrite(int timeoutMs)
+//--------------------------------------------------------------------------
+{
+    short revents = 0;
+    int ret = pollSocket(_sockFd, POLLOUT, timeoutMs, revents);
+
     IDataPort::Status st = IDataPort::PORT_ERROR;
-    // ret == 0: timeout, ret == 1: ready, ret == -1: error
     if (ret > 0)
     {
-        // linux workaround. select returns 1 for closed socket, but there
-        // is nothing to read
-        if( availableToRead() )
+        if( !(revents & (POLLERR | POLLHUP | POLLNVAL)) )
         {
             st = IDataPort::PORT_OK;
         }
@@ -290,11 +360,10 @@ IDataPort::Status IpSocket::waitForRead(int timeoutMs)
     }
     else
     {
-        throw IoEventHandlingException(errno, "[IpSocket::waitForRead(select)] failed");
+        throw IoEventHandlingException(errno, "[IpSocket::waitForWrite(poll)] failed");
     }
 
     return st;
 }
 
-
 } // grape
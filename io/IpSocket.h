@@ -75,9 +75,14 @@ public:
     unsigned int availableToRead();
     unsigned int readAll(std::vector<unsigned char>& buffer) { return readn(buffer, availableToRead()); }
     IDataPort::Status waitForRead(int timeoutMs);
-    IDataPort::Status waitForWrite(int timeoutMs) { return IDataPort::PORT_OK; } //!< does nothing
+
+    /// Wait until the socket can accept more data for writing, i.e. there is space
+    /// in the socket send buffer.
+    /// \copydetails IDataPort::waitForWrite()
+    IDataPort::Status waitForWrite(int timeoutMs);
     void flushRx() {} //!< does nothing
     void flushTx() {} //!< does nothing
+    int getFd() const { return (int)_sockFd; }
 
     // ------------- Socket specific methods -------------------
 
@@ -106,6 +111,17 @@ public:
     /// \throw SocketException
     void allowPortReuse(bool yes);
 
+    /// Allow several sockets to bind to the same port and share its incoming
+    /// traffic (SO_REUSEPORT). The kernel distributes datagrams or connections
+    /// across the sockets. All sockets must set this before bind().
+    /// \throw SocketException, including if not supported on this platform
+    void allowPortSharing(bool yes);
+
+    /// Put the socket in non-blocking mode. Reads, writes and accepts that cannot
+    /// complete immediately then fail with EAGAIN/EWOULDBLOCK instead of blocking.
+    /// \throw SocketException
+    void setNonBlocking(bool yes);
+
     /// \return the current address to which the socket is bound, in
     /// the format ip:port
     std::string getHostName();
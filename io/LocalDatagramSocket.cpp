@@ -0,0 +1,150 @@
+//==============================================================================
+// Project  : Grape
+// Module   : IO
+// File     : LocalDatagramSocket.cpp
+//
+// Copyright (c) 2012, Vilas Chitrakaran
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//    * Redistributions of source code must retain the above copyright
+//      notice, this list of conditions and the following disclaimer.
+//    * Redistributions in binary form must reproduce the above copyright
+//      notice, this list of conditions and the following disclaimer in the
+//      documentation and/or other materials provided with the distribution.
+//    * Neither the name of the copyright holder nor the names of its
+//      contributors may be used to endorse or promote products derived from
+//      this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR ITS CONTRIBUTORS
+// BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF
+// THE POSSIBILITY OF SUCH DAMAGE.
+//==============================================================================
+
+#include "LocalDatagramSocket.h"
+#include <sys/uio.h>
+#include <errno.h>
+#include <string.h>
+
+namespace grape
+{
+
+//==========================================================================
+LocalDatagramSocket::LocalDatagramSocket()
+//==========================================================================
+    : LocalSocket(openSocket(SOCK_DGRAM))
+{
+}
+
+//--------------------------------------------------------------------------
+LocalDatagramSocket::~LocalDatagramSocket() throw()
+//--------------------------------------------------------------------------
+{
+}
+
+//--------------------------------------------------------------------------
+void LocalDatagramSocket::setRemotePeer(const std::string& path)
+//--------------------------------------------------------------------------
+{
+    struct sockaddr_un addr;
+    socklen_t len;
+    makeAddress(path, addr, len);
+    if( ::connect(_sockFd, (struct sockaddr*)&addr, len) < 0 )
+    {
+        throwSocketException("[LocalDatagramSocket::setRemotePeer(connect)]");
+    }
+}
+
+//--------------------------------------------------------------------------
+unsigned int LocalDatagramSocket::write(const std::vector<unsigned char>& buffer)
+//--------------------------------------------------------------------------
+{
+    return write(buffer.empty() ? NULL : &buffer[0], buffer.size());
+}
+
+//--------------------------------------------------------------------------
+unsigned int LocalDatagramSocket::write(const unsigned char* pBuffer, unsigned int bytes)
+//--------------------------------------------------------------------------
+{
+    ssize_t len = ::send(_sockFd, pBuffer, bytes, MSG_NOSIGNAL);
+    if( len < 0 )
+    {
+        throwSocketException("[LocalDatagramSocket::write(send)]");
+    }
+
+    return len;
+}
+
+//--------------------------------------------------------------------------
+unsigned int LocalDatagramSocket::writev(const Buffer* buffers, unsigned int count)
+//--------------------------------------------------------------------------
+{
+    struct iovec iov[MAX_WRITEV_BUFFERS];
+    if( count > MAX_WRITEV_BUFFERS )
+    {
+        throw SocketException(EMSGSIZE, "[LocalDatagramSocket::writev]: Too many buffers");
+    }
+    for(unsigned int i = 0; i < count; ++i)
+    {
+        iov[i].iov_base = (void*)buffers[i].pData;
+        iov[i].iov_len = buffers[i].size;
+    }
+
+    struct msghdr msg;
+    memset(&msg, 0, sizeof(msg));
+    msg.msg_iov = iov;
+    msg.msg_iovlen = count;
+
+    ssize_t len = ::sendmsg(_sockFd, &msg, MSG_NOSIGNAL);
+    if( len < 0 )
+    {
+        throwSocketException("[LocalDatagramSocket::writev(sendmsg)]");
+    }
+
+    return len;
+}
+
+//--------------------------------------------------------------------------
+unsigned int LocalDatagramSocket::writeTo(const std::string& path, const unsigned char* pBuffer, unsigned int bytes)
+//--------------------------------------------------------------------------
+{
+    struct sockaddr_un addr;
+    socklen_t addrLen;
+    makeAddress(path, addr, addrLen);
+
+    ssize_t len = ::sendto(_sockFd, pBuffer, bytes, MSG_NOSIGNAL, (struct sockaddr*)&addr, addrLen);
+    if( len < 0 )
+    {
+        throwSocketException("[LocalDatagramSocket::writeTo(sendto)]");
+    }
+
+    return len;
+}
+
+//--------------------------------------------------------------------------
+unsigned int LocalDatagramSocket::readFrom(unsigned char* pBuffer, unsigned int bytes, std::string& srcPath)
+//--------------------------------------------------------------------------
+{
+    struct sockaddr_un addr;
+    socklen_t addrLen = sizeof(addr);
+
+    ssize_t len = ::recvfrom(_sockFd, pBuffer, bytes, 0, (struct sockaddr*)&addr, &addrLen);
+    if( len < 0 )
+    {
+        throwSocketException("[LocalDatagramSocket::readFrom(recvfrom)]");
+    }
+
+    srcPath = getPath(addr, addrLen);
+    return len;
+}
+
+} // grape
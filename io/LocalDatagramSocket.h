@@ -0,0 +1,91 @@
+//==============================================================================
+// Project  : Grape
+// Module   : IO
+// File     : LocalDatagramSocket.h
+// Brief    : Unix domain datagram socket
+//
+// Copyright (c) 2012, Vilas Chitrakaran
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//    * Redistributions of source code must retain the above copyright
+//      notice, this list of conditions and the following disclaimer.
+//    * Redistributions in binary form must reproduce the above copyright
+//      notice, this list of conditions and the following disclaimer in the
+//      documentation and/or other materials provided with the distribution.
+//    * Neither the name of the copyright holder nor the names of its
+//      contributors may be used to endorse or promote products derived from
+//      this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR ITS CONTRIBUTORS
+// BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF
+// THE POSSIBILITY OF SUCH DAMAGE.
+//==============================================================================
+
+#ifndef GRAPE_LOCALDATAGRAMSOCKET_H
+#define GRAPE_LOCALDATAGRAMSOCKET_H
+
+#include "LocalSocket.h"
+
+namespace grape
+{
+
+/// \brief Unix domain datagram socket
+/// \ingroup io
+///
+/// Message oriented link between processes on the same host. Unlike UDP,
+/// local datagrams are reliable and delivered in order; a writer blocks when
+/// the receiver's queue is full. Use in place of UdpSocket for local links.
+/// A socket must be bound (see bind()) to receive datagrams.
+///
+/// Note that any method can throw SocketException on error
+class GRAPEIO_DLL_API LocalDatagramSocket : public LocalSocket
+{
+public:
+
+    LocalDatagramSocket();
+    virtual ~LocalDatagramSocket() throw(/*nothing*/);
+
+    /// Specify the default destination for write() and writev(). Datagrams
+    /// from other sockets are no longer received once a peer is set.
+    /// \param path Path the peer socket is bound to
+    void setRemotePeer(const std::string& path);
+
+    /// \copydoc IDataPort::write()
+    /// This method writes to remote peer specified in setRemotePeer()
+    unsigned int write(const std::vector<unsigned char>& buffer);
+    unsigned int write(const unsigned char* pBuffer, unsigned int bytes);
+
+    /// \copydoc IDataPort::writev()
+    /// The buffers are sent as a single datagram to the remote peer specified in
+    /// setRemotePeer()
+    unsigned int writev(const Buffer* buffers, unsigned int count);
+
+    /// Send message to a specific socket
+    /// \param path     Path the destination socket is bound to
+    /// \param pBuffer  Message
+    /// \param bytes    Size of message
+    /// \return number of bytes sent
+    unsigned int writeTo(const std::string& path, const unsigned char* pBuffer, unsigned int bytes);
+
+    /// Block to receive message from any socket
+    /// \param pBuffer  Buffer to receive message into
+    /// \param bytes    Size of buffer
+    /// \param srcPath  Path of the sending socket. Empty if the sender is not bound.
+    /// \return number of bytes received
+    unsigned int readFrom(unsigned char* pBuffer, unsigned int bytes, std::string& srcPath);
+
+}; // LocalDatagramSocket
+
+} // grape
+
+#endif // GRAPE_LOCALDATAGRAMSOCKET_H
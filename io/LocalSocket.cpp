@@ -0,0 +1,413 @@
+//==============================================================================
+// Project  : Grape
+// Module   : IO
+// File     : LocalSocket.cpp
+//
+// Copyright (c) 2012, Vilas Chitrakaran
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//    * Redistributions of source code must retain the above copyright
+//      notice, this list of conditions and the following disclaimer.
+//    * Redistributions in binary form must reproduce the above copyright
+//      notice, this list of conditions and the following disclaimer in the
+//      documentation and/or other materials provided with the distribution.
+//    * Neither the name of the copyright holder nor the names of its
+//      contributors may be used to endorse or promote products derived from
+//      this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR ITS CONTRIBUTORS
+// BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF
+// THE POSSIBILITY OF SUCH DAMAGE.
+//==============================================================================
+
+#include "LocalSocket.h"
+#include <unistd.h>
+#include <poll.h>
+#include <time.h>
+#include <errno.h>
+#include <string.h>
+#include <stddef.h>
+#include <sys/ioctl.h>
+#include <sys/stat.h>
+#include <sstream>
+
+namespace grape
+{
+
+//==========================================================================
+LocalSocket::LocalSocket(int fd)
+//==========================================================================
+    : _sockFd(fd)
+{
+}
+
+//--------------------------------------------------------------------------
+LocalSocket::~LocalSocket() throw()
+//--------------------------------------------------------------------------
+{
+    close();
+}
+
+//--------------------------------------------------------------------------
+int LocalSocket::openSocket(int type)
+//--------------------------------------------------------------------------
+{
+    int fd = ::socket(AF_UNIX, type | SOCK_CLOEXEC, 0);
+    if( fd < 0 )
+    {
+        std::ostringstream str;
+        str << "[LocalSocket::openSocket(socket)]: " << strerror(errno);
+        throw SocketException(errno, str.str());
+    }
+    return fd;
+}
+
+//--------------------------------------------------------------------------
+void LocalSocket::close() throw()
+//--------------------------------------------------------------------------
+{
+    if( _sockFd != -1 )
+    {
+        ::close(_sockFd);
+        _sockFd = -1;
+    }
+    if( !_boundPath.empty() )
+    {
+        ::unlink(_boundPath.c_str());
+        _boundPath.clear();
+    }
+}
+
+//--------------------------------------------------------------------------
+void LocalSocket::throwSocketException(const std::string& location)
+//--------------------------------------------------------------------------
+{
+    int e = errno;
+    std::ostringstream str;
+    str << location << ": " << strerror(e);
+    throw SocketException(e, str.str());
+}
+
+//--------------------------------------------------------------------------
+void LocalSocket::makeAddress(const std::string& path, struct sockaddr_un& addr, socklen_t& len)
+//--------------------------------------------------------------------------
+{
+    memset(&addr, 0, sizeof(addr));
+    addr.sun_family = AF_UNIX;
+    if( path.empty() || (path.size() >= sizeof(addr.sun_path)) )
+    {
+        std::ostringstream str;
+        str << "[LocalSocket::makeAddress]: Invalid socket path '" << path << "'";
+        throw SocketException(EINVAL, str.str());
+    }
+
+    memcpy(addr.sun_path, path.c_str(), path.size());
+    len = offsetof(struct sockaddr_un, sun_path) + path.size();
+    if( path[0] == '@' )
+    {
+        addr.sun_path[0] = '\0'; // abstract namespace. Name is not null terminated
+    }
+    else
+    {
+        len += 1;
+    }
+}
+
+//--------------------------------------------------------------------------
+std::string LocalSocket::getPath(const struct sockaddr_un& addr, socklen_t len)
+//--------------------------------------------------------------------------
+{
+    const socklen_t offset = offsetof(struct sockaddr_un, sun_path);
+    if( len <= offset )
+    {
+        return ""; // unnamed
+    }
+    if( addr.sun_path[0] == '\0' )
+    {
+        return "@" + std::string(addr.sun_path + 1, len - offset - 1);
+    }
+    return std::string(addr.sun_path, strnlen(addr.sun_path, len - offset));
+}
+
+//--------------------------------------------------------------------------
+void LocalSocket::removeStaleSocket(const std::string& path, const struct sockaddr_un& addr, socklen_t len)
+//--------------------------------------------------------------------------
+{
+    // only a socket file that nobody listens on is stale. Anything else
+    // (regular files, live sockets of other processes) is left for bind() to
+    // report as EADDRINUSE
+    struct stat st;
+    if( (lstat(path.c_str(), &st) < 0) || !S_ISSOCK(st.st_mode) )
+    {
+        return;
+    }
+
+    int type = SOCK_STREAM;
+    socklen_t typeLen = sizeof(type);
+    if( getsockopt(_sockFd, SOL_SOCKET, SO_TYPE, &type, &typeLen) < 0 )
+    {
+        return;
+    }
+    int probe = ::socket(AF_UNIX, type | SOCK_CLOEXEC, 0);
+    if( probe < 0 )
+    {
+        return;
+    }
+    bool stale = ((::connect(probe, (const struct sockaddr*)&addr, len) < 0) && (errno == ECONNREFUSED));
+    ::close(probe);
+    if( stale )
+    {
+        ::unlink(path.c_str());
+    }
+}
+
+//--------------------------------------------------------------------------
+void LocalSocket::bind(const std::string& path)
+//--------------------------------------------------------------------------
+{
+    struct sockaddr_un addr;
+    socklen_t len;
+    makeAddress(path, addr, len);
+
+    bool isFile = (path[0] != '@');
+    if( isFile )
+    {
+        removeStaleSocket(path, addr, len);
+    }
+
+    if( ::bind(_sockFd, (struct sockaddr*)&addr, len) < 0 )
+    {
+        throwSocketException("[LocalSocket::bind]");
+    }
+
+    if( isFile )
+    {
+        _boundPath = path;
+    }
+}
+
+//------------------------------------------------------------------------------
+unsigned int LocalSocket::availableToRead()
+//------------------------------------------------------------------------------
+{
+    int bytes = 0;
+    if( ioctl(_sockFd, FIONREAD, &bytes) < 0 )
+    {
+        throwSocketException("[LocalSocket::availableToRead]");
+    }
+    return bytes;
+}
+
+//--------------------------------------------------------------------------
+unsigned int LocalSocket::readn(std::vector<unsigned char>& buffer, unsigned int bytesToRead)
+//--------------------------------------------------------------------------
+{
+    if( bytesToRead > buffer.size() )
+    {
+        buffer.resize(bytesToRead);
+    }
+
+    return readn(buffer.empty() ? NULL : &buffer[0], bytesToRead);
+}
+
+//--------------------------------------------------------------------------
+unsigned int LocalSocket::readn(unsigned char* pBuffer, unsigned int bytesToRead)
+//--------------------------------------------------------------------------
+{
+    ssize_t len = ::recv(_sockFd, pBuffer, bytesToRead, 0);
+    if( len < 0 )
+    {
+        throwSocketException("[LocalSocket::readn(recv)]");
+    }
+
+    return len;
+}
+
+//--------------------------------------------------------------------------
+static int pollLocal(int fd, short events, int timeoutMs, short& revents)
+//--------------------------------------------------------------------------
+{
+    struct pollfd pfd;
+    pfd.fd = fd;
+    pfd.events = events;
+    pfd.revents = 0;
+
+    struct timespec ts;
+    struct timespec* pTs = NULL;
+    if( timeoutMs >= 0 )
+    {
+        ts.tv_sec = timeoutMs / 1000;
+        ts.tv_nsec = (timeoutMs % 1000) * 1000000L;
+        pTs = &ts;
+    }
+    int ret = ppoll(&pfd, 1, pTs, NULL);
+    revents = pfd.revents;
+    return ret;
+}
+
+//--------------------------------------------------------------------------
+IDataPort::Status LocalSocket::waitForRead(int timeoutMs)
+//--------------------------------------------------------------------------
+{
+    short revents = 0;
+    int ret = pollLocal(_sockFd, POLLIN | POLLRDHUP, timeoutMs, revents);
+
+    IDataPort::Status st = IDataPort::PORT_ERROR;
+    if (ret > 0)
+    {
+        // peer closed. Ready only if there is still data to read
+        if( revents & (POLLHUP | POLLRDHUP) )
+        {
+            st = availableToRead() ? IDataPort::PORT_OK : IDataPort::PORT_ERROR;
+        }
+        else if( revents & POLLIN )
+        {
+            st = IDataPort::PORT_OK;
+        }
+    }
+    else if (ret == 0)
+    {
+        st = IDataPort::PORT_TIMEOUT;
+    }
+    else
+    {
+        throw IoEventHandlingException(errno, "[LocalSocket::waitForRead(poll)] failed");
+    }
+
+    return st;
+}
+
+//--------------------------------------------------------------------------
+IDataPort::Status LocalSocket::waitForWrite(int timeoutMs)
+//--------------------------------------------------------------------------
+{
+    short revents = 0;
+    int ret = pollLocal(_sockFd, POLLOUT, timeoutMs, revents);
+
+    IDataPort::Status st = IDataPort::PORT_ERROR;
+    if (ret > 0)
+    {
+        if( !(revents & (POLLERR | POLLHUP | POLLNVAL)) )
+        {
+            st = IDataPort::PORT_OK;
+        }
+    }
+    else if (ret == 0)
+    {
+        st = IDataPort::PORT_TIMEOUT;
+    }
+    else
+    {
+        throw IoEventHandlingException(errno, "[LocalSocket::waitForWrite(poll)] failed");
+    }
+
+    return st;
+}
+
+//--------------------------------------------------------------------------
+unsigned int LocalSocket::writeWithFds(const unsigned char* pBuffer, unsigned int bytes, const int* fds, unsigned int nFds)
+//--------------------------------------------------------------------------
+{
+    if( nFds > MAX_FDS )
+    {
+        throw SocketException(EINVAL, "[LocalSocket::writeWithFds]: Too many descriptors");
+    }
+
+    struct iovec iov;
+    iov.iov_base = (void*)pBuffer;
+    iov.iov_len = bytes;
+
+    union
+    {
+        struct cmsghdr align;
+        char buf[CMSG_SPACE(MAX_FDS * sizeof(int))];
+    } control;
+
+    struct msghdr msg;
+    memset(&msg, 0, sizeof(msg));
+    msg.msg_iov = &iov;
+    msg.msg_iovlen = 1;
+    if( nFds > 0 )
+    {
+        msg.msg_control = control.buf;
+        msg.msg_controllen = CMSG_SPACE(nFds * sizeof(int));
+        struct cmsghdr* cm = CMSG_FIRSTHDR(&msg);
+        cm->cmsg_level = SOL_SOCKET;
+        cm->cmsg_type = SCM_RIGHTS;
+        cm->cmsg_len = CMSG_LEN(nFds * sizeof(int));
+        memcpy(CMSG_DATA(cm), fds, nFds * sizeof(int));
+    }
+
+    ssize_t len = ::sendmsg(_sockFd, &msg, MSG_NOSIGNAL);
+    if( len < 0 )
+    {
+        throwSocketException("[LocalSocket::writeWithFds(sendmsg)]");
+    }
+    return len;
+}
+
+//--------------------------------------------------------------------------
+unsigned int LocalSocket::readWithFds(unsigned char* pBuffer, unsigned int bytes, int* fds, unsigned int& nFds)
+//--------------------------------------------------------------------------
+{
+    struct iovec iov;
+    iov.iov_base = pBuffer;
+    iov.iov_len = bytes;
+
+    union
+    {
+        struct cmsghdr align;
+        char buf[CMSG_SPACE(MAX_FDS * sizeof(int))];
+    } control;
+
+    struct msghdr msg;
+    memset(&msg, 0, sizeof(msg));
+    msg.msg_iov = &iov;
+    msg.msg_iovlen = 1;
+    msg.msg_control = control.buf;
+    msg.msg_controllen = sizeof(control.buf);
+
+    ssize_t len = ::recvmsg(_sockFd, &msg, MSG_CMSG_CLOEXEC);
+    if( len < 0 )
+    {
+        throwSocketException("[LocalSocket::readWithFds(recvmsg)]");
+    }
+
+    unsigned int capacity = nFds;
+    nFds = 0;
+    for(struct cmsghdr* cm = CMSG_FIRSTHDR(&msg); cm != NULL; cm = CMSG_NXTHDR(&msg, cm))
+    {
+        if( (cm->cmsg_level != SOL_SOCKET) || (cm->cmsg_type != SCM_RIGHTS) )
+        {
+            continue;
+        }
+        unsigned int n = (cm->cmsg_len - CMSG_LEN(0)) / sizeof(int);
+        const unsigned char* pFds = CMSG_DATA(cm);
+        for(unsigned int i = 0; i < n; ++i)
+        {
+            int fd;
+            memcpy(&fd, pFds + i * sizeof(int), sizeof(int));
+            if( nFds < capacity )
+            {
+                fds[nFds++] = fd;
+            }
+            else
+            {
+                ::close(fd);
+            }
+        }
+    }
+    return len;
+}
+
+} // grape
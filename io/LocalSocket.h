@@ -0,0 +1,144 @@
+//==============================================================================
+// Project  : Grape
+// Module   : IO
+// File     : LocalSocket.h
+// Brief    : Unix domain socket base class
+//
+// Copyright (c) 2012, Vilas Chitrakaran
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//    * Redistributions of source code must retain the above copyright
+//      notice, this list of conditions and the following disclaimer.
+//    * Redistributions in binary form must reproduce the above copyright
+//      notice, this list of conditions and the following disclaimer in the
+//      documentation and/or other materials provided with the distribution.
+//    * Neither the name of the copyright holder nor the names of its
+//      contributors may be used to endorse or promote products derived from
+//      this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR ITS CONTRIBUTORS
+// BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF
+// THE POSSIBILITY OF SUCH DAMAGE.
+//==============================================================================
+
+#ifndef GRAPE_LOCALSOCKET_H
+#define GRAPE_LOCALSOCKET_H
+
+#include "IDataPort.h"
+#include "SocketException.h"
+#include <string>
+#include <sys/socket.h>
+#include <sys/un.h>
+
+namespace grape
+{
+
+/// \brief Base class for Unix domain (AF_UNIX) sockets
+/// \ingroup io
+///
+/// Local sockets connect processes on the same host without going through the
+/// TCP/IP stack. Sockets are named by a filesystem path, or by a name in the
+/// Linux abstract namespace if the path starts with '@'.
+///
+/// In addition to data, local sockets can pass open file descriptors to the peer
+/// process. See writeWithFds(), readWithFds().
+///
+/// See LocalStreamSocket and LocalDatagramSocket. Note that any method can throw
+/// SocketException on error. Available on POSIX platforms only.
+class GRAPEIO_DLL_API LocalSocket : public IDataPort
+{
+public:
+
+    /// Maximum number of file descriptors passed in one message
+    static const unsigned int MAX_FDS = 16;
+
+public:
+
+    // ------------- Reimplemented from IDataPort -------------------
+
+    virtual ~LocalSocket() throw(/*nothing*/);
+    virtual void close() throw(/*nothing*/);
+    unsigned int availableToRead();
+    unsigned int readAll(std::vector<unsigned char>& buffer) { return readn(buffer, availableToRead()); }
+    unsigned int readn(std::vector<unsigned char>& buffer, unsigned int bytes);
+    unsigned int readn(unsigned char* pBuffer, unsigned int bytes);
+    IDataPort::Status waitForRead(int timeoutMs);
+
+    /// Wait until the socket can accept more data for writing
+    /// \copydetails IDataPort::waitForWrite()
+    IDataPort::Status waitForWrite(int timeoutMs);
+    void flushRx() {} //!< does nothing
+    void flushTx() {} //!< does nothing
+    int getFd() const { return _sockFd; }
+
+    // ------------- Socket specific methods -------------------
+
+    /// Bind the socket to a name. For filesystem paths, a stale socket file at
+    /// the path (one that refuses connections) is removed first, and the file is
+    /// removed again on close(). Other files, and sockets in use, are not touched.
+    /// \param path Filesystem path, or '@' followed by an abstract name
+    /// \throw SocketException if the path exists and is not a stale socket
+    void bind(const std::string& path);
+
+    /// Send data along with open file descriptors. The peer receives duplicates
+    /// of the descriptors with readWithFds(); the caller's descriptors remain open.
+    /// \param pBuffer  Data to send. At least one byte must be sent with the descriptors.
+    /// \param bytes    Number of bytes to send
+    /// \param fds      Descriptors to send
+    /// \param nFds     Number of descriptors. At most MAX_FDS.
+    /// \return number of bytes sent
+    unsigned int writeWithFds(const unsigned char* pBuffer, unsigned int bytes, const int* fds, unsigned int nFds);
+
+    /// Receive data along with any file descriptors passed by the peer. Received
+    /// descriptors are owned by the caller, and are close-on-exec.
+    /// \param pBuffer  Buffer for received data
+    /// \param bytes    Size of buffer
+    /// \param fds      Array for received descriptors
+    /// \param nFds     On input, size of fds array. On output, number of descriptors
+    ///                 received. Descriptors that don't fit are closed.
+    /// \return number of bytes received
+    unsigned int readWithFds(unsigned char* pBuffer, unsigned int bytes, int* fds, unsigned int& nFds);
+
+protected:
+
+    /// Take ownership of an open local socket
+    /// \param fd Socket descriptor. See openSocket()
+    explicit LocalSocket(int fd);
+
+    /// Create a local socket
+    /// \param type SOCK_STREAM or SOCK_DGRAM
+    /// \return socket descriptor
+    static int openSocket(int type);
+
+    /// Construct a socket address from a path. '@' prefix denotes the abstract namespace.
+    static void makeAddress(const std::string& path, struct sockaddr_un& addr, socklen_t& len);
+
+    /// Extract the path from a socket address
+    static std::string getPath(const struct sockaddr_un& addr, socklen_t len);
+
+    /// Remove the socket file at path if no socket is listening on it
+    void removeStaleSocket(const std::string& path, const struct sockaddr_un& addr, socklen_t len);
+
+    /// Throw a SocketException. Specify location from where it was thrown in
+    /// order to help the user
+    void throwSocketException(const std::string& location);
+
+protected:
+    int _sockFd;
+    std::string _boundPath;
+
+}; // LocalSocket
+
+} // grape
+
+#endif // GRAPE_LOCALSOCKET_H
@@ -0,0 +1,139 @@
+//==============================================================================
+// Project  : Grape
+// Module   : IO
+// File     : LocalStreamSocket.cpp
+//
+// Copyright (c) 2012, Vilas Chitrakaran
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//    * Redistributions of source code must retain the above copyright
+//      notice, this list of conditions and the following disclaimer.
+//    * Redistributions in binary form must reproduce the above copyright
+//      notice, this list of conditions and the following disclaimer in the
+//      documentation and/or other materials provided with the distribution.
+//    * Neither the name of the copyright holder nor the names of its
+//      contributors may be used to endorse or promote products derived from
+//      this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR ITS CONTRIBUTORS
+// BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF
+// THE POSSIBILITY OF SUCH DAMAGE.
+//==============================================================================
+
+#include "LocalStreamSocket.h"
+#include "IoVecChunks.h"
+#include <errno.h>
+#include <string.h>
+
+namespace grape
+{
+
+//==========================================================================
+LocalStreamSocket::LocalStreamSocket()
+//==========================================================================
+    : LocalSocket(openSocket(SOCK_STREAM))
+{
+}
+
+//==========================================================================
+LocalStreamSocket::LocalStreamSocket(int fd)
+//==========================================================================
+    : LocalSocket(fd)
+{
+}
+
+//--------------------------------------------------------------------------
+LocalStreamSocket::~LocalStreamSocket() throw()
+//--------------------------------------------------------------------------
+{
+}
+
+//--------------------------------------------------------------------------
+bool LocalStreamSocket::connect(const std::string& path)
+//--------------------------------------------------------------------------
+{
+    struct sockaddr_un addr;
+    socklen_t len;
+    makeAddress(path, addr, len);
+    return (::connect(_sockFd, (struct sockaddr*)&addr, len) == 0);
+}
+
+//--------------------------------------------------------------------------
+void LocalStreamSocket::listen(int backlog)
+//--------------------------------------------------------------------------
+{
+    if( ::listen(_sockFd, backlog) < 0 )
+    {
+        throwSocketException("[LocalStreamSocket::listen]");
+    }
+}
+
+//--------------------------------------------------------------------------
+LocalStreamSocket* LocalStreamSocket::accept()
+//--------------------------------------------------------------------------
+{
+    int fd = ::accept4(_sockFd, NULL, NULL, SOCK_CLOEXEC);
+    if( fd < 0 )
+    {
+        throwSocketException("[LocalStreamSocket::accept]");
+    }
+    return new LocalStreamSocket(fd);
+}
+
+//--------------------------------------------------------------------------
+unsigned int LocalStreamSocket::write(const std::vector<unsigned char>& buffer)
+//--------------------------------------------------------------------------
+{
+    return write(buffer.empty() ? NULL : &buffer[0], buffer.size());
+}
+
+//--------------------------------------------------------------------------
+unsigned int LocalStreamSocket::write(const unsigned char* pBuffer, unsigned int bytes)
+//--------------------------------------------------------------------------
+{
+    ssize_t len = ::send(_sockFd, pBuffer, bytes, MSG_NOSIGNAL);
+    if( len < 0 )
+    {
+        throwSocketException("[LocalStreamSocket::write(send)]");
+    }
+
+    return len;
+}
+
+//--------------------------------------------------------------------------
+unsigned int LocalStreamSocket::writev(const Buffer* buffers, unsigned int count)
+//--------------------------------------------------------------------------
+{
+    IoVecChunks chunks(buffers, count);
+    while( chunks.next() )
+    {
+        struct msghdr msg;
+        memset(&msg, 0, sizeof(msg));
+        msg.msg_iov = chunks.iov();
+        msg.msg_iovlen = chunks.size();
+
+        ssize_t len = ::sendmsg(_sockFd, &msg, MSG_NOSIGNAL);
+        if( len < 0 )
+        {
+            throwSocketException("[LocalStreamSocket::writev(sendmsg)]");
+        }
+        if( !chunks.advance(len) )
+        {
+            break; // partial write. caller continues with the rest
+        }
+    }
+
+    return chunks.total();
+}
+
+} // grape
@@ -0,0 +1,96 @@
+//==============================================================================
+// Project  : Grape
+// Module   : IO
+// File     : LocalStreamSocket.h
+// Brief    : Unix domain stream socket
+//
+// Copyright (c) 2012, Vilas Chitrakaran
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//    * Redistributions of source code must retain the above copyright
+//      notice, this list of conditions and the following disclaimer.
+//    * Redistributions in binary form must reproduce the above copyright
+//      notice, this list of conditions and the following disclaimer in the
+//      documentation and/or other materials provided with the distribution.
+//    * Neither the name of the copyright holder nor the names of its
+//      contributors may be used to endorse or promote products derived from
+//      this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR ITS CONTRIBUTORS
+// BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF
+// THE POSSIBILITY OF SUCH DAMAGE.
+//==============================================================================
+
+#ifndef GRAPE_LOCALSTREAMSOCKET_H
+#define GRAPE_LOCALSTREAMSOCKET_H
+
+#include "LocalSocket.h"
+
+namespace grape
+{
+
+/// \brief Unix domain stream socket
+/// \ingroup io
+///
+/// Connection oriented, reliable byte stream between processes on the same host.
+/// Use in place of TcpSocket for local links; the interface is the same, with
+/// socket paths in place of IP addresses and ports.
+/// \code
+/// // server
+/// grape::LocalStreamSocket server;
+/// server.bind("/tmp/grape.sock");
+/// server.listen(1);
+/// grape::LocalStreamSocket* pClient = server.accept();
+///
+/// // client
+/// grape::LocalStreamSocket client;
+/// client.connect("/tmp/grape.sock");
+/// \endcode
+///
+/// Note that any method can throw SocketException on error
+class GRAPEIO_DLL_API LocalStreamSocket : public LocalSocket
+{
+public:
+
+    LocalStreamSocket();
+    virtual ~LocalStreamSocket() throw(/*nothing*/);
+
+    /// Establish connection with a listening socket
+    /// \param path Path the server socket is bound to. See LocalSocket::bind()
+    /// \return true if connection was established successfully
+    bool connect(const std::string& path);
+
+    /// Place socket in a passive state listening for incoming connections.
+    /// Call bind first.
+    /// \param backlog The maximum length of queue of pending connections.
+    /// \see bind, accept
+    void listen(int backlog);
+
+    /// Accept an incoming connection. This socket should be bound (see bind())
+    /// and listening for connections (see listen())
+    /// \return Socket for the accepted connection. After use, the user must
+    /// delete the socket.
+    LocalStreamSocket* accept();
+
+    unsigned int write(const std::vector<unsigned char>& buffer);
+    unsigned int write(const unsigned char* pBuffer, unsigned int bytes);
+    unsigned int writev(const Buffer* buffers, unsigned int count);
+
+private:
+    explicit LocalStreamSocket(int fd);
+
+}; // LocalStreamSocket
+
+} // grape
+
+#endif // GRAPE_LOCALSTREAMSOCKET_H
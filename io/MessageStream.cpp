@@ -0,0 +1,229 @@
+//==============================================================================
+// Project  : Grape
+// Module   : IO
+// File     : MessageStream.cpp
+//
+// Copyright (c) 2012, Vilas Chitrakaran
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//    * Redistributions of source code must retain the above copyright
+//      notice, this list of conditions and the following disclaimer.
+//    * Redistributions in binary form must reproduce the above copyright
+//      notice, this list of conditions and the following disclaimer in the
+//      documentation and/or other materials provided with the distribution.
+//    * Neither the name of the copyright holder nor the names of its
+//      contributors may be used to endorse or promote products derived from
+//      this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR ITS CONTRIBUTORS
+// BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF
+// THE POSSIBILITY OF SUCH DAMAGE.
+//==============================================================================
+
+#include "MessageStream.h"
+#include <string.h>
+#include <errno.h>
+#include <limits.h>
+#include <sstream>
+
+namespace grape
+{
+
+static const unsigned int MAX_PARTS = 15; // payload parts per message in send()
+
+//------------------------------------------------------------------------------
+static inline void encodeLength(unsigned int length, unsigned char* pHeader)
+//------------------------------------------------------------------------------
+{
+    pHeader[0] = (unsigned char)(length >> 24);
+    pHeader[1] = (unsigned char)(length >> 16);
+    pHeader[2] = (unsigned char)(length >> 8);
+    pHeader[3] = (unsigned char)(length);
+}
+
+//------------------------------------------------------------------------------
+static inline unsigned int decodeLength(const unsigned char* pHeader)
+//------------------------------------------------------------------------------
+{
+    return ((unsigned int)pHeader[0] << 24) | ((unsigned int)pHeader[1] << 16) | ((unsigned int)pHeader[2] << 8) | (unsigned int)pHeader[3];
+}
+
+//==============================================================================
+MessageStream::MessageStream(IDataPort& port, unsigned int maxMessageSize, unsigned int bufferSize)
+//==============================================================================
+    : _port(port),
+      _maxMessageSize(maxMessageSize),
+      _pBuffer(NULL),
+      _capacity(bufferSize),
+      _readPos(0),
+      _writePos(0)
+{
+    if( maxMessageSize > UINT_MAX - HEADER_SIZE )
+    {
+        throw IoException(EINVAL, "[MessageStream::MessageStream]: Maximum message size too large");
+    }
+
+    if( _capacity < maxMessageSize + HEADER_SIZE )
+    {
+        _capacity = maxMessageSize + HEADER_SIZE;
+    }
+    _pBuffer = new unsigned char[_capacity];
+}
+
+//------------------------------------------------------------------------------
+MessageStream::~MessageStream() throw()
+//------------------------------------------------------------------------------
+{
+    delete [] _pBuffer;
+}
+
+//------------------------------------------------------------------------------
+void MessageStream::compact()
+//------------------------------------------------------------------------------
+{
+    if( _readPos == _writePos )
+    {
+        _readPos = _writePos = 0;
+        return;
+    }
+
+    // Move the partial message to the front of the buffer if there isn't enough
+    // room behind it to complete it, or if the free space is getting small.
+    unsigned int pending = _writePos - _readPos;
+    unsigned int needed = HEADER_SIZE;
+    if( pending >= HEADER_SIZE )
+    {
+        // an oversized length is reported by next(), don't let it wrap here
+        unsigned int length = decodeLength(_pBuffer + _readPos);
+        if( length <= _maxMessageSize )
+        {
+            needed += length;
+        }
+    }
+
+    if( (_readPos > 0) && ((_readPos + needed > _capacity) || (_capacity - _writePos < _capacity / 4)) )
+    {
+        memmove(_pBuffer, _pBuffer + _readPos, pending);
+        _readPos = 0;
+        _writePos = pending;
+    }
+}
+
+//------------------------------------------------------------------------------
+unsigned int MessageStream::receive()
+//------------------------------------------------------------------------------
+{
+    compact();
+    if( _writePos == _capacity )
+    {
+        throw IoReadException(-1, "[MessageStream::receive]: Receive buffer full. Call next() to consume messages");
+    }
+
+    unsigned int bytes = _port.readn(_pBuffer + _writePos, _capacity - _writePos);
+    _writePos += bytes;
+    return bytes;
+}
+
+//------------------------------------------------------------------------------
+bool MessageStream::next(Message& msg)
+//------------------------------------------------------------------------------
+{
+    unsigned int pending = _writePos - _readPos;
+    if( pending < HEADER_SIZE )
+    {
+        return false;
+    }
+
+    unsigned int length = decodeLength(_pBuffer + _readPos);
+    if( length > _maxMessageSize )
+    {
+        std::ostringstream str;
+        str << "[MessageStream::next]: Message size " << length << " exceeds limit " << _maxMessageSize;
+        throw IoReadException(-1, str.str());
+    }
+
+    if( pending < HEADER_SIZE + length )
+    {
+        return false;
+    }
+
+    msg.pData = _pBuffer + _readPos + HEADER_SIZE;
+    msg.size = length;
+    _readPos += HEADER_SIZE + length;
+    return true;
+}
+
+//------------------------------------------------------------------------------
+void MessageStream::send(const unsigned char* pData, unsigned int size)
+//------------------------------------------------------------------------------
+{
+    IDataPort::Buffer part = {pData, size};
+    send(&part, 1);
+}
+
+//------------------------------------------------------------------------------
+void MessageStream::send(const IDataPort::Buffer* parts, unsigned int count)
+//------------------------------------------------------------------------------
+{
+    if( count > MAX_PARTS )
+    {
+        throw IoWriteException(-1, "[MessageStream::send]: Too many message parts");
+    }
+
+    unsigned char header[HEADER_SIZE];
+    IDataPort::Buffer buffers[MAX_PARTS + 1];
+
+    unsigned int length = 0;
+    for(unsigned int i = 0; i < count; ++i)
+    {
+        buffers[i + 1] = parts[i];
+        length += parts[i].size;
+    }
+
+    encodeLength(length, header);
+    buffers[0].pData = header;
+    buffers[0].size = HEADER_SIZE;
+
+    writeAll(buffers, count + 1);
+}
+
+//------------------------------------------------------------------------------
+void MessageStream::writeAll(IDataPort::Buffer* buffers, unsigned int count)
+//------------------------------------------------------------------------------
+{
+    while( count > 0 )
+    {
+        // the first buffer is never empty here, so no progress means the port is stuck
+        unsigned int written = _port.writev(buffers, count);
+        if( written == 0 )
+        {
+            throw IoWriteException(-1, "[MessageStream::writeAll]: Port accepted no data");
+        }
+
+        // skip past the buffers that were written completely, and adjust the
+        // partially written one
+        while( (count > 0) && (written >= buffers->size) )
+        {
+            written -= buffers->size;
+            ++buffers;
+            --count;
+        }
+        if( count > 0 )
+        {
+            buffers->pData += written;
+            buffers->size -= written;
+        }
+    }
+}
+
+} // grape
@@ -0,0 +1,149 @@
+//==============================================================================
+// Project  : Grape
+// Module   : IO
+// File     : MessageStream.h
+// Brief    : Length-prefixed message framing over stream ports
+//
+// Copyright (c) 2012, Vilas Chitrakaran
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//    * Redistributions of source code must retain the above copyright
+//      notice, this list of conditions and the following disclaimer.
+//    * Redistributions in binary form must reproduce the above copyright
+//      notice, this list of conditions and the following disclaimer in the
+//      documentation and/or other materials provided with the distribution.
+//    * Neither the name of the copyright holder nor the names of its
+//      contributors may be used to endorse or promote products derived from
+//      this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR ITS CONTRIBUTORS
+// BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF
+// THE POSSIBILITY OF SUCH DAMAGE.
+//==============================================================================
+
+#ifndef GRAPEIO_MESSAGESTREAM_H
+#define GRAPEIO_MESSAGESTREAM_H
+
+#include "IDataPort.h"
+
+namespace grape
+{
+
+/// \class MessageStream
+/// \ingroup io
+/// \brief Length-prefixed message framing over a stream port such as TcpSocket
+///
+/// A byte stream does not preserve message boundaries: a single read may return
+/// part of a message, or several messages. MessageStream frames each message with
+/// a 4 byte length header (network byte order) and reassembles complete messages
+/// on the receiving end.
+///
+/// Received data is accumulated in an internal buffer that is allocated once.
+/// Complete messages are handed out as pointers into that buffer, without copying.
+/// On the sending side, header and payload are written with a single gather write.
+///
+/// \code
+/// grape::MessageStream stream(socket);
+/// stream.send(command, commandSize);
+///
+/// while( socket.waitForRead(1000) == grape::IDataPort::PORT_OK )
+/// {
+///     if( stream.receive() == 0 ) break; // connection closed
+///
+///     grape::MessageStream::Message msg;
+///     while( stream.next(msg) )
+///     {
+///         process(msg.pData, msg.size); // valid until the next call to receive()
+///     }
+/// }
+/// \endcode
+///
+/// Methods throw the exceptions thrown by the underlying port. Not thread-safe.
+class GRAPEIO_DLL_API MessageStream
+{
+public:
+    static const unsigned int HEADER_SIZE = 4; //!< bytes in the length header
+
+    /// \brief A received message
+    struct Message
+    {
+        const unsigned char* pData; //!< Message payload
+        unsigned int size;          //!< Payload size in bytes
+    };
+
+public:
+
+    /// Constructor
+    /// \param port             Stream port to frame messages on. Must outlive this object.
+    /// \param maxMessageSize   Largest payload that can be received.
+    /// \param bufferSize       Size of the receive buffer. A larger buffer lets more
+    ///                         messages be collected by a single call to receive().
+    ///                         Enlarged if necessary to hold the largest message.
+    /// \throw IoException if maxMessageSize plus the header does not fit in an unsigned int.
+    MessageStream(IDataPort& port, unsigned int maxMessageSize = 65536, unsigned int bufferSize = 0);
+    ~MessageStream() throw();
+
+    /// \return The underlying port
+    IDataPort& port() { return _port; }
+
+    /// Read available data from the port into the receive buffer. This makes a single
+    /// read call, which blocks if the port blocks and has no data. Messages returned
+    /// by next() earlier are invalidated.
+    /// \return Number of bytes read. For a TcpSocket, 0 means the peer has closed the connection.
+    /// \throw IoReadException if the receive buffer is full because complete messages
+    ///        have not been consumed with next().
+    unsigned int receive();
+
+    /// Get the next complete message in the receive buffer.
+    /// \param msg  Set to point to the message payload. The data remains valid until the
+    ///             next call to receive().
+    /// \return false if no complete message is available.
+    /// \throw IoReadException if the next message header announces a message larger
+    ///        than maxMessageSize. The stream cannot resynchronise; close the connection.
+    bool next(Message& msg);
+
+    /// \return Number of received bytes not yet returned as messages
+    unsigned int pendingBytes() const { return _writePos - _readPos; }
+
+    /// Send a message. Blocks until the whole message is written.
+    /// \param pData    Payload
+    /// \param size     Payload size in bytes
+    /// \throw IoWriteException if the port stops accepting data.
+    void send(const unsigned char* pData, unsigned int size);
+
+    /// Send a message made up of several parts, as if they were concatenated.
+    /// \param parts    Array of buffers
+    /// \param count    Number of buffers (at most 15)
+    void send(const IDataPort::Buffer* parts, unsigned int count);
+
+    /// Discard all received data.
+    void reset() { _readPos = _writePos = 0; }
+
+private:
+    void compact();
+    void writeAll(IDataPort::Buffer* buffers, unsigned int count);
+private:
+    MessageStream(const MessageStream&);            //!< disable copy
+    MessageStream &operator=(const MessageStream&); //!< disable assignment
+private:
+    IDataPort&      _port;
+    unsigned int    _maxMessageSize;
+    unsigned char*  _pBuffer;
+    unsigned int    _capacity;
+    unsigned int    _readPos;   //!< start of first unconsumed byte
+    unsigned int    _writePos;  //!< end of received data
+}; // MessageStream
+
+} // grape
+
+#endif // GRAPEIO_MESSAGESTREAM_H
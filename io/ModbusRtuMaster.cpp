@@ -0,0 +1,511 @@
+//==============================================================================
+// Project  : Grape
+// Module   : IO
+// File     : ModbusRtuMaster.cpp
+//
+// Copyright (c) 2012, Vilas Chitrakaran
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//    * Redistributions of source code must retain the above copyright
+//      notice, this list of conditions and the following disclaimer.
+//    * Redistributions in binary form must reproduce the above copyright
+//      notice, this list of conditions and the following disclaimer in the
+//      documentation and/or other materials provided with the distribution.
+//    * Neither the name of the copyright holder nor the names of its
+//      contributors may be used to endorse or promote products derived from
+//      this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR ITS CONTRIBUTORS
+// BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF
+// THE POSSIBILITY OF SUCH DAMAGE.
+//==============================================================================
+
+#include "ModbusRtuMaster.h"
+#include <string.h>
+#include <errno.h>
+#include <sstream>
+
+#ifdef _MSC_VER
+#include <windows.h>
+#else
+#include <time.h>
+#endif
+
+namespace grape
+{
+
+static const unsigned char EXCEPTION_FLAG = 0x80;
+static const unsigned int EXCEPTION_RESPONSE_SIZE = 5;
+static const unsigned int BITS_PER_CHARACTER = 11;      // start, 8 data, parity or second stop, stop
+static const long long FIXED_FRAME_GAP_NS = 1750000;    // t3.5 above 19200 baud
+
+//--------------------------------------------------------------------------
+static void putU16(unsigned char* p, unsigned short v)
+//--------------------------------------------------------------------------
+{
+    p[0] = (unsigned char)(v >> 8);
+    p[1] = (unsigned char)v;
+}
+
+//--------------------------------------------------------------------------
+static unsigned short getU16(const unsigned char* p)
+//--------------------------------------------------------------------------
+{
+    return (unsigned short)((p[0] << 8) | p[1]);
+}
+
+//==========================================================================
+ModbusRtuMaster::ModbusRtuMaster(SerialPort& port, unsigned int responseTimeoutMs)
+//==========================================================================
+    : _port(port),
+      _responseTimeoutNs((long long)responseTimeoutMs * 1000000LL),
+      _charNs(0),
+      _frameGapNs(0),
+      _busIdleNs(0),
+      _busyNs(0),
+      _busUtilisation(0)
+{
+    resetStatistics();
+    updateTiming();
+}
+
+//--------------------------------------------------------------------------
+ModbusRtuMaster::~ModbusRtuMaster() throw()
+//--------------------------------------------------------------------------
+{
+}
+
+//--------------------------------------------------------------------------
+long long ModbusRtuMaster::nowNs()
+//--------------------------------------------------------------------------
+{
+#ifdef _MSC_VER
+    LARGE_INTEGER count, frequency;
+    QueryPerformanceCounter(&count);
+    QueryPerformanceFrequency(&frequency);
+    return (long long)((double)count.QuadPart * 1e9 / (double)frequency.QuadPart);
+#else
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (long long)ts.tv_sec * 1000000000LL + ts.tv_nsec;
+#endif
+}
+
+//--------------------------------------------------------------------------
+void ModbusRtuMaster::sleepUntilNs(long long deadline)
+//--------------------------------------------------------------------------
+{
+    long long remaining = deadline - nowNs();
+    while( remaining > 0 )
+    {
+#ifdef _MSC_VER
+        Sleep((DWORD)((remaining + 999999LL) / 1000000LL));
+#else
+        struct timespec ts;
+        ts.tv_sec = (time_t)(remaining / 1000000000LL);
+        ts.tv_nsec = (long)(remaining % 1000000000LL);
+        nanosleep(&ts, NULL);
+#endif
+        remaining = deadline - nowNs();
+    }
+}
+
+//--------------------------------------------------------------------------
+void ModbusRtuMaster::updateTiming()
+//--------------------------------------------------------------------------
+{
+    const unsigned int baud = _port.getBaudRate();
+    if( baud == 0 )
+    {
+        throw IoException(EINVAL, "[ModbusRtuMaster::updateTiming]: Baud rate of port is 0");
+    }
+    _charNs = (BITS_PER_CHARACTER * 1000000000LL + baud - 1) / baud;
+    _frameGapNs = (baud > 19200) ? FIXED_FRAME_GAP_NS : (_charNs * 7 + 1) / 2;
+}
+
+//--------------------------------------------------------------------------
+const ModbusRtuMaster::SlaveStatistics& ModbusRtuMaster::getSlaveStatistics(unsigned char slave) const
+//--------------------------------------------------------------------------
+{
+    if( slave >= MAX_SLAVES )
+    {
+        throw IoException(EINVAL, "[ModbusRtuMaster::getSlaveStatistics]: Slave address must be 0 to 247");
+    }
+    return _slaveStats[slave];
+}
+
+//--------------------------------------------------------------------------
+void ModbusRtuMaster::resetStatistics()
+//--------------------------------------------------------------------------
+{
+    memset(_slaveStats, 0, sizeof(_slaveStats));
+}
+
+//--------------------------------------------------------------------------
+unsigned short ModbusRtuMaster::crc16(const unsigned char* pData, unsigned int size)
+//--------------------------------------------------------------------------
+{
+    unsigned short crc = 0xFFFF;
+    for(unsigned int i = 0; i < size; ++i)
+    {
+        crc ^= pData[i];
+        for(int bit = 0; bit < 8; ++bit)
+        {
+            crc = (crc & 1) ? (unsigned short)((crc >> 1) ^ 0xA001) : (unsigned short)(crc >> 1);
+        }
+    }
+    return crc;
+}
+
+//--------------------------------------------------------------------------
+void ModbusRtuMaster::validate(const Request& request)
+//--------------------------------------------------------------------------
+{
+    unsigned int maxCount = 1;
+    bool isWrite = true;
+    switch( request.function )
+    {
+    case READ_COILS:
+    case READ_DISCRETE_INPUTS:
+        maxCount = 2000;
+        isWrite = false;
+        break;
+    case READ_HOLDING_REGISTERS:
+    case READ_INPUT_REGISTERS:
+        maxCount = 125;
+        isWrite = false;
+        break;
+    case WRITE_SINGLE_COIL:
+    case WRITE_SINGLE_REGISTER:
+        break;
+    case WRITE_MULTIPLE_REGISTERS:
+        maxCount = 123;
+        break;
+    default:
+    {
+        std::ostringstream str;
+        str << "[ModbusRtuMaster::validate]: Unsupported function code " << (int)request.function;
+        throw IoException(EINVAL, str.str());
+    }
+    }
+
+    if( (request.count == 0) || (request.count > maxCount) )
+    {
+        std::ostringstream str;
+        str << "[ModbusRtuMaster::validate]: Count must be 1 to " << maxCount << " for function " << (int)request.function;
+        throw IoException(EINVAL, str.str());
+    }
+    if( (request.slave >= MAX_SLAVES) || ((request.slave == 0) && !isWrite) )
+    {
+        throw IoException(EINVAL, "[ModbusRtuMaster::validate]: Slave address must be 1 to 247, or 0 to broadcast a write");
+    }
+    if( request.pData == NULL )
+    {
+        throw IoException(EINVAL, "[ModbusRtuMaster::validate]: No data buffer");
+    }
+}
+
+//--------------------------------------------------------------------------
+unsigned int ModbusRtuMaster::encodeRequest(const Request& request)
+//--------------------------------------------------------------------------
+{
+    _tx[0] = request.slave;
+    _tx[1] = request.function;
+    putU16(_tx + 2, request.address);
+
+    unsigned int size = 6;
+    switch( request.function )
+    {
+    case WRITE_SINGLE_COIL:
+        putU16(_tx + 4, request.pData[0] ? 0xFF00 : 0x0000);
+        break;
+    case WRITE_SINGLE_REGISTER:
+        putU16(_tx + 4, request.pData[0]);
+        break;
+    case WRITE_MULTIPLE_REGISTERS:
+        putU16(_tx + 4, request.count);
+        _tx[6] = (unsigned char)(2 * request.count);
+        for(unsigned int i = 0; i < request.count; ++i)
+        {
+            putU16(_tx + 7 + 2 * i, request.pData[i]);
+        }
+        size = 7 + 2 * request.count;
+        break;
+    default:
+        putU16(_tx + 4, request.count);
+        break;
+    }
+
+    const unsigned short crc = crc16(_tx, size);
+    _tx[size++] = (unsigned char)(crc & 0xFF);
+    _tx[size++] = (unsigned char)(crc >> 8);
+    return size;
+}
+
+//--------------------------------------------------------------------------
+unsigned int ModbusRtuMaster::expectedResponseSize(const Request& request) const
+//--------------------------------------------------------------------------
+{
+    switch( request.function )
+    {
+    case READ_COILS:
+    case READ_DISCRETE_INPUTS:
+        return 5 + (request.count + 7) / 8;
+    case READ_HOLDING_REGISTERS:
+    case READ_INPUT_REGISTERS:
+        return 5 + 2 * request.count;
+    default:
+        return 8; // writes echo address and value or count
+    }
+}
+
+//--------------------------------------------------------------------------
+unsigned int ModbusRtuMaster::readResponse(unsigned int expected, long long deadline)
+//--------------------------------------------------------------------------
+{
+    unsigned int received = 0;
+    while( received < expected )
+    {
+        const long long remaining = deadline - nowNs();
+        if( remaining <= 0 )
+        {
+            break;
+        }
+        const IDataPort::Status status = _port.waitForRead((int)((remaining + 999999LL) / 1000000LL));
+        if( status == IDataPort::PORT_ERROR )
+        {
+            break;
+        }
+        if( status != IDataPort::PORT_OK )
+        {
+            continue;
+        }
+
+        const unsigned int n = _port.readn(_rx + received, expected - received);
+        if( n == 0 )
+        {
+            continue;
+        }
+        received += n;
+        _busIdleNs = nowNs();
+
+        // an exception response is shorter than the normal one
+        if( (received >= 2) && (_rx[1] & EXCEPTION_FLAG) && (expected > EXCEPTION_RESPONSE_SIZE) )
+        {
+            expected = EXCEPTION_RESPONSE_SIZE;
+        }
+    }
+    return received;
+}
+
+//--------------------------------------------------------------------------
+ModbusRtuMaster::Result ModbusRtuMaster::decodeResponse(Request& request, unsigned int size)
+//--------------------------------------------------------------------------
+{
+    const unsigned short crc = crc16(_rx, size - 2);
+    if( (_rx[size - 2] != (unsigned char)(crc & 0xFF)) || (_rx[size - 1] != (unsigned char)(crc >> 8)) )
+    {
+        return CRC_ERROR;
+    }
+    if( _rx[0] != request.slave )
+    {
+        return BAD_RESPONSE;
+    }
+    if( _rx[1] == (request.function | EXCEPTION_FLAG) )
+    {
+        if( size != EXCEPTION_RESPONSE_SIZE )
+        {
+            return BAD_RESPONSE;
+        }
+        request.exceptionCode = _rx[2];
+        return EXCEPTION;
+    }
+    if( (_rx[1] != request.function) || (size != expectedResponseSize(request)) )
+    {
+        return BAD_RESPONSE;
+    }
+
+    switch( request.function )
+    {
+    case READ_COILS:
+    case READ_DISCRETE_INPUTS:
+        if( _rx[2] != size - 5 )
+        {
+            return BAD_RESPONSE;
+        }
+        for(unsigned int i = 0; i < request.count; ++i)
+        {
+            request.pData[i] = (_rx[3 + i / 8] >> (i % 8)) & 1;
+        }
+        break;
+    case READ_HOLDING_REGISTERS:
+    case READ_INPUT_REGISTERS:
+        if( _rx[2] != size - 5 )
+        {
+            return BAD_RESPONSE;
+        }
+        for(unsigned int i = 0; i < request.count; ++i)
+        {
+            request.pData[i] = getU16(_rx + 3 + 2 * i);
+        }
+        break;
+    default:
+        // writes echo the address and the value (single) or count (multiple)
+        if( memcmp(_rx + 2, _tx + 2, 4) != 0 )
+        {
+            return BAD_RESPONSE;
+        }
+        break;
+    }
+    return OK;
+}
+
+//--------------------------------------------------------------------------
+void ModbusRtuMaster::updateStatistics(const Request& request, long long latencyNs)
+//--------------------------------------------------------------------------
+{
+    SlaveStatistics& stats = _slaveStats[request.slave];
+    ++stats.requests;
+    switch( request.result )
+    {
+    case TIMEOUT:
+        ++stats.timeouts;
+        return;
+    case CRC_ERROR:
+    case BAD_RESPONSE:
+        ++stats.errors;
+        return;
+    case EXCEPTION:
+        ++stats.exceptions;
+        break;
+    default:
+        break;
+    }
+
+    if( request.slave == 0 )
+    {
+        return; // broadcasts have no response
+    }
+
+    const unsigned long long latencyUs = (unsigned long long)(latencyNs / 1000);
+    ++stats.responses;
+    stats.lastLatencyUs = latencyUs;
+    stats.totalLatencyUs += latencyUs;
+    if( (stats.responses == 1) || (latencyUs < stats.minLatencyUs) )
+    {
+        stats.minLatencyUs = latencyUs;
+    }
+    if( latencyUs > stats.maxLatencyUs )
+    {
+        stats.maxLatencyUs = latencyUs;
+    }
+}
+
+//--------------------------------------------------------------------------
+ModbusRtuMaster::Result ModbusRtuMaster::transact(Request& request)
+//--------------------------------------------------------------------------
+{
+    validate(request);
+    const unsigned int size = encodeRequest(request);
+    request.exceptionCode = 0;
+
+    // wait out only what remains of the inter-frame gap, then discard anything
+    // left on the line (eg: a late response to a timed out request)
+    sleepUntilNs(_busIdleNs + _frameGapNs);
+    _port.flushRx();
+
+    const long long txStart = nowNs();
+    unsigned int written = 0;
+    while( written < size )
+    {
+        written += _port.write(_tx + written, size - written);
+        if( written < size )
+        {
+            _port.waitForWrite((int)(_responseTimeoutNs / 1000000LL));
+        }
+    }
+    _port.waitForWrite((int)(_responseTimeoutNs / 1000000LL));
+
+    // the driver may report the write complete before the UART has shifted it out
+    const long long airNs = size * _charNs;
+    const long long now = nowNs();
+    const long long txEnd = (now > txStart + airNs) ? now : txStart + airNs;
+    _busIdleNs = txEnd;
+    _busyNs += airNs;
+
+    if( request.slave == 0 )
+    {
+        // give slaves time to process the broadcast before the next request
+        sleepUntilNs(txEnd + _responseTimeoutNs);
+        _busIdleNs = nowNs();
+        request.result = OK;
+        updateStatistics(request, 0);
+        return request.result;
+    }
+
+    unsigned int expected = expectedResponseSize(request);
+    const unsigned int received = readResponse(expected, txEnd + _responseTimeoutNs);
+    const long long rxAirNs = received * _charNs;
+    _busyNs += rxAirNs;
+    if( _busIdleNs < txEnd + rxAirNs )
+    {
+        _busIdleNs = txEnd + rxAirNs; // the response can't have ended before it was shifted in
+    }
+    if( (received >= 2) && (_rx[1] & EXCEPTION_FLAG) )
+    {
+        expected = EXCEPTION_RESPONSE_SIZE;
+    }
+
+    if( received < expected )
+    {
+        request.result = TIMEOUT;
+        _busIdleNs = nowNs();
+    }
+    else
+    {
+        request.result = decodeResponse(request, received);
+    }
+    updateStatistics(request, _busIdleNs - txStart);
+    return request.result;
+}
+
+//--------------------------------------------------------------------------
+unsigned int ModbusRtuMaster::addPoll(const Request& request)
+//--------------------------------------------------------------------------
+{
+    validate(request);
+    _polls.push_back(request);
+    _polls.back().result = NOT_RUN;
+    _polls.back().exceptionCode = 0;
+    return (unsigned int)(_polls.size() - 1);
+}
+
+//--------------------------------------------------------------------------
+unsigned int ModbusRtuMaster::pollCycle()
+//--------------------------------------------------------------------------
+{
+    const long long start = nowNs();
+    _busyNs = 0;
+
+    unsigned int nOk = 0;
+    for(size_t i = 0; i < _polls.size(); ++i)
+    {
+        nOk += (transact(_polls[i]) == OK);
+    }
+
+    const long long elapsed = nowNs() - start;
+    _busUtilisation = (elapsed > 0) ? (double)_busyNs / (double)elapsed : 0;
+    return nOk;
+}
+
+} // grape
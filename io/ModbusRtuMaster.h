@@ -0,0 +1,231 @@
+//==============================================================================
+// Project  : Grape
+// Module   : IO
+// File     : ModbusRtuMaster.h
+// Brief    : Modbus RTU master over a serial port
+//
+// Copyright (c) 2012, Vilas Chitrakaran
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//    * Redistributions of source code must retain the above copyright
+//      notice, this list of conditions and the following disclaimer.
+//    * Redistributions in binary form must reproduce the above copyright
+//      notice, this list of conditions and the following disclaimer in the
+//      documentation and/or other materials provided with the distribution.
+//    * Neither the name of the copyright holder nor the names of its
+//      contributors may be used to endorse or promote products derived from
+//      this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR ITS CONTRIBUTORS
+// BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF
+// THE POSSIBILITY OF SUCH DAMAGE.
+//==============================================================================
+
+#ifndef GRAPEIO_MODBUSRTUMASTER_H
+#define GRAPEIO_MODBUSRTUMASTER_H
+
+#include "SerialPort.h"
+#include <vector>
+
+namespace grape
+{
+
+/// \class ModbusRtuMaster
+/// \ingroup io
+/// \brief Modbus RTU master for polling slaves on an RS-485 bus
+///
+/// Requests are sent as soon as the bus allows: the master waits only for the
+/// remainder of the 3.5 character inter-frame gap since the last byte on the
+/// bus, instead of a fixed delay. The gap is computed from the baud rate of the
+/// port, taking 11 bits per character; above 19200 baud it is fixed at 1750 us,
+/// as the Modbus serial line specification recommends. A response is read up
+/// to its expected length, derived from the request, so the master does not
+/// have to wait for a gap to detect the end of a frame.
+///
+/// Requests are either executed individually with transact(), or added to a
+/// polling table that pollCycle() executes back to back. Response latency and
+/// error counters are kept for each slave.
+/// \code
+/// grape::SerialPort port;
+/// port.setPortName("/dev/ttyUSB0");
+/// port.open();
+/// port.setBaudRate(grape::SerialPort::B115200);
+/// grape::ModbusRtuMaster master(port);
+///
+/// unsigned short temperatures[4];
+/// grape::ModbusRtuMaster::Request req = {};
+/// req.slave = 7;
+/// req.function = grape::ModbusRtuMaster::READ_INPUT_REGISTERS;
+/// req.address = 100;
+/// req.count = 4;
+/// req.pData = temperatures;
+/// const unsigned int poll = master.addPoll(req);
+///
+/// while( running )
+/// {
+///     master.pollCycle();
+///     if( master.getPoll(poll).result == grape::ModbusRtuMaster::OK )
+///         publish(temperatures);
+/// }
+/// \endcode
+///
+/// Methods throw IoException for invalid requests, and the port's exceptions on
+/// port errors. Not thread-safe.
+class GRAPEIO_DLL_API ModbusRtuMaster
+{
+public:
+    static const unsigned int MAX_ADU_SIZE = 256;   //!< Largest RTU frame, in bytes
+    static const unsigned int MAX_SLAVES = 248;     //!< Slave addresses are 1 to 247. 0 is broadcast.
+
+    /// \brief Supported function codes
+    enum Function
+    {
+        READ_COILS = 1,
+        READ_DISCRETE_INPUTS = 2,
+        READ_HOLDING_REGISTERS = 3,
+        READ_INPUT_REGISTERS = 4,
+        WRITE_SINGLE_COIL = 5,
+        WRITE_SINGLE_REGISTER = 6,
+        WRITE_MULTIPLE_REGISTERS = 16
+    };
+
+    /// \brief Outcome of a request
+    enum Result
+    {
+        OK,             //!< Valid response received
+        TIMEOUT,        //!< No response, or an incomplete one, within the response timeout
+        CRC_ERROR,      //!< Response failed the CRC check
+        EXCEPTION,      //!< Slave returned an exception response. See Request::exceptionCode.
+        BAD_RESPONSE,   //!< Response from the wrong slave, for the wrong function, or of the wrong size
+        NOT_RUN         //!< Request not executed yet
+    };
+
+    /// \brief A request and its outcome
+    struct Request
+    {
+        unsigned char slave;            //!< Slave address. 0 to broadcast a write.
+        unsigned char function;         //!< One of Function
+        unsigned short address;         //!< First register or coil
+        unsigned short count;           //!< Number of registers or coils
+        unsigned short* pData;          //!< Read destination or write source. One element per
+                                        //!< register or coil (0 or 1 for coils).
+        Result result;                  //!< Set on completion
+        unsigned char exceptionCode;    //!< Set if result is EXCEPTION
+    };
+
+    /// \brief Counters for one slave
+    struct SlaveStatistics
+    {
+        unsigned long long requests;
+        unsigned long long responses;       //!< Valid responses, including exception responses
+        unsigned long long timeouts;
+        unsigned long long errors;          //!< CRC errors and bad responses
+        unsigned long long exceptions;
+        unsigned long long lastLatencyUs;   //!< From start of request to end of response
+        unsigned long long minLatencyUs;
+        unsigned long long maxLatencyUs;
+        unsigned long long totalLatencyUs;  //!< Divide by responses for the mean
+    };
+
+public:
+    /// Constructor. The port must be open and configured; call updateTiming()
+    /// if its baud rate is changed afterwards.
+    /// \param port                 Port to the bus. Must outlive this object.
+    /// \param responseTimeoutMs    Time allowed for a response after the request
+    ///                             has been transmitted
+    ModbusRtuMaster(SerialPort& port, unsigned int responseTimeoutMs = 100);
+    ~ModbusRtuMaster() throw();
+
+    /// Recompute character and inter-frame timing from the baud rate of the port
+    void updateTiming();
+
+    /// Set the time allowed for a response after the request has been transmitted.
+    /// For a broadcast, this is the turnaround delay before the next request.
+    void setResponseTimeout(unsigned int ms) { _responseTimeoutNs = (long long)ms * 1000000LL; }
+
+    /// \return the inter-frame gap (t3.5) in microseconds
+    unsigned int getFrameGapUs() const { return (unsigned int)(_frameGapNs / 1000); }
+
+    /// \return the transmission time of one character in nanoseconds
+    unsigned int getCharacterTimeNs() const { return (unsigned int)_charNs; }
+
+    /// Execute a request and wait for the response
+    /// \param request  Request to execute. result and exceptionCode are set, and
+    ///                 for reads, pData is filled in.
+    /// \return request.result
+    /// \throw IoException if the request is invalid
+    Result transact(Request& request);
+
+    /// Add a request to the polling table
+    /// \return index of the request in the table
+    /// \throw IoException if the request is invalid
+    unsigned int addPoll(const Request& request);
+
+    /// \return a request in the polling table, with the outcome of its last execution
+    const Request& getPoll(unsigned int index) const { return _polls[index]; }
+
+    /// \return number of requests in the polling table
+    unsigned int getPollCount() const { return (unsigned int)_polls.size(); }
+
+    /// Empty the polling table
+    void clearPolls() { _polls.clear(); }
+
+    /// Execute every request in the polling table once, back to back
+    /// \return number of requests that completed with OK
+    unsigned int pollCycle();
+
+    /// \return fraction of the last pollCycle() the bus spent transmitting frames.
+    /// The remainder is inter-frame gaps, slave turnaround and host latency.
+    double getBusUtilisation() const { return _busUtilisation; }
+
+    /// \param slave Slave address, 0 to MAX_SLAVES - 1. Broadcasts are counted under 0.
+    /// \return counters for a slave
+    /// \throw IoException if the address is out of range
+    const SlaveStatistics& getSlaveStatistics(unsigned char slave) const;
+
+    /// Reset the counters for all slaves
+    void resetStatistics();
+
+    /// Compute the Modbus CRC-16 (polynomial 0xA001 reflected, initial value 0xFFFF)
+    /// \return CRC. It is sent low byte first.
+    static unsigned short crc16(const unsigned char* pData, unsigned int size);
+
+private:
+    static long long nowNs();
+    static void sleepUntilNs(long long deadline);
+    static void validate(const Request& request);
+    unsigned int encodeRequest(const Request& request);
+    unsigned int expectedResponseSize(const Request& request) const;
+    Result decodeResponse(Request& request, unsigned int size);
+    unsigned int readResponse(unsigned int expected, long long deadline);
+    void updateStatistics(const Request& request, long long latencyNs);
+private:
+    ModbusRtuMaster(const ModbusRtuMaster&);              //!< disable copy
+    ModbusRtuMaster &operator=(const ModbusRtuMaster&);   //!< disable assignment
+private:
+    SerialPort&             _port;
+    long long               _responseTimeoutNs;
+    long long               _charNs;            //!< time to transmit one character
+    long long               _frameGapNs;        //!< t3.5
+    long long               _busIdleNs;         //!< time of the last byte on the bus
+    long long               _busyNs;            //!< frame transmission time accumulated by pollCycle()
+    double                  _busUtilisation;
+    unsigned char           _tx[MAX_ADU_SIZE];
+    unsigned char           _rx[MAX_ADU_SIZE];
+    std::vector<Request>    _polls;
+    SlaveStatistics         _slaveStats[MAX_SLAVES];
+}; // ModbusRtuMaster
+
+} // grape
+
+#endif // GRAPEIO_MODBUSRTUMASTER_H
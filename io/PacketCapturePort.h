@@ -0,0 +1,167 @@
+//==============================================================================
+// Project  : Grape
+// Module   : IO
+// File     : PacketCapturePort.h
+// Brief    : Memory-mapped raw capture of UDP traffic
+//
+// Copyright (c) 2012, Vilas Chitrakaran
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//    * Redistributions of source code must retain the above copyright
+//      notice, this list of conditions and the following disclaimer.
+//    * Redistributions in binary form must reproduce the above copyright
+//      notice, this list of conditions and the following disclaimer in the
+//      documentation and/or other materials provided with the distribution.
+//    * Neither the name of the copyright holder nor the names of its
+//      contributors may be used to endorse or promote products derived from
+//      this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR ITS CONTRIBUTORS
+// BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF
+// THE POSSIBILITY OF SUCH DAMAGE.
+//==============================================================================
+
+#ifndef GRAPEIO_PACKETCAPTUREPORT_H
+#define GRAPEIO_PACKETCAPTUREPORT_H
+
+#include "IDataPort.h"
+#include <string>
+#include <netinet/in.h>
+
+namespace grape
+{
+
+/// \class PacketCapturePort
+/// \ingroup io
+/// \brief Receive-only port capturing UDP datagrams from a network interface
+/// through a memory-mapped packet ring
+///
+/// For high-rate sensor streams (eg: lidar) where reading one datagram per system
+/// call cannot keep up. The port opens an AF_PACKET socket with a TPACKET_V3 ring
+/// shared with the kernel. The kernel fills the ring a block at a time, filtering
+/// traffic in-kernel with a BPF program that accepts only IPv4 UDP datagrams to
+/// the given port, and hands over a block when it is full or its timeout expires.
+/// Datagrams are then read straight from the ring with no system call and no copy,
+/// using nextPacket(). A system call is only made to wait when the ring is empty.
+///
+/// The IDataPort read methods copy out the payload of one datagram per call, as
+/// UdpSocket does, so the port can also be used where an IDataPort is expected.
+/// \code
+/// grape::PacketCapturePort port;
+/// port.open("eth1", 2368);
+/// grape::PacketCapturePort::Packet pkt;
+/// while( port.nextPacket(pkt, 100) )
+///     processLidarPacket(pkt.pPayload, pkt.payloadLength);
+/// \endcode
+///
+/// Capture sees datagrams regardless of whether a socket is bound to the port, and
+/// does not consume them. Fragmented datagrams are not captured. Requires
+/// CAP_NET_RAW. Available on Linux only.
+class GRAPEIO_DLL_API PacketCapturePort : public IDataPort
+{
+public:
+    /// \brief A captured datagram. Pointers refer to the ring, and remain valid
+    /// until the next call to any read method of the port, or close().
+    struct Packet
+    {
+        const unsigned char* pPacket;   //!< IPv4 header
+        unsigned int packetLength;      //!< Bytes captured from the IPv4 header on
+        const unsigned char* pPayload;  //!< UDP payload
+        unsigned int payloadLength;     //!< Bytes of UDP payload captured
+        struct sockaddr_in source;      //!< Source address and port
+        struct sockaddr_in destination; //!< Destination address and port
+        long long timestampNs;          //!< Capture time (CLOCK_REALTIME)
+    };
+
+    /// \brief Kernel capture counters, since open()
+    struct Statistics
+    {
+        unsigned long long packets;     //!< Datagrams that passed the filter
+        unsigned long long drops;       //!< Datagrams dropped because the ring was full
+        unsigned long long freezes;     //!< Times the ring was found full
+    };
+
+    /// Largest ring block size accepted by open()
+    static const unsigned int MAX_BLOCK_SIZE = 0x40000000U;
+
+public:
+    PacketCapturePort();
+    virtual ~PacketCapturePort() throw(/*nothing*/);
+
+    /// Start capturing
+    /// \param interfaceName    Network interface (eg: "eth1", "lo")
+    /// \param udpPort          Destination UDP port to capture. 0 captures all UDP traffic.
+    /// \param blockSize        Size of each ring block in bytes. A multiple of the page
+    ///                         size, rounded up to a power of 2. At most MAX_BLOCK_SIZE.
+    /// \param blockCount       Number of blocks in the ring
+    /// \param blockTimeoutMs   Time after which the kernel hands over a block that is
+    ///                         not full. Bounds the latency at low packet rates.
+    /// \throw IoOpenException, also if blockSize is too large
+    void open(const std::string& interfaceName, unsigned short udpPort,
+              unsigned int blockSize = 1<<20, unsigned int blockCount = 16, unsigned int blockTimeoutMs = 10);
+
+    /// \return true if the port is open
+    bool isOpen() const;
+
+    /// Get the next captured datagram, without copying it out of the ring
+    /// \param packet       Set to the datagram. See Packet for the lifetime of pointers.
+    /// \param timeoutMs    Milliseconds to wait if the ring is empty. Negative to wait
+    ///                     indefinitely.
+    /// \throw IoReadException, IoEventHandlingException
+    /// \return false on timeout
+    bool nextPacket(Packet& packet, int timeoutMs);
+
+    /// \return kernel capture counters
+    /// \throw IoException
+    Statistics getStatistics();
+
+    // ------------- Reimplemented from IDataPort -------------------
+
+    void close() throw(/*nothing*/);
+
+    /// \copydoc IDataPort::readAll()
+    /// Reads the payload of the next datagram, if one has been captured. Does not block.
+    unsigned int readAll(std::vector<unsigned char>& buffer);
+
+    /// \copydoc IDataPort::readn()
+    /// Blocks until a datagram is captured, then reads up to the requested number of
+    /// bytes of its payload. The rest of the datagram is discarded.
+    unsigned int readn(std::vector<unsigned char>& buffer, unsigned int bytes);
+    unsigned int readn(unsigned char* pBuffer, unsigned int bytes);
+
+    /// \return Payload size of the next captured datagram, or 0 if there is none
+    unsigned int availableToRead();
+    Status waitForRead(int timeoutMs);
+
+    /// Discard all captured datagrams
+    void flushRx();
+
+    /// The port is receive-only
+    /// \throw IoWriteException
+    unsigned int write(const std::vector<unsigned char>& buffer);
+    unsigned int write(const unsigned char* pBuffer, unsigned int bytes);
+    Status waitForWrite(int /*timeoutMs*/) { return PORT_ERROR; } //!< The port is receive-only
+    void flushTx() {} //!< does nothing
+
+    int getFd() const;
+
+private:
+    PacketCapturePort(const PacketCapturePort&);              //!< disable copy
+    PacketCapturePort &operator=(const PacketCapturePort&);   //!< disable assignment
+private:
+    class PacketCapturePortP* _pImpl;                         //!< platform specific private implementation
+}; // PacketCapturePort
+
+} // grape
+
+#endif // GRAPEIO_PACKETCAPTUREPORT_H
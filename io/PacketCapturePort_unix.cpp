@@ -0,0 +1,538 @@
+//==============================================================================
+// Project  : Grape
+// Module   : IO
+// File     : PacketCapturePort_unix.cpp
+//
+// Copyright (c) 2012, Vilas Chitrakaran
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//    * Redistributions of source code must retain the above copyright
+//      notice, this list of conditions and the following disclaimer.
+//    * Redistributions in binary form must reproduce the above copyright
+//      notice, this list of conditions and the following disclaimer in the
+//      documentation and/or other materials provided with the distribution.
+//    * Neither the name of the copyright holder nor the names of its
+//      contributors may be used to endorse or promote products derived from
+//      this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR ITS CONTRIBUTORS
+// BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF
+// THE POSSIBILITY OF SUCH DAMAGE.
+//==============================================================================
+
+#include "PacketCapturePort.h"
+#include <sys/socket.h>
+#include <sys/mman.h>
+#include <linux/if_packet.h>
+#include <linux/if_ether.h>
+#include <linux/filter.h>
+#include <net/if.h>
+#include <arpa/inet.h>
+#include <poll.h>
+#include <unistd.h>
+#include <errno.h>
+#include <string.h>
+#include <sstream>
+
+#ifndef PACKET_IGNORE_OUTGOING
+#define PACKET_IGNORE_OUTGOING 23
+#endif
+
+namespace grape
+{
+
+//==============================================================================
+/// \class PacketCapturePortP
+/// \brief Linux specific private implementation
+//==============================================================================
+class PacketCapturePortP
+{
+public:
+    PacketCapturePortP() : _fd(-1), _pRing(NULL), _blockSize(0), _blockCount(0),
+        _block(0), _pBlock(NULL), _pNext(NULL), _remaining(0), _consumePending(false)
+    {
+        memset(&_stats, 0, sizeof(_stats));
+    }
+    void checkOpen(const char* location) const;
+    static void throwOpen(const char* location, int e);
+    static void setFilter(int fd, unsigned short udpPort);
+    bool acquireBlock();
+    void releaseBlock();
+    bool ensurePacket(int timeoutMs);
+    void consume();
+    bool parse(const struct tpacket3_hdr* pHdr, PacketCapturePort::Packet& packet) const;
+    void accumulateStatistics();
+public:
+    int _fd;
+    unsigned char* _pRing;
+    unsigned int _blockSize;
+    unsigned int _blockCount;
+    unsigned int _block;                //!< index of the block being read, or next to read
+    struct tpacket_block_desc* _pBlock; //!< block being read. NULL if the block is owned by the kernel
+    unsigned char* _pNext;              //!< next packet in the block
+    unsigned int _remaining;            //!< packets left in the block, including _pNext
+    bool _consumePending;               //!< packet at _pNext was returned to the caller
+    PacketCapturePort::Packet _packet;  //!< parsed packet at _pNext
+    PacketCapturePort::Statistics _stats;
+}; // PacketCapturePortP
+
+//------------------------------------------------------------------------------
+void PacketCapturePortP::checkOpen(const char* location) const
+//------------------------------------------------------------------------------
+{
+    if( _fd < 0 )
+    {
+        std::ostringstream str;
+        str << location << ": Port not open";
+        throw IoException(-1, str.str());
+    }
+}
+
+//------------------------------------------------------------------------------
+void PacketCapturePortP::throwOpen(const char* location, int e)
+//------------------------------------------------------------------------------
+{
+    std::ostringstream str;
+    str << location << ": " << strerror(e);
+    throw IoOpenException(e, str.str());
+}
+
+//------------------------------------------------------------------------------
+void PacketCapturePortP::setFilter(int fd, unsigned short udpPort)
+//------------------------------------------------------------------------------
+{
+    // offsets are from the IPv4 header (SOCK_DGRAM strips the link layer)
+    struct sock_filter code[] =
+    {
+        BPF_STMT(BPF_LD | BPF_B | BPF_ABS, 9),                  // protocol
+        BPF_JUMP(BPF_JMP | BPF_JEQ | BPF_K, IPPROTO_UDP, 0, 6),
+        BPF_STMT(BPF_LD | BPF_H | BPF_ABS, 6),                  // flags and fragment offset
+        BPF_JUMP(BPF_JMP | BPF_JSET | BPF_K, 0x3fff, 4, 0),     // drop fragments
+        BPF_STMT(BPF_LDX | BPF_B | BPF_MSH, 0),                 // x = header length
+        BPF_STMT(BPF_LD | BPF_H | BPF_IND, 2),                  // destination port
+        BPF_JUMP(BPF_JMP | BPF_JEQ | BPF_K, udpPort, 0, 1),
+        BPF_STMT(BPF_RET | BPF_K, 0x40000),                     // accept
+        BPF_STMT(BPF_RET | BPF_K, 0)                            // drop
+    };
+    if( udpPort == 0 )
+    {
+        // any port: fall through to accept
+        code[6].code = BPF_JMP | BPF_JA;
+        code[6].k = 0;
+        code[6].jf = 0;
+    }
+
+    struct sock_fprog prog;
+    prog.len = sizeof(code) / sizeof(code[0]);
+    prog.filter = code;
+    if( setsockopt(fd, SOL_SOCKET, SO_ATTACH_FILTER, &prog, sizeof(prog)) < 0 )
+    {
+        throwOpen("[PacketCapturePort::open(SO_ATTACH_FILTER)]", errno);
+    }
+}
+
+//------------------------------------------------------------------------------
+bool PacketCapturePortP::acquireBlock()
+//------------------------------------------------------------------------------
+{
+    struct tpacket_block_desc* pBlock = (struct tpacket_block_desc*)(_pRing + (size_t)_block * _blockSize);
+    if( (__atomic_load_n(&pBlock->hdr.bh1.block_status, __ATOMIC_ACQUIRE) & TP_STATUS_USER) == 0 )
+    {
+        return false;
+    }
+    _pBlock = pBlock;
+    _remaining = pBlock->hdr.bh1.num_pkts;
+    _pNext = (unsigned char*)pBlock + pBlock->hdr.bh1.offset_to_first_pkt;
+    return true;
+}
+
+//------------------------------------------------------------------------------
+void PacketCapturePortP::releaseBlock()
+//------------------------------------------------------------------------------
+{
+    __atomic_store_n(&_pBlock->hdr.bh1.block_status, TP_STATUS_KERNEL, __ATOMIC_RELEASE);
+    _pBlock = NULL;
+    _pNext = NULL;
+    _remaining = 0;
+    _block = (_block + 1) % _blockCount;
+}
+
+//------------------------------------------------------------------------------
+void PacketCapturePortP::consume()
+//------------------------------------------------------------------------------
+{
+    const struct tpacket3_hdr* pHdr = (const struct tpacket3_hdr*)_pNext;
+    _pNext += pHdr->tp_next_offset;
+    --_remaining;
+    _consumePending = false;
+}
+
+//------------------------------------------------------------------------------
+bool PacketCapturePortP::parse(const struct tpacket3_hdr* pHdr, PacketCapturePort::Packet& packet) const
+//------------------------------------------------------------------------------
+{
+    const struct sockaddr_ll* pLl = (const struct sockaddr_ll*)((const unsigned char*)pHdr + TPACKET_ALIGN(sizeof(struct tpacket3_hdr)));
+    if( pLl->sll_pkttype == PACKET_OUTGOING )
+    {
+        return false; // seen again as incoming on loopback
+    }
+
+    const unsigned char* p = (const unsigned char*)pHdr + pHdr->tp_net;
+    const unsigned int len = pHdr->tp_snaplen;
+    if( (len < 20) || ((p[0] >> 4) != 4) )
+    {
+        return false;
+    }
+    const unsigned int ipHeaderLen = (p[0] & 0xf) * 4;
+    if( len < ipHeaderLen + 8 )
+    {
+        return false;
+    }
+    const unsigned char* pUdp = p + ipHeaderLen;
+    const unsigned int udpLen = ((unsigned int)pUdp[4] << 8) | pUdp[5];
+
+    packet.pPacket = p;
+    packet.packetLength = len;
+    packet.pPayload = pUdp + 8;
+    packet.payloadLength = len - ipHeaderLen - 8;
+    if( (udpLen >= 8) && (udpLen - 8 < packet.payloadLength) )
+    {
+        packet.payloadLength = udpLen - 8; // link layer padding
+    }
+
+    memset(&packet.source, 0, sizeof(packet.source));
+    packet.source.sin_family = AF_INET;
+    memcpy(&packet.source.sin_addr, p + 12, 4);
+    memcpy(&packet.source.sin_port, pUdp, 2);
+    memset(&packet.destination, 0, sizeof(packet.destination));
+    packet.destination.sin_family = AF_INET;
+    memcpy(&packet.destination.sin_addr, p + 16, 4);
+    memcpy(&packet.destination.sin_port, pUdp + 2, 2);
+
+    packet.timestampNs = (long long)pHdr->tp_sec * 1000000000LL + pHdr->tp_nsec;
+    return true;
+}
+
+//------------------------------------------------------------------------------
+bool PacketCapturePortP::ensurePacket(int timeoutMs)
+//------------------------------------------------------------------------------
+{
+    if( _consumePending )
+    {
+        consume();
+    }
+
+    while( true )
+    {
+        if( _pBlock == NULL )
+        {
+            if( !acquireBlock() )
+            {
+                struct pollfd pfd;
+                pfd.fd = _fd;
+                pfd.events = POLLIN;
+                pfd.revents = 0;
+                int ret = poll(&pfd, 1, timeoutMs);
+                if( ret < 0 )
+                {
+                    if( errno == EINTR )
+                    {
+                        return false;
+                    }
+                    std::ostringstream str;
+                    str << "[PacketCapturePort::waitForRead(poll)]: " << strerror(errno);
+                    throw IoEventHandlingException(errno, str.str());
+                }
+                if( (ret == 0) || !acquireBlock() )
+                {
+                    return false;
+                }
+            }
+        }
+
+        if( _remaining == 0 )
+        {
+            releaseBlock();
+            continue;
+        }
+
+        if( parse((const struct tpacket3_hdr*)_pNext, _packet) )
+        {
+            return true;
+        }
+        consume();
+    }
+}
+
+//------------------------------------------------------------------------------
+void PacketCapturePortP::accumulateStatistics()
+//------------------------------------------------------------------------------
+{
+    // the kernel resets its counters on every read
+    struct tpacket_stats_v3 st;
+    socklen_t len = sizeof(st);
+    if( getsockopt(_fd, SOL_PACKET, PACKET_STATISTICS, &st, &len) < 0 )
+    {
+        std::ostringstream str;
+        str << "[PacketCapturePort::getStatistics(PACKET_STATISTICS)]: " << strerror(errno);
+        throw IoException(errno, str.str());
+    }
+    _stats.packets += st.tp_packets;
+    _stats.drops += st.tp_drops;
+    _stats.freezes += st.tp_freeze_q_cnt;
+}
+
+//==============================================================================
+PacketCapturePort::PacketCapturePort()
+//==============================================================================
+    : _pImpl(new PacketCapturePortP)
+{
+}
+
+//------------------------------------------------------------------------------
+PacketCapturePort::~PacketCapturePort() throw()
+//------------------------------------------------------------------------------
+{
+    close();
+    delete _pImpl;
+}
+
+//------------------------------------------------------------------------------
+void PacketCapturePort::open(const std::string& interfaceName, unsigned short udpPort,
+                             unsigned int blockSize, unsigned int blockCount, unsigned int blockTimeoutMs)
+//------------------------------------------------------------------------------
+{
+    close();
+
+    if( blockSize > MAX_BLOCK_SIZE )
+    {
+        throw IoOpenException(EINVAL, "[PacketCapturePort::open]: Block size larger than MAX_BLOCK_SIZE");
+    }
+
+    unsigned int ifIndex = if_nametoindex(interfaceName.c_str());
+    if( ifIndex == 0 )
+    {
+        PacketCapturePortP::throwOpen("[PacketCapturePort::open(if_nametoindex)]", errno);
+    }
+
+    const unsigned int pageSize = sysconf(_SC_PAGESIZE);
+    unsigned int size = pageSize;
+    while( size < blockSize )
+    {
+        size <<= 1;
+    }
+    if( blockCount == 0 )
+    {
+        blockCount = 1;
+    }
+
+    // protocol 0: nothing is queued until bind(), after the filter is in place
+    int fd = socket(AF_PACKET, SOCK_DGRAM, 0);
+    if( fd < 0 )
+    {
+        PacketCapturePortP::throwOpen("[PacketCapturePort::open(socket)]", errno);
+    }
+    _pImpl->_fd = fd;
+
+    try
+    {
+        PacketCapturePortP::setFilter(fd, udpPort);
+
+        int version = TPACKET_V3;
+        if( setsockopt(fd, SOL_PACKET, PACKET_VERSION, &version, sizeof(version)) < 0 )
+        {
+            PacketCapturePortP::throwOpen("[PacketCapturePort::open(PACKET_VERSION)]", errno);
+        }
+
+        // not available before Linux 4.20; outgoing packets are then skipped when read
+        int one = 1;
+        setsockopt(fd, SOL_PACKET, PACKET_IGNORE_OUTGOING, &one, sizeof(one));
+
+        struct tpacket_req3 req;
+        memset(&req, 0, sizeof(req));
+        req.tp_block_size = size;
+        req.tp_block_nr = blockCount;
+        req.tp_frame_size = TPACKET_ALIGNMENT << 7; // nominal; V3 packs variable size frames
+        req.tp_frame_nr = (size / req.tp_frame_size) * blockCount;
+        req.tp_retire_blk_tov = blockTimeoutMs;
+        if( setsockopt(fd, SOL_PACKET, PACKET_RX_RING, &req, sizeof(req)) < 0 )
+        {
+            PacketCapturePortP::throwOpen("[PacketCapturePort::open(PACKET_RX_RING)]", errno);
+        }
+
+        void* p = mmap(NULL, (size_t)size * blockCount, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_LOCKED, fd, 0);
+        if( p == MAP_FAILED )
+        {
+            // locking may exceed RLIMIT_MEMLOCK
+            p = mmap(NULL, (size_t)size * blockCount, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+        }
+        if( p == MAP_FAILED )
+        {
+            PacketCapturePortP::throwOpen("[PacketCapturePort::open(mmap)]", errno);
+        }
+        _pImpl->_pRing = (unsigned char*)p;
+        _pImpl->_blockSize = size;
+        _pImpl->_blockCount = blockCount;
+
+        struct sockaddr_ll addr;
+        memset(&addr, 0, sizeof(addr));
+        addr.sll_family = AF_PACKET;
+        addr.sll_protocol = htons(ETH_P_IP);
+        addr.sll_ifindex = ifIndex;
+        if( bind(fd, (struct sockaddr*)&addr, sizeof(addr)) < 0 )
+        {
+            PacketCapturePortP::throwOpen("[PacketCapturePort::open(bind)]", errno);
+        }
+    }
+    catch(...)
+    {
+        close();
+        throw;
+    }
+}
+
+//------------------------------------------------------------------------------
+bool PacketCapturePort::isOpen() const
+//------------------------------------------------------------------------------
+{
+    return (_pImpl->_fd >= 0);
+}
+
+//------------------------------------------------------------------------------
+int PacketCapturePort::getFd() const
+//------------------------------------------------------------------------------
+{
+    return _pImpl->_fd;
+}
+
+//------------------------------------------------------------------------------
+void PacketCapturePort::close() throw()
+//------------------------------------------------------------------------------
+{
+    if( _pImpl->_pRing != NULL )
+    {
+        munmap(_pImpl->_pRing, (size_t)_pImpl->_blockSize * _pImpl->_blockCount);
+        _pImpl->_pRing = NULL;
+    }
+    if( _pImpl->_fd >= 0 )
+    {
+        ::close(_pImpl->_fd);
+        _pImpl->_fd = -1;
+    }
+    _pImpl->_block = 0;
+    _pImpl->_pBlock = NULL;
+    _pImpl->_pNext = NULL;
+    _pImpl->_remaining = 0;
+    _pImpl->_consumePending = false;
+    memset(&_pImpl->_stats, 0, sizeof(_pImpl->_stats));
+}
+
+//------------------------------------------------------------------------------
+bool PacketCapturePort::nextPacket(Packet& packet, int timeoutMs)
+//------------------------------------------------------------------------------
+{
+    _pImpl->checkOpen("[PacketCapturePort::nextPacket]");
+    if( !_pImpl->ensurePacket(timeoutMs) )
+    {
+        return false;
+    }
+    packet = _pImpl->_packet;
+    _pImpl->_consumePending = true;
+    return true;
+}
+
+//------------------------------------------------------------------------------
+PacketCapturePort::Statistics PacketCapturePort::getStatistics()
+//------------------------------------------------------------------------------
+{
+    _pImpl->checkOpen("[PacketCapturePort::getStatistics]");
+    _pImpl->accumulateStatistics();
+    return _pImpl->_stats;
+}
+
+//------------------------------------------------------------------------------
+unsigned int PacketCapturePort::availableToRead()
+//------------------------------------------------------------------------------
+{
+    _pImpl->checkOpen("[PacketCapturePort::availableToRead]");
+    return _pImpl->ensurePacket(0) ? _pImpl->_packet.payloadLength : 0;
+}
+
+//------------------------------------------------------------------------------
+IDataPort::Status PacketCapturePort::waitForRead(int timeoutMs)
+//------------------------------------------------------------------------------
+{
+    _pImpl->checkOpen("[PacketCapturePort::waitForRead]");
+    return _pImpl->ensurePacket(timeoutMs) ? PORT_OK : PORT_TIMEOUT;
+}
+
+//------------------------------------------------------------------------------
+void PacketCapturePort::flushRx()
+//------------------------------------------------------------------------------
+{
+    _pImpl->checkOpen("[PacketCapturePort::flushRx]");
+    while( _pImpl->ensurePacket(0) )
+    {
+        _pImpl->releaseBlock();
+    }
+}
+
+//------------------------------------------------------------------------------
+unsigned int PacketCapturePort::readAll(std::vector<unsigned char>& buffer)
+//------------------------------------------------------------------------------
+{
+    unsigned int n = availableToRead();
+    if( n == 0 )
+    {
+        return 0;
+    }
+    return readn(buffer, n);
+}
+
+//------------------------------------------------------------------------------
+unsigned int PacketCapturePort::readn(std::vector<unsigned char>& buffer, unsigned int bytes)
+//------------------------------------------------------------------------------
+{
+    if( buffer.size() < bytes )
+    {
+        buffer.resize(bytes);
+    }
+    return readn(buffer.empty() ? NULL : &buffer[0], bytes);
+}
+
+//------------------------------------------------------------------------------
+unsigned int PacketCapturePort::readn(unsigned char* pBuffer, unsigned int bytes)
+//------------------------------------------------------------------------------
+{
+    Packet packet;
+    while( !nextPacket(packet, -1) ) {} // interrupted by signal
+    unsigned int n = (packet.payloadLength < bytes) ? packet.payloadLength : bytes;
+    memcpy(pBuffer, packet.pPayload, n);
+    return n;
+}
+
+//------------------------------------------------------------------------------
+unsigned int PacketCapturePort::write(const std::vector<unsigned char>& buffer)
+//------------------------------------------------------------------------------
+{
+    return write(buffer.empty() ? NULL : &buffer[0], buffer.size());
+}
+
+//------------------------------------------------------------------------------
+unsigned int PacketCapturePort::write(const unsigned char* /*pBuffer*/, unsigned int /*bytes*/)
+//------------------------------------------------------------------------------
+{
+    throw IoWriteException(EOPNOTSUPP, "[PacketCapturePort::write]: Port is receive-only");
+}
+
+} // grape
@@ -0,0 +1,210 @@
+//==============================================================================
+// Project  : Grape
+// Module   : IO
+// File     : PacketFramer.h
+// Brief    : Incremental packet framing for byte streams
+//
+// Copyright (c) 2012, Vilas Chitrakaran
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//    * Redistributions of source code must retain the above copyright
+//      notice, this list of conditions and the following disclaimer.
+//    * Redistributions in binary form must reproduce the above copyright
+//      notice, this list of conditions and the following disclaimer in the
+//      documentation and/or other materials provided with the distribution.
+//    * Neither the name of the copyright holder nor the names of its
+//      contributors may be used to endorse or promote products derived from
+//      this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR ITS CONTRIBUTORS
+// BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF
+// THE POSSIBILITY OF SUCH DAMAGE.
+//==============================================================================
+
+#ifndef GRAPEIO_PACKETFRAMER_H
+#define GRAPEIO_PACKETFRAMER_H
+
+#include "IDataPort.h"
+
+namespace grape
+{
+
+/// \brief Framing category of policies whose frames end at a delimiter
+struct TerminatedFramingTag {};
+
+/// \brief Framing category of policies whose frames begin with a delimiter and a length
+struct LengthPrefixedFramingTag {};
+
+/// \brief 8 bit XOR of all bytes. For use with LengthPrefixedFraming
+struct XorChecksum
+{
+    static const unsigned int SIZE = 1;
+    static inline void compute(const unsigned char* pData, unsigned int size, unsigned char* pOut);
+};
+
+/// \brief CRC-16/CCITT-FALSE (polynomial 0x1021, initial value 0xFFFF), sent big
+/// endian. For use with LengthPrefixedFraming
+struct Crc16Checksum
+{
+    static const unsigned int SIZE = 2;
+    static inline void compute(const unsigned char* pData, unsigned int size, unsigned char* pOut);
+};
+
+/// \brief Framing policy: start byte, payload length byte, payload, checksum.
+/// The checksum covers the length byte and the payload.
+/// \tparam START    Start of frame marker
+/// \tparam Checksum XorChecksum, Crc16Checksum, or a class with the same interface
+template<unsigned char START, typename Checksum>
+struct LengthPrefixedFraming
+{
+    typedef LengthPrefixedFramingTag Category;
+    static const unsigned char DELIMITER = START;
+    static const unsigned int HEADER_SIZE = 2;
+    static const unsigned int TRAILER_SIZE = Checksum::SIZE;
+
+    /// \return total frame size given its header, or 0 if the header is invalid
+    static unsigned int frameSize(const unsigned char* pHeader) { return HEADER_SIZE + pHeader[1] + TRAILER_SIZE; }
+
+    /// \return true if the checksum of a complete frame is correct
+    static inline bool verify(const unsigned char* pFrame, unsigned int size);
+
+    /// Encode a frame. pOut must hold size + HEADER_SIZE + TRAILER_SIZE bytes.
+    /// \return encoded size, or 0 if the payload is longer than 255 bytes
+    static inline unsigned int encode(const unsigned char* pPayload, unsigned int size, unsigned char* pOut);
+};
+
+/// \brief Framing policy: consistent overhead byte stuffing (COBS), with each
+/// frame terminated by a zero byte.
+struct CobsFraming
+{
+    typedef TerminatedFramingTag Category;
+    static const unsigned char DELIMITER = 0;
+
+    /// Decode in place. \return decoded size, or -1 if the encoding is invalid
+    static inline int decode(unsigned char* pData, unsigned int size);
+
+    /// Encode a frame, including the terminator. pOut must hold size + size/254 + 2 bytes.
+    /// \return encoded size
+    static inline unsigned int encode(const unsigned char* pPayload, unsigned int size, unsigned char* pOut);
+};
+
+/// \brief Framing policy: SLIP (RFC 1055), with each frame terminated by END
+/// (0xC0) and END/ESC bytes in the payload escaped.
+struct SlipFraming
+{
+    typedef TerminatedFramingTag Category;
+    static const unsigned char DELIMITER = 0xC0;
+    static const unsigned char ESC = 0xDB;
+    static const unsigned char ESC_END = 0xDC;
+    static const unsigned char ESC_ESC = 0xDD;
+
+    /// Decode in place. \return decoded size, or -1 if the encoding is invalid
+    static inline int decode(unsigned char* pData, unsigned int size);
+
+    /// Encode a frame, with a leading and a trailing END. pOut must hold 2 * size + 2 bytes.
+    /// \return encoded size
+    static inline unsigned int encode(const unsigned char* pPayload, unsigned int size, unsigned char* pOut);
+};
+
+/// \class PacketFramer
+/// \ingroup io
+/// \brief Incremental framing state machine for byte streams (eg: SerialPort)
+///
+/// Bytes are pushed in chunks of any size, as they come from the port, and each
+/// complete, valid frame is passed to a handler as soon as its last byte arrives.
+/// Frames that lie entirely within a chunk are validated and decoded in the chunk
+/// itself and passed to the handler without copying; only a frame split across
+/// chunks is assembled in an internal buffer. Delimiters are located with memchr,
+/// which the C library implements with vector instructions. No memory is
+/// allocated.
+///
+/// The framing format is a policy class: LengthPrefixedFraming, CobsFraming or
+/// SlipFraming. The handler is any function or object callable as
+/// handler(const unsigned char* pPayload, unsigned int size); the payload is valid
+/// only during the call.
+/// \code
+/// struct ImuHandler
+/// {
+///     void operator()(const unsigned char* p, unsigned int n) { parseImuSample(p, n); }
+/// };
+///
+/// grape::PacketFramer< grape::LengthPrefixedFraming<0xAA, grape::Crc16Checksum> > framer;
+/// ImuHandler handler;
+/// while( port.waitForRead(100) == grape::IDataPort::PORT_OK )
+///     framer.readFrom(port, handler);
+/// \endcode
+///
+/// \tparam Framing     Framing policy
+/// \tparam MAX_FRAME   Largest encoded frame, in bytes. Longer frames are dropped.
+template<typename Framing, unsigned int MAX_FRAME = 1024>
+class PacketFramer
+{
+public:
+    static const unsigned int CHUNK_SIZE = 4096;    //!< bytes read from the port per readFrom() call
+
+    /// \brief Framing counters
+    struct Statistics
+    {
+        unsigned long long frames;          //!< valid frames passed to the handler
+        unsigned long long checksumErrors;  //!< frames with a bad checksum or invalid encoding
+        unsigned long long overruns;        //!< frames longer than MAX_FRAME
+        unsigned long long droppedBytes;    //!< bytes outside any frame
+    };
+
+public:
+    PacketFramer() { reset(); }
+    ~PacketFramer() {}
+
+    /// Discard any partial frame and clear statistics
+    inline void reset();
+
+    /// Process a chunk of the byte stream. Encoded frames in the chunk may be
+    /// decoded in place, so the chunk is modified.
+    /// \param pData    Bytes from the stream
+    /// \param size     Number of bytes
+    /// \param handler  Called with each valid frame
+    /// \return number of frames passed to the handler
+    template<typename Handler>
+    inline unsigned int push(unsigned char* pData, unsigned int size, Handler& handler);
+
+    /// Read the bytes available from a port, without blocking, and process them
+    /// \return number of frames passed to the handler
+    template<typename Handler>
+    inline unsigned int readFrom(IDataPort& port, Handler& handler);
+
+    /// \return framing counters
+    const Statistics& getStatistics() const { return _stats; }
+
+private:
+    template<typename Handler>
+    inline unsigned int push(unsigned char* pData, unsigned int size, Handler& handler, TerminatedFramingTag);
+    template<typename Handler>
+    inline unsigned int push(unsigned char* pData, unsigned int size, Handler& handler, LengthPrefixedFramingTag);
+    template<typename Handler>
+    inline bool emitTerminated(unsigned char* pFrame, unsigned int size, Handler& handler);
+    inline void resync();
+    inline void append(const unsigned char* pData, unsigned int size);
+
+private:
+    unsigned char   _buffer[MAX_FRAME];     //!< frame split across chunks
+    unsigned int    _fill;
+    bool            _overrun;               //!< current frame exceeded MAX_FRAME. Skip to next delimiter
+    unsigned char   _chunk[CHUNK_SIZE];     //!< read buffer for readFrom()
+    Statistics      _stats;
+}; // PacketFramer
+
+} // grape
+
+#include "PacketFramer.hpp"
+
+#endif // GRAPEIO_PACKETFRAMER_H
@@ -0,0 +1,451 @@
+//==============================================================================
+// Project  : Grape
+// Module   : IO
+// File     : PacketFramer.hpp
+//
+// Copyright (c) 2012, Vilas Chitrakaran
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//    * Redistributions of source code must retain the above copyright
+//      notice, this list of conditions and the following disclaimer.
+//    * Redistributions in binary form must reproduce the above copyright
+//      notice, this list of conditions and the following disclaimer in the
+//      documentation and/or other materials provided with the distribution.
+//    * Neither the name of the copyright holder nor the names of its
+//      contributors may be used to endorse or promote products derived from
+//      this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR ITS CONTRIBUTORS
+// BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF
+// THE POSSIBILITY OF SUCH DAMAGE.
+//==============================================================================
+
+#include <cstring>
+
+namespace grape
+{
+
+//---------------------------------------------------------------------------------------------------------------------
+void XorChecksum::compute(const unsigned char* pData, unsigned int size, unsigned char* pOut)
+//---------------------------------------------------------------------------------------------------------------------
+{
+    unsigned char sum = 0;
+    for(unsigned int i = 0; i < size; ++i)
+    {
+        sum ^= pData[i];
+    }
+    pOut[0] = sum;
+}
+
+//---------------------------------------------------------------------------------------------------------------------
+void Crc16Checksum::compute(const unsigned char* pData, unsigned int size, unsigned char* pOut)
+//---------------------------------------------------------------------------------------------------------------------
+{
+    unsigned short crc = 0xFFFF;
+    for(unsigned int i = 0; i < size; ++i)
+    {
+        crc ^= (unsigned short)(pData[i] << 8);
+        for(int bit = 0; bit < 8; ++bit)
+        {
+            crc = (crc & 0x8000) ? (unsigned short)((crc << 1) ^ 0x1021) : (unsigned short)(crc << 1);
+        }
+    }
+    pOut[0] = (unsigned char)(crc >> 8);
+    pOut[1] = (unsigned char)(crc & 0xFF);
+}
+
+//---------------------------------------------------------------------------------------------------------------------
+template<unsigned char START, typename Checksum>
+bool LengthPrefixedFraming<START, Checksum>::verify(const unsigned char* pFrame, unsigned int size)
+//---------------------------------------------------------------------------------------------------------------------
+{
+    unsigned char check[Checksum::SIZE];
+    Checksum::compute(pFrame + 1, size - 1 - Checksum::SIZE, check);
+    return (0 == memcmp(check, pFrame + size - Checksum::SIZE, Checksum::SIZE));
+}
+
+//---------------------------------------------------------------------------------------------------------------------
+template<unsigned char START, typename Checksum>
+unsigned int LengthPrefixedFraming<START, Checksum>::encode(const unsigned char* pPayload, unsigned int size,
+                                                            unsigned char* pOut)
+//---------------------------------------------------------------------------------------------------------------------
+{
+    if( size > 255 )
+    {
+        return 0;
+    }
+    pOut[0] = START;
+    pOut[1] = (unsigned char)size;
+    memcpy(pOut + HEADER_SIZE, pPayload, size);
+    Checksum::compute(pOut + 1, size + 1, pOut + HEADER_SIZE + size);
+    return HEADER_SIZE + size + TRAILER_SIZE;
+}
+
+//---------------------------------------------------------------------------------------------------------------------
+int CobsFraming::decode(unsigned char* pData, unsigned int size)
+//---------------------------------------------------------------------------------------------------------------------
+{
+    // each block is a code byte c followed by c-1 data bytes, and implies a zero
+    // after it unless c is 0xFF or it is the last block. The output never gets
+    // ahead of the input, so decoding in place is safe.
+    unsigned int in = 0;
+    unsigned int out = 0;
+    while( in < size )
+    {
+        const unsigned int code = pData[in++];
+        if( (code == 0) || (in + code - 1 > size) )
+        {
+            return -1;
+        }
+        memmove(pData + out, pData + in, code - 1);
+        in += code - 1;
+        out += code - 1;
+        if( (code != 0xFF) && (in < size) )
+        {
+            pData[out++] = 0;
+        }
+    }
+    return (int)out;
+}
+
+//---------------------------------------------------------------------------------------------------------------------
+unsigned int CobsFraming::encode(const unsigned char* pPayload, unsigned int size, unsigned char* pOut)
+//---------------------------------------------------------------------------------------------------------------------
+{
+    unsigned int codeIndex = 0;
+    unsigned int out = 1;
+    unsigned char code = 1;
+    for(unsigned int i = 0; i < size; ++i)
+    {
+        if( pPayload[i] != 0 )
+        {
+            pOut[out++] = pPayload[i];
+            ++code;
+        }
+        if( (pPayload[i] == 0) || (code == 0xFF) )
+        {
+            pOut[codeIndex] = code;
+            codeIndex = out++;
+            code = 1;
+        }
+    }
+    pOut[codeIndex] = code;
+    pOut[out++] = DELIMITER;
+    return out;
+}
+
+//---------------------------------------------------------------------------------------------------------------------
+int SlipFraming::decode(unsigned char* pData, unsigned int size)
+//---------------------------------------------------------------------------------------------------------------------
+{
+    unsigned int out = 0;
+    for(unsigned int in = 0; in < size; ++in)
+    {
+        if( pData[in] != ESC )
+        {
+            pData[out++] = pData[in];
+            continue;
+        }
+        if( ++in == size )
+        {
+            return -1;
+        }
+        if( pData[in] == ESC_END )
+        {
+            pData[out++] = DELIMITER;
+        }
+        else if( pData[in] == ESC_ESC )
+        {
+            pData[out++] = ESC;
+        }
+        else
+        {
+            return -1;
+        }
+    }
+    return (int)out;
+}
+
+//---------------------------------------------------------------------------------------------------------------------
+unsigned int SlipFraming::encode(const unsigned char* pPayload, unsigned int size, unsigned char* pOut)
+//---------------------------------------------------------------------------------------------------------------------
+{
+    unsigned int out = 0;
+    pOut[out++] = DELIMITER;
+    for(unsigned int i = 0; i < size; ++i)
+    {
+        if( pPayload[i] == DELIMITER )
+        {
+            pOut[out++] = ESC;
+            pOut[out++] = ESC_END;
+        }
+        else if( pPayload[i] == ESC )
+        {
+            pOut[out++] = ESC;
+            pOut[out++] = ESC_ESC;
+        }
+        else
+        {
+            pOut[out++] = pPayload[i];
+        }
+    }
+    pOut[out++] = DELIMITER;
+    return out;
+}
+
+//---------------------------------------------------------------------------------------------------------------------
+template<typename Framing, unsigned int MAX_FRAME>
+void PacketFramer<Framing, MAX_FRAME>::reset()
+//---------------------------------------------------------------------------------------------------------------------
+{
+    _fill = 0;
+    _overrun = false;
+    memset(&_stats, 0, sizeof(_stats));
+}
+
+//---------------------------------------------------------------------------------------------------------------------
+template<typename Framing, unsigned int MAX_FRAME>
+template<typename Handler>
+unsigned int PacketFramer<Framing, MAX_FRAME>::push(unsigned char* pData, unsigned int size, Handler& handler)
+//---------------------------------------------------------------------------------------------------------------------
+{
+    return push(pData, size, handler, typename Framing::Category());
+}
+
+//---------------------------------------------------------------------------------------------------------------------
+template<typename Framing, unsigned int MAX_FRAME>
+template<typename Handler>
+unsigned int PacketFramer<Framing, MAX_FRAME>::readFrom(IDataPort& port, Handler& handler)
+//---------------------------------------------------------------------------------------------------------------------
+{
+    unsigned int bytes = port.availableToRead();
+    if( bytes == 0 )
+    {
+        return 0;
+    }
+    if( bytes > CHUNK_SIZE )
+    {
+        bytes = CHUNK_SIZE;
+    }
+    bytes = port.readn(_chunk, bytes);
+    return push(_chunk, bytes, handler);
+}
+
+//---------------------------------------------------------------------------------------------------------------------
+template<typename Framing, unsigned int MAX_FRAME>
+void PacketFramer<Framing, MAX_FRAME>::append(const unsigned char* pData, unsigned int size)
+//---------------------------------------------------------------------------------------------------------------------
+{
+    memcpy(_buffer + _fill, pData, size);
+    _fill += size;
+}
+
+//---------------------------------------------------------------------------------------------------------------------
+template<typename Framing, unsigned int MAX_FRAME>
+template<typename Handler>
+bool PacketFramer<Framing, MAX_FRAME>::emitTerminated(unsigned char* pFrame, unsigned int size, Handler& handler)
+//---------------------------------------------------------------------------------------------------------------------
+{
+    if( size == 0 )
+    {
+        return false; // back to back delimiters
+    }
+    const int decoded = Framing::decode(pFrame, size);
+    if( decoded < 0 )
+    {
+        ++_stats.checksumErrors;
+        return false;
+    }
+    ++_stats.frames;
+    handler((const unsigned char*)pFrame, (unsigned int)decoded);
+    return true;
+}
+
+//---------------------------------------------------------------------------------------------------------------------
+template<typename Framing, unsigned int MAX_FRAME>
+template<typename Handler>
+unsigned int PacketFramer<Framing, MAX_FRAME>::push(unsigned char* pData, unsigned int size, Handler& handler,
+                                                    TerminatedFramingTag)
+//---------------------------------------------------------------------------------------------------------------------
+{
+    unsigned int nFrames = 0;
+    unsigned int pos = 0;
+    while( pos < size )
+    {
+        const unsigned char* pEnd = (const unsigned char*)memchr(pData + pos, Framing::DELIMITER, size - pos);
+        const unsigned int segment = (pEnd ? (unsigned int)(pEnd - pData) : size) - pos;
+
+        if( _overrun || (_fill + segment > MAX_FRAME) )
+        {
+            if( !_overrun )
+            {
+                _overrun = true;
+                ++_stats.overruns;
+            }
+            _stats.droppedBytes += _fill + segment;
+            _fill = 0;
+        }
+        else if( !pEnd )
+        {
+            append(pData + pos, segment);
+        }
+        else if( _fill == 0 )
+        {
+            nFrames += emitTerminated(pData + pos, segment, handler);
+        }
+        else
+        {
+            append(pData + pos, segment);
+            nFrames += emitTerminated(_buffer, _fill, handler);
+            _fill = 0;
+        }
+
+        if( !pEnd )
+        {
+            break;
+        }
+        _overrun = false;
+        pos += segment + 1;
+    }
+    return nFrames;
+}
+
+//---------------------------------------------------------------------------------------------------------------------
+template<typename Framing, unsigned int MAX_FRAME>
+void PacketFramer<Framing, MAX_FRAME>::resync()
+//---------------------------------------------------------------------------------------------------------------------
+{
+    // drop the start byte of the rejected frame and look for the next one among
+    // the bytes already buffered
+    const unsigned char* pStart = (const unsigned char*)memchr(_buffer + 1, Framing::DELIMITER, _fill - 1);
+    const unsigned int skip = pStart ? (unsigned int)(pStart - _buffer) : _fill;
+    _stats.droppedBytes += skip;
+    _fill -= skip;
+    memmove(_buffer, _buffer + skip, _fill);
+}
+
+//---------------------------------------------------------------------------------------------------------------------
+template<typename Framing, unsigned int MAX_FRAME>
+template<typename Handler>
+unsigned int PacketFramer<Framing, MAX_FRAME>::push(unsigned char* pData, unsigned int size, Handler& handler,
+                                                    LengthPrefixedFramingTag)
+//---------------------------------------------------------------------------------------------------------------------
+{
+    const unsigned int OVERHEAD = Framing::HEADER_SIZE + Framing::TRAILER_SIZE;
+    unsigned int nFrames = 0;
+    unsigned int pos = 0;
+    for(;;)
+    {
+        if( _fill > 0 )
+        {
+            // continue the frame held in the buffer. Take only as many bytes as it
+            // needs, so that subsequent frames can be processed in place.
+            unsigned int take = 0;
+            if( _fill < Framing::HEADER_SIZE )
+            {
+                take = Framing::HEADER_SIZE - _fill;
+                take = (take < size - pos) ? take : size - pos;
+                append(pData + pos, take);
+                pos += take;
+                if( _fill < Framing::HEADER_SIZE )
+                {
+                    break;
+                }
+            }
+
+            const unsigned int frameSize = Framing::frameSize(_buffer);
+            if( (frameSize < OVERHEAD) || (frameSize > MAX_FRAME) )
+            {
+                _stats.overruns += (frameSize > MAX_FRAME);
+                resync();
+                continue;
+            }
+            if( _fill < frameSize )
+            {
+                take = frameSize - _fill;
+                take = (take < size - pos) ? take : size - pos;
+                append(pData + pos, take);
+                pos += take;
+                if( _fill < frameSize )
+                {
+                    break;
+                }
+            }
+
+            if( !Framing::verify(_buffer, frameSize) )
+            {
+                ++_stats.checksumErrors;
+                resync();
+                continue;
+            }
+            ++_stats.frames;
+            ++nFrames;
+            handler((const unsigned char*)_buffer + Framing::HEADER_SIZE, frameSize - OVERHEAD);
+            _fill -= frameSize;
+            memmove(_buffer, _buffer + frameSize, _fill);
+            continue;
+        }
+
+        if( pos >= size )
+        {
+            break;
+        }
+
+        const unsigned char* pStart = (const unsigned char*)memchr(pData + pos, Framing::DELIMITER, size - pos);
+        if( !pStart )
+        {
+            _stats.droppedBytes += size - pos;
+            break;
+        }
+        _stats.droppedBytes += (unsigned int)(pStart - pData) - pos;
+        pos = (unsigned int)(pStart - pData);
+
+        // frame entirely within the chunk: validate in place
+        const unsigned int available = size - pos;
+        if( available >= Framing::HEADER_SIZE )
+        {
+            const unsigned int frameSize = Framing::frameSize(pData + pos);
+            if( (frameSize < OVERHEAD) || (frameSize > MAX_FRAME) )
+            {
+                _stats.overruns += (frameSize > MAX_FRAME);
+                ++_stats.droppedBytes;
+                ++pos;
+                continue;
+            }
+            if( available >= frameSize )
+            {
+                if( Framing::verify(pData + pos, frameSize) )
+                {
+                    ++_stats.frames;
+                    ++nFrames;
+                    handler((const unsigned char*)pData + pos + Framing::HEADER_SIZE, frameSize - OVERHEAD);
+                    pos += frameSize;
+                }
+                else
+                {
+                    ++_stats.checksumErrors;
+                    ++_stats.droppedBytes;
+                    ++pos;
+                }
+                continue;
+            }
+        }
+
+        // frame continues in the next chunk
+        append(pData + pos, available);
+        pos = size;
+    }
+    return nFrames;
+}
+
+} // grape
@@ -0,0 +1,487 @@
+//==============================================================================
+// Project  : Grape
+// Module   : IO
+// File     : ReliableUdpChannel.cpp
+//
+// Copyright (c) 2012, Vilas Chitrakaran
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//    * Redistributions of source code must retain the above copyright
+//      notice, this list of conditions and the following disclaimer.
+//    * Redistributions in binary form must reproduce the above copyright
+//      notice, this list of conditions and the following disclaimer in the
+//      documentation and/or other materials provided with the distribution.
+//    * Neither the name of the copyright holder nor the names of its
+//      contributors may be used to endorse or promote products derived from
+//      this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR ITS CONTRIBUTORS
+// BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF
+// THE POSSIBILITY OF SUCH DAMAGE.
+//==============================================================================
+
+#include "ReliableUdpChannel.h"
+#include <string.h>
+#include <errno.h>
+
+#ifndef _MSC_VER
+#include <time.h>
+#endif
+
+namespace grape
+{
+
+// packet types. Reliable: type, 0, seq[4], payload. Unreliable: type, 0, payload.
+// Ack: type, 0, base[4], mask[4] where base is the first sequence number not
+// received and bit i of mask is set if base + 1 + i was received.
+// Skip: type, 0, seq[4]. Replaces an abandoned reliable message, so that the
+// receiver moves past its sequence number without delivering anything.
+static const unsigned char TYPE_RELIABLE = 1;
+static const unsigned char TYPE_UNRELIABLE = 2;
+static const unsigned char TYPE_ACK = 3;
+static const unsigned char TYPE_SKIP = 4;
+static const unsigned int UNRELIABLE_HEADER_SIZE = 2;
+static const unsigned int ACK_SIZE = 10;
+
+//--------------------------------------------------------------------------
+static void putU32(unsigned char* p, unsigned int v)
+//--------------------------------------------------------------------------
+{
+    p[0] = (unsigned char)(v >> 24);
+    p[1] = (unsigned char)(v >> 16);
+    p[2] = (unsigned char)(v >> 8);
+    p[3] = (unsigned char)v;
+}
+
+//--------------------------------------------------------------------------
+static unsigned int getU32(const unsigned char* p)
+//--------------------------------------------------------------------------
+{
+    return ((unsigned int)p[0] << 24) | ((unsigned int)p[1] << 16) | ((unsigned int)p[2] << 8) | p[3];
+}
+
+//==========================================================================
+ReliableUdpChannel::ReliableUdpChannel(UdpSocket& socket, const struct sockaddr_in& peer,
+                                       unsigned int windowSize, unsigned int maxMessageSize)
+//==========================================================================
+    : _socket(socket),
+      _peer(peer),
+      _window(windowSize),
+      _maxMessageSize(maxMessageSize),
+      _rtoNs(20000000LL),
+      _maxRetries(10),
+      _ordered(true),
+      _txNext(0),
+      _txInUse(0),
+      _rxBase(0),
+      _rxMask(0),
+      _deliverNext(0),
+      _pPacket(NULL)
+{
+    if( (_window == 0) || (_window > MAX_WINDOW) )
+    {
+        throw SocketException(EINVAL, "[ReliableUdpChannel::ReliableUdpChannel]: Window size must be 1 to MAX_WINDOW");
+    }
+
+    memset(&_stats, 0, sizeof(_stats));
+
+    const unsigned int packetSize = _maxMessageSize + HEADER_SIZE;
+    _storage.resize(_window * packetSize + _window * _maxMessageSize + packetSize);
+
+    unsigned char* p = &_storage[0];
+    _txSlots.resize(_window);
+    _rxSlots.resize(_window);
+    for(unsigned int i = 0; i < _window; ++i)
+    {
+        memset(&_txSlots[i], 0, sizeof(Slot));
+        _txSlots[i].pData = p;
+        p += packetSize;
+    }
+    for(unsigned int i = 0; i < _window; ++i)
+    {
+        memset(&_rxSlots[i], 0, sizeof(Slot));
+        _rxSlots[i].pData = p;
+        p += _maxMessageSize;
+    }
+    _pPacket = p;
+}
+
+//--------------------------------------------------------------------------
+ReliableUdpChannel::~ReliableUdpChannel() throw()
+//--------------------------------------------------------------------------
+{
+}
+
+//--------------------------------------------------------------------------
+long long ReliableUdpChannel::nowNs()
+//--------------------------------------------------------------------------
+{
+#ifdef _MSC_VER
+    return (long long)GetTickCount64() * 1000000LL;
+#else
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (long long)ts.tv_sec * 1000000000LL + ts.tv_nsec;
+#endif
+}
+
+//--------------------------------------------------------------------------
+bool ReliableUdpChannel::sendReliable(const unsigned char* pData, unsigned int size)
+//--------------------------------------------------------------------------
+{
+    if( size > _maxMessageSize )
+    {
+        throw SocketException(EMSGSIZE, "[ReliableUdpChannel::sendReliable]: Message larger than maxMessageSize");
+    }
+
+    Slot& slot = _txSlots[_txNext % _window];
+    if( slot.inUse )
+    {
+        return false;
+    }
+
+    slot.pData[0] = TYPE_RELIABLE;
+    slot.pData[1] = 0;
+    putU32(slot.pData + 2, _txNext);
+    if( size )
+    {
+        memcpy(slot.pData + HEADER_SIZE, pData, size);
+    }
+    slot.seq = _txNext;
+    slot.length = size + HEADER_SIZE;
+    slot.retries = 0;
+    slot.fastRetransmitted = false;
+    slot.inUse = true;
+    ++_txInUse;
+    ++_txNext;
+    ++_stats.sent;
+
+    transmit(slot, nowNs());
+    return true;
+}
+
+//--------------------------------------------------------------------------
+void ReliableUdpChannel::sendUnreliable(const unsigned char* pData, unsigned int size)
+//--------------------------------------------------------------------------
+{
+    if( size > _maxMessageSize )
+    {
+        throw SocketException(EMSGSIZE, "[ReliableUdpChannel::sendUnreliable]: Message larger than maxMessageSize");
+    }
+
+    // _pPacket is free outside receive()
+    _pPacket[0] = TYPE_UNRELIABLE;
+    _pPacket[1] = 0;
+    if( size )
+    {
+        memcpy(_pPacket + UNRELIABLE_HEADER_SIZE, pData, size);
+    }
+    _socket.writeTo(_peer, _pPacket, size + UNRELIABLE_HEADER_SIZE);
+    ++_stats.unreliableSent;
+}
+
+//--------------------------------------------------------------------------
+void ReliableUdpChannel::transmit(Slot& slot, long long now)
+//--------------------------------------------------------------------------
+{
+    _socket.writeTo(_peer, slot.pData, slot.length);
+    slot.lastSentNs = now;
+}
+
+//--------------------------------------------------------------------------
+void ReliableUdpChannel::serviceTimers(long long now)
+//--------------------------------------------------------------------------
+{
+    if( _txInUse == 0 )
+    {
+        return;
+    }
+
+    for(unsigned int i = 0; i < _window; ++i)
+    {
+        Slot& slot = _txSlots[i];
+        if( !slot.inUse || (now - slot.lastSentNs < _rtoNs) )
+        {
+            continue;
+        }
+        // abandon the payload, but keep the sequence number in flight as a skip
+        // until it is acknowledged, or the receiver would wait for it forever
+        if( (slot.retries >= _maxRetries) && (slot.pData[0] != TYPE_SKIP) )
+        {
+            slot.pData[0] = TYPE_SKIP;
+            slot.length = HEADER_SIZE;
+            ++_stats.failed;
+        }
+        ++slot.retries;
+        ++_stats.retransmits;
+        transmit(slot, now);
+    }
+}
+
+//--------------------------------------------------------------------------
+long long ReliableUdpChannel::nextTimerNs() const
+//--------------------------------------------------------------------------
+{
+    long long next = -1;
+    if( _txInUse == 0 )
+    {
+        return next;
+    }
+    for(unsigned int i = 0; i < _window; ++i)
+    {
+        const Slot& slot = _txSlots[i];
+        if( slot.inUse && ((next < 0) || (slot.lastSentNs + _rtoNs < next)) )
+        {
+            next = slot.lastSentNs + _rtoNs;
+        }
+    }
+    return next;
+}
+
+//--------------------------------------------------------------------------
+void ReliableUdpChannel::sendAck()
+//--------------------------------------------------------------------------
+{
+    unsigned char ack[ACK_SIZE];
+    ack[0] = TYPE_ACK;
+    ack[1] = 0;
+    putU32(ack + 2, _rxBase);
+    putU32(ack + 6, _rxMask >> 1);
+    _socket.writeTo(_peer, ack, ACK_SIZE);
+    ++_stats.acksSent;
+}
+
+//--------------------------------------------------------------------------
+void ReliableUdpChannel::processAck(const unsigned char* pPacket, unsigned int length, long long now)
+//--------------------------------------------------------------------------
+{
+    if( length < ACK_SIZE )
+    {
+        return;
+    }
+    ++_stats.acksReceived;
+
+    const unsigned int base = getU32(pPacket + 2);
+    const unsigned int mask = getU32(pPacket + 6);
+
+    // release acknowledged messages and find the highest selectively acknowledged one
+    unsigned int highest = 0;
+    for(unsigned int i = 0; i < _window; ++i)
+    {
+        Slot& slot = _txSlots[i];
+        if( !slot.inUse )
+        {
+            continue;
+        }
+        const unsigned int d = slot.seq - base;
+        if( ((int)d < 0) || ((d >= 1) && (d <= 32) && (mask & (1U << (d - 1)))) )
+        {
+            slot.inUse = false;
+            --_txInUse;
+        }
+    }
+    for(unsigned int b = 0; b < 32; ++b)
+    {
+        if( mask & (1U << b) )
+        {
+            highest = b + 1;
+        }
+    }
+
+    // messages missing below a received one were lost: resend them once without
+    // waiting for the timeout
+    if( highest == 0 )
+    {
+        return;
+    }
+    for(unsigned int i = 0; i < _window; ++i)
+    {
+        Slot& slot = _txSlots[i];
+        const unsigned int d = slot.seq - base;
+        if( slot.inUse && !slot.fastRetransmitted && (d < highest) )
+        {
+            slot.fastRetransmitted = true;
+            ++_stats.retransmits;
+            transmit(slot, now);
+        }
+    }
+}
+
+//--------------------------------------------------------------------------
+unsigned int ReliableUdpChannel::copyOut(const unsigned char* pSrc, unsigned int size,
+                                         unsigned char* pBuffer, unsigned int capacity)
+//--------------------------------------------------------------------------
+{
+    const unsigned int n = (size < capacity) ? size : capacity;
+    if( n )
+    {
+        memcpy(pBuffer, pSrc, n);
+    }
+    return n;
+}
+
+//--------------------------------------------------------------------------
+ReliableUdpChannel::Kind ReliableUdpChannel::processData(const unsigned char* pPacket, unsigned int length,
+                                                         unsigned char* pBuffer, unsigned int capacity,
+                                                         unsigned int& outLength)
+//--------------------------------------------------------------------------
+{
+    if( length < HEADER_SIZE )
+    {
+        return NONE;
+    }
+
+    const bool skip = (pPacket[0] == TYPE_SKIP);
+    const unsigned int seq = getU32(pPacket + 2);
+    const unsigned int d = seq - _rxBase;
+
+    // already received: the acknowledgement was lost, send it again
+    if( ((int)d < 0) || ((d < 32) && (_rxMask & (1U << d))) )
+    {
+        ++_stats.duplicates;
+        sendAck();
+        return NONE;
+    }
+
+    // outside the window, or no room to hold it until the gap before it is filled
+    if( (d >= _window) || (_ordered && (seq - _deliverNext >= _window)) )
+    {
+        return NONE;
+    }
+
+    _rxMask |= (1U << d);
+    while( _rxMask & 1U )
+    {
+        _rxMask >>= 1;
+        ++_rxBase;
+    }
+    sendAck();
+
+    const unsigned char* pPayload = pPacket + HEADER_SIZE;
+    const unsigned int size = length - HEADER_SIZE;
+    if( _ordered )
+    {
+        if( seq != _deliverNext )
+        {
+            Slot& slot = _rxSlots[seq % _window];
+            memcpy(slot.pData, pPayload, size);
+            slot.seq = seq;
+            slot.length = size;
+            slot.skipped = skip;
+            slot.inUse = true;
+            return NONE;
+        }
+        ++_deliverNext;
+    }
+
+    if( skip )
+    {
+        return NONE;
+    }
+    ++_stats.delivered;
+    outLength = copyOut(pPayload, size, pBuffer, capacity);
+    return RELIABLE;
+}
+
+//--------------------------------------------------------------------------
+ReliableUdpChannel::Kind ReliableUdpChannel::receive(unsigned char* pBuffer, unsigned int capacity,
+                                                     unsigned int& length, int timeoutMs)
+//--------------------------------------------------------------------------
+{
+    length = 0;
+    const long long deadline = (timeoutMs < 0) ? -1 : nowNs() + (long long)timeoutMs * 1000000LL;
+    const unsigned int packetSize = _maxMessageSize + HEADER_SIZE;
+
+    for(;;)
+    {
+        // messages held back by an earlier gap that has since been filled
+        if( _ordered )
+        {
+            Slot& held = _rxSlots[_deliverNext % _window];
+            if( held.inUse && (held.seq == _deliverNext) )
+            {
+                held.inUse = false;
+                ++_deliverNext;
+                if( held.skipped )
+                {
+                    continue;
+                }
+                ++_stats.delivered;
+                length = copyOut(held.pData, held.length, pBuffer, capacity);
+                return RELIABLE;
+            }
+        }
+
+        long long now = nowNs();
+        serviceTimers(now);
+
+        // wait until the deadline or the next retransmission, whichever is first
+        long long waitNs = (deadline < 0) ? -1 : ((deadline > now) ? deadline - now : 0);
+        const long long timer = nextTimerNs();
+        if( timer >= 0 )
+        {
+            const long long t = (timer > now) ? timer - now : 0;
+            if( (waitNs < 0) || (t < waitNs) )
+            {
+                waitNs = t;
+            }
+        }
+        const int waitMs = (waitNs < 0) ? -1 : (int)((waitNs + 999999LL) / 1000000LL);
+
+        if( _socket.waitForRead(waitMs) != IDataPort::PORT_OK )
+        {
+            if( (deadline >= 0) && (nowNs() >= deadline) )
+            {
+                return NONE;
+            }
+            continue;
+        }
+
+        struct sockaddr_in src;
+        const unsigned int n = _socket.readFrom(_pPacket, packetSize, src);
+        if( (n < UNRELIABLE_HEADER_SIZE)
+                || (src.sin_addr.s_addr != _peer.sin_addr.s_addr) || (src.sin_port != _peer.sin_port) )
+        {
+            continue;
+        }
+
+        Kind kind = NONE;
+        switch( _pPacket[0] )
+        {
+        case TYPE_RELIABLE:
+        case TYPE_SKIP:
+            kind = processData(_pPacket, n, pBuffer, capacity, length);
+            break;
+        case TYPE_UNRELIABLE:
+            ++_stats.unreliableReceived;
+            length = copyOut(_pPacket + UNRELIABLE_HEADER_SIZE, n - UNRELIABLE_HEADER_SIZE, pBuffer, capacity);
+            kind = UNRELIABLE;
+            break;
+        case TYPE_ACK:
+            processAck(_pPacket, n, nowNs());
+            break;
+        default:
+            break;
+        }
+        if( kind != NONE )
+        {
+            return kind;
+        }
+        if( (deadline >= 0) && (nowNs() >= deadline) && (_socket.waitForRead(0) != IDataPort::PORT_OK) )
+        {
+            return NONE;
+        }
+    }
+}
+
+} // grape
@@ -0,0 +1,213 @@
+//==============================================================================
+// Project  : Grape
+// Module   : IO
+// File     : ReliableUdpChannel.h
+// Brief    : Reliable sequenced messaging over UDP
+//
+// Copyright (c) 2012, Vilas Chitrakaran
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//    * Redistributions of source code must retain the above copyright
+//      notice, this list of conditions and the following disclaimer.
+//    * Redistributions in binary form must reproduce the above copyright
+//      notice, this list of conditions and the following disclaimer in the
+//      documentation and/or other materials provided with the distribution.
+//    * Neither the name of the copyright holder nor the names of its
+//      contributors may be used to endorse or promote products derived from
+//      this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR ITS CONTRIBUTORS
+// BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF
+// THE POSSIBILITY OF SUCH DAMAGE.
+//==============================================================================
+
+#ifndef GRAPEIO_RELIABLEUDPCHANNEL_H
+#define GRAPEIO_RELIABLEUDPCHANNEL_H
+
+#include "UdpSocket.h"
+#include <vector>
+
+namespace grape
+{
+
+/// \class ReliableUdpChannel
+/// \ingroup io
+/// \brief Reliable and best-effort messaging between two peers over one UdpSocket
+///
+/// Reliable messages carry a sequence number and are held by the sender until
+/// the receiver acknowledges them. The receiver acknowledges every reliable
+/// message with a selective acknowledgement: the first sequence number not yet
+/// received, plus a bitmap of the messages received beyond it. The sender
+/// retransmits a message when it times out, or immediately when a later
+/// message is acknowledged while it is not (the gap acts as a negative
+/// acknowledgement). Duplicates are discarded by the receiver.
+///
+/// Unreliable messages share the socket but bypass all of this, so bulk
+/// telemetry is not held up behind a lost command, as it would be on a TCP
+/// connection.
+///
+/// The number of unacknowledged messages is bounded by the window size, and all
+/// buffers are allocated on construction. Timers are serviced from receive(),
+/// which must be called regularly by both peers. A message still unacknowledged
+/// after the retry limit is abandoned and counted as failed. Its sequence number
+/// is then sent as a skip marker, without the payload, until the receiver
+/// acknowledges it, so that the receiver moves past the gap and later messages
+/// flow again in both ordered and unordered mode. The skip marker holds its
+/// window slot until then, so a peer that stays unreachable eventually fills
+/// the window and sendReliable() returns false.
+/// \code
+/// grape::UdpServer socket(localPort);
+/// grape::ReliableUdpChannel channel(socket, peerAddress);
+/// channel.sendReliable(command, commandSize);
+/// channel.sendUnreliable(telemetry, telemetrySize);
+///
+/// unsigned char buffer[1400];
+/// unsigned int length;
+/// if( channel.receive(buffer, sizeof(buffer), length, 10) == grape::ReliableUdpChannel::RELIABLE )
+///     processCommand(buffer, length);
+/// \endcode
+///
+/// Methods throw SocketException on socket errors. Not thread-safe.
+class GRAPEIO_DLL_API ReliableUdpChannel
+{
+public:
+    static const unsigned int MAX_WINDOW = 32;  //!< Largest window size (width of the acknowledgement bitmap)
+    static const unsigned int HEADER_SIZE = 6;  //!< Bytes added to each reliable message
+
+    /// \brief Kind of message returned by receive()
+    enum Kind
+    {
+        NONE,       //!< No message within the timeout
+        RELIABLE,   //!< Message sent with sendReliable()
+        UNRELIABLE  //!< Message sent with sendUnreliable()
+    };
+
+    /// \brief Channel counters
+    struct Statistics
+    {
+        unsigned long long sent;            //!< Reliable messages sent (first transmission)
+        unsigned long long retransmits;     //!< Retransmissions, by timeout or gap
+        unsigned long long failed;          //!< Reliable messages abandoned after the retry limit
+        unsigned long long delivered;       //!< Reliable messages delivered to the application
+        unsigned long long duplicates;      //!< Duplicate reliable messages discarded
+        unsigned long long acksSent;
+        unsigned long long acksReceived;
+        unsigned long long unreliableSent;
+        unsigned long long unreliableReceived;
+    };
+
+public:
+
+    /// Constructor
+    /// \param socket           Socket to communicate over. Must be bound if the peer
+    ///                         sends to a fixed port. Must outlive this object.
+    /// \param peer             Address of the remote channel
+    /// \param windowSize       Maximum number of unacknowledged reliable messages
+    ///                         in each direction (at most MAX_WINDOW)
+    /// \param maxMessageSize   Largest message payload, in bytes
+    ReliableUdpChannel(UdpSocket& socket, const struct sockaddr_in& peer,
+                       unsigned int windowSize = MAX_WINDOW, unsigned int maxMessageSize = 1400);
+    ~ReliableUdpChannel() throw();
+
+    /// Set the time after which an unacknowledged message is sent again (default 20 ms)
+    void setRetransmitTimeout(unsigned int ms) { _rtoNs = (long long)ms * 1000000LL; }
+
+    /// Set the number of retransmissions before a message is abandoned (default 10)
+    void setMaxRetries(unsigned int count) { _maxRetries = count; }
+
+    /// Deliver reliable messages in sequence order (default), or as soon as they
+    /// arrive. Ordered delivery holds messages received after a lost one until the
+    /// lost one is retransmitted.
+    void setOrdered(bool yes) { _ordered = yes; }
+
+    /// Send a message with guaranteed delivery
+    /// \param pData    Payload
+    /// \param size     Payload size. At most maxMessageSize.
+    /// \return false if the window is full; call receive() to process
+    ///         acknowledgements and try again.
+    bool sendReliable(const unsigned char* pData, unsigned int size);
+
+    /// Send a message without delivery guarantee
+    /// \param pData    Payload
+    /// \param size     Payload size. At most maxMessageSize.
+    void sendUnreliable(const unsigned char* pData, unsigned int size);
+
+    /// Process incoming datagrams and retransmission timers until a message is
+    /// received or the timeout expires.
+    /// \param pBuffer  Buffer for the message payload
+    /// \param capacity Size of buffer. Longer messages are truncated.
+    /// \param length   Set to the message length
+    /// \param timeoutMs Milliseconds to wait. 0 to only process what is already
+    ///                 queued. Negative to wait indefinitely.
+    /// \return the kind of message received, or NONE on timeout
+    Kind receive(unsigned char* pBuffer, unsigned int capacity, unsigned int& length, int timeoutMs);
+
+    /// \return Number of reliable messages sent and not yet acknowledged
+    unsigned int pending() const { return _txInUse; }
+
+    /// \return channel counters
+    const Statistics& getStatistics() const { return _stats; }
+
+private:
+    /// a reliable message held for retransmission or reordering
+    struct Slot
+    {
+        unsigned int seq;
+        unsigned int length;            //!< packet length, including header (tx) or payload length (rx)
+        long long lastSentNs;
+        unsigned int retries;
+        bool inUse;
+        bool fastRetransmitted;
+        bool skipped;                   //!< rx: abandoned by the sender. Advance past it without delivery
+        unsigned char* pData;
+    };
+
+private:
+    static long long nowNs();
+    void transmit(Slot& slot, long long now);
+    void serviceTimers(long long now);
+    long long nextTimerNs() const;
+    void sendAck();
+    void processAck(const unsigned char* pPacket, unsigned int length, long long now);
+    Kind processData(const unsigned char* pPacket, unsigned int length, unsigned char* pBuffer,
+                     unsigned int capacity, unsigned int& outLength);
+    static unsigned int copyOut(const unsigned char* pSrc, unsigned int size, unsigned char* pBuffer, unsigned int capacity);
+private:
+    ReliableUdpChannel(const ReliableUdpChannel&);              //!< disable copy
+    ReliableUdpChannel &operator=(const ReliableUdpChannel&);   //!< disable assignment
+private:
+    UdpSocket&          _socket;
+    struct sockaddr_in  _peer;
+    unsigned int        _window;
+    unsigned int        _maxMessageSize;
+    long long           _rtoNs;
+    unsigned int        _maxRetries;
+    bool                _ordered;
+
+    std::vector<unsigned char> _storage;    //!< backing memory for all slots and the receive packet
+    std::vector<Slot>   _txSlots;           //!< indexed by seq % window
+    unsigned int        _txNext;            //!< next sequence number to send
+    unsigned int        _txInUse;
+
+    std::vector<Slot>   _rxSlots;           //!< messages held for ordered delivery, indexed by seq % window
+    unsigned int        _rxBase;            //!< first sequence number not yet received
+    unsigned int        _rxMask;            //!< bit i: _rxBase + i received
+    unsigned int        _deliverNext;       //!< next sequence number to deliver, in ordered mode
+    unsigned char*      _pPacket;           //!< receive buffer for one datagram
+
+    Statistics          _stats;
+}; // ReliableUdpChannel
+
+} // grape
+
+#endif // GRAPEIO_RELIABLEUDPCHANNEL_H
@@ -45,7 +45,6 @@ namespace grape
 /// \brief A simple serial port communication class
 /// The class provides a basic interface to serial ports.
 /// \todo
-/// - Test all bytes have been transmitted in waitForWrite()
 /// - In windows, review overlapped io timeouts are correct
 ///
 /// Example program:
@@ -64,6 +63,12 @@ public:
         B57600,
         B115200,
         B230400,
+        B460800,
+        B921600,
+        B1000000,
+        B1500000,
+        B2000000,
+        B3000000,
         BAUD_MAX    //!< not valid as a baud specifier. marks length of enumeration
     };
 
@@ -76,6 +81,10 @@ public:
         DATA_FORMAT_MAX
     };
 
+public:
+    /// Largest ring size accepted by startReaderThread()
+    static const unsigned int MAX_READER_BUFFER_SIZE = 0x40000000U;
+
 public:
     SerialPort();
     virtual ~SerialPort() throw (/*nothing*/);
@@ -91,6 +100,40 @@ public:
     /// \throw InvalidBaudException
     void setBaudRate(BaudRate baud);
 
+    /// Set a baud rate that is not in BaudRate (eg: 250000 for DMX, or the exact
+    /// rate of a sensor running off a non-standard crystal). On Linux this uses
+    /// termios2 with BOTHER, so any rate the UART clock can divide down to is
+    /// accepted. This works only if the port is already open.
+    /// \param baud Bits per second
+    /// \throw InvalidBaudException if the driver rejects the rate
+    void setCustomBaudRate(unsigned int baud);
+
+    /// \return the current baud rate in bits per second
+    /// \throw SerialPortException
+    unsigned int getBaudRate();
+
+    /// Enable or disable low latency mode (Linux ASYNC_LOW_LATENCY). The driver
+    /// then pushes received data to the reader immediately instead of batching
+    /// it; for FTDI USB adapters this also lowers the latency timer from 16 ms
+    /// to 1 ms. Not all drivers support this (eg: pseudo terminals).
+    /// \throw SerialPortException
+    void setLowLatency(bool yes);
+
+    /// Make readn() block, using the terminal VMIN/VTIME rules. By default, reads
+    /// don't block and return whatever has been received.
+    /// - minBytes > 0, timeout = 0: wait until minBytes have arrived
+    /// - minBytes > 0, timeout > 0: wait for minBytes, or until no byte has
+    ///   arrived for 'timeout' after the first one
+    /// - minBytes = 0, timeout > 0: wait up to 'timeout' for the first byte
+    /// - minBytes = 0, timeout = 0: don't block (default)
+    ///
+    /// A read returns at most the number of bytes requested. Not for use with
+    /// the reader thread. On Windows, minBytes > 0 waits for the full count.
+    /// \param minBytes        Minimum number of bytes to wait for
+    /// \param timeoutDeciSec  Timeout in tenths of a second
+    /// \throw SerialPortException
+    void setBlockingRead(unsigned char minBytes, unsigned char timeoutDeciSec);
+
     /// Set data format. This works only if the port is already open.
     /// \param fmt One of the supported data format constants
     /// \see open
@@ -115,15 +158,56 @@ public:
     /// \return true if open
     bool isOpen();
 
+    /// Start a background thread that drains the port into a lock-free ring
+    /// buffer as soon as data arrives, recording the time each chunk was
+    /// received (POSIX only). While it runs, readn(), availableToRead() and
+    /// waitForRead() are served from the ring: reads copy from memory without
+    /// a system call, and a system call is made only to sleep when the ring is
+    /// empty. The port must be open. The thread is stopped by close().
+    /// While the thread runs, getFd() returns a descriptor that is readable as
+    /// long as the ring holds data (or the thread has failed), so waitForAny()
+    /// and level-triggered IoReactor registrations see buffered data. Register
+    /// the port with a reactor after starting or stopping the thread.
+    /// \param bufferSize Ring size in bytes. Rounded up to a power of 2. At most
+    ///                   MAX_READER_BUFFER_SIZE. If the ring fills up, the thread
+    ///                   stops draining and further data is held (or dropped) by
+    ///                   the driver.
+    /// \throw SerialPortException
+    void startReaderThread(unsigned int bufferSize = 65536);
+
+    /// Stop the background reader thread. Data still in the ring is discarded.
+    void stopReaderThread() throw();
+
+    /// \return true if the background reader thread is running
+    bool isReaderThreadRunning() const;
+
+    /// Read data received by the background reader thread, along with the time
+    /// it was received. Returns data from one chunk only (bytes that arrived
+    /// together), so that all bytes returned share the timestamp. Does not block.
+    /// \param pBuffer     Buffer for the data
+    /// \param bytes       Size of buffer
+    /// \param timestampNs Set to the time the chunk was read from the driver
+    ///                    (CLOCK_MONOTONIC, nanoseconds)
+    /// \throw SerialPortException if the reader thread is not running
+    /// \return number of bytes read. 0 if no data is buffered.
+    unsigned int readTimestamped(unsigned char* pBuffer, unsigned int bytes, long long& timestampNs);
+
     void close() throw();
     unsigned int readAll(std::vector<unsigned char>& buffer);
     unsigned int readn(std::vector<unsigned char>& buffer, unsigned int bytes);
+    unsigned int readn(unsigned char* pBuffer, unsigned int bytes);
     unsigned int availableToRead();
     unsigned int write(const std::vector<unsigned char>& buffer);
+    unsigned int write(const unsigned char* pBuffer, unsigned int bytes);
+    unsigned int writev(const Buffer* buffers, unsigned int count);
     IDataPort::Status waitForRead(int timeoutMs);
+
+    /// \copydoc IDataPort::waitForWrite()
+    /// Returns when the driver has transmitted all written data (tcdrain).
     IDataPort::Status waitForWrite(int timeoutMs);
     void flushRx();
     void flushTx();
+    int getFd() const;
 
 private:
     class SerialPortP* _pImpl; //!< platform specific private implementation
@@ -38,7 +38,10 @@
 #include <sys/ioctl.h>
 #include <sys/types.h>
 #include <sys/time.h>
-#include <sys/select.h>
+#include <poll.h>
+#include "IoVecChunks.h"
+#include <pthread.h>
+#include <time.h>
 #include <errno.h>
 #include <string.h>
 #include <sstream>
@@ -47,6 +50,32 @@
 #   define FNDELAY  O_NDELAY
 #endif
 
+#ifdef __linux__
+#include <linux/serial.h>
+
+// termios2 from asm/termbits.h, which can't be included along with termios.h.
+// Needed for baud rates without a Bxxx constant.
+#ifdef TCGETS2
+struct termios2
+{
+    tcflag_t c_iflag;
+    tcflag_t c_oflag;
+    tcflag_t c_cflag;
+    tcflag_t c_lflag;
+    cc_t c_line;
+    cc_t c_cc[19];
+    speed_t c_ispeed;
+    speed_t c_ospeed;
+};
+#ifndef BOTHER
+#define BOTHER 0010000
+#endif
+#ifndef IBSHIFT
+#define IBSHIFT 16
+#endif
+#endif
+#endif
+
 namespace grape
 {
 
@@ -59,21 +88,97 @@ class SerialPortP
 public:
     static const int INVALID_PORT_HANDLE = -1;
     static const int baud[SerialPort::BAUD_MAX]; // linux baud rate constants
+    static const unsigned int baudValue[SerialPort::BAUD_MAX]; // bits per second
+    static const unsigned int MAX_CHUNKS = 1024; // chunk records in reader thread mode
+
+    /// bytes received together by the reader thread
+    struct Chunk
+    {
+        unsigned int end;           //!< ring index one past the last byte of the chunk
+        long long timestampNs;
+    };
+
 public:
-    SerialPortP() : _portFd(-1), _portName("") {}
-    ~SerialPortP() throw() {}
+    SerialPortP();
+    ~SerialPortP() throw();
     bool getAttributes(struct termios&);
     bool setAttributes(struct termios&);
+
+    // reader thread mode
+    static void* readerMain(void* pArg);
+    static long long nowNs();
+    void readerLoop();
+    bool waitForSpace();
+    bool waitForData(int timeoutMs);
+    unsigned int readRing(unsigned char* pBuffer, unsigned int bytes, bool oneChunk, long long* pTimestamp);
+    void consume(unsigned int tail);
+    void wake(int* pWaiting, pthread_cond_t* pCond);
+    void signalReady();
+    void clearReady();
 public:
     int _portFd;
     std::string _portName;
 
+    // reader thread mode. Indices are free running. _head and _chunkHead are
+    // written by the reader thread only, _tail and _chunkTail by the consumer only.
+    bool _readerRunning;
+    pthread_t _reader;
+    int _stopPipe[2];
+    int _stopping;
+    int _readerError;               //!< errno that stopped the reader thread
+    std::vector<unsigned char> _ring;
+    unsigned int _mask;
+    unsigned int _head;
+    unsigned int _tail;
+    std::vector<Chunk> _chunks;
+    unsigned int _chunkHead;
+    unsigned int _chunkTail;
+    int _consumerWaiting;           //!< consumer sleeps on _dataCond
+    int _readerWaiting;             //!< reader thread sleeps on _spaceCond
+    int _readyPipe[2];              //!< read end is readable while the ring has data. See getFd()
+    int _readySignalled;            //!< a byte is in _readyPipe
+    pthread_mutex_t _lock;
+    pthread_cond_t _dataCond;
+    pthread_cond_t _spaceCond;
+
 }; // SerialPortP
 
 // linux baud constants from termios.h
-const int SerialPortP::baud[SerialPort::BAUD_MAX] = {B4800, B9600, B19200, B38400, B57600, B115200, B230400};
+const int SerialPortP::baud[SerialPort::BAUD_MAX] = {B4800, B9600, B19200, B38400, B57600, B115200, B230400,
+                                                      B460800, B921600, B1000000, B1500000, B2000000, B3000000};
+const unsigned int SerialPortP::baudValue[SerialPort::BAUD_MAX] = {4800, 9600, 19200, 38400, 57600, 115200, 230400,
+                                                                   460800, 921600, 1000000, 1500000, 2000000, 3000000};
 
 //==============================================================================
+SerialPortP::SerialPortP()
+//==============================================================================
+    : _portFd(-1), _portName(""), _readerRunning(false), _stopping(0), _readerError(0),
+      _mask(0), _head(0), _tail(0), _chunkHead(0), _chunkTail(0), _consumerWaiting(0), _readerWaiting(0),
+      _readySignalled(0)
+{
+    _stopPipe[0] = _stopPipe[1] = -1;
+    _readyPipe[0] = _readyPipe[1] = -1;
+    pthread_mutex_init(&_lock, NULL);
+    pthread_condattr_t attr;
+    pthread_condattr_init(&attr);
+#ifndef __APPLE__
+    pthread_condattr_setclock(&attr, CLOCK_MONOTONIC);
+#endif
+    pthread_cond_init(&_dataCond, &attr);
+    pthread_cond_init(&_spaceCond, &attr);
+    pthread_condattr_destroy(&attr);
+}
+
+//------------------------------------------------------------------------------
+SerialPortP::~SerialPortP() throw()
+//------------------------------------------------------------------------------
+{
+    pthread_cond_destroy(&_spaceCond);
+    pthread_cond_destroy(&_dataCond);
+    pthread_mutex_destroy(&_lock);
+}
+
+//------------------------------------------------------------------------------
 bool SerialPortP::getAttributes(struct termios& tops)
 //==============================================================================
 {
@@ -87,6 +192,271 @@ bool SerialPortP::setAttributes(struct termios& tops)
     return ( tcsetattr (_portFd, TCSANOW, &tops) == 0 );
 }
 
+//------------------------------------------------------------------------------
+long long SerialPortP::nowNs()
+//------------------------------------------------------------------------------
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (long long)ts.tv_sec * 1000000000LL + ts.tv_nsec;
+}
+
+//------------------------------------------------------------------------------
+void* SerialPortP::readerMain(void* pArg)
+//------------------------------------------------------------------------------
+{
+    ((SerialPortP*)pArg)->readerLoop();
+    return NULL;
+}
+
+//------------------------------------------------------------------------------
+void SerialPortP::wake(int* pWaiting, pthread_cond_t* pCond)
+//------------------------------------------------------------------------------
+{
+    // the index update that precedes this is seq_cst, so either the sleeper sees
+    // it, or we see the sleeper's flag
+    if( __atomic_load_n(pWaiting, __ATOMIC_SEQ_CST) )
+    {
+        pthread_mutex_lock(&_lock);
+        pthread_cond_broadcast(pCond);
+        pthread_mutex_unlock(&_lock);
+    }
+}
+
+//------------------------------------------------------------------------------
+void SerialPortP::signalReady()
+//------------------------------------------------------------------------------
+{
+    // only the transition to signalled writes, so the pipe never holds more than a byte
+    int expected = 0;
+    if( __atomic_compare_exchange_n(&_readySignalled, &expected, 1, false, __ATOMIC_SEQ_CST, __ATOMIC_SEQ_CST) )
+    {
+        char c = 0;
+        while( (::write(_readyPipe[1], &c, 1) < 0) && (errno == EINTR) ) {}
+    }
+}
+
+//------------------------------------------------------------------------------
+void SerialPortP::clearReady()
+//------------------------------------------------------------------------------
+{
+    if( !__atomic_load_n(&_readySignalled, __ATOMIC_SEQ_CST) )
+    {
+        return;
+    }
+    char c[16];
+    ssize_t n = 0;
+    do
+    {
+        n = ::read(_readyPipe[0], c, sizeof(c));
+    } while( (n > 0) || ((n < 0) && (errno == EINTR)) );
+    __atomic_store_n(&_readySignalled, 0, __ATOMIC_SEQ_CST);
+
+    // the reader thread signals only on the transition, so recheck for data it
+    // published while the flag was still set
+    if( (__atomic_load_n(&_head, __ATOMIC_SEQ_CST) != _tail) || __atomic_load_n(&_readerError, __ATOMIC_SEQ_CST) )
+    {
+        signalReady();
+    }
+}
+
+//------------------------------------------------------------------------------
+bool SerialPortP::waitForSpace()
+//------------------------------------------------------------------------------
+{
+    pthread_mutex_lock(&_lock);
+    __atomic_store_n(&_readerWaiting, 1, __ATOMIC_SEQ_CST);
+    while( !__atomic_load_n(&_stopping, __ATOMIC_SEQ_CST)
+           && ((_head - __atomic_load_n(&_tail, __ATOMIC_SEQ_CST) > _mask)
+               || (_chunkHead - __atomic_load_n(&_chunkTail, __ATOMIC_SEQ_CST) >= MAX_CHUNKS)) )
+    {
+        pthread_cond_wait(&_spaceCond, &_lock);
+    }
+    __atomic_store_n(&_readerWaiting, 0, __ATOMIC_RELAXED);
+    pthread_mutex_unlock(&_lock);
+    return !__atomic_load_n(&_stopping, __ATOMIC_SEQ_CST);
+}
+
+//------------------------------------------------------------------------------
+void SerialPortP::readerLoop()
+//------------------------------------------------------------------------------
+{
+    const unsigned int capacity = _mask + 1;
+    struct pollfd fds[2];
+    fds[0].fd = _portFd;
+    fds[0].events = POLLIN;
+    fds[1].fd = _stopPipe[0];
+    fds[1].events = POLLIN;
+
+    int error = 0;
+    while( !__atomic_load_n(&_stopping, __ATOMIC_SEQ_CST) )
+    {
+        const unsigned int used = _head - __atomic_load_n(&_tail, __ATOMIC_ACQUIRE);
+        const unsigned int chunks = _chunkHead - __atomic_load_n(&_chunkTail, __ATOMIC_ACQUIRE);
+        if( (used == capacity) || (chunks == MAX_CHUNKS) )
+        {
+            waitForSpace();
+            continue;
+        }
+
+        fds[0].revents = fds[1].revents = 0;
+        if( poll(fds, 2, -1) < 0 )
+        {
+            if( errno == EINTR )
+            {
+                continue;
+            }
+            error = errno;
+            break;
+        }
+        if( fds[1].revents )
+        {
+            break;
+        }
+        const long long timestamp = nowNs();
+
+        // read straight into the ring, up to the wrap point
+        const unsigned int offset = _head & _mask;
+        unsigned int space = capacity - used;
+        if( space > capacity - offset )
+        {
+            space = capacity - offset;
+        }
+        ssize_t n = ::read(_portFd, &_ring[offset], space);
+        if( n < 0 )
+        {
+            if( (errno == EAGAIN) || (errno == EWOULDBLOCK) || (errno == EINTR) )
+            {
+                continue;
+            }
+            error = errno;
+            break;
+        }
+        if( n == 0 )
+        {
+            if( fds[0].revents & (POLLHUP | POLLERR | POLLNVAL) )
+            {
+                error = EIO; // hangup
+                break;
+            }
+            continue;
+        }
+
+        // publish the chunk record before the data it describes
+        Chunk& chunk = _chunks[_chunkHead % MAX_CHUNKS];
+        chunk.end = _head + n;
+        chunk.timestampNs = timestamp;
+        __atomic_store_n(&_chunkHead, _chunkHead + 1, __ATOMIC_SEQ_CST);
+        __atomic_store_n(&_head, _head + n, __ATOMIC_SEQ_CST);
+        signalReady();
+        wake(&_consumerWaiting, &_dataCond);
+    }
+
+    if( error )
+    {
+        __atomic_store_n(&_readerError, error, __ATOMIC_SEQ_CST);
+        signalReady();
+        pthread_mutex_lock(&_lock);
+        pthread_cond_broadcast(&_dataCond);
+        pthread_mutex_unlock(&_lock);
+    }
+}
+
+//------------------------------------------------------------------------------
+bool SerialPortP::waitForData(int timeoutMs)
+//------------------------------------------------------------------------------
+{
+    if( (__atomic_load_n(&_head, __ATOMIC_ACQUIRE) != _tail) )
+    {
+        return true;
+    }
+    if( timeoutMs == 0 )
+    {
+        return false;
+    }
+
+    struct timespec deadline;
+    if( timeoutMs > 0 )
+    {
+        clock_gettime(CLOCK_MONOTONIC, &deadline);
+        deadline.tv_sec += timeoutMs / 1000;
+        deadline.tv_nsec += (timeoutMs % 1000) * 1000000L;
+        if( deadline.tv_nsec >= 1000000000L )
+        {
+            deadline.tv_sec += 1;
+            deadline.tv_nsec -= 1000000000L;
+        }
+    }
+
+    pthread_mutex_lock(&_lock);
+    __atomic_store_n(&_consumerWaiting, 1, __ATOMIC_SEQ_CST);
+    while( (__atomic_load_n(&_head, __ATOMIC_SEQ_CST) == _tail) && !__atomic_load_n(&_readerError, __ATOMIC_SEQ_CST) )
+    {
+        int ret = (timeoutMs < 0) ? pthread_cond_wait(&_dataCond, &_lock) : pthread_cond_timedwait(&_dataCond, &_lock, &deadline);
+        if( ret == ETIMEDOUT )
+        {
+            break;
+        }
+    }
+    __atomic_store_n(&_consumerWaiting, 0, __ATOMIC_RELAXED);
+    pthread_mutex_unlock(&_lock);
+    return (__atomic_load_n(&_head, __ATOMIC_ACQUIRE) != _tail);
+}
+
+//------------------------------------------------------------------------------
+unsigned int SerialPortP::readRing(unsigned char* pBuffer, unsigned int bytes, bool oneChunk, long long* pTimestamp)
+//------------------------------------------------------------------------------
+{
+    const unsigned int head = __atomic_load_n(&_head, __ATOMIC_ACQUIRE);
+    unsigned int n = head - _tail;
+    if( n == 0 )
+    {
+        return 0;
+    }
+    if( oneChunk )
+    {
+        const Chunk& chunk = _chunks[_chunkTail % MAX_CHUNKS];
+        if( chunk.end - _tail < n )
+        {
+            n = chunk.end - _tail;
+        }
+        *pTimestamp = chunk.timestampNs;
+    }
+    if( n > bytes )
+    {
+        n = bytes;
+    }
+
+    const unsigned int capacity = _mask + 1;
+    const unsigned int offset = _tail & _mask;
+    const unsigned int first = (n < capacity - offset) ? n : (capacity - offset);
+    memcpy(pBuffer, &_ring[offset], first);
+    memcpy(pBuffer + first, &_ring[0], n - first);
+
+    consume(_tail + n);
+    return n;
+}
+
+//------------------------------------------------------------------------------
+void SerialPortP::consume(unsigned int tail)
+//------------------------------------------------------------------------------
+{
+    // release the records of chunks that have been read completely
+    unsigned int chunkTail = _chunkTail;
+    const unsigned int chunkHead = __atomic_load_n(&_chunkHead, __ATOMIC_ACQUIRE);
+    while( (chunkTail != chunkHead) && ((int)(_chunks[chunkTail % MAX_CHUNKS].end - tail) <= 0) )
+    {
+        ++chunkTail;
+    }
+    __atomic_store_n(&_chunkTail, chunkTail, __ATOMIC_SEQ_CST);
+    __atomic_store_n(&_tail, tail, __ATOMIC_SEQ_CST);
+    if( __atomic_load_n(&_head, __ATOMIC_SEQ_CST) == tail )
+    {
+        clearReady();
+    }
+    wake(&_readerWaiting, &_spaceCond);
+}
+
 //==============================================================================
 SerialPort::SerialPort()
 //==============================================================================
@@ -144,6 +514,144 @@ void SerialPort::setBaudRate(BaudRate baud)
     }
 }
 
+//------------------------------------------------------------------------------
+void SerialPort::setCustomBaudRate(unsigned int baud)
+//------------------------------------------------------------------------------
+{
+#if defined(__linux__) && defined(TCGETS2)
+    struct termios2 tops;
+    if( ioctl(_pImpl->_portFd, TCGETS2, &tops) < 0 )
+    {
+        std::ostringstream str;
+        str << "[SerialPort::setCustomBaudRate(TCGETS2)]: " << strerror(errno);
+        throw SerialPortException(errno, str.str());
+    }
+
+    tops.c_cflag &= ~(CBAUD | (CBAUD << IBSHIFT));
+    tops.c_cflag |= BOTHER | (BOTHER << IBSHIFT);
+    tops.c_ispeed = baud;
+    tops.c_ospeed = baud;
+
+    if( ioctl(_pImpl->_portFd, TCSETS2, &tops) < 0 )
+    {
+        std::ostringstream str;
+        str << "[SerialPort::setCustomBaudRate(TCSETS2)]: " << strerror(errno);
+        throw InvalidBaudException(errno, str.str());
+    }
+#else
+    // only the standard rates have constants elsewhere
+    for(int i = 0; i < SerialPort::BAUD_MAX; ++i)
+    {
+        if( SerialPortP::baudValue[i] == baud )
+        {
+            setBaudRate((BaudRate)i);
+            return;
+        }
+    }
+    throw InvalidBaudException(-1, "[SerialPort::setCustomBaudRate]: Non-standard baud rates not supported on this platform");
+#endif
+}
+
+//------------------------------------------------------------------------------
+unsigned int SerialPort::getBaudRate()
+//------------------------------------------------------------------------------
+{
+#if defined(__linux__) && defined(TCGETS2)
+    struct termios2 tops;
+    if( ioctl(_pImpl->_portFd, TCGETS2, &tops) < 0 )
+    {
+        std::ostringstream str;
+        str << "[SerialPort::getBaudRate(TCGETS2)]: " << strerror(errno);
+        throw SerialPortException(errno, str.str());
+    }
+    return tops.c_ospeed;
+#else
+    struct termios tops;
+    if( !_pImpl->getAttributes(tops) )
+    {
+        throw SerialPortException(-1, "[SerialPort::getBaudRate(getAttributes)] failed");
+    }
+    speed_t speed = cfgetospeed(&tops);
+    for(int i = 0; i < SerialPort::BAUD_MAX; ++i)
+    {
+        if( (speed_t)SerialPortP::baud[i] == speed )
+        {
+            return SerialPortP::baudValue[i];
+        }
+    }
+    return 0;
+#endif
+}
+
+//------------------------------------------------------------------------------
+void SerialPort::setLowLatency(bool yes)
+//------------------------------------------------------------------------------
+{
+#ifdef __linux__
+    struct serial_struct serial;
+    if( ioctl(_pImpl->_portFd, TIOCGSERIAL, &serial) < 0 )
+    {
+        std::ostringstream str;
+        str << "[SerialPort::setLowLatency(TIOCGSERIAL)]: " << strerror(errno);
+        throw SerialPortException(errno, str.str());
+    }
+
+    if( yes )
+    {
+        serial.flags |= ASYNC_LOW_LATENCY;
+    }
+    else
+    {
+        serial.flags &= ~ASYNC_LOW_LATENCY;
+    }
+
+    if( ioctl(_pImpl->_portFd, TIOCSSERIAL, &serial) < 0 )
+    {
+        std::ostringstream str;
+        str << "[SerialPort::setLowLatency(TIOCSSERIAL)]: " << strerror(errno);
+        throw SerialPortException(errno, str.str());
+    }
+#else
+    throw SerialPortException(-1, "[SerialPort::setLowLatency]: Not supported on this platform");
+#endif
+}
+
+//------------------------------------------------------------------------------
+void SerialPort::setBlockingRead(unsigned char minBytes, unsigned char timeoutDeciSec)
+//------------------------------------------------------------------------------
+{
+    struct termios tops;
+    if( !_pImpl->getAttributes(tops) )
+    {
+        throw SerialPortException(-1, "[SerialPort::setBlockingRead(getAttributes)] failed");
+    }
+
+    tops.c_cc[VMIN] = minBytes;
+    tops.c_cc[VTIME] = timeoutDeciSec;
+
+    if( !_pImpl->setAttributes(tops) )
+    {
+        throw SerialPortException(-1, "[SerialPort::setBlockingRead(setAttributes)] failed");
+    }
+
+    // VMIN and VTIME apply only to blocking descriptors
+    int flags = fcntl(_pImpl->_portFd, F_GETFL);
+    if( (minBytes == 0) && (timeoutDeciSec == 0) )
+    {
+        flags |= FNDELAY;
+    }
+    else
+    {
+        flags &= ~FNDELAY;
+    }
+    if( fcntl(_pImpl->_portFd, F_SETFL, flags) < 0 )
+    {
+        std::ostringstream str;
+        str << "[SerialPort::setBlockingRead(fcntl)]: " << strerror(errno);
+        throw SerialPortException(errno, str.str());
+    }
+}
+
 //------------------------------------------------------------------------------
 void SerialPort::setDataFormat(DataFormat fmt)
 //------------------------------------------------------------------------------
@@ -253,6 +761,7 @@ void SerialPort::open()
 void SerialPort::close() throw()
 //------------------------------------------------------------------------------
 {
+    stopReaderThread();
     if( isOpen() )
     {
         ::close( _pImpl->_portFd );
@@ -267,6 +776,119 @@ bool SerialPort::isOpen()
     return (_pImpl->_portFd != SerialPortP::INVALID_PORT_HANDLE);
 }
 
+//------------------------------------------------------------------------------
+void SerialPort::startReaderThread(unsigned int bufferSize)
+//------------------------------------------------------------------------------
+{
+    if( !isOpen() )
+    {
+        throw SerialPortException(-1, "[SerialPort::startReaderThread]: Port not open");
+    }
+    if( bufferSize > MAX_READER_BUFFER_SIZE )
+    {
+        throw SerialPortException(EINVAL, "[SerialPort::startReaderThread]: Buffer size exceeds MAX_READER_BUFFER_SIZE");
+    }
+    stopReaderThread();
+
+    unsigned int size = 1;
+    while( size < bufferSize )
+    {
+        size <<= 1;
+    }
+    SerialPortP& p = *_pImpl;
+    p._ring.resize(size);
+    p._mask = size - 1;
+    p._chunks.resize(SerialPortP::MAX_CHUNKS);
+    p._head = p._tail = 0;
+    p._chunkHead = p._chunkTail = 0;
+    p._stopping = 0;
+    p._readerError = 0;
+    p._readySignalled = 0;
+
+    if( pipe(p._stopPipe) < 0 )
+    {
+        std::ostringstream str;
+        str << "[SerialPort::startReaderThread(pipe)]: " << strerror(errno);
+        throw SerialPortException(errno, str.str());
+    }
+    if( pipe(p._readyPipe) < 0 )
+    {
+        int error = errno;
+        ::close(p._stopPipe[0]);
+        ::close(p._stopPipe[1]);
+        std::ostringstream str;
+        str << "[SerialPort::startReaderThread(pipe)]: " << strerror(error);
+        throw SerialPortException(error, str.str());
+    }
+    for(int i = 0; i < 2; ++i)
+    {
+        fcntl(p._readyPipe[i], F_SETFL, fcntl(p._readyPipe[i], F_GETFL) | O_NONBLOCK);
+        fcntl(p._readyPipe[i], F_SETFD, FD_CLOEXEC);
+    }
+
+    int ret = pthread_create(&p._reader, NULL, SerialPortP::readerMain, &p);
+    if( ret != 0 )
+    {
+        ::close(p._stopPipe[0]);
+        ::close(p._stopPipe[1]);
+        ::close(p._readyPipe[0]);
+        ::close(p._readyPipe[1]);
+        p._readyPipe[0] = p._readyPipe[1] = -1;
+        std::ostringstream str;
+        str << "[SerialPort::startReaderThread(pthread_create)]: " << strerror(ret);
+        throw SerialPortException(ret, str.str());
+    }
+    p._readerRunning = true;
+}
+
+//------------------------------------------------------------------------------
+void SerialPort::stopReaderThread() throw()
+//------------------------------------------------------------------------------
+{
+    SerialPortP& p = *_pImpl;
+    if( !p._readerRunning )
+    {
+        return;
+    }
+
+    __atomic_store_n(&p._stopping, 1, __ATOMIC_SEQ_CST);
+    char c = 0;
+    while( (::write(p._stopPipe[1], &c, 1) < 0) && (errno == EINTR) ) {}
+    pthread_mutex_lock(&p._lock);
+    pthread_cond_broadcast(&p._spaceCond);
+    pthread_mutex_unlock(&p._lock);
+    pthread_join(p._reader, NULL);
+
+    ::close(p._stopPipe[0]);
+    ::close(p._stopPipe[1]);
+    p._stopPipe[0] = p._stopPipe[1] = -1;
+    ::close(p._readyPipe[0]);
+    ::close(p._readyPipe[1]);
+    p._readyPipe[0] = p._readyPipe[1] = -1;
+    p._readerRunning = false;
+    p._head = p._tail = 0;
+    p._chunkHead = p._chunkTail = 0;
+}
+
+//------------------------------------------------------------------------------
+bool SerialPort::isReaderThreadRunning() const
+//------------------------------------------------------------------------------
+{
+    return _pImpl->_readerRunning;
+}
+
+//------------------------------------------------------------------------------
+unsigned int SerialPort::readTimestamped(unsigned char* pBuffer, unsigned int bytes, long long& timestampNs)
+//------------------------------------------------------------------------------
+{
+    if( !_pImpl->_readerRunning )
+    {
+        throw SerialPortException(-1, "[SerialPort::readTimestamped]: Reader thread not running");
+    }
+    timestampNs = 0;
+    return _pImpl->readRing(pBuffer, bytes, true, &timestampNs);
+}
+
 
 
 //------------------------------------------------------------------------------
@@ -285,7 +907,19 @@ unsigned int SerialPort::readn(std::vector<unsigned char>& buffer, unsigned int
         buffer.resize(bytesToRead);
     }
 
-    ssize_t bytesRead = ::read(_pImpl->_portFd, &buffer[0], bytesToRead);
+    return readn(buffer.empty() ? NULL : &buffer[0], bytesToRead);
+}
+
+//------------------------------------------------------------------------------
+unsigned int SerialPort::readn(unsigned char* pBuffer, unsigned int bytesToRead)
+//------------------------------------------------------------------------------
+{
+    if( _pImpl->_readerRunning )
+    {
+        return _pImpl->readRing(pBuffer, bytesToRead, false, NULL);
+    }
+
+    ssize_t bytesRead = ::read(_pImpl->_portFd, pBuffer, bytesToRead);
     if( bytesRead < 0)
     {
         std::ostringstream str;
@@ -300,6 +934,11 @@ unsigned int SerialPort::readn(std::vector<unsigned char>& buffer, unsigned int
 unsigned int SerialPort::availableToRead()
 //------------------------------------------------------------------------------
 {
+    if( _pImpl->_readerRunning )
+    {
+        return __atomic_load_n(&_pImpl->_head, __ATOMIC_ACQUIRE) - _pImpl->_tail;
+    }
+
     unsigned int bytes = 0;
 
     if( ioctl(_pImpl->_portFd, FIONREAD, &bytes) < 0 )
@@ -316,16 +955,46 @@ unsigned int SerialPort::availableToRead()
 unsigned int SerialPort::write(const std::vector<unsigned char>& buffer)
 //------------------------------------------------------------------------------
 {
-    int bytes = ::write(_pImpl->_portFd, &buffer[0], buffer.size());
+    return write(buffer.empty() ? NULL : &buffer[0], buffer.size());
+}
+
+//------------------------------------------------------------------------------
+unsigned int SerialPort::write(const unsigned char* pBuffer, unsigned int bytes)
+//------------------------------------------------------------------------------
+{
+    int written = ::write(_pImpl->_portFd, pBuffer, bytes);
 
-    if( bytes < 0 )
+    if( written < 0 )
     {
         std::ostringstream str;
         str << "[SerialPort::write]: " << strerror(errno);
         throw IoWriteException(errno, str.str());
     }
 
-    return bytes;
+    return written;
+}
+
+//------------------------------------------------------------------------------
+unsigned int SerialPort::writev(const Buffer* buffers, unsigned int count)
+//------------------------------------------------------------------------------
+{
+    IoVecChunks chunks(buffers, count);
+    while( chunks.next() )
+    {
+        ssize_t written = ::writev(_pImpl->_portFd, chunks.iov(), chunks.size());
+        if( written < 0 )
+        {
+            std::ostringstream str;
+            str << "[SerialPort::writev]: " << strerror(errno);
+            throw IoWriteException(errno, str.str());
+        }
+        if( !chunks.advance(written) )
+        {
+            break; // partial write. caller continues with the rest
+        }
+    }
+
+    return chunks.total();
 }
 
 //------------------------------------------------------------------------------
@@ -337,31 +1006,38 @@ IDataPort::Status SerialPort::waitForRead(int timeoutMs)
         throw SerialPortException(-1, "[SerialPort::waitForRead]: Port not open");
     }
 
-    fd_set fds;
-    FD_ZERO(&fds);
-    FD_SET(_pImpl->_portFd, &fds);
-
-    // indefinite wait
-    int ret = 0;
-    if( timeoutMs < 0 )
+    if( _pImpl->_readerRunning )
     {
-        ret = select(_pImpl->_portFd+1, &fds, NULL, NULL, NULL);
+        if( _pImpl->waitForData(timeoutMs) )
+        {
+            return IDataPort::PORT_OK;
+        }
+        return __atomic_load_n(&_pImpl->_readerError, __ATOMIC_ACQUIRE) ? IDataPort::PORT_ERROR : IDataPort::PORT_TIMEOUT;
     }
 
-    // wait with timeout
-    else
+    struct pollfd pfd;
+    pfd.fd = _pImpl->_portFd;
+    pfd.events = POLLIN;
+    pfd.revents = 0;
+
+    struct timespec timeout;
+    struct timespec* pTimeout = NULL; // indefinite wait
+    if( timeoutMs >= 0 )
     {
-        long long int secs = timeoutMs/1000;
-        long long int usecs = (timeoutMs * 1000) - (secs * 1000000);
-        struct timeval timeout = {secs, usecs};
-        ret = select(_pImpl->_portFd+1, &fds, NULL, NULL, &timeout);
+        timeout.tv_sec = timeoutMs / 1000;
+        timeout.tv_nsec = (timeoutMs % 1000) * 1000000L;
+        pTimeout = &timeout;
     }
+    int ret = ppoll(&pfd, 1, pTimeout, NULL);
 
     IDataPort::Status st = IDataPort::PORT_ERROR;
     // ret == 0: timeout, ret == 1: ready, ret == -1: error
     if (ret > 0)
     {
-        st = IDataPort::PORT_OK;
+        if( pfd.revents & POLLIN )
+        {
+            st = IDataPort::PORT_OK;
+        }
     }
     else if (ret == 0)
     {
@@ -369,7 +1045,7 @@ IDataPort::Status SerialPort::waitForRead(int timeoutMs)
     }
     else
     {
-        throw IoEventHandlingException(errno, "[SerialPort::waitForRead(select)] failed");
+        throw IoEventHandlingException(errno, "[SerialPort::waitForRead(poll)] failed");
     }
 
     return st;
@@ -382,10 +1058,41 @@ IDataPort::Status SerialPort::waitForWrite(int timeoutMs)
     if( !isOpen() )
     {
         throw SerialPortException(-1, "[SerialPort::waitForWrite]: Port not open");
+    }
 
+    // poll the driver output queue while a timeout applies, as tcdrain() has none
+    if( timeoutMs >= 0 )
+    {
+        const long long deadline = SerialPortP::nowNs() + (long long)timeoutMs * 1000000LL;
+        while( true )
+        {
+            int queued = 0;
+            if( ioctl(_pImpl->_portFd, TIOCOUTQ, &queued) < 0 )
+            {
+                break; // not supported by the driver. Wait in tcdrain()
+            }
+            if( queued == 0 )
+            {
+                break;
+            }
+            if( SerialPortP::nowNs() >= deadline )
+            {
+                return IDataPort::PORT_TIMEOUT;
+            }
+            usleep(500);
+        }
     }
 
-    /// \todo: check bytes transmitted
+    // waits for the UART to shift out the last bytes
+    while( tcdrain(_pImpl->_portFd) < 0 )
+    {
+        if( errno != EINTR )
+        {
+            std::ostringstream str;
+            str << "[SerialPort::waitForWrite(tcdrain)]: " << strerror(errno);
+            throw IoEventHandlingException(errno, str.str());
+        }
+    }
 
     return IDataPort::PORT_OK;
 }
@@ -395,6 +1102,10 @@ void SerialPort::flushRx()
 //------------------------------------------------------------------------------
 {
     tcflush(_pImpl->_portFd, TCIFLUSH);
+    if( _pImpl->_readerRunning )
+    {
+        _pImpl->consume(__atomic_load_n(&_pImpl->_head, __ATOMIC_ACQUIRE));
+    }
 }
 
 //------------------------------------------------------------------------------
@@ -404,4 +1115,15 @@ void SerialPort::flushTx()
     tcflush(_pImpl->_portFd, TCOFLUSH);
 }
 
+//------------------------------------------------------------------------------
+int SerialPort::getFd() const
+//------------------------------------------------------------------------------
+{
+    if( _pImpl->_readerRunning )
+    {
+        return _pImpl->_readyPipe[0];
+    }
+    return _pImpl->_portFd;
+}
+
 } // grape
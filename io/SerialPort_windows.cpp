@@ -65,7 +65,8 @@ public:
 }; // SerialPortP
 
 // windows baud constants from winbase.h
-const int SerialPortP::baud[SerialPort::BAUD_MAX] = {CBR_4800, CBR_9600, CBR_19200, CBR_38400, CBR_57600, CBR_115200, 230400};
+const int SerialPortP::baud[SerialPort::BAUD_MAX] = {CBR_4800, CBR_9600, CBR_19200, CBR_38400, CBR_57600, CBR_115200, 230400,
+                                                      460800, 921600, 1000000, 1500000, 2000000, 3000000};
 
 //==============================================================================
 bool SerialPortP::getAttributes(DCB& dcb)
@@ -184,6 +185,69 @@ void SerialPort::setBaudRate(BaudRate baud)
     }
 }
 
+//------------------------------------------------------------------------------
+void SerialPort::setCustomBaudRate(unsigned int baud)
+//------------------------------------------------------------------------------
+{
+    DCB dcb = {0};
+    if( !_pImpl->getAttributes(dcb) )
+    {
+        throw SerialPortException(GetLastError(), "[SerialPort::setCustomBaudRate(getAttributes)] failed");
+    }
+
+    dcb.BaudRate = baud;
+
+    if( !_pImpl->setAttributes(dcb) )
+    {
+        throw InvalidBaudException(GetLastError(), "[SerialPort::setCustomBaudRate(setAttributes)] failed");
+    }
+}
+
+//------------------------------------------------------------------------------
+unsigned int SerialPort::getBaudRate()
+//------------------------------------------------------------------------------
+{
+    DCB dcb = {0};
+    if( !_pImpl->getAttributes(dcb) )
+    {
+        throw SerialPortException(GetLastError(), "[SerialPort::getBaudRate(getAttributes)] failed");
+    }
+    return dcb.BaudRate;
+}
+
+//------------------------------------------------------------------------------
+void SerialPort::setLowLatency(bool yes)
+//------------------------------------------------------------------------------
+{
+    // the FTDI latency timer is a driver setting on windows (device manager)
+    throw SerialPortException(-1, "[SerialPort::setLowLatency]: Not supported on this platform");
+}
+
+//------------------------------------------------------------------------------
+void SerialPort::setBlockingRead(unsigned char minBytes, unsigned char timeoutDeciSec)
+//------------------------------------------------------------------------------
+{
+    // approximate VMIN/VTIME with comm timeouts
+    COMMTIMEOUTS timeouts={0};
+    if( minBytes == 0 )
+    {
+        // return immediately with what's there, or wait up to the timeout for the first byte
+        timeouts.ReadIntervalTimeout = MAXDWORD;
+        timeouts.ReadTotalTimeoutMultiplier = (timeoutDeciSec ? MAXDWORD : 0);
+        timeouts.ReadTotalTimeoutConstant = timeoutDeciSec * 100;
+    }
+    else
+    {
+        // wait for the requested count, or an inter-byte gap
+        timeouts.ReadIntervalTimeout = timeoutDeciSec * 100;
+    }
+
+    if( 0 == SetCommTimeouts(_pImpl->_portFd, &timeouts) )
+    {
+        throw SerialPortException(GetLastError(), "[SerialPort::setBlockingRead(SetCommTimeouts)] failed");
+    }
+}
+
 //------------------------------------------------------------------------------
 void SerialPort::setDataFormat(DataFormat fmt)
 //------------------------------------------------------------------------------
@@ -311,6 +375,33 @@ bool SerialPort::isOpen()
     return (_pImpl->_portFd != INVALID_HANDLE_VALUE);
 }
 
+//------------------------------------------------------------------------------
+void SerialPort::startReaderThread(unsigned int bufferSize)
+//------------------------------------------------------------------------------
+{
+    throw SerialPortException(-1, "[SerialPort::startReaderThread]: Not supported on this platform");
+}
+
+//------------------------------------------------------------------------------
+void SerialPort::stopReaderThread() throw()
+//------------------------------------------------------------------------------
+{
+}
+
+//------------------------------------------------------------------------------
+bool SerialPort::isReaderThreadRunning() const
+//------------------------------------------------------------------------------
+{
+    return false;
+}
+
+//------------------------------------------------------------------------------
+unsigned int SerialPort::readTimestamped(unsigned char* pBuffer, unsigned int bytes, long long& timestampNs)
+//------------------------------------------------------------------------------
+{
+    throw SerialPortException(-1, "[SerialPort::readTimestamped]: Reader thread not running");
+}
+
 //------------------------------------------------------------------------------
 unsigned int SerialPort::readAll(std::vector<unsigned char>& buffer)
 //------------------------------------------------------------------------------
@@ -328,6 +419,13 @@ unsigned int SerialPort::readn(std::vector<unsigned char>& buffer, unsigned int
         buffer.resize(bytesToRead);
     }
 
+    return readn(buffer.empty() ? NULL : &buffer[0], bytesToRead);
+}
+
+//------------------------------------------------------------------------------
+unsigned int SerialPort::readn(unsigned char* pBuffer, unsigned int bytesToRead)
+//------------------------------------------------------------------------------
+{
     // create event to handle read completion
     OVERLAPPED osReader = {0};
     osReader.hEvent = CreateEvent(NULL, TRUE, FALSE, NULL);
@@ -338,7 +436,7 @@ unsigned int SerialPort::readn(std::vector<unsigned char>& buffer, unsigned int
 
     // read all
     unsigned int bytesRead = 0;
-    if( 0 != ReadFile(_pImpl->_portFd, &buffer[0], bytesToRead, (LPDWORD)(&bytesRead), &osReader) )
+    if( 0 != ReadFile(_pImpl->_portFd, pBuffer, bytesToRead, (LPDWORD)(&bytesRead), &osReader) )
     {
         // read completed immediately. We are done
         CloseHandle(osReader.hEvent);
@@ -398,6 +496,13 @@ unsigned int SerialPort::availableToRead()
 //------------------------------------------------------------------------------
 unsigned int SerialPort::write(const std::vector<unsigned char>& buffer)
 //------------------------------------------------------------------------------
+{
+    return write(buffer.empty() ? NULL : &buffer[0], buffer.size());
+}
+
+//------------------------------------------------------------------------------
+unsigned int SerialPort::write(const unsigned char* pBuffer, unsigned int bytes)
+//------------------------------------------------------------------------------
 {
     // create event to handle write completion
     OVERLAPPED osWriter = {0};
@@ -409,7 +514,7 @@ unsigned int SerialPort::write(const std::vector<unsigned char>& buffer)
 
     // write all
     unsigned int bytesWritten = 0;
-    if( 0 != WriteFile(_pImpl->_portFd, &buffer[0], buffer.size(), (LPDWORD)(&bytesWritten), &osWriter) )
+    if( 0 != WriteFile(_pImpl->_portFd, pBuffer, bytes, (LPDWORD)(&bytesWritten), &osWriter) )
     {
         // completed immediately. We are done
         CloseHandle(osWriter.hEvent);
@@ -452,6 +557,13 @@ unsigned int SerialPort::write(const std::vector<unsigned char>& buffer)
     return bytesWritten;
 }
 
+//------------------------------------------------------------------------------
+unsigned int SerialPort::writev(const Buffer* buffers, unsigned int count)
+//------------------------------------------------------------------------------
+{
+    return IDataPort::writev(buffers, count);
+}
+
 //------------------------------------------------------------------------------
 IDataPort::Status SerialPort::waitForRead(int timeoutMs)
 //------------------------------------------------------------------------------
@@ -480,6 +592,13 @@ void SerialPort::flushTx()
     PurgeComm(_pImpl->_portFd, PURGE_TXABORT|PURGE_TXCLEAR);
 }
 
+//------------------------------------------------------------------------------
+int SerialPort::getFd() const
+//------------------------------------------------------------------------------
+{
+    return -1; // HANDLEs cannot be used with POSIX event demultiplexers
+}
+
 
 } // grape
 
@@ -0,0 +1,159 @@
+//==============================================================================
+// Project  : Grape
+// Module   : IO
+// File     : ShardedUdpServer.h
+// Brief    : Multi-threaded UDP server sharded over SO_REUSEPORT sockets
+//
+// Copyright (c) 2012, Vilas Chitrakaran
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//    * Redistributions of source code must retain the above copyright
+//      notice, this list of conditions and the following disclaimer.
+//    * Redistributions in binary form must reproduce the above copyright
+//      notice, this list of conditions and the following disclaimer in the
+//      documentation and/or other materials provided with the distribution.
+//    * Neither the name of the copyright holder nor the names of its
+//      contributors may be used to endorse or promote products derived from
+//      this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR ITS CONTRIBUTORS
+// BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF
+// THE POSSIBILITY OF SUCH DAMAGE.
+//==============================================================================
+
+#ifndef GRAPEIO_SHARDEDUDPSERVER_H
+#define GRAPEIO_SHARDEDUDPSERVER_H
+
+#include "UdpSocket.h"
+#include <vector>
+
+namespace grape
+{
+
+/// \class ShardedUdpServer
+/// \ingroup io
+/// \brief UDP server that scales receive throughput across cores
+///
+/// The server opens several UDP sockets bound to the same port with
+/// SO_REUSEPORT. The kernel distributes incoming datagrams across the sockets
+/// (shards), and each shard is serviced by its own receiver thread pinned to a
+/// core. Datagrams are received in batches (see UdpSocket::readBatch()) and
+/// passed to a user supplied handler, called from the receiver threads:
+/// \code
+/// class Ingest : public grape::ShardedUdpServer::IHandler
+/// {
+///     void onReceive(unsigned int shard, const grape::UdpSocket::Datagram* datagrams, unsigned int count)
+///     {
+///         // called concurrently for different shards
+///     }
+/// };
+///
+/// Ingest handler;
+/// grape::ShardedUdpServer server(port, 4, &handler);
+/// server.setSteering(grape::ShardedUdpServer::STEER_CPU);
+/// server.start();
+/// // ...
+/// server.stop();
+/// \endcode
+///
+/// By default the kernel picks a shard by hashing the source and destination
+/// address, so all datagrams from one sensor arrive in order on one shard.
+/// Setting a steering mode instead keeps each datagram on the core that received
+/// it from the network, for better cache locality. Available on Linux only.
+class GRAPEIO_DLL_API ShardedUdpServer
+{
+public:
+
+    /// \brief How the kernel distributes datagrams across shards
+    enum Steering
+    {
+        STEER_HASH,         //!< Hash of source and destination address (default)
+        STEER_INCOMING_CPU, //!< Prefer the shard pinned to the receiving core (SO_INCOMING_CPU)
+        STEER_CPU           //!< Shard = receiving core modulo shard count (BPF program, SO_ATTACH_REUSEPORT_CBPF)
+    };
+
+    /// \brief Interface for datagram handlers
+    class GRAPEIO_DLL_API IHandler
+    {
+    public:
+        virtual ~IHandler() {}
+
+        /// Called from a receiver thread with a batch of datagrams. The datagrams
+        /// are valid only for the duration of the call.
+        /// \param shard        Index of the shard that received the datagrams
+        /// \param datagrams    Received datagrams
+        /// \param count        Number of datagrams
+        virtual void onReceive(unsigned int shard, const UdpSocket::Datagram* datagrams, unsigned int count) = 0;
+    };
+
+    /// \brief Per shard counters
+    struct Statistics
+    {
+        unsigned long long datagrams;   //!< Datagrams received
+        unsigned long long batches;     //!< Handler calls
+        unsigned long long errors;      //!< Receive errors and exceptions thrown by the handler
+    };
+
+public:
+
+    /// Open and bind the shard sockets. Datagrams are queued from this point.
+    /// \param port             Port to listen on
+    /// \param shards           Number of sockets and receiver threads
+    /// \param pHandler         Handler for received datagrams
+    /// \param batchSize        Maximum number of datagrams passed to a handler call
+    /// \param maxDatagramSize  Size of each receive buffer. Larger datagrams are truncated.
+    /// \throw SocketException
+    ShardedUdpServer(unsigned int port, unsigned int shards, IHandler* pHandler,
+                     unsigned int batchSize = 32, unsigned int maxDatagramSize = 2048);
+    ~ShardedUdpServer() throw();
+
+    /// Set the core each receiver thread is pinned to. Call before start().
+    /// By default, shards are pinned in turn to the cores the process may run on.
+    /// \param cpus One core number for each shard. -1 leaves a shard unpinned.
+    void setCpus(const std::vector<int>& cpus);
+
+    /// Select how datagrams are distributed across shards. Call before start().
+    /// \throw SocketException if the mode is not supported by the kernel
+    void setSteering(Steering mode);
+
+    /// Start the receiver threads
+    /// \throw SocketException if a thread cannot be created, or pinned to its core
+    void start();
+
+    /// Stop the receiver threads and wait for them to exit. Datagrams arriving
+    /// while stopped are queued in the sockets.
+    void stop() throw();
+
+    /// \return true if the receiver threads are running
+    bool isRunning() const;
+
+    /// \return Number of shards
+    unsigned int shardCount() const;
+
+    /// \return The socket of a shard, for example to set buffer sizes or to send
+    ///         replies. Do not read from it while the server is running.
+    UdpSocket& socket(unsigned int shard);
+
+    /// \return counters for a shard
+    Statistics getStatistics(unsigned int shard) const;
+
+private:
+    ShardedUdpServer(const ShardedUdpServer&);              //!< disable copy
+    ShardedUdpServer &operator=(const ShardedUdpServer&);   //!< disable assignment
+private:
+    class ShardedUdpServerP* _pImpl;                        //!< platform specific private implementation
+}; // ShardedUdpServer
+
+} // grape
+
+#endif // GRAPEIO_SHARDEDUDPSERVER_H
@@ -0,0 +1,441 @@
+//==============================================================================
+// Project  : Grape
+// Module   : IO
+// File     : ShardedUdpServer_unix.cpp
+//
+// Copyright (c) 2012, Vilas Chitrakaran
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//    * Redistributions of source code must retain the above copyright
+//      notice, this list of conditions and the following disclaimer.
+//    * Redistributions in binary form must reproduce the above copyright
+//      notice, this list of conditions and the following disclaimer in the
+//      documentation and/or other materials provided with the distribution.
+//    * Neither the name of the copyright holder nor the names of its
+//      contributors may be used to endorse or promote products derived from
+//      this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR ITS CONTRIBUTORS
+// BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF
+// THE POSSIBILITY OF SUCH DAMAGE.
+//==============================================================================
+
+#include "ShardedUdpServer.h"
+#include <linux/filter.h>
+#include <sys/eventfd.h>
+#include <pthread.h>
+#include <sched.h>
+#include <poll.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <errno.h>
+#include <string.h>
+#include <sstream>
+
+#ifndef SO_INCOMING_CPU
+#define SO_INCOMING_CPU 49
+#endif
+#ifndef SO_ATTACH_REUSEPORT_CBPF
+#define SO_ATTACH_REUSEPORT_CBPF 51
+#endif
+
+namespace grape
+{
+
+//==============================================================================
+/// \class ShardedUdpServerP
+/// \brief Linux specific private implementation
+//==============================================================================
+class ShardedUdpServerP
+{
+public:
+    /// state of one shard. Counters are written by the receiver thread only
+    struct Shard
+    {
+        ShardedUdpServerP* pOwner;
+        unsigned int index;
+        int cpu;
+        UdpSocket* pSocket;
+        pthread_t thread;
+        bool threadStarted;
+        std::vector<unsigned char> storage;
+        std::vector<UdpSocket::Datagram> datagrams;
+        ShardedUdpServer::Statistics stats;
+    };
+public:
+    ShardedUdpServerP() : _pHandler(NULL), _steering(ShardedUdpServer::STEER_HASH), _stopFd(-1), _isRunning(false) {}
+    ~ShardedUdpServerP() throw();
+    static void* receiver(void* pArg);
+    void service(Shard& shard);
+    void applySteering();
+public:
+    ShardedUdpServer::IHandler* _pHandler;
+    ShardedUdpServer::Steering _steering;
+    std::vector<Shard> _shards;
+    int _stopFd;                            //!< eventfd. Readable when threads must exit
+    bool _isRunning;
+}; // ShardedUdpServerP
+
+//------------------------------------------------------------------------------
+ShardedUdpServerP::~ShardedUdpServerP() throw()
+//------------------------------------------------------------------------------
+{
+    for(unsigned int i = 0; i < _shards.size(); ++i)
+    {
+        delete _shards[i].pSocket;
+    }
+    if( _stopFd != -1 )
+    {
+        ::close(_stopFd);
+    }
+}
+
+//------------------------------------------------------------------------------
+void* ShardedUdpServerP::receiver(void* pArg)
+//------------------------------------------------------------------------------
+{
+    Shard* pShard = (Shard*)pArg;
+    pShard->pOwner->service(*pShard);
+    return NULL;
+}
+
+//------------------------------------------------------------------------------
+void ShardedUdpServerP::service(Shard& shard)
+//------------------------------------------------------------------------------
+{
+    struct pollfd fds[2];
+    fds[0].fd = shard.pSocket->getFd();
+    fds[0].events = POLLIN;
+    fds[1].fd = _stopFd;
+    fds[1].events = POLLIN;
+
+    const unsigned int batchSize = shard.datagrams.size();
+    unsigned int lastCount = 0;
+    while( true )
+    {
+        // a full batch means more are likely queued; skip the wait
+        if( lastCount < batchSize )
+        {
+            fds[0].revents = 0;
+            fds[1].revents = 0;
+            if( poll(fds, 2, -1) < 0 )
+            {
+                if( errno == EINTR )
+                {
+                    continue;
+                }
+                __atomic_add_fetch(&shard.stats.errors, 1, __ATOMIC_RELAXED);
+                break;
+            }
+            if( fds[1].revents )
+            {
+                break;
+            }
+        }
+
+        lastCount = 0;
+        try
+        {
+            lastCount = shard.pSocket->readBatch(&shard.datagrams[0], batchSize);
+        }
+        catch(SocketException& ex)
+        {
+            // socket is non-blocking; EAGAIN just means it is drained
+            if( (ex.code() != EAGAIN) && (ex.code() != EWOULDBLOCK) )
+            {
+                __atomic_add_fetch(&shard.stats.errors, 1, __ATOMIC_RELAXED);
+            }
+            continue;
+        }
+
+        __atomic_add_fetch(&shard.stats.datagrams, lastCount, __ATOMIC_RELAXED);
+        __atomic_add_fetch(&shard.stats.batches, 1, __ATOMIC_RELAXED);
+        try
+        {
+            _pHandler->onReceive(shard.index, &shard.datagrams[0], lastCount);
+        }
+        catch(...)
+        {
+            __atomic_add_fetch(&shard.stats.errors, 1, __ATOMIC_RELAXED);
+        }
+    }
+}
+
+//------------------------------------------------------------------------------
+void ShardedUdpServerP::applySteering()
+//------------------------------------------------------------------------------
+{
+    if( _steering == ShardedUdpServer::STEER_INCOMING_CPU )
+    {
+        for(unsigned int i = 0; i < _shards.size(); ++i)
+        {
+            int cpu = _shards[i].cpu;
+            if( (cpu >= 0) && (setsockopt(_shards[i].pSocket->getFd(), SOL_SOCKET, SO_INCOMING_CPU, &cpu, sizeof(cpu)) < 0) )
+            {
+                std::ostringstream str;
+                str << "[ShardedUdpServer::start(SO_INCOMING_CPU)]: " << strerror(errno);
+                throw SocketException(errno, str.str());
+            }
+        }
+    }
+    else if( _steering == ShardedUdpServer::STEER_CPU )
+    {
+        // return (receiving cpu % shards) as the index of the socket in the group.
+        // Sockets are indexed in the order they were bound.
+        struct sock_filter code[] = {
+            { BPF_LD  | BPF_W | BPF_ABS, 0, 0, (unsigned int)(SKF_AD_OFF + SKF_AD_CPU) },
+            { BPF_ALU | BPF_MOD | BPF_K, 0, 0, (unsigned int)_shards.size() },
+            { BPF_RET | BPF_A, 0, 0, 0 }
+        };
+        struct sock_fprog prog;
+        prog.len = sizeof(code) / sizeof(code[0]);
+        prog.filter = code;
+        if( setsockopt(_shards[0].pSocket->getFd(), SOL_SOCKET, SO_ATTACH_REUSEPORT_CBPF, &prog, sizeof(prog)) < 0 )
+        {
+            std::ostringstream str;
+            str << "[ShardedUdpServer::start(SO_ATTACH_REUSEPORT_CBPF)]: " << strerror(errno);
+            throw SocketException(errno, str.str());
+        }
+    }
+}
+
+//==============================================================================
+ShardedUdpServer::ShardedUdpServer(unsigned int port, unsigned int shards, IHandler* pHandler,
+                                   unsigned int batchSize, unsigned int maxDatagramSize)
+//==============================================================================
+    : _pImpl(new ShardedUdpServerP)
+{
+    try
+    {
+        if( (shards == 0) || (pHandler == NULL) )
+        {
+            throw SocketException(EINVAL, "[ShardedUdpServer::ShardedUdpServer]: Need at least one shard and a handler");
+        }
+        if( batchSize == 0 )
+        {
+            batchSize = 1;
+        }
+
+        _pImpl->_pHandler = pHandler;
+        _pImpl->_stopFd = eventfd(0, EFD_CLOEXEC);
+        if( _pImpl->_stopFd < 0 )
+        {
+            std::ostringstream str;
+            str << "[ShardedUdpServer::ShardedUdpServer(eventfd)]: " << strerror(errno);
+            throw SocketException(errno, str.str());
+        }
+
+        // spread shards over the cores this process may run on, which may be
+        // fewer than the cores online (taskset, container cpusets)
+        std::vector<int> allowed;
+        cpu_set_t cpus;
+        CPU_ZERO(&cpus);
+        if( sched_getaffinity(0, sizeof(cpus), &cpus) == 0 )
+        {
+            for(int cpu = 0; cpu < CPU_SETSIZE; ++cpu)
+            {
+                if( CPU_ISSET(cpu, &cpus) )
+                {
+                    allowed.push_back(cpu);
+                }
+            }
+        }
+        if( allowed.empty() )
+        {
+            long nCpus = sysconf(_SC_NPROCESSORS_ONLN);
+            for(long cpu = 0; cpu < ((nCpus < 1) ? 1 : nCpus); ++cpu)
+            {
+                allowed.push_back((int)cpu);
+            }
+        }
+
+        _pImpl->_shards.resize(shards);
+        for(unsigned int i = 0; i < shards; ++i)
+        {
+            ShardedUdpServerP::Shard& shard = _pImpl->_shards[i];
+            shard.pOwner = _pImpl;
+            shard.index = i;
+            shard.cpu = allowed[i % allowed.size()];
+            shard.pSocket = NULL;
+            shard.threadStarted = false;
+            memset(&shard.stats, 0, sizeof(shard.stats));
+            shard.storage.resize(batchSize * maxDatagramSize);
+            shard.datagrams.resize(batchSize);
+            for(unsigned int j = 0; j < batchSize; ++j)
+            {
+                shard.datagrams[j].pData = &shard.storage[j * maxDatagramSize];
+                shard.datagrams[j].capacity = maxDatagramSize;
+                shard.datagrams[j].length = 0;
+            }
+
+            shard.pSocket = new UdpSocket;
+            shard.pSocket->allowPortSharing(true);
+            shard.pSocket->bind(port);
+
+            // reads never block, so a receiver can skip the poll after a full batch
+            // and still notice stop()
+            int fd = shard.pSocket->getFd();
+            if( fcntl(fd, F_SETFL, fcntl(fd, F_GETFL) | O_NONBLOCK) < 0 )
+            {
+                std::ostringstream str;
+                str << "[ShardedUdpServer::ShardedUdpServer(fcntl)]: " << strerror(errno);
+                throw SocketException(errno, str.str());
+            }
+        }
+    }
+    catch(...)
+    {
+        delete _pImpl;
+        throw;
+    }
+}
+
+//------------------------------------------------------------------------------
+ShardedUdpServer::~ShardedUdpServer() throw()
+//------------------------------------------------------------------------------
+{
+    stop();
+    delete _pImpl;
+}
+
+//------------------------------------------------------------------------------
+void ShardedUdpServer::setCpus(const std::vector<int>& cpus)
+//------------------------------------------------------------------------------
+{
+    for(unsigned int i = 0; (i < cpus.size()) && (i < _pImpl->_shards.size()); ++i)
+    {
+        _pImpl->_shards[i].cpu = cpus[i];
+    }
+}
+
+//------------------------------------------------------------------------------
+void ShardedUdpServer::setSteering(Steering mode)
+//------------------------------------------------------------------------------
+{
+    _pImpl->_steering = mode;
+}
+
+//------------------------------------------------------------------------------
+void ShardedUdpServer::start()
+//------------------------------------------------------------------------------
+{
+    if( _pImpl->_isRunning )
+    {
+        return;
+    }
+
+    _pImpl->applySteering();
+
+    _pImpl->_isRunning = true;
+    for(unsigned int i = 0; i < _pImpl->_shards.size(); ++i)
+    {
+        ShardedUdpServerP::Shard& shard = _pImpl->_shards[i];
+
+        // pin the thread as it is created, so a core it can't run on fails here
+        pthread_attr_t attr;
+        pthread_attr_init(&attr);
+        int ret = 0;
+        if( (shard.cpu >= 0) && (shard.cpu < CPU_SETSIZE) )
+        {
+            cpu_set_t cpus;
+            CPU_ZERO(&cpus);
+            CPU_SET(shard.cpu, &cpus);
+            ret = pthread_attr_setaffinity_np(&attr, sizeof(cpus), &cpus);
+        }
+        else if( shard.cpu >= CPU_SETSIZE )
+        {
+            ret = EINVAL;
+        }
+        if( ret != 0 )
+        {
+            pthread_attr_destroy(&attr);
+            stop();
+            std::ostringstream str;
+            str << "[ShardedUdpServer::start(pthread_attr_setaffinity_np)]: Shard " << i << ", core " << shard.cpu << ": " << strerror(ret);
+            throw SocketException(ret, str.str());
+        }
+
+        ret = pthread_create(&shard.thread, &attr, ShardedUdpServerP::receiver, &shard);
+        pthread_attr_destroy(&attr);
+        if( ret != 0 )
+        {
+            stop();
+            std::ostringstream str;
+            str << "[ShardedUdpServer::start(pthread_create)]: Shard " << i << ", core " << shard.cpu << ": " << strerror(ret);
+            throw SocketException(ret, str.str());
+        }
+        shard.threadStarted = true;
+    }
+}
+
+//------------------------------------------------------------------------------
+void ShardedUdpServer::stop() throw()
+//------------------------------------------------------------------------------
+{
+    if( !_pImpl->_isRunning )
+    {
+        return;
+    }
+
+    eventfd_write(_pImpl->_stopFd, 1);
+
+    for(unsigned int i = 0; i < _pImpl->_shards.size(); ++i)
+    {
+        ShardedUdpServerP::Shard& shard = _pImpl->_shards[i];
+        if( shard.threadStarted )
+        {
+            pthread_join(shard.thread, NULL);
+            shard.threadStarted = false;
+        }
+    }
+
+    // rearm for the next start()
+    eventfd_t val;
+    eventfd_read(_pImpl->_stopFd, &val);
+    _pImpl->_isRunning = false;
+}
+
+//------------------------------------------------------------------------------
+bool ShardedUdpServer::isRunning() const
+//------------------------------------------------------------------------------
+{
+    return _pImpl->_isRunning;
+}
+
+//------------------------------------------------------------------------------
+unsigned int ShardedUdpServer::shardCount() const
+//------------------------------------------------------------------------------
+{
+    return _pImpl->_shards.size();
+}
+
+//------------------------------------------------------------------------------
+UdpSocket& ShardedUdpServer::socket(unsigned int shard)
+//------------------------------------------------------------------------------
+{
+    return *_pImpl->_shards.at(shard).pSocket;
+}
+
+//------------------------------------------------------------------------------
+ShardedUdpServer::Statistics ShardedUdpServer::getStatistics(unsigned int shard) const
+//------------------------------------------------------------------------------
+{
+    const Statistics& s = _pImpl->_shards.at(shard).stats;
+    Statistics stats;
+    stats.datagrams = __atomic_load_n(&s.datagrams, __ATOMIC_RELAXED);
+    stats.batches = __atomic_load_n(&s.batches, __ATOMIC_RELAXED);
+    stats.errors = __atomic_load_n(&s.errors, __ATOMIC_RELAXED);
+    return stats;
+}
+
+} // grape
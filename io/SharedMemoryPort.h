@@ -0,0 +1,152 @@
+//==============================================================================
+// Project  : Grape
+// Module   : IO
+// File     : SharedMemoryPort.h
+// Brief    : Shared memory data port
+//
+// Copyright (c) 2012, Vilas Chitrakaran
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//    * Redistributions of source code must retain the above copyright
+//      notice, this list of conditions and the following disclaimer.
+//    * Redistributions in binary form must reproduce the above copyright
+//      notice, this list of conditions and the following disclaimer in the
+//      documentation and/or other materials provided with the distribution.
+//    * Neither the name of the copyright holder nor the names of its
+//      contributors may be used to endorse or promote products derived from
+//      this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR ITS CONTRIBUTORS
+// BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF
+// THE POSSIBILITY OF SUCH DAMAGE.
+//==============================================================================
+
+#ifndef GRAPEIO_SHAREDMEMORYPORT_H
+#define GRAPEIO_SHAREDMEMORYPORT_H
+
+#include "IDataPort.h"
+#include <string>
+
+namespace grape
+{
+
+/// \class SharedMemoryPort
+/// \ingroup io
+/// \brief Data port between two processes on the same host, over shared memory
+///
+/// The port is a pair of lock-free single-producer/single-consumer byte rings
+/// in a named shared memory region (shm_open/mmap), one for each direction.
+/// One process creates the region, the other opens it by name. Reads and
+/// writes copy directly to and from shared memory and make no system calls
+/// unless the other side is asleep waiting for data (or space), in which case
+/// it is woken with a futex.
+///
+/// Each direction must have exactly one reader and one writer thread.
+///
+/// Each side records its process id in the region, so that calls that block
+/// notice when the other side has closed the port or its process has died:
+/// waitForRead() and waitForWrite() with a non-zero timeout return PORT_ERROR,
+/// and readn() and write() throw, instead of waiting forever.
+/// \code
+/// // control process
+/// grape::SharedMemoryPort port;
+/// port.create("/grape_telemetry", 1<<20);
+/// port.write(sample, sizeof(sample));
+///
+/// // supervisor process
+/// grape::SharedMemoryPort port;
+/// port.open("/grape_telemetry");
+/// if( port.waitForRead(100) == grape::IDataPort::PORT_OK )
+///     port.readn(buffer, sizeof(buffer));
+/// \endcode
+///
+/// Like a stream socket, the port carries a byte stream; use MessageStream on top
+/// for message framing. The port has no file descriptor, so it cannot be used
+/// with IoReactor. Available on Linux only, not on Android, which lacks shm_open.
+class GRAPEIO_DLL_API SharedMemoryPort : public IDataPort
+{
+public:
+    /// Largest ring size accepted by create()
+    static const unsigned int MAX_CAPACITY = 0x40000000U;
+
+public:
+    SharedMemoryPort();
+    virtual ~SharedMemoryPort() throw(/*nothing*/);
+
+    /// Create the shared memory region. The region is removed when the
+    /// creating port is closed.
+    /// \param name     Name of the region (eg: "/grape_telemetry")
+    /// \param capacity Size of each ring in bytes. Rounded up to a power of 2.
+    ///                 At most MAX_CAPACITY.
+    /// \param replaceExisting If true, a region of the same name (eg: left by a
+    ///                 process that crashed) is removed first. If false, an existing
+    ///                 region is an error.
+    /// \throw IoOpenException if the region exists, or capacity is too large
+    void create(const std::string& name, unsigned int capacity, bool replaceExisting = false);
+
+    /// Attach to a region created by another port with create()
+    /// \param name     Name of the region
+    /// \throw IoOpenException if the region does not exist or is not initialised
+    void open(const std::string& name);
+
+    /// \return true if the port is created or opened
+    bool isOpen() const;
+
+    /// Set the number of times waitForRead() and waitForWrite() poll the ring
+    /// before sleeping. Spinning avoids wakeup latency at the cost of CPU time.
+    /// \param count Number of polls. 0 (default) sleeps immediately.
+    void setSpinCount(unsigned int count);
+
+    /// \return Size of each ring in bytes
+    unsigned int capacity() const;
+
+    // ------------- Reimplemented from IDataPort -------------------
+
+    void close() throw(/*nothing*/);
+
+    /// \copydoc IDataPort::readAll()
+    /// Does not block.
+    unsigned int readAll(std::vector<unsigned char>& buffer);
+
+    /// \copydoc IDataPort::readn()
+    /// Blocks until at least one byte is available, then reads whatever is
+    /// available up to the requested number of bytes. Throws IoReadException if
+    /// the ring is empty and the other side has gone.
+    unsigned int readn(std::vector<unsigned char>& buffer, unsigned int bytes);
+    unsigned int readn(unsigned char* pBuffer, unsigned int bytes);
+    unsigned int availableToRead();
+    Status waitForRead(int timeoutMs);
+    void flushRx();
+
+    /// \copydoc IDataPort::write()
+    /// Blocks until there is space for at least one byte, then writes as much
+    /// as fits. Throws IoWriteException if the ring is full and the other side
+    /// has gone.
+    unsigned int write(const std::vector<unsigned char>& buffer);
+    unsigned int write(const unsigned char* pBuffer, unsigned int bytes);
+
+    /// Wait until the reader has consumed all written data
+    /// \copydetails IDataPort::waitForWrite()
+    Status waitForWrite(int timeoutMs);
+    void flushTx() {} //!< does nothing
+
+private:
+    SharedMemoryPort(const SharedMemoryPort&);              //!< disable copy
+    SharedMemoryPort &operator=(const SharedMemoryPort&);   //!< disable assignment
+private:
+    class SharedMemoryPortP* _pImpl;                        //!< platform specific private implementation
+}; // SharedMemoryPort
+
+} // grape
+
+#endif // GRAPEIO_SHAREDMEMORYPORT_H
@@ -0,0 +1,622 @@
+//==============================================================================
+// Project  : Grape
+// Module   : IO
+// File     : SharedMemoryPort_unix.cpp
+//
+// Copyright (c) 2012, Vilas Chitrakaran
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//    * Redistributions of source code must retain the above copyright
+//      notice, this list of conditions and the following disclaimer.
+//    * Redistributions in binary form must reproduce the above copyright
+//      notice, this list of conditions and the following disclaimer in the
+//      documentation and/or other materials provided with the distribution.
+//    * Neither the name of the copyright holder nor the names of its
+//      contributors may be used to endorse or promote products derived from
+//      this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR ITS CONTRIBUTORS
+// BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF
+// THE POSSIBILITY OF SUCH DAMAGE.
+//==============================================================================
+
+#include "SharedMemoryPort.h"
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+#include <signal.h>
+#include <linux/futex.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <time.h>
+#include <errno.h>
+#include <string.h>
+#include <sstream>
+
+namespace grape
+{
+
+//==============================================================================
+/// \class SharedMemoryPortP
+/// \brief Linux specific private implementation
+//==============================================================================
+class SharedMemoryPortP
+{
+public:
+    static const unsigned int MAGIC = 0x47534d50; // "GSMP"
+    static const unsigned int CACHE_LINE = 64;
+    static const long long PEER_CHECK_NS = 100000000LL; //!< how often blocking waits check the peer
+
+    /// control block of one ring. Indices are free running; producer and
+    /// consumer fields are on separate cache lines
+    struct Ring
+    {
+        unsigned int head;          //!< write index. Written by producer only
+        char pad0[CACHE_LINE - sizeof(unsigned int)];
+        unsigned int tail;          //!< read index. Written by consumer only
+        char pad1[CACHE_LINE - sizeof(unsigned int)];
+        int dataSeq;                //!< futex. Bumped by producer to wake a waiting consumer
+        int readerWaiting;
+        char pad2[CACHE_LINE - 2 * sizeof(int)];
+        int spaceSeq;               //!< futex. Bumped by consumer to wake a waiting producer
+        int writerWaiting;
+        char pad3[CACHE_LINE - 2 * sizeof(int)];
+    };
+
+    /// layout of the start of the shared region. Ring data follows.
+    struct Header
+    {
+        unsigned int magic;         //!< set last by the creator
+        unsigned int capacity;
+        int pid[2];                 //!< process of [0] creator, [1] opener. 0 before attach, -1 after close
+        char pad[CACHE_LINE - 2 * sizeof(unsigned int) - 2 * sizeof(int)];
+        Ring rings[2];              //!< [0] creator to opener, [1] opener to creator
+    };
+
+public:
+    SharedMemoryPortP() : _pHeader(NULL), _mapSize(0), _pTx(NULL), _pRx(NULL), _pTxData(NULL), _pRxData(NULL),
+        _mask(0), _spinCount(0), _isCreator(false) {}
+    void map(int fd, size_t size);
+    void attach(unsigned int capacity, bool isCreator);
+    static size_t regionSize(unsigned int capacity) { return sizeof(Header) + 2 * (size_t)capacity; }
+    static std::string shmName(const std::string& name);
+    static long long nowNs();
+    static int futexWait(int* pAddr, int value, long long timeoutNs);
+    static void futexWake(int* pAddr);
+    IDataPort::Status waitFor(bool forSpace, unsigned int level, long long timeoutNs);
+    bool peerGone() const;
+    void detach();
+    unsigned int readable() const;
+    unsigned int writable() const;
+    void checkOpen(const char* location) const;
+public:
+    Header* _pHeader;
+    size_t _mapSize;
+    Ring* _pTx;
+    Ring* _pRx;
+    unsigned char* _pTxData;
+    unsigned char* _pRxData;
+    unsigned int _mask;
+    unsigned int _spinCount;
+    bool _isCreator;
+    std::string _name;
+}; // SharedMemoryPortP
+
+//------------------------------------------------------------------------------
+std::string SharedMemoryPortP::shmName(const std::string& name)
+//------------------------------------------------------------------------------
+{
+    return (!name.empty() && (name[0] == '/')) ? name : ("/" + name);
+}
+
+//------------------------------------------------------------------------------
+long long SharedMemoryPortP::nowNs()
+//------------------------------------------------------------------------------
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (long long)ts.tv_sec * 1000000000LL + ts.tv_nsec;
+}
+
+//------------------------------------------------------------------------------
+int SharedMemoryPortP::futexWait(int* pAddr, int value, long long timeoutNs)
+//------------------------------------------------------------------------------
+{
+    struct timespec ts;
+    struct timespec* pTs = NULL;
+    if( timeoutNs >= 0 )
+    {
+        ts.tv_sec = timeoutNs / 1000000000LL;
+        ts.tv_nsec = timeoutNs % 1000000000LL;
+        pTs = &ts;
+    }
+    // shared futex (not FUTEX_PRIVATE_FLAG): the word is in memory mapped by another process
+    return syscall(SYS_futex, pAddr, FUTEX_WAIT, value, pTs, NULL, 0);
+}
+
+//------------------------------------------------------------------------------
+void SharedMemoryPortP::futexWake(int* pAddr)
+//------------------------------------------------------------------------------
+{
+    syscall(SYS_futex, pAddr, FUTEX_WAKE, 1, NULL, NULL, 0);
+}
+
+//------------------------------------------------------------------------------
+unsigned int SharedMemoryPortP::readable() const
+//------------------------------------------------------------------------------
+{
+    unsigned int head = __atomic_load_n(&_pRx->head, __ATOMIC_ACQUIRE);
+    return head - _pRx->tail;
+}
+
+//------------------------------------------------------------------------------
+unsigned int SharedMemoryPortP::writable() const
+//------------------------------------------------------------------------------
+{
+    unsigned int tail = __atomic_load_n(&_pTx->tail, __ATOMIC_ACQUIRE);
+    return (_mask + 1) - (_pTx->head - tail);
+}
+
+//------------------------------------------------------------------------------
+bool SharedMemoryPortP::peerGone() const
+//------------------------------------------------------------------------------
+{
+    int pid = __atomic_load_n(&_pHeader->pid[_isCreator ? 1 : 0], __ATOMIC_ACQUIRE);
+    if( pid == 0 )
+    {
+        return false; // not attached yet
+    }
+    return (pid < 0) || ((kill(pid, 0) < 0) && (errno == ESRCH));
+}
+
+//------------------------------------------------------------------------------
+void SharedMemoryPortP::detach()
+//------------------------------------------------------------------------------
+{
+    // mark this side closed, and wake the peer if it waits on us
+    __atomic_store_n(&_pHeader->pid[_isCreator ? 0 : 1], -1, __ATOMIC_SEQ_CST);
+    __atomic_add_fetch(&_pTx->dataSeq, 1, __ATOMIC_SEQ_CST);
+    futexWake(&_pTx->dataSeq);
+    __atomic_add_fetch(&_pRx->spaceSeq, 1, __ATOMIC_SEQ_CST);
+    futexWake(&_pRx->spaceSeq);
+}
+
+//------------------------------------------------------------------------------
+void SharedMemoryPortP::checkOpen(const char* location) const
+//------------------------------------------------------------------------------
+{
+    if( _pHeader == NULL )
+    {
+        std::ostringstream str;
+        str << location << ": Port not open";
+        throw IoException(-1, str.str());
+    }
+}
+
+//------------------------------------------------------------------------------
+void SharedMemoryPortP::map(int fd, size_t size)
+//------------------------------------------------------------------------------
+{
+    void* p = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    if( p == MAP_FAILED )
+    {
+        std::ostringstream str;
+        str << "[SharedMemoryPort::map(mmap)]: " << strerror(errno);
+        throw IoOpenException(errno, str.str());
+    }
+
+    _pHeader = (Header*)p;
+    _mapSize = size;
+}
+
+//------------------------------------------------------------------------------
+void SharedMemoryPortP::attach(unsigned int capacity, bool isCreator)
+//------------------------------------------------------------------------------
+{
+    _isCreator = isCreator;
+    unsigned char* pData = (unsigned char*)_pHeader + sizeof(Header);
+    _mask = capacity - 1;
+    _pTx = &_pHeader->rings[isCreator ? 0 : 1];
+    _pRx = &_pHeader->rings[isCreator ? 1 : 0];
+    _pTxData = pData + (isCreator ? 0 : capacity);
+    _pRxData = pData + (isCreator ? capacity : 0);
+}
+
+//------------------------------------------------------------------------------
+IDataPort::Status SharedMemoryPortP::waitFor(bool forSpace, unsigned int level, long long timeoutNs)
+//------------------------------------------------------------------------------
+{
+    // forSpace: wait until tx ring has at most 'level' bytes queued
+    // otherwise: wait until rx ring has at least 'level' bytes
+    Ring* pRing = forSpace ? _pTx : _pRx;
+    int* pSeq = forSpace ? &pRing->spaceSeq : &pRing->dataSeq;
+    int* pWaiting = forSpace ? &pRing->writerWaiting : &pRing->readerWaiting;
+
+    for(unsigned int i = 0; i <= _spinCount; ++i)
+    {
+        if( forSpace ? ((_mask + 1 - writable()) <= level) : (readable() >= level) )
+        {
+            return IDataPort::PORT_OK;
+        }
+    }
+    if( timeoutNs == 0 )
+    {
+        return IDataPort::PORT_TIMEOUT;
+    }
+
+    long long deadline = (timeoutNs > 0) ? (nowNs() + timeoutNs) : 0;
+    while( true )
+    {
+        // announce, then re-check, so that the other side either sees the flag
+        // or we see its update
+        __atomic_store_n(pWaiting, 1, __ATOMIC_SEQ_CST);
+        int seq = __atomic_load_n(pSeq, __ATOMIC_SEQ_CST);
+        if( forSpace ? ((_mask + 1 - writable()) <= level) : (readable() >= level) )
+        {
+            __atomic_store_n(pWaiting, 0, __ATOMIC_RELAXED);
+            return IDataPort::PORT_OK;
+        }
+        if( peerGone() )
+        {
+            __atomic_store_n(pWaiting, 0, __ATOMIC_RELAXED);
+            return IDataPort::PORT_ERROR;
+        }
+
+        // a peer that closes wakes us, but one that dies doesn't. Sleep in
+        // slices to check on it
+        long long remaining = PEER_CHECK_NS;
+        if( timeoutNs > 0 )
+        {
+            remaining = deadline - nowNs();
+            if( remaining <= 0 )
+            {
+                __atomic_store_n(pWaiting, 0, __ATOMIC_RELAXED);
+                return IDataPort::PORT_TIMEOUT;
+            }
+            if( remaining > PEER_CHECK_NS )
+            {
+                remaining = PEER_CHECK_NS;
+            }
+        }
+
+        if( (futexWait(pSeq, seq, remaining) < 0) && (errno != EAGAIN) && (errno != EINTR) && (errno != ETIMEDOUT) )
+        {
+            __atomic_store_n(pWaiting, 0, __ATOMIC_RELAXED);
+            std::ostringstream str;
+            str << "[SharedMemoryPort::waitFor(futex)]: " << strerror(errno);
+            throw IoEventHandlingException(errno, str.str());
+        }
+    }
+}
+
+//==============================================================================
+SharedMemoryPort::SharedMemoryPort()
+//==============================================================================
+    : _pImpl(new SharedMemoryPortP)
+{
+}
+
+//------------------------------------------------------------------------------
+SharedMemoryPort::~SharedMemoryPort() throw()
+//------------------------------------------------------------------------------
+{
+    close();
+    delete _pImpl;
+}
+
+//------------------------------------------------------------------------------
+void SharedMemoryPort::create(const std::string& name, unsigned int capacity, bool replaceExisting)
+//------------------------------------------------------------------------------
+{
+    close();
+
+    if( capacity > MAX_CAPACITY )
+    {
+        throw IoOpenException(EINVAL, "[SharedMemoryPort::create]: Capacity larger than MAX_CAPACITY");
+    }
+    unsigned int size = 1;
+    while( size < capacity )
+    {
+        size <<= 1;
+    }
+
+    std::string shmName = SharedMemoryPortP::shmName(name);
+    int fd = shm_open(shmName.c_str(), O_RDWR | O_CREAT | O_EXCL, 0600);
+    if( (fd < 0) && (errno == EEXIST) && replaceExisting )
+    {
+        // stale region left by a previous run
+        shm_unlink(shmName.c_str());
+        fd = shm_open(shmName.c_str(), O_RDWR | O_CREAT | O_EXCL, 0600);
+    }
+    if( fd < 0 )
+    {
+        std::ostringstream str;
+        str << "[SharedMemoryPort::create(shm_open)]: " << strerror(errno);
+        throw IoOpenException(errno, str.str());
+    }
+
+    size_t mapSize = SharedMemoryPortP::regionSize(size);
+    if( ftruncate(fd, mapSize) < 0 )
+    {
+        int e = errno;
+        ::close(fd);
+        shm_unlink(shmName.c_str());
+        std::ostringstream str;
+        str << "[SharedMemoryPort::create(ftruncate)]: " << strerror(e);
+        throw IoOpenException(e, str.str());
+    }
+
+    try
+    {
+        _pImpl->map(fd, mapSize);
+    }
+    catch(...)
+    {
+        ::close(fd);
+        shm_unlink(shmName.c_str());
+        throw;
+    }
+    ::close(fd);
+    _pImpl->attach(size, true);
+    _pImpl->_name = shmName;
+
+    // ftruncate zero-fills the region, so only the header needs setting up
+    _pImpl->_pHeader->capacity = size;
+    _pImpl->_pHeader->pid[0] = getpid();
+    __atomic_store_n(&_pImpl->_pHeader->magic, SharedMemoryPortP::MAGIC, __ATOMIC_RELEASE);
+}
+
+//------------------------------------------------------------------------------
+void SharedMemoryPort::open(const std::string& name)
+//------------------------------------------------------------------------------
+{
+    close();
+
+    std::string shmName = SharedMemoryPortP::shmName(name);
+    int fd = shm_open(shmName.c_str(), O_RDWR, 0);
+    if( fd < 0 )
+    {
+        std::ostringstream str;
+        str << "[SharedMemoryPort::open(shm_open)]: " << strerror(errno);
+        throw IoOpenException(errno, str.str());
+    }
+
+    struct stat st;
+    if( (fstat(fd, &st) < 0) || ((size_t)st.st_size < sizeof(SharedMemoryPortP::Header)) )
+    {
+        ::close(fd);
+        throw IoOpenException(EAGAIN, "[SharedMemoryPort::open]: Region not initialised");
+    }
+
+    try
+    {
+        _pImpl->map(fd, st.st_size);
+    }
+    catch(...)
+    {
+        ::close(fd);
+        throw;
+    }
+    ::close(fd);
+
+    SharedMemoryPortP::Header* pHeader = _pImpl->_pHeader;
+    if( (__atomic_load_n(&pHeader->magic, __ATOMIC_ACQUIRE) != SharedMemoryPortP::MAGIC)
+            || (SharedMemoryPortP::regionSize(pHeader->capacity) != (size_t)st.st_size) )
+    {
+        close();
+        throw IoOpenException(EAGAIN, "[SharedMemoryPort::open]: Region not initialised");
+    }
+    _pImpl->attach(pHeader->capacity, false);
+    __atomic_store_n(&pHeader->pid[1], getpid(), __ATOMIC_RELEASE);
+}
+
+//------------------------------------------------------------------------------
+bool SharedMemoryPort::isOpen() const
+//------------------------------------------------------------------------------
+{
+    return (_pImpl->_pHeader != NULL);
+}
+
+//------------------------------------------------------------------------------
+void SharedMemoryPort::setSpinCount(unsigned int count)
+//------------------------------------------------------------------------------
+{
+    _pImpl->_spinCount = count;
+}
+
+//------------------------------------------------------------------------------
+unsigned int SharedMemoryPort::capacity() const
+//------------------------------------------------------------------------------
+{
+    return isOpen() ? (_pImpl->_mask + 1) : 0;
+}
+
+//------------------------------------------------------------------------------
+void SharedMemoryPort::close() throw()
+//------------------------------------------------------------------------------
+{
+    if( _pImpl->_pTx != NULL )
+    {
+        _pImpl->detach();
+        _pImpl->_pTx = NULL;
+        _pImpl->_pRx = NULL;
+    }
+    if( _pImpl->_pHeader != NULL )
+    {
+        munmap(_pImpl->_pHeader, _pImpl->_mapSize);
+        _pImpl->_pHeader = NULL;
+    }
+    if( _pImpl->_isCreator && !_pImpl->_name.empty() )
+    {
+        shm_unlink(_pImpl->_name.c_str());
+    }
+    _pImpl->_name.clear();
+    _pImpl->_isCreator = false;
+}
+
+//------------------------------------------------------------------------------
+unsigned int SharedMemoryPort::availableToRead()
+//------------------------------------------------------------------------------
+{
+    _pImpl->checkOpen("[SharedMemoryPort::availableToRead]");
+    return _pImpl->readable();
+}
+
+//------------------------------------------------------------------------------
+IDataPort::Status SharedMemoryPort::waitForRead(int timeoutMs)
+//------------------------------------------------------------------------------
+{
+    _pImpl->checkOpen("[SharedMemoryPort::waitForRead]");
+    long long timeoutNs = (timeoutMs < 0) ? -1 : (long long)timeoutMs * 1000000LL;
+    return _pImpl->waitFor(false, 1, timeoutNs);
+}
+
+//------------------------------------------------------------------------------
+IDataPort::Status SharedMemoryPort::waitForWrite(int timeoutMs)
+//------------------------------------------------------------------------------
+{
+    _pImpl->checkOpen("[SharedMemoryPort::waitForWrite]");
+    long long timeoutNs = (timeoutMs < 0) ? -1 : (long long)timeoutMs * 1000000LL;
+    return _pImpl->waitFor(true, 0, timeoutNs);
+}
+
+//------------------------------------------------------------------------------
+void SharedMemoryPort::flushRx()
+//------------------------------------------------------------------------------
+{
+    _pImpl->checkOpen("[SharedMemoryPort::flushRx]");
+    SharedMemoryPortP::Ring* pRing = _pImpl->_pRx;
+    __atomic_store_n(&pRing->tail, __atomic_load_n(&pRing->head, __ATOMIC_ACQUIRE), __ATOMIC_RELEASE);
+    __atomic_thread_fence(__ATOMIC_SEQ_CST);
+    if( __atomic_load_n(&pRing->writerWaiting, __ATOMIC_RELAXED) )
+    {
+        __atomic_add_fetch(&pRing->spaceSeq, 1, __ATOMIC_SEQ_CST);
+        SharedMemoryPortP::futexWake(&pRing->spaceSeq);
+    }
+}
+
+//------------------------------------------------------------------------------
+unsigned int SharedMemoryPort::readAll(std::vector<unsigned char>& buffer)
+//------------------------------------------------------------------------------
+{
+    unsigned int bytes = availableToRead();
+    if( bytes == 0 )
+    {
+        return 0;
+    }
+    return readn(buffer, bytes);
+}
+
+//------------------------------------------------------------------------------
+unsigned int SharedMemoryPort::readn(std::vector<unsigned char>& buffer, unsigned int bytes)
+//------------------------------------------------------------------------------
+{
+    if( bytes > buffer.size() )
+    {
+        buffer.resize(bytes);
+    }
+    return readn(buffer.empty() ? NULL : &buffer[0], bytes);
+}
+
+//------------------------------------------------------------------------------
+unsigned int SharedMemoryPort::readn(unsigned char* pBuffer, unsigned int bytes)
+//------------------------------------------------------------------------------
+{
+    _pImpl->checkOpen("[SharedMemoryPort::readn]");
+    if( bytes == 0 )
+    {
+        return 0;
+    }
+
+    SharedMemoryPortP::Ring* pRing = _pImpl->_pRx;
+    unsigned int avail = _pImpl->readable();
+    if( avail == 0 )
+    {
+        if( _pImpl->waitFor(false, 1, -1) != PORT_OK )
+        {
+            throw IoReadException(EPIPE, "[SharedMemoryPort::readn]: Peer has gone");
+        }
+        avail = _pImpl->readable();
+    }
+
+    unsigned int n = (avail < bytes) ? avail : bytes;
+    unsigned int tail = pRing->tail;
+    unsigned int offset = tail & _pImpl->_mask;
+    unsigned int first = _pImpl->_mask + 1 - offset;
+    if( first > n )
+    {
+        first = n;
+    }
+    memcpy(pBuffer, _pImpl->_pRxData + offset, first);
+    memcpy(pBuffer + first, _pImpl->_pRxData, n - first);
+
+    __atomic_store_n(&pRing->tail, tail + n, __ATOMIC_RELEASE);
+    __atomic_thread_fence(__ATOMIC_SEQ_CST);
+    if( __atomic_load_n(&pRing->writerWaiting, __ATOMIC_RELAXED) )
+    {
+        __atomic_add_fetch(&pRing->spaceSeq, 1, __ATOMIC_SEQ_CST);
+        SharedMemoryPortP::futexWake(&pRing->spaceSeq);
+    }
+    return n;
+}
+
+//------------------------------------------------------------------------------
+unsigned int SharedMemoryPort::write(const std::vector<unsigned char>& buffer)
+//------------------------------------------------------------------------------
+{
+    return write(buffer.empty() ? NULL : &buffer[0], buffer.size());
+}
+
+//------------------------------------------------------------------------------
+unsigned int SharedMemoryPort::write(const unsigned char* pBuffer, unsigned int bytes)
+//------------------------------------------------------------------------------
+{
+    _pImpl->checkOpen("[SharedMemoryPort::write]");
+    if( bytes == 0 )
+    {
+        return 0;
+    }
+
+    SharedMemoryPortP::Ring* pRing = _pImpl->_pTx;
+    unsigned int space = _pImpl->writable();
+    if( space == 0 )
+    {
+        if( _pImpl->waitFor(true, _pImpl->_mask, -1) != PORT_OK )
+        {
+            throw IoWriteException(EPIPE, "[SharedMemoryPort::write]: Peer has gone");
+        }
+        space = _pImpl->writable();
+    }
+
+    unsigned int n = (space < bytes) ? space : bytes;
+    unsigned int head = pRing->head;
+    unsigned int offset = head & _pImpl->_mask;
+    unsigned int first = _pImpl->_mask + 1 - offset;
+    if( first > n )
+    {
+        first = n;
+    }
+    memcpy(_pImpl->_pTxData + offset, pBuffer, first);
+    memcpy(_pImpl->_pTxData, pBuffer + first, n - first);
+
+    __atomic_store_n(&pRing->head, head + n, __ATOMIC_RELEASE);
+    __atomic_thread_fence(__ATOMIC_SEQ_CST);
+    if( __atomic_load_n(&pRing->readerWaiting, __ATOMIC_RELAXED) )
+    {
+        __atomic_add_fetch(&pRing->dataSeq, 1, __ATOMIC_SEQ_CST);
+        SharedMemoryPortP::futexWake(&pRing->dataSeq);
+    }
+    return n;
+}
+
+} // grape
@@ -0,0 +1,218 @@
+//==============================================================================
+// Project  : Grape
+// Module   : IO
+// File     : TcpSendQueue.cpp
+//
+// Copyright (c) 2012, Vilas Chitrakaran
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//    * Redistributions of source code must retain the above copyright
+//      notice, this list of conditions and the following disclaimer.
+//    * Redistributions in binary form must reproduce the above copyright
+//      notice, this list of conditions and the following disclaimer in the
+//      documentation and/or other materials provided with the distribution.
+//    * Neither the name of the copyright holder nor the names of its
+//      contributors may be used to endorse or promote products derived from
+//      this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR ITS CONTRIBUTORS
+// BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF
+// THE POSSIBILITY OF SUCH DAMAGE.
+//==============================================================================
+
+#include "TcpSendQueue.h"
+#include <string.h>
+#include <errno.h>
+
+namespace grape
+{
+
+//==============================================================================
+TcpSendQueue::TcpSendQueue(TcpSocket& socket, unsigned int capacity)
+//==============================================================================
+    : _socket(socket),
+      _pBuffer(NULL),
+      _capacity(1),
+      _mask(0),
+      _head(0),
+      _tail(0),
+      _highWaterMark(0),
+      _rejected(0),
+      _writeCalls(0),
+      _discarded(0)
+{
+    if( capacity > MAX_CAPACITY )
+    {
+        throw SocketException(EINVAL, "[TcpSendQueue::TcpSendQueue]: Capacity larger than MAX_CAPACITY");
+    }
+    while( _capacity < capacity )
+    {
+        _capacity <<= 1;
+    }
+    _mask = _capacity - 1;
+    _pBuffer = new unsigned char[_capacity];
+}
+
+//------------------------------------------------------------------------------
+TcpSendQueue::~TcpSendQueue() throw()
+//------------------------------------------------------------------------------
+{
+    delete [] _pBuffer;
+}
+
+//------------------------------------------------------------------------------
+bool TcpSendQueue::enqueue(const unsigned char* pData, unsigned int size)
+//------------------------------------------------------------------------------
+{
+    IDataPort::Buffer part = {pData, size};
+    return enqueue(&part, 1);
+}
+
+//------------------------------------------------------------------------------
+bool TcpSendQueue::enqueue(const IDataPort::Buffer* parts, unsigned int count)
+//------------------------------------------------------------------------------
+{
+    unsigned long long size = 0;
+    for(unsigned int i = 0; i < count; ++i)
+    {
+        size += parts[i].size;
+    }
+
+    unsigned long long head = __atomic_load_n(&_head, __ATOMIC_ACQUIRE);
+    unsigned long long tail = _tail;
+    unsigned long long used = tail - head;
+    if( used + size > _capacity )
+    {
+        __atomic_store_n(&_rejected, _rejected + 1, __ATOMIC_RELAXED);
+        return false;
+    }
+
+    for(unsigned int i = 0; i < count; ++i)
+    {
+        const unsigned char* pSrc = parts[i].pData;
+        unsigned int remaining = parts[i].size;
+        while( remaining > 0 )
+        {
+            unsigned int offset = (unsigned int)(tail & _mask);
+            unsigned int chunk = _capacity - offset; // contiguous space up to the end of the buffer
+            if( chunk > remaining )
+            {
+                chunk = remaining;
+            }
+            memcpy(_pBuffer + offset, pSrc, chunk);
+            pSrc += chunk;
+            remaining -= chunk;
+            tail += chunk;
+        }
+    }
+
+    __atomic_store_n(&_tail, tail, __ATOMIC_RELEASE);
+
+    used += size;
+    if( used > _highWaterMark )
+    {
+        __atomic_store_n(&_highWaterMark, (unsigned int)used, __ATOMIC_RELAXED);
+    }
+    return true;
+}
+
+//------------------------------------------------------------------------------
+unsigned int TcpSendQueue::flush()
+//------------------------------------------------------------------------------
+{
+    unsigned long long head = _head;
+    unsigned long long tail = __atomic_load_n(&_tail, __ATOMIC_ACQUIRE);
+    unsigned int nSent = 0;
+
+    while( head != tail )
+    {
+        // queued data occupies at most two contiguous regions of the buffer
+        IDataPort::Buffer regions[2];
+        unsigned int nRegions = 1;
+        unsigned int offset = (unsigned int)(head & _mask);
+        unsigned int used = (unsigned int)(tail - head);
+        regions[0].pData = _pBuffer + offset;
+        regions[0].size = used;
+        if( offset + used > _capacity )
+        {
+            regions[0].size = _capacity - offset;
+            regions[1].pData = _pBuffer;
+            regions[1].size = used - regions[0].size;
+            nRegions = 2;
+        }
+
+        unsigned int written = _socket.writevNoWait(regions, nRegions);
+        __atomic_store_n(&_writeCalls, _writeCalls + 1, __ATOMIC_RELAXED);
+        if( written == 0 )
+        {
+            break; // socket send buffer full
+        }
+
+        head += written;
+        nSent += written;
+        __atomic_store_n(&_head, head, __ATOMIC_RELEASE);
+
+        if( written < used )
+        {
+            break; // socket send buffer full
+        }
+        tail = __atomic_load_n(&_tail, __ATOMIC_ACQUIRE);
+    }
+
+    return nSent;
+}
+
+//------------------------------------------------------------------------------
+unsigned int TcpSendQueue::depth() const
+//------------------------------------------------------------------------------
+{
+    unsigned long long head = __atomic_load_n(&_head, __ATOMIC_ACQUIRE);
+    unsigned long long tail = __atomic_load_n(&_tail, __ATOMIC_ACQUIRE);
+    return (unsigned int)(tail - head);
+}
+
+//------------------------------------------------------------------------------
+TcpSendQueue::Statistics TcpSendQueue::getStatistics() const
+//------------------------------------------------------------------------------
+{
+    Statistics stats;
+    stats.bytesDiscarded = __atomic_load_n(&_discarded, __ATOMIC_ACQUIRE); // before head, see clear()
+    unsigned long long head = __atomic_load_n(&_head, __ATOMIC_ACQUIRE);
+    unsigned long long tail = __atomic_load_n(&_tail, __ATOMIC_ACQUIRE);
+    stats.depth = (unsigned int)(tail - head);
+    stats.highWaterMark = __atomic_load_n(&_highWaterMark, __ATOMIC_RELAXED);
+    stats.bytesQueued = tail;
+    stats.bytesSent = head - stats.bytesDiscarded;
+    stats.rejected = __atomic_load_n(&_rejected, __ATOMIC_RELAXED);
+    stats.writeCalls = __atomic_load_n(&_writeCalls, __ATOMIC_RELAXED);
+    return stats;
+}
+
+//------------------------------------------------------------------------------
+void TcpSendQueue::resetHighWaterMark()
+//------------------------------------------------------------------------------
+{
+    __atomic_store_n(&_highWaterMark, depth(), __ATOMIC_RELAXED);
+}
+
+//------------------------------------------------------------------------------
+void TcpSendQueue::clear()
+//------------------------------------------------------------------------------
+{
+    unsigned long long head = __atomic_load_n(&_head, __ATOMIC_ACQUIRE);
+    unsigned long long tail = __atomic_load_n(&_tail, __ATOMIC_ACQUIRE);
+    __atomic_store_n(&_head, tail, __ATOMIC_RELEASE);
+    __atomic_store_n(&_discarded, _discarded + (tail - head), __ATOMIC_RELEASE);
+}
+
+} // grape
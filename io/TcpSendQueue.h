@@ -0,0 +1,148 @@
+//==============================================================================
+// Project  : Grape
+// Module   : IO
+// File     : TcpSendQueue.h
+// Brief    : Coalescing non-blocking send queue for TCP sockets
+//
+// Copyright (c) 2012, Vilas Chitrakaran
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//    * Redistributions of source code must retain the above copyright
+//      notice, this list of conditions and the following disclaimer.
+//    * Redistributions in binary form must reproduce the above copyright
+//      notice, this list of conditions and the following disclaimer in the
+//      documentation and/or other materials provided with the distribution.
+//    * Neither the name of the copyright holder nor the names of its
+//      contributors may be used to endorse or promote products derived from
+//      this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR ITS CONTRIBUTORS
+// BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF
+// THE POSSIBILITY OF SUCH DAMAGE.
+//==============================================================================
+
+#ifndef GRAPEIO_TCPSENDQUEUE_H
+#define GRAPEIO_TCPSENDQUEUE_H
+
+#include "TcpSocket.h"
+
+namespace grape
+{
+
+/// \class TcpSendQueue
+/// \ingroup io
+/// \brief Buffered, non-blocking writer for a TcpSocket
+///
+/// TcpSocket::write() blocks when the socket send buffer is full, and may write
+/// only part of the data. TcpSendQueue decouples the sender from the connection:
+/// - enqueue() copies a message into a fixed size queue and never blocks. If the
+///   queue does not have room for the whole message, nothing is queued and the
+///   call returns false.
+/// - flush() writes as much of the queue as the socket accepts without blocking,
+///   coalescing all queued messages into a single gather write.
+/// - When flush() leaves data in the queue, wait for the socket to become writable
+///   (IpSocket::waitForWrite(), or WRITABLE events from IoReactor) and flush again.
+///
+/// enqueue() and flush() may be called from two different threads (one producer,
+/// one consumer) without locking. For example, the control thread enqueues
+/// telemetry while an IO thread flushes it to a slow supervisor connection:
+/// \code
+/// // control thread
+/// if( !queue.enqueue(sample, sizeof(sample)) ) { ++dropped; }
+///
+/// // IO thread
+/// while( running )
+/// {
+///     if( queue.isEmpty() ) { /* wait for data */ }
+///     queue.flush();
+///     if( !queue.isEmpty() ) { socket.waitForWrite(100); }
+/// }
+/// \endcode
+class GRAPEIO_DLL_API TcpSendQueue
+{
+public:
+
+    /// \brief Queue statistics
+    struct Statistics
+    {
+        unsigned int depth;                 //!< Bytes currently queued
+        unsigned int highWaterMark;         //!< Largest depth since construction or resetHighWaterMark()
+        unsigned long long bytesQueued;     //!< Total bytes accepted by enqueue()
+        unsigned long long bytesSent;       //!< Total bytes written to the socket
+        unsigned long long bytesDiscarded;  //!< Total bytes dropped by clear()
+        unsigned long long rejected;        //!< Number of messages rejected by enqueue() for lack of space
+        unsigned long long writeCalls;      //!< Number of write system calls made by flush()
+    };
+
+public:
+
+    static const unsigned int MAX_CAPACITY = 0x80000000U;    //!< Largest queue size (2 GiB)
+
+    /// Constructor
+    /// \param socket   Connected socket. Must outlive this object.
+    /// \param capacity Queue size in bytes. Rounded up to a power of 2.
+    /// \throw SocketException if capacity is larger than MAX_CAPACITY
+    TcpSendQueue(TcpSocket& socket, unsigned int capacity = 1024 * 1024);
+    ~TcpSendQueue() throw();
+
+    /// Queue a message. Never blocks. (Producer)
+    /// \return false if there is not enough space for the whole message.
+    bool enqueue(const unsigned char* pData, unsigned int size);
+
+    /// Queue a message made up of several parts, as if they were concatenated.
+    /// Either all parts are queued or none. (Producer)
+    /// \return false if there is not enough space for the whole message.
+    bool enqueue(const IDataPort::Buffer* parts, unsigned int count);
+
+    /// Write queued data to the socket without blocking. (Consumer)
+    /// \return Number of bytes written
+    /// \throw SocketException
+    unsigned int flush();
+
+    /// \return true if there is no data waiting to be sent
+    bool isEmpty() const { return depth() == 0; }
+
+    /// \return Number of bytes waiting to be sent
+    unsigned int depth() const;
+
+    /// \return Queue capacity in bytes
+    unsigned int capacity() const { return _capacity; }
+
+    /// \return Queue statistics
+    Statistics getStatistics() const;
+
+    /// Reset the high water mark to the current queue depth. (Producer)
+    void resetHighWaterMark();
+
+    /// Discard all queued data. Must not be called concurrently with enqueue() or flush().
+    void clear();
+
+private:
+    TcpSendQueue(const TcpSendQueue&);              //!< disable copy
+    TcpSendQueue &operator=(const TcpSendQueue&);   //!< disable assignment
+private:
+    TcpSocket&          _socket;
+    unsigned char*      _pBuffer;
+    unsigned int        _capacity;
+    unsigned int        _mask;
+    unsigned long long  _head;          //!< total bytes consumed. Written by consumer only
+    unsigned long long  _tail;          //!< total bytes produced. Written by producer only
+    unsigned int        _highWaterMark; //!< written by producer only
+    unsigned long long  _rejected;      //!< written by producer only
+    unsigned long long  _writeCalls;    //!< written by consumer only
+    unsigned long long  _discarded;     //!< bytes dropped by clear(). Included in _head
+}; // TcpSendQueue
+
+} // grape
+
+#endif // GRAPEIO_TCPSENDQUEUE_H
@@ -40,6 +40,7 @@
 #include <arpa/inet.h>
 #include <netdb.h>
 #include <unistd.h>
+#include "IoVecChunks.h"
 #endif
 
 #ifdef _MSC_VER
@@ -57,7 +58,7 @@ namespace grape
 //==========================================================================
 TcpSocket::TcpSocket()
 //==========================================================================
-    : IpSocket()
+    : IpSocket(), _pPool(NULL)
 {
     if( (int)(_sockFd = socket(AF_INET /*ipv4*/, SOCK_STREAM /*TCP*/, IPPROTO_TCP)) == INVALID_SOCKET)
     {
@@ -66,6 +67,14 @@ TcpSocket::TcpSocket()
 
 }
 
+//==========================================================================
+TcpSocket::TcpSocket(SOCKET fd)
+//==========================================================================
+    : IpSocket(), _pPool(NULL)
+{
+    _sockFd = fd;
+}
+
 //--------------------------------------------------------------------------
 TcpSocket::~TcpSocket() throw()
 //--------------------------------------------------------------------------
@@ -80,6 +89,28 @@ bool TcpSocket::connect(const std::string& remoteIp, int remotePort)
     return (::connect(_sockFd, (struct sockaddr*)(&peer), sizeof(struct sockaddr)) != SOCKET_ERROR );
 }
 
+//--------------------------------------------------------------------------
+bool TcpSocket::connect(const HostResolver::Address& address)
+//--------------------------------------------------------------------------
+{
+    struct sockaddr_storage local;
+    socklen_t len = sizeof(local);
+    if( getsockname(_sockFd, (struct sockaddr*)&local, &len) == SOCKET_ERROR )
+    {
+        throwSocketException("[TcpSocket::connect(getsockname)]");
+    }
+
+    if( local.ss_family != address.family() )
+    {
+        close();
+        if( (_sockFd = socket(address.family(), SOCK_STREAM, IPPROTO_TCP)) == INVALID_SOCKET )
+        {
+            throwSocketException("[TcpSocket::connect(socket)]");
+        }
+    }
+    return (::connect(_sockFd, address.get(), address.length) != SOCKET_ERROR );
+}
+
 //--------------------------------------------------------------------------
 void TcpSocket::listen(int backlog)
 //--------------------------------------------------------------------------
@@ -94,14 +125,147 @@ void TcpSocket::listen(int backlog)
 TcpSocket* TcpSocket::accept()
 //--------------------------------------------------------------------------
 {
-    TcpSocket* client = new TcpSocket;
     SOCKET fd = ::accept(_sockFd, NULL, NULL);
     if( fd == INVALID_SOCKET )
     {
         throwSocketException("[TcpSocket::accept]");
     }
-    client->setSockFd(fd);
-    return client;
+    return new TcpSocket(fd);
+}
+
+//--------------------------------------------------------------------------
+unsigned int TcpSocket::acceptMany(Pool& pool, std::vector<TcpSocket*>& accepted, unsigned int maxCount)
+//--------------------------------------------------------------------------
+{
+    unsigned int count = 0;
+    while( count < maxCount )
+    {
+#ifdef __linux__
+        SOCKET fd = ::accept4(_sockFd, NULL, NULL, SOCK_CLOEXEC);
+#else
+        SOCKET fd = ::accept(_sockFd, NULL, NULL);
+#endif
+        if( fd == INVALID_SOCKET )
+        {
+#ifdef _MSC_VER
+            int e = WSAGetLastError();
+            if( e == WSAEWOULDBLOCK )
+#else
+            int e = errno;
+            if( (e == EAGAIN) || (e == EWOULDBLOCK) )
+#endif
+            {
+                break; // drained
+            }
+#ifndef _MSC_VER
+            if( (e == ECONNABORTED) || (e == EINTR) )
+            {
+                continue; // connection reset while queued
+            }
+#endif
+            if( count > 0 )
+            {
+                break; // report the error on the next call
+            }
+            throwSocketException("[TcpSocket::acceptMany(accept)]");
+        }
+        TcpSocket* pSocket = pool.acquire(fd);
+        try
+        {
+            accepted.push_back(pSocket);
+        }
+        catch(...)
+        {
+            pool.release(pSocket);
+            throw;
+        }
+        ++count;
+    }
+    return count;
+}
+
+//==========================================================================
+TcpSocket::Pool::Pool(unsigned int preallocate)
+//==========================================================================
+{
+    _all.reserve(preallocate);
+    _idle.reserve(preallocate);
+    for(unsigned int i = 0; i < preallocate; ++i)
+    {
+        TcpSocket* pSocket = new TcpSocket(INVALID_SOCKET);
+        _all.push_back(pSocket);
+        _idle.push_back(pSocket);
+    }
+}
+
+//--------------------------------------------------------------------------
+TcpSocket::Pool::~Pool() throw()
+//--------------------------------------------------------------------------
+{
+    for(unsigned int i = 0; i < _all.size(); ++i)
+    {
+        delete _all[i];
+    }
+}
+
+//--------------------------------------------------------------------------
+TcpSocket* TcpSocket::Pool::acquire(SOCKET fd)
+//--------------------------------------------------------------------------
+{
+    TcpSocket* pSocket = NULL;
+    if( _idle.empty() )
+    {
+        try
+        {
+            pSocket = new TcpSocket(fd);
+        }
+        catch(...)
+        {
+            CLOSESOCKET(fd);
+            throw;
+        }
+
+        // from here, the socket owns the descriptor
+        try
+        {
+            _all.push_back(pSocket);
+            _idle.reserve(_all.size()); // so that release() never allocates
+        }
+        catch(...)
+        {
+            if( !_all.empty() && (_all.back() == pSocket) )
+            {
+                _all.pop_back();
+            }
+            delete pSocket;
+            throw;
+        }
+    }
+    else
+    {
+        pSocket = _idle.back();
+        _idle.pop_back();
+        pSocket->setSockFd(fd);
+    }
+    pSocket->_pPool = this;
+    return pSocket;
+}
+
+//--------------------------------------------------------------------------
+void TcpSocket::Pool::release(TcpSocket* pSocket)
+//--------------------------------------------------------------------------
+{
+    if( pSocket == NULL )
+    {
+        return;
+    }
+    if( pSocket->_pPool != this )
+    {
+        throw SocketException(EINVAL, "[TcpSocket::Pool::release]: Socket not in use from this pool");
+    }
+    pSocket->_pPool = NULL;
+    pSocket->close();
+    _idle.push_back(pSocket);
 }
 
 //--------------------------------------------------------------------------
@@ -119,7 +283,14 @@ void TcpSocket::setNoDelay(bool yes)
 unsigned int TcpSocket::write(const std::vector<unsigned char>& buffer)
 //--------------------------------------------------------------------------
 {
-    int len = ::send(_sockFd, (const char*)&buffer[0], buffer.size(), 0);
+    return write(buffer.empty() ? NULL : &buffer[0], buffer.size());
+}
+
+//--------------------------------------------------------------------------
+unsigned int TcpSocket::write(const unsigned char* pBuffer, unsigned int bytes)
+//--------------------------------------------------------------------------
+{
+    int len = ::send(_sockFd, (const char*)pBuffer, bytes, 0);
 
     if( len == SOCKET_ERROR )
     {
@@ -129,6 +300,74 @@ unsigned int TcpSocket::write(const std::vector<unsigned char>& buffer)
     return len;
 }
 
+//--------------------------------------------------------------------------
+unsigned int TcpSocket::writev(const Buffer* buffers, unsigned int count)
+//--------------------------------------------------------------------------
+{
+#ifdef _MSC_VER
+    return IDataPort::writev(buffers, count);
+#else
+    IoVecChunks chunks(buffers, count);
+    while( chunks.next() )
+    {
+        struct msghdr msg;
+        memset(&msg, 0, sizeof(msg));
+        msg.msg_iov = chunks.iov();
+        msg.msg_iovlen = chunks.size();
+
+        ssize_t len = ::sendmsg(_sockFd, &msg, 0);
+        if( len == SOCKET_ERROR )
+        {
+            throwSocketException("[TcpSocket::writev(sendmsg)]");
+        }
+        if( !chunks.advance(len) )
+        {
+            break; // partial write. caller continues with the rest
+        }
+    }
+
+    return chunks.total();
+#endif
+}
+
+//--------------------------------------------------------------------------
+unsigned int TcpSocket::writevNoWait(const Buffer* buffers, unsigned int count)
+//--------------------------------------------------------------------------
+{
+#ifdef _MSC_VER
+    if( waitForWrite(0) != IDataPort::PORT_OK )
+    {
+        return 0;
+    }
+    return IDataPort::writev(buffers, count);
+#else
+    IoVecChunks chunks(buffers, count);
+    while( chunks.next() )
+    {
+        struct msghdr msg;
+        memset(&msg, 0, sizeof(msg));
+        msg.msg_iov = chunks.iov();
+        msg.msg_iovlen = chunks.size();
+
+        ssize_t len = ::sendmsg(_sockFd, &msg, MSG_DONTWAIT | MSG_NOSIGNAL);
+        if( len == SOCKET_ERROR )
+        {
+            if( (errno == EAGAIN) || (errno == EWOULDBLOCK) )
+            {
+                break;
+            }
+            throwSocketException("[TcpSocket::writevNoWait(sendmsg)]");
+        }
+        if( !chunks.advance(len) )
+        {
+            break;
+        }
+    }
+
+    return chunks.total();
+#endif
+}
+
 //--------------------------------------------------------------------------
 unsigned int TcpSocket::readn(std::vector<unsigned char>& buffer, unsigned int bytesToRead)
 //--------------------------------------------------------------------------
@@ -138,7 +377,14 @@ unsigned int TcpSocket::readn(std::vector<unsigned char>& buffer, unsigned int b
         buffer.resize(bytesToRead);
     }
 
-    int len = ::recv(_sockFd, (char*)(&buffer[0]), bytesToRead, 0/*MSG_WAITALL*/);
+    return readn(buffer.empty() ? NULL : &buffer[0], bytesToRead);
+}
+
+//--------------------------------------------------------------------------
+unsigned int TcpSocket::readn(unsigned char* pBuffer, unsigned int bytesToRead)
+//--------------------------------------------------------------------------
+{
+    int len = ::recv(_sockFd, (char*)pBuffer, bytesToRead, 0/*MSG_WAITALL*/);
     if( len == SOCKET_ERROR )
     {
         throwSocketException("[TcpSocket::receive(recv)]");
@@ -35,6 +35,8 @@
 #define GRAPE_TCPSOCKET_H
 
 #include "IpSocket.h"
+#include "HostResolver.h"
+#include <vector>
 
 namespace grape
 {
@@ -51,11 +53,58 @@ namespace grape
 /// \include TcpClientExample.cpp
 class GRAPEIO_DLL_API TcpSocket : public IpSocket
 {
+public:
+
+    /// \brief A pool of reusable connection objects, for acceptMany()
+    ///
+    /// The pool owns the sockets it hands out. Return them with release()
+    /// instead of deleting them; released sockets are closed and reused for later
+    /// connections, so accepting does not allocate once the pool has warmed up.
+    /// Sockets still in use are deleted along with the pool.
+    /// Not thread-safe.
+    class GRAPEIO_DLL_API Pool
+    {
+    public:
+        /// \param preallocate Number of connection objects to create up front
+        explicit Pool(unsigned int preallocate = 0);
+        ~Pool() throw(/*nothing*/);
+
+        /// Wrap an open connection descriptor in a pooled socket
+        /// \param fd Connected socket descriptor. Ownership passes to the returned socket;
+        ///           if acquire() throws, the descriptor is closed
+        /// \return Socket for the connection
+        TcpSocket* acquire(SOCKET fd);
+
+        /// Close a socket obtained from this pool and return it to the pool
+        /// \param pSocket Socket handed out by this pool. NULL is ignored.
+        /// \throw SocketException if the socket is not in use from this pool,
+        ///        eg: it was already released, or came from another pool
+        void release(TcpSocket* pSocket);
+
+        /// \return Number of sockets available for reuse
+        unsigned int idle() const { return _idle.size(); }
+
+        /// \return Number of sockets handed out and not yet released
+        unsigned int inUse() const { return _all.size() - _idle.size(); }
+
+    private:
+        Pool(const Pool&);              //!< disable copy
+        Pool &operator=(const Pool&);   //!< disable assignment
+    private:
+        std::vector<TcpSocket*> _all;
+        std::vector<TcpSocket*> _idle;
+    }; // Pool
+
 public:
 
     TcpSocket();
     virtual ~TcpSocket() throw(/*nothing*/);
 
+    /// Take ownership of an open TCP socket descriptor, such as one returned by
+    /// the accept() system call.
+    /// \param fd Socket descriptor. INVALID_SOCKET creates a closed socket object.
+    explicit TcpSocket(SOCKET fd);
+
     /// Enable TCP_NODELAY socket option (disable Nagle algorithm)
     /// \throw SocketException
     void setNoDelay(bool option);
@@ -67,6 +116,16 @@ public:
     /// \return true if connection was established successfully
     bool connect(const std::string& remoteIp,int remotePort);
 
+    /// Establish connection with a remote peer at a resolved address. Use with
+    /// HostResolver::tryResolve() to reconnect without blocking on name lookup.
+    /// If the address is IPv6 (or the socket was reopened as IPv6 and the address
+    /// is IPv4), the socket is first reopened in the matching address family;
+    /// socket options set before the call are then lost.
+    /// \param address Remote address
+    /// \return true if connection was established successfully
+    /// \throw SocketException if the socket cannot be reopened
+    bool connect(const HostResolver::Address& address);
+
     /// Place socket in a passive state listening for incoming connections.
     /// Note that this will work only with connection-based protocols such as TCP.
     /// Call bind first.
@@ -88,9 +147,35 @@ public:
     /// \see bind, listen
     TcpSocket* accept();
 
+    /// Accept all pending connections, up to a limit, without blocking. Use this
+    /// to drain a burst of incoming connections in one go, eg: when IoReactor
+    /// reports the listening socket readable. The listening socket must be in
+    /// non-blocking mode (see setNonBlocking()). The accepted connections are
+    /// in blocking mode.
+    /// \param pool     Pool providing the connection objects. Release each
+    ///                 connection back to this pool when done with it.
+    /// \param accepted Accepted connections are appended here
+    /// \param maxCount Maximum number of connections to accept
+    /// \return Number of connections accepted. 0 if none were pending.
+    /// \see bind, listen, Pool
+    unsigned int acceptMany(Pool& pool, std::vector<TcpSocket*>& accepted, unsigned int maxCount = 64);
+
     unsigned int readn(std::vector<unsigned char>& buffer, unsigned int bytes);
+    unsigned int readn(unsigned char* pBuffer, unsigned int bytes);
     unsigned int write(const std::vector<unsigned char>& buffer);
+    unsigned int write(const unsigned char* pBuffer, unsigned int bytes);
+    unsigned int writev(const Buffer* buffers, unsigned int count);
+
+    /// Gather write that never blocks. Writes as much data as the socket send buffer
+    /// can accept right now.
+    /// \param buffers  Array of buffers
+    /// \param count    Number of buffers in the array
+    /// \return Number of bytes written. 0 if the send buffer is full.
+    /// \throw SocketException
+    unsigned int writevNoWait(const Buffer* buffers, unsigned int count);
 
+private:
+    Pool* _pPool; //!< pool that handed this socket out. NULL if not from a pool, or idle
 }; // TcpSocket
 
 } // grape
@@ -42,7 +42,19 @@ namespace grape
 /// \brief UDP server
 /// \ingroup io
 ///
-/// This is nothing more than a UDP socket that binds to a port
+/// This is nothing more than a UDP socket that binds to a port, and optionally
+/// subscribes to a multicast group. A publisher sends to all subscribers of a
+/// group with a single write:
+/// \code
+/// // publisher
+/// grape::UdpSocket publisher;
+/// publisher.setMulticastTtl(1);
+/// publisher.writeTo(groupAddress, message); // groupAddress: 239.255.0.1:port
+///
+/// // each subscriber
+/// grape::UdpServer subscriber(port, "239.255.0.1");
+/// subscriber.readFrom(buffer, source);
+/// \endcode
 class GRAPEIO_DLL_API UdpServer : public UdpSocket
 {
 public:
@@ -51,6 +63,18 @@ public:
         allowPortReuse(true);
         bind(port);
     }
+
+    /// Bind to a port and join a multicast group
+    /// \param port         Port the group publishes on
+    /// \param groupIp      Multicast group address
+    /// \param interfaceIp  Local interface to join on. Leave empty to let the system choose.
+    /// \throw SocketException
+    UdpServer(unsigned int port, const std::string& groupIp, const std::string& interfaceIp = "") : UdpSocket()
+    {
+        allowPortReuse(true);
+        bind(port);
+        joinMulticastGroup(groupIp, interfaceIp);
+    }
     ~UdpServer() throw() {}
 };// UdpServer
 
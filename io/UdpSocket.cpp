@@ -40,6 +40,30 @@
 #include <arpa/inet.h>
 #include <netdb.h>
 #include <unistd.h>
+#include <sys/uio.h>
+#endif
+
+#ifdef __linux__
+#include <linux/net_tstamp.h>
+#include <linux/errqueue.h>
+#include <time.h>
+#include <netinet/udp.h>
+#ifndef UDP_SEGMENT
+#define UDP_SEGMENT 103
+#endif
+#ifndef UDP_GRO
+#define UDP_GRO 104
+#endif
+#ifndef SO_BUSY_POLL
+#define SO_BUSY_POLL 46
+#endif
+#ifndef SO_PREFER_BUSY_POLL
+#define SO_PREFER_BUSY_POLL 69
+#endif
+#ifndef SO_TXTIME
+#define SO_TXTIME 61
+#define SCM_TXTIME SO_TXTIME
+#endif
 #endif
 
 #ifdef _MSC_VER
@@ -54,10 +78,16 @@
 namespace grape
 {
 
+#ifdef __linux__
+static const unsigned int MAX_BATCH = 64; // datagrams per recvmmsg/sendmmsg call
+#endif
+
 //==========================================================================
 UdpSocket::UdpSocket()
 //==========================================================================
+    : _spinBudgetNs(0)
 {
+    resetBusyPollStatistics();
     if( (int)(_sockFd = socket(AF_INET /*ipv4*/, SOCK_DGRAM /*UDP*/, IPPROTO_UDP)) == INVALID_SOCKET)
     {
         throwSocketException("[UdpSocket::UdpSocket](socket)");
@@ -82,7 +112,14 @@ bool UdpSocket::setRemotePeer(struct sockaddr_in &peer)
 unsigned int UdpSocket::writeTo(struct sockaddr_in &destAddr, const std::vector<unsigned char>& buffer)
 //--------------------------------------------------------------------------
 {
-    int len = sendto(_sockFd, (const char*)&buffer[0], buffer.size(), 0, (struct sockaddr *)&destAddr, sizeof(struct sockaddr_in));
+    return writeTo(destAddr, buffer.empty() ? NULL : &buffer[0], buffer.size());
+}
+
+//--------------------------------------------------------------------------
+unsigned int UdpSocket::writeTo(struct sockaddr_in &destAddr, const unsigned char* pBuffer, unsigned int bytes)
+//--------------------------------------------------------------------------
+{
+    int len = sendto(_sockFd, (const char*)pBuffer, bytes, 0, (struct sockaddr *)&destAddr, sizeof(struct sockaddr_in));
     if( len == SOCKET_ERROR )
     {
         throwSocketException("[UdpSocket::writeTo(sendto)]");
@@ -94,10 +131,17 @@ unsigned int UdpSocket::writeTo(struct sockaddr_in &destAddr, const std::vector<
 //--------------------------------------------------------------------------
 unsigned int UdpSocket::readFrom(std::vector<unsigned char>& buffer, struct sockaddr_in &srcAddr)
 //--------------------------------------------------------------------------
+{
+    return readFrom(buffer.empty() ? NULL : &buffer[0], buffer.size(), srcAddr);
+}
+
+//--------------------------------------------------------------------------
+unsigned int UdpSocket::readFrom(unsigned char* pBuffer, unsigned int bytes, struct sockaddr_in &srcAddr)
+//--------------------------------------------------------------------------
 {
     int srcAddrLen = sizeof(struct sockaddr);
 
-    int len = ::recvfrom(_sockFd, (char*)(&buffer[0]), buffer.size(), 0/*MSG_WAITALL*/, (struct sockaddr *) &(srcAddr), (socklen_t *)&srcAddrLen);
+    int len = ::recvfrom(_sockFd, (char*)pBuffer, bytes, 0/*MSG_WAITALL*/, (struct sockaddr *) &(srcAddr), (socklen_t *)&srcAddrLen);
     if( len == SOCKET_ERROR )
     {
         throwSocketException("[UdpSocket::readFrom(receivefrom)]");
@@ -106,11 +150,560 @@ unsigned int UdpSocket::readFrom(std::vector<unsigned char>& buffer, struct sock
     return len;
 }
 
+#ifdef __linux__
+//--------------------------------------------------------------------------
+static long long toNs(const struct timespec& t)
+//--------------------------------------------------------------------------
+{
+    return (long long)t.tv_sec * 1000000000LL + t.tv_nsec;
+}
+
+//--------------------------------------------------------------------------
+static void parseTimestamp(struct msghdr& msg, UdpSocket::Timestamp& ts)
+//--------------------------------------------------------------------------
+{
+    for(struct cmsghdr* cm = CMSG_FIRSTHDR(&msg); cm != NULL; cm = CMSG_NXTHDR(&msg, cm))
+    {
+        if( cm->cmsg_level != SOL_SOCKET )
+        {
+            continue;
+        }
+        if( cm->cmsg_type == SCM_TIMESTAMPING )
+        {
+            // [0] software, [1] deprecated, [2] raw hardware
+            struct timespec t[3];
+            memcpy(t, CMSG_DATA(cm), sizeof(t));
+            ts.softwareNs = toNs(t[0]);
+            ts.hardwareNs = toNs(t[2]);
+        }
+        else if( cm->cmsg_type == SCM_TIMESTAMPNS )
+        {
+            struct timespec t;
+            memcpy(&t, CMSG_DATA(cm), sizeof(t));
+            ts.softwareNs = toNs(t);
+        }
+    }
+}
+#endif
+
+//--------------------------------------------------------------------------
+unsigned int UdpSocket::writeSegmented(struct sockaddr_in &destAddr, const unsigned char* pBuffer, unsigned int bytes, unsigned int segmentSize)
+//--------------------------------------------------------------------------
+{
+    if( segmentSize == 0 )
+    {
+        throw SocketException(EINVAL, "[UdpSocket::writeSegmented]: Segment size is 0");
+    }
+
+#ifdef __linux__
+    // limits on one offloaded send: total payload of an IP datagram, and segment count
+    static const unsigned int MAX_PAYLOAD = 65507;
+    static const unsigned int MAX_SEGMENTS = 64;
+    unsigned int segmentsPerSend = MAX_PAYLOAD / segmentSize;
+    if( segmentsPerSend > MAX_SEGMENTS )
+    {
+        segmentsPerSend = MAX_SEGMENTS;
+    }
+    if( segmentsPerSend == 0 )
+    {
+        throw SocketException(EMSGSIZE, "[UdpSocket::writeSegmented]: Segment size too large");
+    }
+    const unsigned int maxSend = segmentsPerSend * segmentSize;
+
+    union
+    {
+        struct cmsghdr align;
+        char buf[CMSG_SPACE(sizeof(uint16_t))];
+    } control;
+
+    unsigned int sent = 0;
+    while( sent < bytes )
+    {
+        unsigned int n = bytes - sent;
+        if( n > maxSend )
+        {
+            n = maxSend;
+        }
+
+        struct iovec iov;
+        iov.iov_base = (void*)(pBuffer + sent);
+        iov.iov_len = n;
+
+        struct msghdr msg;
+        memset(&msg, 0, sizeof(msg));
+        msg.msg_name = &destAddr;
+        msg.msg_namelen = sizeof(struct sockaddr_in);
+        msg.msg_iov = &iov;
+        msg.msg_iovlen = 1;
+
+        // a single datagram needs no segmentation
+        if( n > segmentSize )
+        {
+            msg.msg_control = control.buf;
+            msg.msg_controllen = sizeof(control.buf);
+            struct cmsghdr* cm = CMSG_FIRSTHDR(&msg);
+            cm->cmsg_level = SOL_UDP;
+            cm->cmsg_type = UDP_SEGMENT;
+            cm->cmsg_len = CMSG_LEN(sizeof(uint16_t));
+            uint16_t gso = segmentSize;
+            memcpy(CMSG_DATA(cm), &gso, sizeof(gso));
+        }
+
+        ssize_t len = ::sendmsg(_sockFd, &msg, 0);
+        if( len == SOCKET_ERROR )
+        {
+            throwSocketException("[UdpSocket::writeSegmented(sendmsg)]");
+        }
+        sent += len;
+    }
+    return sent;
+#else
+    unsigned int sent = 0;
+    while( sent < bytes )
+    {
+        unsigned int n = bytes - sent;
+        if( n > segmentSize )
+        {
+            n = segmentSize;
+        }
+        sent += writeTo(destAddr, pBuffer + sent, n);
+    }
+    return sent;
+#endif
+}
+
+//--------------------------------------------------------------------------
+void UdpSocket::enableReceiveOffload(bool yes)
+//--------------------------------------------------------------------------
+{
+#ifdef __linux__
+    int val = (yes?1:0);
+    if( setsockopt(_sockFd, SOL_UDP, UDP_GRO, &val, sizeof(val)) == SOCKET_ERROR )
+    {
+        throwSocketException("[UdpSocket::enableReceiveOffload(UDP_GRO)]");
+    }
+#else
+    if( yes )
+    {
+        throw SocketException(ENOSYS, "[UdpSocket::enableReceiveOffload]: Not supported on this platform");
+    }
+#endif
+}
+
+//--------------------------------------------------------------------------
+unsigned int UdpSocket::readCoalesced(unsigned char* pBuffer, unsigned int bytes, struct sockaddr_in &srcAddr, unsigned int& segmentSize)
+//--------------------------------------------------------------------------
+{
+#ifdef __linux__
+    struct iovec iov;
+    iov.iov_base = pBuffer;
+    iov.iov_len = bytes;
+
+    union
+    {
+        struct cmsghdr align;
+        char buf[CMSG_SPACE(sizeof(int))];
+    } control;
+
+    struct msghdr msg;
+    memset(&msg, 0, sizeof(msg));
+    msg.msg_name = &srcAddr;
+    msg.msg_namelen = sizeof(struct sockaddr_in);
+    msg.msg_iov = &iov;
+    msg.msg_iovlen = 1;
+    msg.msg_control = control.buf;
+    msg.msg_controllen = sizeof(control.buf);
+
+    ssize_t len = ::recvmsg(_sockFd, &msg, 0);
+    if( len == SOCKET_ERROR )
+    {
+        throwSocketException("[UdpSocket::readCoalesced(recvmsg)]");
+    }
+
+    segmentSize = len; // not coalesced
+    for(struct cmsghdr* cm = CMSG_FIRSTHDR(&msg); cm != NULL; cm = CMSG_NXTHDR(&msg, cm))
+    {
+        if( (cm->cmsg_level == SOL_UDP) && (cm->cmsg_type == UDP_GRO) )
+        {
+            int gso = 0;
+            memcpy(&gso, CMSG_DATA(cm), sizeof(gso));
+            segmentSize = gso;
+        }
+    }
+    return len;
+#else
+    unsigned int len = readFrom(pBuffer, bytes, srcAddr);
+    segmentSize = len;
+    return len;
+#endif
+}
+
+//--------------------------------------------------------------------------
+void UdpSocket::setBusyPoll(unsigned int spinBudgetUs, unsigned int kernelBusyPollUs, bool preferBusyPoll)
+//--------------------------------------------------------------------------
+{
+#ifdef __linux__
+    if( kernelBusyPollUs > 0 )
+    {
+        int val = kernelBusyPollUs;
+        if( setsockopt(_sockFd, SOL_SOCKET, SO_BUSY_POLL, &val, sizeof(val)) == SOCKET_ERROR )
+        {
+            throwSocketException("[UdpSocket::setBusyPoll(SO_BUSY_POLL)]");
+        }
+    }
+    if( preferBusyPoll )
+    {
+        int val = 1;
+        if( setsockopt(_sockFd, SOL_SOCKET, SO_PREFER_BUSY_POLL, &val, sizeof(val)) == SOCKET_ERROR )
+        {
+            throwSocketException("[UdpSocket::setBusyPoll(SO_PREFER_BUSY_POLL)]");
+        }
+    }
+    _spinBudgetNs = (long long)spinBudgetUs * 1000LL;
+    resetBusyPollStatistics();
+#else
+    if( spinBudgetUs || kernelBusyPollUs || preferBusyPoll )
+    {
+        throw SocketException(ENOSYS, "[UdpSocket::setBusyPoll]: Not supported on this platform");
+    }
+#endif
+}
+
+//--------------------------------------------------------------------------
+void UdpSocket::resetBusyPollStatistics()
+//--------------------------------------------------------------------------
+{
+    _busyPollStats.spinHits = 0;
+    _busyPollStats.blockingHits = 0;
+    _busyPollStats.timeouts = 0;
+}
+
+//--------------------------------------------------------------------------
+IDataPort::Status UdpSocket::waitForRead(int timeoutMs)
+//--------------------------------------------------------------------------
+{
+#ifdef __linux__
+    if( _spinBudgetNs > 0 )
+    {
+        struct timespec ts;
+        clock_gettime(CLOCK_MONOTONIC, &ts);
+        const long long start = (long long)ts.tv_sec * 1000000000LL + ts.tv_nsec;
+        long long budget = _spinBudgetNs;
+        if( (timeoutMs >= 0) && ((long long)timeoutMs * 1000000LL < budget) )
+        {
+            budget = (long long)timeoutMs * 1000000LL;
+        }
+
+        long long elapsed = 0;
+        do
+        {
+            char c;
+            if( ::recv(_sockFd, &c, 1, MSG_PEEK | MSG_DONTWAIT | MSG_TRUNC) >= 0 )
+            {
+                ++_busyPollStats.spinHits;
+                return IDataPort::PORT_OK;
+            }
+            if( (errno != EAGAIN) && (errno != EWOULDBLOCK) )
+            {
+                return IDataPort::PORT_ERROR;
+            }
+            clock_gettime(CLOCK_MONOTONIC, &ts);
+            elapsed = (long long)ts.tv_sec * 1000000000LL + ts.tv_nsec - start;
+        } while( elapsed < budget );
+
+        int remainingMs = -1;
+        if( timeoutMs >= 0 )
+        {
+            remainingMs = timeoutMs - (int)(elapsed / 1000000LL);
+            if( remainingMs < 0 )
+            {
+                remainingMs = 0;
+            }
+        }
+
+        IDataPort::Status st = IpSocket::waitForRead(remainingMs);
+        if( st == IDataPort::PORT_OK )
+        {
+            ++_busyPollStats.blockingHits;
+        }
+        else if( st == IDataPort::PORT_TIMEOUT )
+        {
+            ++_busyPollStats.timeouts;
+        }
+        return st;
+    }
+#endif
+    return IpSocket::waitForRead(timeoutMs);
+}
+
+//--------------------------------------------------------------------------
+void UdpSocket::enableTimestamping(unsigned int flags)
+//--------------------------------------------------------------------------
+{
+#ifdef __linux__
+    int val = 0;
+    if( flags & TIMESTAMP_RX_SOFTWARE )
+    {
+        val |= SOF_TIMESTAMPING_RX_SOFTWARE | SOF_TIMESTAMPING_SOFTWARE;
+    }
+    if( flags & TIMESTAMP_RX_HARDWARE )
+    {
+        val |= SOF_TIMESTAMPING_RX_HARDWARE | SOF_TIMESTAMPING_RAW_HARDWARE;
+    }
+    if( flags & TIMESTAMP_TX_SOFTWARE )
+    {
+        val |= SOF_TIMESTAMPING_TX_SOFTWARE | SOF_TIMESTAMPING_SOFTWARE;
+    }
+    if( flags & TIMESTAMP_TX_HARDWARE )
+    {
+        val |= SOF_TIMESTAMPING_TX_HARDWARE | SOF_TIMESTAMPING_RAW_HARDWARE;
+    }
+    if( flags & (TIMESTAMP_TX_SOFTWARE | TIMESTAMP_TX_HARDWARE) )
+    {
+        // number the datagrams, and don't loop the payload back with the timestamp
+        val |= SOF_TIMESTAMPING_OPT_ID | SOF_TIMESTAMPING_OPT_TSONLY;
+    }
+    if( setsockopt(_sockFd, SOL_SOCKET, SO_TIMESTAMPING, &val, sizeof(val)) == SOCKET_ERROR )
+    {
+        throwSocketException("[UdpSocket::enableTimestamping(SO_TIMESTAMPING)]");
+    }
+#else
+    if( flags != 0 )
+    {
+        throw SocketException(ENOSYS, "[UdpSocket::enableTimestamping]: Not supported on this platform");
+    }
+#endif
+}
+
+//--------------------------------------------------------------------------
+unsigned int UdpSocket::readFrom(unsigned char* pBuffer, unsigned int bytes, struct sockaddr_in &srcAddr, Timestamp& ts)
+//--------------------------------------------------------------------------
+{
+    ts.softwareNs = 0;
+    ts.hardwareNs = 0;
+#ifdef __linux__
+    struct iovec iov;
+    iov.iov_base = pBuffer;
+    iov.iov_len = bytes;
+
+    union
+    {
+        struct cmsghdr align;
+        char buf[CMSG_SPACE(3 * sizeof(struct timespec))];
+    } control;
+
+    struct msghdr msg;
+    memset(&msg, 0, sizeof(msg));
+    msg.msg_name = &srcAddr;
+    msg.msg_namelen = sizeof(struct sockaddr_in);
+    msg.msg_iov = &iov;
+    msg.msg_iovlen = 1;
+    msg.msg_control = control.buf;
+    msg.msg_controllen = sizeof(control.buf);
+
+    int len = ::recvmsg(_sockFd, &msg, 0);
+    if( len == SOCKET_ERROR )
+    {
+        throwSocketException("[UdpSocket::readFrom(recvmsg)]");
+    }
+    parseTimestamp(msg, ts);
+    return len;
+#else
+    return readFrom(pBuffer, bytes, srcAddr);
+#endif
+}
+
+//--------------------------------------------------------------------------
+bool UdpSocket::readTxTimestamp(Timestamp& ts, unsigned int& id)
+//--------------------------------------------------------------------------
+{
+    ts.softwareNs = 0;
+    ts.hardwareNs = 0;
+    id = 0;
+#ifdef __linux__
+    union
+    {
+        struct cmsghdr align;
+        char buf[CMSG_SPACE(3 * sizeof(struct timespec)) + CMSG_SPACE(sizeof(struct sock_extended_err) + sizeof(struct sockaddr_in))];
+    } control;
+
+    struct msghdr msg;
+    memset(&msg, 0, sizeof(msg));
+    msg.msg_control = control.buf;
+    msg.msg_controllen = sizeof(control.buf);
+
+    if( ::recvmsg(_sockFd, &msg, MSG_ERRQUEUE | MSG_DONTWAIT) == SOCKET_ERROR )
+    {
+        if( (errno == EAGAIN) || (errno == EWOULDBLOCK) )
+        {
+            return false;
+        }
+        throwSocketException("[UdpSocket::readTxTimestamp(recvmsg)]");
+    }
+
+    parseTimestamp(msg, ts);
+    for(struct cmsghdr* cm = CMSG_FIRSTHDR(&msg); cm != NULL; cm = CMSG_NXTHDR(&msg, cm))
+    {
+        if( (cm->cmsg_level == SOL_IP) && (cm->cmsg_type == IP_RECVERR) )
+        {
+            struct sock_extended_err err;
+            memcpy(&err, CMSG_DATA(cm), sizeof(err));
+            if( err.ee_origin == SO_EE_ORIGIN_TIMESTAMPING )
+            {
+                id = err.ee_data;
+            }
+        }
+    }
+    return true;
+#else
+    throw SocketException(ENOSYS, "[UdpSocket::readTxTimestamp]: Not supported on this platform");
+#endif
+}
+
+//--------------------------------------------------------------------------
+void UdpSocket::enableTxTime(TxTimeClock clock, bool reportErrors)
+//--------------------------------------------------------------------------
+{
+#ifdef __linux__
+    struct sock_txtime cfg;
+    cfg.clockid = (clock == TXTIME_TAI) ? CLOCK_TAI : CLOCK_MONOTONIC;
+    cfg.flags = (reportErrors ? SOF_TXTIME_REPORT_ERRORS : 0);
+    if( setsockopt(_sockFd, SOL_SOCKET, SO_TXTIME, &cfg, sizeof(cfg)) == SOCKET_ERROR )
+    {
+        throwSocketException("[UdpSocket::enableTxTime(SO_TXTIME)]");
+    }
+#else
+    throw SocketException(ENOSYS, "[UdpSocket::enableTxTime]: Not supported on this platform");
+#endif
+}
+
+//--------------------------------------------------------------------------
+long long UdpSocket::txTimeNow(TxTimeClock clock)
+//--------------------------------------------------------------------------
+{
+#ifdef __linux__
+    struct timespec t;
+    clock_gettime((clock == TXTIME_TAI) ? CLOCK_TAI : CLOCK_MONOTONIC, &t);
+    return toNs(t);
+#else
+    throw SocketException(ENOSYS, "[UdpSocket::txTimeNow]: Not supported on this platform");
+#endif
+}
+
+//--------------------------------------------------------------------------
+unsigned int UdpSocket::writeAt(const std::vector<unsigned char>& buffer, long long deadlineNs)
+//--------------------------------------------------------------------------
+{
+    return writeAt(buffer.empty() ? NULL : &buffer[0], buffer.size(), deadlineNs);
+}
+
+//--------------------------------------------------------------------------
+unsigned int UdpSocket::writeAt(const unsigned char* pBuffer, unsigned int bytes, long long deadlineNs)
+//--------------------------------------------------------------------------
+{
+#ifdef __linux__
+    struct iovec iov;
+    iov.iov_base = (void*)pBuffer;
+    iov.iov_len = bytes;
+
+    union
+    {
+        struct cmsghdr align;
+        char buf[CMSG_SPACE(sizeof(uint64_t))];
+    } control;
+
+    struct msghdr msg;
+    memset(&msg, 0, sizeof(msg));
+    msg.msg_name = &_peer;
+    msg.msg_namelen = sizeof(struct sockaddr_in);
+    msg.msg_iov = &iov;
+    msg.msg_iovlen = 1;
+    msg.msg_control = control.buf;
+    msg.msg_controllen = sizeof(control.buf);
+
+    struct cmsghdr* cm = CMSG_FIRSTHDR(&msg);
+    cm->cmsg_level = SOL_SOCKET;
+    cm->cmsg_type = SCM_TXTIME;
+    cm->cmsg_len = CMSG_LEN(sizeof(uint64_t));
+    uint64_t txtime = deadlineNs;
+    memcpy(CMSG_DATA(cm), &txtime, sizeof(txtime));
+
+    ssize_t len = ::sendmsg(_sockFd, &msg, 0);
+    if( len == SOCKET_ERROR )
+    {
+        throwSocketException("[UdpSocket::writeAt(sendmsg)]");
+    }
+    return len;
+#else
+    throw SocketException(ENOSYS, "[UdpSocket::writeAt]: Not supported on this platform");
+#endif
+}
+
+//--------------------------------------------------------------------------
+bool UdpSocket::readTxTimeError(TxTimeError& error)
+//--------------------------------------------------------------------------
+{
+    error.deadlineNs = 0;
+    error.missed = false;
+#ifdef __linux__
+    union
+    {
+        struct cmsghdr align;
+        char buf[CMSG_SPACE(sizeof(struct sock_extended_err) + sizeof(struct sockaddr_in))];
+    } control;
+
+    struct msghdr msg;
+    memset(&msg, 0, sizeof(msg));
+    msg.msg_control = control.buf;
+    msg.msg_controllen = sizeof(control.buf);
+
+    // skip anything else on the error queue (eg: transmit timestamps)
+    for(;;)
+    {
+        msg.msg_controllen = sizeof(control.buf);
+        if( ::recvmsg(_sockFd, &msg, MSG_ERRQUEUE | MSG_DONTWAIT) == SOCKET_ERROR )
+        {
+            if( (errno == EAGAIN) || (errno == EWOULDBLOCK) )
+            {
+                return false;
+            }
+            throwSocketException("[UdpSocket::readTxTimeError(recvmsg)]");
+        }
+
+        for(struct cmsghdr* cm = CMSG_FIRSTHDR(&msg); cm != NULL; cm = CMSG_NXTHDR(&msg, cm))
+        {
+            if( (cm->cmsg_level != SOL_IP) || (cm->cmsg_type != IP_RECVERR) )
+            {
+                continue;
+            }
+            struct sock_extended_err err;
+            memcpy(&err, CMSG_DATA(cm), sizeof(err));
+            if( err.ee_origin == SO_EE_ORIGIN_TXTIME )
+            {
+                // the requested time is split across ee_data (high) and ee_info (low)
+                error.deadlineNs = (long long)(((uint64_t)err.ee_data << 32) | err.ee_info);
+                error.missed = (err.ee_code == SO_EE_CODE_TXTIME_MISSED);
+                return true;
+            }
+        }
+    }
+#else
+    throw SocketException(ENOSYS, "[UdpSocket::readTxTimeError]: Not supported on this platform");
+#endif
+}
+
 //--------------------------------------------------------------------------
 unsigned int UdpSocket::write(const std::vector<unsigned char>& buffer)
 //--------------------------------------------------------------------------
 {
-    int len = sendto(_sockFd, (const char*)&buffer[0], buffer.size(), 0, (struct sockaddr *)&_peer, sizeof(struct sockaddr_in));
+    return write(buffer.empty() ? NULL : &buffer[0], buffer.size());
+}
+
+//--------------------------------------------------------------------------
+unsigned int UdpSocket::write(const unsigned char* pBuffer, unsigned int bytes)
+//--------------------------------------------------------------------------
+{
+    int len = sendto(_sockFd, (const char*)pBuffer, bytes, 0, (struct sockaddr *)&_peer, sizeof(struct sockaddr_in));
     if( len == SOCKET_ERROR )
     {
         throwSocketException("[UdpSocket::write(sendto)]");
@@ -119,6 +712,56 @@ unsigned int UdpSocket::write(const std::vector<unsigned char>& buffer)
     return len;
 }
 
+//--------------------------------------------------------------------------
+unsigned int UdpSocket::writev(const Buffer* buffers, unsigned int count)
+//--------------------------------------------------------------------------
+{
+    if( count > MAX_WRITEV_BUFFERS )
+    {
+        throw SocketException(EMSGSIZE, "[UdpSocket::writev]: Too many buffers");
+    }
+
+#ifdef _MSC_VER
+    // send as one datagram
+    WSABUF bufs[MAX_WRITEV_BUFFERS];
+    for(unsigned int i = 0; i < count; ++i)
+    {
+        bufs[i].buf = (char*)buffers[i].pData;
+        bufs[i].len = buffers[i].size;
+    }
+
+    DWORD len = 0;
+    if( WSASendTo(_sockFd, bufs, count, &len, 0, (struct sockaddr *)&_peer, sizeof(struct sockaddr_in), NULL, NULL) == SOCKET_ERROR )
+    {
+        throwSocketException("[UdpSocket::writev(WSASendTo)]");
+    }
+
+    return len;
+#else
+    struct iovec iov[MAX_WRITEV_BUFFERS];
+    for(unsigned int i = 0; i < count; ++i)
+    {
+        iov[i].iov_base = (void*)buffers[i].pData;
+        iov[i].iov_len = buffers[i].size;
+    }
+
+    struct msghdr msg;
+    memset(&msg, 0, sizeof(msg));
+    msg.msg_name = &_peer;
+    msg.msg_namelen = sizeof(struct sockaddr_in);
+    msg.msg_iov = iov;
+    msg.msg_iovlen = count;
+
+    ssize_t len = ::sendmsg(_sockFd, &msg, 0);
+    if( len == SOCKET_ERROR )
+    {
+        throwSocketException("[UdpSocket::writev(sendmsg)]");
+    }
+
+    return len;
+#endif
+}
+
 //--------------------------------------------------------------------------
 unsigned int UdpSocket::readn(std::vector<unsigned char>& buffer, unsigned int bytesToRead)
 //--------------------------------------------------------------------------
@@ -128,11 +771,18 @@ unsigned int UdpSocket::readn(std::vector<unsigned char>& buffer, unsigned int b
         buffer.resize(bytesToRead);
     }
 
+    return readn(buffer.empty() ? NULL : &buffer[0], bytesToRead);
+}
+
+//--------------------------------------------------------------------------
+unsigned int UdpSocket::readn(unsigned char* pBuffer, unsigned int bytesToRead)
+//--------------------------------------------------------------------------
+{
     struct sockaddr_in srcAddr;
     int srcAddrLen = sizeof(struct sockaddr);
 
     // wait for messages
-    int len = ::recvfrom(_sockFd, (char*)&buffer[0], bytesToRead, 0/*MSG_WAITALL*/, (struct sockaddr *) &(srcAddr), (socklen_t *)&srcAddrLen);
+    int len = ::recvfrom(_sockFd, (char*)pBuffer, bytesToRead, 0/*MSG_WAITALL*/, (struct sockaddr *) &(srcAddr), (socklen_t *)&srcAddrLen);
 
     if( len == SOCKET_ERROR )
     {
@@ -142,5 +792,219 @@ unsigned int UdpSocket::readn(std::vector<unsigned char>& buffer, unsigned int b
     return len;
 }
 
+//--------------------------------------------------------------------------
+struct in_addr UdpSocket::toInAddr(const std::string& ip, const std::string& location)
+//--------------------------------------------------------------------------
+{
+    struct in_addr addr;
+    addr.s_addr = htonl(INADDR_ANY);
+    if( !ip.empty() )
+    {
+        addr.s_addr = inet_addr(ip.c_str());
+        if( addr.s_addr == INADDR_NONE )
+        {
+            std::ostringstream str;
+            str << location << ": Invalid address " << ip;
+            throw SocketException(EINVAL, str.str());
+        }
+    }
+    return addr;
+}
+
+//--------------------------------------------------------------------------
+void UdpSocket::setMembership(int option, const std::string& groupIp, const std::string& interfaceIp, const std::string& location)
+//--------------------------------------------------------------------------
+{
+    struct ip_mreq mreq;
+    mreq.imr_multiaddr = toInAddr(groupIp, location);
+    mreq.imr_interface = toInAddr(interfaceIp, location);
+    if( setsockopt(_sockFd, IPPROTO_IP, option, (const char*)&mreq, sizeof(mreq)) == SOCKET_ERROR )
+    {
+        throwSocketException(location);
+    }
+}
+
+//--------------------------------------------------------------------------
+void UdpSocket::joinMulticastGroup(const std::string& groupIp, const std::string& interfaceIp)
+//--------------------------------------------------------------------------
+{
+    setMembership(IP_ADD_MEMBERSHIP, groupIp, interfaceIp, "[UdpSocket::joinMulticastGroup(IP_ADD_MEMBERSHIP)]");
+}
+
+//--------------------------------------------------------------------------
+void UdpSocket::leaveMulticastGroup(const std::string& groupIp, const std::string& interfaceIp)
+//--------------------------------------------------------------------------
+{
+    setMembership(IP_DROP_MEMBERSHIP, groupIp, interfaceIp, "[UdpSocket::leaveMulticastGroup(IP_DROP_MEMBERSHIP)]");
+}
+
+//--------------------------------------------------------------------------
+void UdpSocket::setMulticastTtl(unsigned int ttl)
+//--------------------------------------------------------------------------
+{
+    int val = ttl;
+    if( setsockopt(_sockFd, IPPROTO_IP, IP_MULTICAST_TTL, (const char*)&val, sizeof(int)) == SOCKET_ERROR )
+    {
+        throwSocketException("[UdpSocket::setMulticastTtl(IP_MULTICAST_TTL)]");
+    }
+}
+
+//--------------------------------------------------------------------------
+void UdpSocket::setMulticastLoopback(bool yes)
+//--------------------------------------------------------------------------
+{
+    int val = (yes?1:0);
+    if( setsockopt(_sockFd, IPPROTO_IP, IP_MULTICAST_LOOP, (const char*)&val, sizeof(int)) == SOCKET_ERROR )
+    {
+        throwSocketException("[UdpSocket::setMulticastLoopback(IP_MULTICAST_LOOP)]");
+    }
+}
+
+//--------------------------------------------------------------------------
+void UdpSocket::setMulticastInterface(const std::string& interfaceIp)
+//--------------------------------------------------------------------------
+{
+    struct in_addr addr = toInAddr(interfaceIp, "[UdpSocket::setMulticastInterface]");
+    if( setsockopt(_sockFd, IPPROTO_IP, IP_MULTICAST_IF, (const char*)&addr, sizeof(addr)) == SOCKET_ERROR )
+    {
+        throwSocketException("[UdpSocket::setMulticastInterface(IP_MULTICAST_IF)]");
+    }
+}
+
+//--------------------------------------------------------------------------
+unsigned int UdpSocket::readBatch(Datagram* datagrams, unsigned int count)
+//--------------------------------------------------------------------------
+{
+#ifdef __linux__
+    struct mmsghdr msgs[MAX_BATCH];
+    struct iovec iovs[MAX_BATCH];
+
+    unsigned int nRead = 0;
+    int flags = MSG_WAITFORONE; // block for the first datagram only
+    while( nRead < count )
+    {
+        unsigned int n = count - nRead;
+        if( n > MAX_BATCH )
+        {
+            n = MAX_BATCH;
+        }
+
+        Datagram* pDg = datagrams + nRead;
+        memset(msgs, 0, n * sizeof(struct mmsghdr));
+        for(unsigned int i = 0; i < n; ++i)
+        {
+            iovs[i].iov_base = pDg[i].pData;
+            iovs[i].iov_len = pDg[i].capacity;
+            msgs[i].msg_hdr.msg_iov = &iovs[i];
+            msgs[i].msg_hdr.msg_iovlen = 1;
+            msgs[i].msg_hdr.msg_name = &pDg[i].address;
+            msgs[i].msg_hdr.msg_namelen = sizeof(struct sockaddr_in);
+        }
+
+        int ret = recvmmsg(_sockFd, msgs, n, flags, NULL);
+        if( ret == SOCKET_ERROR )
+        {
+            if( (nRead > 0) && ((errno == EAGAIN) || (errno == EWOULDBLOCK)) )
+            {
+                break;
+            }
+            throwSocketException("[UdpSocket::readBatch(recvmmsg)]");
+        }
+
+        for(int i = 0; i < ret; ++i)
+        {
+            pDg[i].length = msgs[i].msg_len;
+        }
+        nRead += ret;
+
+        if( (unsigned int)ret < n )
+        {
+            break; // socket drained
+        }
+        flags = MSG_DONTWAIT;
+    }
+    return nRead;
+#else
+    // one datagram per call on other platforms. Block for the first one only
+    unsigned int nRead = 0;
+    while( (nRead < count) && ((nRead == 0) || availableToRead()) )
+    {
+        int srcAddrLen = sizeof(struct sockaddr_in);
+        Datagram& dg = datagrams[nRead];
+        int len = ::recvfrom(_sockFd, (char*)dg.pData, dg.capacity, 0, (struct sockaddr *)&dg.address, (socklen_t *)&srcAddrLen);
+        if( len == SOCKET_ERROR )
+        {
+            throwSocketException("[UdpSocket::readBatch(recvfrom)]");
+        }
+        dg.length = len;
+        ++nRead;
+    }
+    return nRead;
+#endif
+}
+
+//--------------------------------------------------------------------------
+unsigned int UdpSocket::writeBatch(const Datagram* datagrams, unsigned int count)
+//--------------------------------------------------------------------------
+{
+#ifdef __linux__
+    struct mmsghdr msgs[MAX_BATCH];
+    struct iovec iovs[MAX_BATCH];
+
+    unsigned int nSent = 0;
+    while( nSent < count )
+    {
+        unsigned int n = count - nSent;
+        if( n > MAX_BATCH )
+        {
+            n = MAX_BATCH;
+        }
+
+        const Datagram* pDg = datagrams + nSent;
+        memset(msgs, 0, n * sizeof(struct mmsghdr));
+        for(unsigned int i = 0; i < n; ++i)
+        {
+            iovs[i].iov_base = pDg[i].pData;
+            iovs[i].iov_len = pDg[i].length;
+            msgs[i].msg_hdr.msg_iov = &iovs[i];
+            msgs[i].msg_hdr.msg_iovlen = 1;
+            msgs[i].msg_hdr.msg_name = (void*)&pDg[i].address;
+            msgs[i].msg_hdr.msg_namelen = sizeof(struct sockaddr_in);
+        }
+
+        int ret = sendmmsg(_sockFd, msgs, n, 0);
+        if( ret == SOCKET_ERROR )
+        {
+            if( nSent > 0 )
+            {
+                break; // report what was sent. The error will recur on the next call
+            }
+            throwSocketException("[UdpSocket::writeBatch(sendmmsg)]");
+        }
+
+        nSent += ret;
+        if( (unsigned int)ret < n )
+        {
+            break;
+        }
+    }
+    return nSent;
+#else
+    for(unsigned int i = 0; i < count; ++i)
+    {
+        const Datagram& dg = datagrams[i];
+        int len = sendto(_sockFd, (const char*)dg.pData, dg.length, 0, (struct sockaddr *)&dg.address, sizeof(struct sockaddr_in));
+        if( len == SOCKET_ERROR )
+        {
+            if( i > 0 )
+            {
+                return i;
+            }
+            throwSocketException("[UdpSocket::writeBatch(sendto)]");
+        }
+    }
+    return count;
+#endif
+}
 
 } // grape
@@ -45,6 +45,58 @@ namespace grape
 /// Note that any method can throw SocketException on error
 class GRAPEIO_DLL_API UdpSocket : public IpSocket
 {
+public:
+
+    /// \brief A datagram for batched IO. See readBatch(), writeBatch()
+    struct Datagram
+    {
+        unsigned char* pData;       //!< Message buffer
+        unsigned int capacity;      //!< Size of message buffer. Used by readBatch()
+        unsigned int length;        //!< Number of bytes in the message
+        struct sockaddr_in address; //!< Source address (readBatch) or destination address (writeBatch)
+    };
+
+    /// \brief Timestamping options. See enableTimestamping()
+    enum TimestampFlags
+    {
+        TIMESTAMP_RX_SOFTWARE   = 0x1,  //!< Time at which the kernel received the datagram
+        TIMESTAMP_RX_HARDWARE   = 0x2,  //!< Time at which the NIC received the datagram
+        TIMESTAMP_TX_SOFTWARE   = 0x4,  //!< Time at which the kernel passed the datagram to the driver
+        TIMESTAMP_TX_HARDWARE   = 0x8   //!< Time at which the NIC sent the datagram
+    };
+
+    /// \brief Kernel timestamps of a datagram, in nanoseconds. A field is 0 if
+    /// the timestamp is not available.
+    struct Timestamp
+    {
+        long long softwareNs;   //!< System clock (CLOCK_REALTIME)
+        long long hardwareNs;   //!< NIC clock (raw, not converted to system time)
+    };
+
+    /// \brief Clock that transmit times are given in. See enableTxTime()
+    enum TxTimeClock
+    {
+        TXTIME_MONOTONIC,   //!< CLOCK_MONOTONIC. Supported by the fq qdisc.
+        TXTIME_TAI          //!< CLOCK_TAI. Required by the etf qdisc for NIC launch time offload.
+    };
+
+    /// \brief A datagram dropped by the kernel because its transmit time could not be
+    /// met. See readTxTimeError()
+    struct TxTimeError
+    {
+        long long deadlineNs;   //!< Transmit time requested with writeAt()
+        bool missed;            //!< true if the time had passed when the datagram reached the
+                                //!< queue, false if the request was invalid (eg: wrong clock)
+    };
+
+    /// \brief Outcome counts of waitForRead() in busy-poll mode. See setBusyPoll()
+    struct BusyPollStatistics
+    {
+        unsigned long long spinHits;        //!< Data arrived while spinning
+        unsigned long long blockingHits;    //!< Data arrived after falling back to a blocking wait
+        unsigned long long timeouts;        //!< No data within the timeout
+    };
+
 public:
 
     UdpSocket();
@@ -60,10 +112,17 @@ public:
     /// Since UDP sockets are connectionless, this method will read data from any remote host.
     /// To get data source information, use readFrom()
     unsigned int readn(std::vector<unsigned char>& buffer, unsigned int bytes);
+    unsigned int readn(unsigned char* pBuffer, unsigned int bytes);
 
     /// \copydoc IDataPort::write()
     /// This method writes to remote peer specified in setRemotePeer()
     unsigned int write(const std::vector<unsigned char>& buffer);
+    unsigned int write(const unsigned char* pBuffer, unsigned int bytes);
+
+    /// \copydoc IDataPort::writev()
+    /// The buffers are sent as a single datagram to the remote peer specified in
+    /// setRemotePeer()
+    unsigned int writev(const Buffer* buffers, unsigned int count);
 
     /// Send message to a specific host
     /// \param destAddr   Destination address information
@@ -71,6 +130,7 @@ public:
     /// \throw SocketException
     /// \return number of bytes sent
     unsigned int writeTo(struct sockaddr_in &destAddr, const std::vector<unsigned char>& buffer);
+    unsigned int writeTo(struct sockaddr_in &destAddr, const unsigned char* pBuffer, unsigned int bytes);
 
     /// Block to receive message from any host
     /// \param buffer Buffer to receive message into
@@ -78,9 +138,178 @@ public:
     /// \throw SocketException
     /// \return number of bytes received
     unsigned int readFrom(std::vector<unsigned char>& buffer, struct sockaddr_in &srcAddr);
+    unsigned int readFrom(unsigned char* pBuffer, unsigned int bytes, struct sockaddr_in &srcAddr);
+
+    /// Receive several datagrams in one call. Blocks until at least one datagram
+    /// is available, then reads as many queued datagrams as will fit in the array
+    /// without blocking further.
+    /// \param datagrams Preallocated array of datagrams. On input, pData and capacity
+    ///                  describe the buffers. On output, length and address are set for
+    ///                  each datagram received. Datagrams larger than capacity are truncated.
+    /// \param count     Number of elements in the array
+    /// \throw SocketException
+    /// \return number of datagrams received
+    unsigned int readBatch(Datagram* datagrams, unsigned int count);
+
+    /// Send several datagrams in one call.
+    /// \param datagrams Array of datagrams. pData, length and address are used.
+    /// \param count     Number of elements in the array
+    /// \throw SocketException
+    /// \return number of datagrams sent. May be less than count if the socket buffer is full.
+    unsigned int writeBatch(const Datagram* datagrams, unsigned int count);
+
+    /// Send a large buffer as a train of datagrams of equal size (the last one may
+    /// be shorter). On Linux, the kernel splits the buffer with UDP generic
+    /// segmentation offload (UDP_SEGMENT), so a whole train costs one system call;
+    /// elsewhere one datagram is sent per call.
+    /// \param destAddr     Destination address
+    /// \param pBuffer      Data to send
+    /// \param bytes        Size of data. May exceed the maximum datagram size; it is
+    ///                     then sent as several trains.
+    /// \param segmentSize  Payload size of each datagram. Must fit the path MTU.
+    /// \throw SocketException
+    /// \return number of bytes sent
+    unsigned int writeSegmented(struct sockaddr_in &destAddr, const unsigned char* pBuffer, unsigned int bytes, unsigned int segmentSize);
+
+    /// Enable UDP generic receive offload (UDP_GRO, Linux only). The kernel may then
+    /// coalesce consecutive datagrams of equal size from the same source into one
+    /// buffer, returned by readCoalesced(). Other read methods must not be used
+    /// while enabled, as they cannot tell where coalesced datagrams begin.
+    /// \throw SocketException
+    void enableReceiveOffload(bool yes);
+
+    /// Receive a datagram, or a run of datagrams coalesced by receive offload.
+    /// \param pBuffer      Buffer for the data. Use a 64 kB buffer to receive whole runs.
+    /// \param bytes        Size of buffer
+    /// \param srcAddr      Source of the datagrams
+    /// \param segmentSize  Size of each datagram in the buffer. All datagrams are this
+    ///                     size, except the last which may be shorter.
+    /// \throw SocketException
+    /// \return number of bytes received
+    unsigned int readCoalesced(unsigned char* pBuffer, unsigned int bytes, struct sockaddr_in &srcAddr, unsigned int& segmentSize);
+
+    /// Enable busy-poll receive mode (Linux only). In this mode, waitForRead() first
+    /// spins on a non-blocking check for data for up to spinBudgetUs, and only then
+    /// falls back to a blocking wait. This avoids the scheduler wakeup latency of a
+    /// blocking wait, at the cost of keeping a core busy.
+    /// \param spinBudgetUs     Microseconds to spin in waitForRead() before blocking.
+    ///                         0 disables busy-poll mode.
+    /// \param kernelBusyPollUs If not 0, sets SO_BUSY_POLL so that the kernel also polls
+    ///                         the network device queue for this long during each
+    ///                         receive, for drivers that support it. Values above the
+    ///                         net.core.busy_read sysctl require CAP_NET_ADMIN.
+    /// \param preferBusyPoll   Set SO_PREFER_BUSY_POLL, so that device interrupts are
+    ///                         deferred while the application is busy polling.
+    /// \throw SocketException
+    void setBusyPoll(unsigned int spinBudgetUs, unsigned int kernelBusyPollUs = 0, bool preferBusyPoll = false);
+
+    /// \return how often waitForRead() found data by spinning, after blocking, or
+    ///         timed out, since busy-poll mode was enabled
+    BusyPollStatistics getBusyPollStatistics() const { return _busyPollStats; }
+
+    /// Clear busy-poll statistics
+    void resetBusyPollStatistics();
+
+    /// \copydoc IDataPort::waitForRead()
+    /// In busy-poll mode, spins before waiting. See setBusyPoll()
+    IDataPort::Status waitForRead(int timeoutMs);
 
+    /// Enable kernel timestamping of datagrams (Linux only). Receive timestamps
+    /// are returned by readFrom(), transmit timestamps by readTxTimestamp().
+    /// Hardware timestamps additionally require the network interface to be
+    /// configured for timestamping (SIOCSHWTSTAMP, eg: using hwstamp_ctl).
+    /// \param flags Combination of TimestampFlags. 0 disables timestamping.
+    /// \throw SocketException if timestamping is not supported.
+    void enableTimestamping(unsigned int flags);
+
+    /// Block to receive message from any host, along with the receive timestamp.
+    /// \param pBuffer Buffer to receive message into
+    /// \param bytes   Size of buffer
+    /// \param srcAddr The address of the host from which data was received.
+    /// \param ts      Receive timestamps, as enabled by enableTimestamping()
+    /// \throw SocketException
+    /// \return number of bytes received
+    unsigned int readFrom(unsigned char* pBuffer, unsigned int bytes, struct sockaddr_in &srcAddr, Timestamp& ts);
+
+    /// Retrieve the transmit timestamp of a previously sent datagram, without
+    /// blocking. Transmit timestamps are queued by the kernel after the datagram
+    /// leaves, so poll this after writes until it returns false.
+    /// \param ts  Transmit timestamps, as enabled by enableTimestamping()
+    /// \param id  Sequence number of the datagram the timestamp belongs to. The
+    ///            first datagram sent after enableTimestamping() is 0.
+    /// \throw SocketException
+    /// \return true if a timestamp was read, false if none was queued.
+    bool readTxTimestamp(Timestamp& ts, unsigned int& id);
+
+    /// Enable scheduled transmission with writeAt() (SO_TXTIME, Linux only). The
+    /// datagram is handed to the network stack immediately and held by the queueing
+    /// discipline until its transmit time, so its departure does not depend on when
+    /// the sending thread is scheduled. The interface must use a qdisc that honours
+    /// transmit times: fq (TXTIME_MONOTONIC) or etf (TXTIME_TAI, eg:
+    /// "tc qdisc replace dev eth0 parent root etf clockid CLOCK_TAI delta 200000").
+    /// Other qdiscs send the datagram immediately.
+    /// \param clock        Clock of the times passed to writeAt(). Clocks other than
+    ///                     TXTIME_MONOTONIC require CAP_NET_ADMIN.
+    /// \param reportErrors Queue a TxTimeError for each datagram dropped because its
+    ///                     transmit time was missed. See readTxTimeError()
+    /// \throw SocketException
+    void enableTxTime(TxTimeClock clock, bool reportErrors = true);
+
+    /// \return the current time in nanoseconds on the given transmit clock, to
+    ///         compute deadlines for writeAt()
+    static long long txTimeNow(TxTimeClock clock);
+
+    /// Send a message to the remote peer specified in setRemotePeer(), to leave at
+    /// the given time. Requires enableTxTime().
+    /// \param deadlineNs Transmit time in nanoseconds, on the clock selected by
+    ///                   enableTxTime(). See txTimeNow().
+    /// \throw SocketException
+    /// \return number of bytes sent
+    unsigned int writeAt(const std::vector<unsigned char>& buffer, long long deadlineNs);
+    unsigned int writeAt(const unsigned char* pBuffer, unsigned int bytes, long long deadlineNs);
+
+    /// Retrieve a report of a datagram dropped by writeAt() scheduling, without
+    /// blocking. Reports share the socket error queue with transmit timestamps, so
+    /// use either this or readTxTimestamp() on a socket, not both.
+    /// \param error Dropped datagram
+    /// \throw SocketException
+    /// \return true if a report was read, false if none was queued.
+    bool readTxTimeError(TxTimeError& error);
+
+    /// Join a multicast group, to receive datagrams sent to the group. The socket
+    /// must be bound to the port the group publishes on.
+    /// \param groupIp      Multicast group address (eg: "239.255.0.1")
+    /// \param interfaceIp  Address of the local interface to join on. Leave empty
+    ///                     to let the system choose.
+    /// \throw SocketException
+    void joinMulticastGroup(const std::string& groupIp, const std::string& interfaceIp = "");
+
+    /// Leave a multicast group joined with joinMulticastGroup()
+    /// \throw SocketException
+    void leaveMulticastGroup(const std::string& groupIp, const std::string& interfaceIp = "");
+
+    /// Set the time-to-live of outgoing multicast datagrams. 1 (default) keeps them
+    /// on the local network.
+    /// \throw SocketException
+    void setMulticastTtl(unsigned int ttl);
+
+    /// Enable or disable delivery of outgoing multicast datagrams to subscribers on
+    /// the sending host. Enabled by default.
+    /// \throw SocketException
+    void setMulticastLoopback(bool yes);
+
+    /// Select the local interface for outgoing multicast datagrams
+    /// \param interfaceIp Address of the local interface
+    /// \throw SocketException
+    void setMulticastInterface(const std::string& interfaceIp);
+
+private:
+    void setMembership(int option, const std::string& groupIp, const std::string& interfaceIp, const std::string& location);
+    struct in_addr toInAddr(const std::string& ip, const std::string& location);
 private:
     sockaddr_in _peer;
+    long long _spinBudgetNs;
+    BusyPollStatistics _busyPollStats;
 
 };// UdpSocket
 
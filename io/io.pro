@@ -23,17 +23,32 @@ HEADERS = SerialPort.h \
     UdpServer.h \
     SerialPortException.h \
     IoException.h \
-    IDataPort.h
+    IDataPort.h \
+    HostResolver.h \
+    MessageStream.h \
+    ReliableUdpChannel.h \
+    PacketFramer.h \
+    PacketFramer.hpp \
+    ModbusRtuMaster.h
 SOURCES = \
+    IDataPort.cpp \
+    HostResolver.cpp \
     IJoystick.cpp \
     TcpSocket.cpp \
     UdpSocket.cpp \
     IpSocket.cpp \
-    UdpServer.cpp
+    UdpServer.cpp \
+    MessageStream.cpp \
+    ReliableUdpChannel.cpp \
+    ModbusRtuMaster.cpp
 
 win32:HEADERS += Dx8JoystickManager.h
 win32:SOURCES += Dx8JoystickManager.cpp SimpleJoystick_windows.cpp SerialPort_windows.cpp
-unix:SOURCES += SerialPort_unix.cpp SimpleJoystick_unix.cpp
+unix:HEADERS += IoReactor.h IoUring.h IoVecChunks.h TcpSendQueue.h LocalSocket.h LocalStreamSocket.h LocalDatagramSocket.h ShardedUdpServer.h PacketCapturePort.h CanPort.h EvdevJoystickManager.h
+unix:SOURCES += SerialPort_unix.cpp SimpleJoystick_unix.cpp IoReactor_unix.cpp IoUring_unix.cpp TcpSendQueue.cpp LocalSocket.cpp LocalStreamSocket.cpp LocalDatagramSocket.cpp ShardedUdpServer_unix.cpp PacketCapturePort_unix.cpp CanPort_unix.cpp EvdevJoystickManager_unix.cpp
+# shm_open is not in Android's C library
+unix:!android:HEADERS += SharedMemoryPort.h
+unix:!android:SOURCES += SharedMemoryPort_unix.cpp
 
 CONFIG(debug, release|debug) {
     win32:LIBS += -lGrapeCored0 -lGrapeUtilsd0 -ldinput8
@@ -0,0 +1,45 @@
+#ifndef TESTIO_PSEUDOTERMINAL_H
+#define TESTIO_PSEUDOTERMINAL_H
+
+#include <QtTest>
+#include <string>
+#include <stdlib.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <poll.h>
+
+//-----------------------------------------------------------------------------
+/// Pseudo terminal standing in for a serial device. The test drives the master
+/// side; the port under test opens the slave side by name.
+class PseudoTerminal
+//-----------------------------------------------------------------------------
+{
+public:
+    PseudoTerminal() : _fd(posix_openpt(O_RDWR | O_NOCTTY))
+    {
+        if( (_fd >= 0) && ((grantpt(_fd) < 0) || (unlockpt(_fd) < 0)) )
+        {
+            ::close(_fd);
+            _fd = -1;
+        }
+    }
+    ~PseudoTerminal() { if( _fd >= 0 ) ::close(_fd); }
+    bool isOpen() const { return (_fd >= 0); }
+    int fd() const { return _fd; }
+    std::string slaveName() const { return ptsname(_fd); }
+    void write(const void* p, size_t n) { QVERIFY(::write(_fd, p, n) == (ssize_t)n); }
+    size_t read(void* p, size_t n, int timeoutMs)
+    {
+        struct pollfd pfd = { _fd, POLLIN, 0 };
+        if( poll(&pfd, 1, timeoutMs) <= 0 ) return 0;
+        ssize_t got = ::read(_fd, p, n);
+        return (got > 0) ? got : 0;
+    }
+private:
+    PseudoTerminal(const PseudoTerminal&);
+    PseudoTerminal &operator=(const PseudoTerminal&);
+private:
+    int _fd;
+};
+
+#endif // TESTIO_PSEUDOTERMINAL_H
@@ -0,0 +1,126 @@
+#include "TestCanPort.h"
+#include <io/IoException.h>
+
+static const char* TEST_INTERFACE = "vcan0";
+
+//-----------------------------------------------------------------------------
+static bool openOrSkip(grape::CanPort& port)
+//-----------------------------------------------------------------------------
+{
+    try
+    {
+        port.open(TEST_INTERFACE);
+    }
+    catch(grape::IoOpenException&)
+    {
+        return false;
+    }
+    return true;
+}
+
+//=============================================================================
+TestCanPort::TestCanPort()
+//=============================================================================
+{
+}
+
+//-----------------------------------------------------------------------------
+void TestCanPort::initTestCase()
+//-----------------------------------------------------------------------------
+{
+    grape::CanPort port;
+    if( !openOrSkip(port) )
+    {
+        QSKIP("vcan0 not available", SkipAll);
+    }
+}
+
+//-----------------------------------------------------------------------------
+void TestCanPort::cleanupTestCase()
+//-----------------------------------------------------------------------------
+{
+}
+
+//-----------------------------------------------------------------------------
+void TestCanPort::batchFiltered()
+//-----------------------------------------------------------------------------
+{
+    grape::CanPort tx;
+    grape::CanPort rx;
+    QVERIFY(openOrSkip(tx));
+    QVERIFY(openOrSkip(rx));
+
+    grape::CanPort::Filter filter = { 0x180, 0x780, false, false };
+    rx.setFilters(&filter, 1);
+    rx.flushRx();
+
+    // alternate frames pass the filter; an extended frame with matching low bits
+    // and a remote request with a matching identifier don't
+    static const unsigned int N_FRAMES = 40;
+    grape::CanPort::Frame out[N_FRAMES + 2];
+    for(unsigned int i = 0; i < N_FRAMES; ++i)
+    {
+        memset(&out[i], 0, sizeof(out[i]));
+        out[i].id = ((i % 2) ? 0x200 : 0x180) + (i % 16);
+        out[i].length = 2;
+        out[i].data[0] = (unsigned char)i;
+        out[i].data[1] = 0xA5;
+    }
+    memset(&out[N_FRAMES], 0, sizeof(out[N_FRAMES]));
+    out[N_FRAMES].id = 0x180;
+    out[N_FRAMES].extended = true;
+    memset(&out[N_FRAMES + 1], 0, sizeof(out[N_FRAMES + 1]));
+    out[N_FRAMES + 1].id = 0x181;
+    out[N_FRAMES + 1].remote = true;
+    QCOMPARE(tx.writeFrames(out, N_FRAMES + 2), N_FRAMES + 2);
+
+    grape::CanPort::Frame in[N_FRAMES];
+    unsigned int received = 0;
+    while( received < N_FRAMES / 2 )
+    {
+        unsigned int n = rx.readFrames(in + received, N_FRAMES - received, 1000);
+        QVERIFY2(n > 0, "frames missing");
+        received += n;
+    }
+    QCOMPARE(received, N_FRAMES / 2);
+    QCOMPARE(rx.readFrames(in, N_FRAMES, 20), 0U);
+
+    for(unsigned int i = 0; i < received; ++i)
+    {
+        QVERIFY(!in[i].extended);
+        QVERIFY(!in[i].remote);
+        QCOMPARE(in[i].id & 0x780, 0x180U);
+        QCOMPARE((unsigned int)in[i].data[0], 2 * i);
+        QCOMPARE(in[i].length, (unsigned char)2);
+        QVERIFY(in[i].timestampNs > 0);
+    }
+}
+
+//-----------------------------------------------------------------------------
+void TestCanPort::rawFrames()
+//-----------------------------------------------------------------------------
+{
+    grape::CanPort tx;
+    grape::CanPort rx;
+    QVERIFY(openOrSkip(tx));
+    QVERIFY(openOrSkip(rx));
+    rx.flushRx();
+
+    // struct can_frame: id (4, host byte order), length (1), padding (3), data (8)
+    unsigned char frames[2 * grape::CanPort::FRAME_SIZE];
+    memset(frames, 0, sizeof(frames));
+    frames[0] = 0x23; frames[1] = 0x01; frames[4] = 1; frames[8] = 0x42;
+    frames[16] = 0x24; frames[17] = 0x01; frames[20] = 1; frames[24] = 0x43;
+    QCOMPARE(tx.write(frames, sizeof(frames)), (unsigned int)sizeof(frames));
+
+    QCOMPARE(rx.waitForRead(1000), grape::IDataPort::PORT_OK);
+    QCOMPARE(rx.availableToRead(), grape::CanPort::FRAME_SIZE);
+    unsigned int n = 0;
+    while( n < sizeof(frames) )
+    {
+        n += rx.readn(&frames[n], sizeof(frames) - n);
+    }
+    QCOMPARE((unsigned int)frames[8], 0x42U);
+    QCOMPARE((unsigned int)frames[24], 0x43U);
+    QCOMPARE(rx.availableToRead(), 0U);
+}
@@ -0,0 +1,21 @@
+#include <QString>
+#include <QtTest>
+#include <io/CanPort.h>
+
+//=============================================================================
+/// \brief Test class for CanPort. Requires a virtual CAN interface:
+/// ip link add dev vcan0 type vcan && ip link set up vcan0
+//=============================================================================
+class TestCanPort : public QObject
+{
+    Q_OBJECT
+
+public:
+    TestCanPort();
+
+private Q_SLOTS:
+    void cleanupTestCase();
+    void initTestCase();
+    void batchFiltered();
+    void rawFrames();
+};
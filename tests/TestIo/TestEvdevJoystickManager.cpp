@@ -0,0 +1,162 @@
+#include "TestEvdevJoystickManager.h"
+#include <linux/uinput.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <time.h>
+
+static const char* DEVICE_NAME = "grape test gamepad";
+
+//-----------------------------------------------------------------------------
+/// A gamepad created through uinput, with a stick axis, a hat and two buttons
+class VirtualGamepad
+//-----------------------------------------------------------------------------
+{
+public:
+    VirtualGamepad() : _fd(::open("/dev/uinput", O_WRONLY | O_NONBLOCK))
+    {
+        if( _fd < 0 ) return;
+        struct uinput_user_dev dev;
+        memset(&dev, 0, sizeof(dev));
+        strncpy(dev.name, DEVICE_NAME, UINPUT_MAX_NAME_SIZE - 1);
+        dev.id.bustype = BUS_VIRTUAL;
+        dev.absmin[ABS_X] = -100;
+        dev.absmax[ABS_X] = 100;
+        dev.absmin[ABS_HAT0X] = -1;
+        dev.absmax[ABS_HAT0X] = 1;
+        if( (ioctl(_fd, UI_SET_EVBIT, EV_KEY) < 0) || (ioctl(_fd, UI_SET_EVBIT, EV_ABS) < 0)
+            || (ioctl(_fd, UI_SET_KEYBIT, BTN_SOUTH) < 0) || (ioctl(_fd, UI_SET_KEYBIT, BTN_EAST) < 0)
+            || (ioctl(_fd, UI_SET_ABSBIT, ABS_X) < 0) || (ioctl(_fd, UI_SET_ABSBIT, ABS_HAT0X) < 0)
+            || (::write(_fd, &dev, sizeof(dev)) != (ssize_t)sizeof(dev)) || (ioctl(_fd, UI_DEV_CREATE) < 0) )
+        {
+            ::close(_fd);
+            _fd = -1;
+        }
+    }
+    ~VirtualGamepad() { destroy(); }
+    bool isOpen() const { return (_fd >= 0); }
+    void destroy()
+    {
+        if( _fd < 0 ) return;
+        ioctl(_fd, UI_DEV_DESTROY);
+        ::close(_fd);
+        _fd = -1;
+    }
+    void emit(unsigned short type, unsigned short code, int value)
+    {
+        struct input_event ev;
+        memset(&ev, 0, sizeof(ev));
+        ev.type = type;
+        ev.code = code;
+        ev.value = value;
+        QVERIFY(::write(_fd, &ev, sizeof(ev)) == (ssize_t)sizeof(ev));
+    }
+private:
+    int _fd;
+};
+
+//-----------------------------------------------------------------------------
+/// Records notifications from the manager
+class JoystickListener : public grape::EvdevJoystickManager::IListener
+//-----------------------------------------------------------------------------
+{
+public:
+    JoystickListener() : connected(-1), disconnected(-1), changes(0) {}
+    void onConnected(unsigned int device) { connected = (int)device; }
+    void onDisconnected(unsigned int device) { disconnected = (int)device; }
+    void onStateChanged(unsigned int) { ++changes; }
+    int connected;
+    int disconnected;
+    int changes;
+};
+
+//-----------------------------------------------------------------------------
+static int findDevice(const grape::EvdevJoystickManager& sticks)
+//-----------------------------------------------------------------------------
+{
+    for(unsigned int i = 0; i < grape::EvdevJoystickManager::MAX_DEVICES; ++i)
+    {
+        if( sticks.isConnected(i) && (sticks.getName(i) == DEVICE_NAME) )
+        {
+            return (int)i;
+        }
+    }
+    return -1;
+}
+
+//=============================================================================
+TestEvdevJoystickManager::TestEvdevJoystickManager()
+//=============================================================================
+{
+}
+
+//-----------------------------------------------------------------------------
+void TestEvdevJoystickManager::initTestCase()
+//-----------------------------------------------------------------------------
+{
+    if( access("/dev/uinput", W_OK) != 0 )
+    {
+        QSKIP("uinput not available", SkipAll);
+    }
+}
+
+//-----------------------------------------------------------------------------
+void TestEvdevJoystickManager::cleanupTestCase()
+//-----------------------------------------------------------------------------
+{
+}
+
+//-----------------------------------------------------------------------------
+void TestEvdevJoystickManager::hotplugAndEvents()
+//-----------------------------------------------------------------------------
+{
+    grape::EvdevJoystickManager sticks;
+    JoystickListener listener;
+    sticks.setListener(&listener);
+
+    // plugged in after the manager started
+    VirtualGamepad pad;
+    QVERIFY(pad.isOpen());
+    for(int i = 0; (i < 50) && (findDevice(sticks) < 0); ++i)
+    {
+        sticks.process(100);
+    }
+    const int device = findDevice(sticks);
+    QVERIFY(device >= 0);
+    QCOMPARE(listener.connected, device);
+
+    const grape::EvdevJoystickManager::State& state = sticks.getState(device);
+    QCOMPARE(state.numAxes, 2U);
+    QCOMPARE(state.numButtons, 2U);
+
+    // events between reports are applied together, with the report's timestamp
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    const long long beforeUs = (long long)ts.tv_sec * 1000000LL + ts.tv_nsec / 1000;
+    pad.emit(EV_ABS, ABS_X, 100);
+    pad.emit(EV_ABS, ABS_HAT0X, -1);
+    pad.emit(EV_KEY, BTN_EAST, 1);
+    pad.emit(EV_SYN, SYN_REPORT, 0);
+    QVERIFY(sticks.process(1000) >= 1U);
+    QCOMPARE(listener.changes, 1);
+    QCOMPARE(state.axes[0], 32767);
+    QCOMPARE(state.axes[1], -32767);
+    QCOMPARE((int)state.buttons[0], 0);
+    QCOMPARE((int)state.buttons[1], 1);
+    QVERIFY(state.timestampUs >= beforeUs);
+
+    // dead zone
+    sticks.setDeadZone(2000);
+    pad.emit(EV_ABS, ABS_X, 5);
+    pad.emit(EV_SYN, SYN_REPORT, 0);
+    QVERIFY(sticks.process(1000) >= 1U);
+    QCOMPARE(state.axes[0], 0);
+
+    // unplugged
+    pad.destroy();
+    for(int i = 0; (i < 50) && sticks.isConnected(device); ++i)
+    {
+        sticks.process(100);
+    }
+    QVERIFY(!sticks.isConnected(device));
+    QCOMPARE(listener.disconnected, device);
+}
@@ -0,0 +1,19 @@
+#include <QString>
+#include <QtTest>
+#include <io/EvdevJoystickManager.h>
+
+//=============================================================================
+/// \brief Test class for EvdevJoystickManager
+//=============================================================================
+class TestEvdevJoystickManager : public QObject
+{
+    Q_OBJECT
+
+public:
+    TestEvdevJoystickManager();
+
+private Q_SLOTS:
+    void cleanupTestCase();
+    void initTestCase();
+    void hotplugAndEvents();
+};
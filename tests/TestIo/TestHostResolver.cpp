@@ -0,0 +1,149 @@
+#include "TestHostResolver.h"
+#include <io/TcpSocket.h>
+#include <string.h>
+#include <stdio.h>
+
+static const int TEST_PORT = 43213;
+
+//=============================================================================
+TestHostResolver::TestHostResolver()
+//=============================================================================
+{
+}
+
+//-----------------------------------------------------------------------------
+void TestHostResolver::initTestCase()
+//-----------------------------------------------------------------------------
+{
+    grape::TcpSocket init; // initialises socket library on windows
+}
+
+//-----------------------------------------------------------------------------
+void TestHostResolver::cleanupTestCase()
+//-----------------------------------------------------------------------------
+{
+}
+
+//-----------------------------------------------------------------------------
+void TestHostResolver::resolveNumeric()
+//-----------------------------------------------------------------------------
+{
+    grape::HostResolver resolver;
+
+    grape::HostResolver::Address v4 = resolver.resolve("127.0.0.1", TEST_PORT);
+    QCOMPARE(v4.family(), (int)AF_INET);
+    const struct sockaddr_in* pV4 = (const struct sockaddr_in*)v4.get();
+    QCOMPARE(ntohs(pV4->sin_port), (unsigned short)TEST_PORT);
+    QCOMPARE(ntohl(pV4->sin_addr.s_addr), (unsigned int)INADDR_LOOPBACK);
+
+    // cached entry, different port
+    grape::HostResolver::Address again = resolver.resolve("127.0.0.1", TEST_PORT + 1);
+    QCOMPARE(ntohs(((const struct sockaddr_in*)again.get())->sin_port), (unsigned short)(TEST_PORT + 1));
+
+    grape::HostResolver::Address v6 = resolver.resolve("::1", TEST_PORT, grape::HostResolver::IPV6);
+    QCOMPARE(v6.family(), (int)AF_INET6);
+    const struct sockaddr_in6* pV6 = (const struct sockaddr_in6*)v6.get();
+    QCOMPARE(ntohs(pV6->sin6_port), (unsigned short)TEST_PORT);
+    QVERIFY(memcmp(&pV6->sin6_addr, &in6addr_loopback, sizeof(in6addr_loopback)) == 0);
+}
+
+//-----------------------------------------------------------------------------
+void TestHostResolver::asyncResolve()
+//-----------------------------------------------------------------------------
+{
+    grape::HostResolver resolver(50);
+    grape::HostResolver::Address addr;
+
+    // first call starts a background lookup
+    QVERIFY(!resolver.tryResolve("localhost", TEST_PORT, addr));
+    bool found = false;
+    for(int tries = 0; (tries < 2000) && !found; ++tries)
+    {
+        QTest::qSleep(1);
+        found = resolver.tryResolve("localhost", TEST_PORT, addr);
+    }
+    QVERIFY2(found, "background lookup did not complete");
+    QCOMPARE(addr.family(), (int)AF_INET);
+
+    // expired entries are still served while being refreshed
+    QTest::qSleep(60);
+    QVERIFY(resolver.tryResolve("localhost", TEST_PORT, addr));
+}
+
+//-----------------------------------------------------------------------------
+void TestHostResolver::connectResolved()
+//-----------------------------------------------------------------------------
+{
+    grape::TcpSocket server;
+    server.allowPortReuse(true);
+    server.bind(TEST_PORT);
+    server.listen(1);
+
+    grape::TcpSocket client;
+    QVERIFY(client.connect(grape::HostResolver::instance().resolve("127.0.0.1", TEST_PORT)));
+    grape::TcpSocket* pPeer = server.accept();
+    const unsigned char msg[] = "hi";
+    QCOMPARE(client.write(msg, sizeof(msg)), (unsigned int)sizeof(msg));
+    unsigned char buf[8];
+    QVERIFY(pPeer->waitForRead(1000) == grape::IDataPort::PORT_OK);
+    QCOMPARE(pPeer->readn(buf, sizeof(buf)), (unsigned int)sizeof(msg));
+    delete pPeer;
+}
+
+//-----------------------------------------------------------------------------
+void TestHostResolver::cacheLimit()
+//-----------------------------------------------------------------------------
+{
+    grape::HostResolver resolver(50, 4);
+
+    // the oldest entries make room for new ones
+    char host[16];
+    for(int i = 1; i <= 10; ++i)
+    {
+        sprintf(host, "127.0.0.%d", i);
+        grape::HostResolver::Address addr = resolver.resolve(host, TEST_PORT);
+        QCOMPARE(ntohl(((const struct sockaddr_in*)addr.get())->sin_addr.s_addr), (unsigned int)(INADDR_LOOPBACK - 1 + i));
+        QVERIFY(resolver.cacheSize() <= 4U);
+    }
+    QCOMPARE(resolver.cacheSize(), 4U);
+
+    // expired entries go first
+    QTest::qSleep(60);
+    resolver.resolve("127.0.0.11", TEST_PORT);
+    QCOMPARE(resolver.cacheSize(), 1U);
+
+    // failed lookups are cached too, and count against the limit
+    bool thrown = false;
+    try
+    {
+        resolver.resolve("no.such.host.invalid", TEST_PORT);
+    }
+    catch(grape::HostInfoException&)
+    {
+        thrown = true;
+    }
+    QVERIFY(thrown);
+    QCOMPARE(resolver.cacheSize(), 2U);
+    resolver.clear();
+    QCOMPARE(resolver.cacheSize(), 0U);
+}
+
+//-----------------------------------------------------------------------------
+void TestHostResolver::failedLookup()
+//-----------------------------------------------------------------------------
+{
+    grape::HostResolver resolver;
+    grape::HostResolver::Address addr;
+
+    // an IPv6 literal has no IPv4 address, so the lookup fails without network access
+    for(int tries = 0; tries < 200; ++tries)
+    {
+        QTest::qSleep(1);
+        QVERIFY(!resolver.tryResolve("::1", TEST_PORT, addr));
+    }
+
+    // the failure is cached, so the host is not queued again on every call.
+    // Entries pending a lookup survive clear()
+    resolver.clear();
+    QCOMPARE(resolver.cacheSize(), 0U);
+}
@@ -0,0 +1,23 @@
+#include <QString>
+#include <QtTest>
+#include <io/HostResolver.h>
+
+//=============================================================================
+/// \brief Test class for HostResolver
+//=============================================================================
+class TestHostResolver : public QObject
+{
+    Q_OBJECT
+
+public:
+    TestHostResolver();
+
+private Q_SLOTS:
+    void cleanupTestCase();
+    void initTestCase();
+    void resolveNumeric();
+    void asyncResolve();
+    void connectResolved();
+    void cacheLimit();
+    void failedLookup();
+};
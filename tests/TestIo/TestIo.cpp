@@ -1,4 +1,23 @@
 #include "TestSerialPort.h"
+#include "TestMessageStream.h"
+#include "TestHostResolver.h"
+#include "TestTcpSocket.h"
+#include "TestReliableUdpChannel.h"
+#include "TestPacketFramer.h"
+#ifndef WIN32
+#include "TestIoReactor.h"
+#include "TestIoUring.h"
+#include "TestTcpSendQueue.h"
+#include "TestUdpSocket.h"
+#include "TestLocalSocket.h"
+#ifndef __ANDROID__
+#include "TestSharedMemoryPort.h"
+#endif
+#include "TestPacketCapturePort.h"
+#include "TestCanPort.h"
+#include "TestModbusRtuMaster.h"
+#include "TestEvdevJoystickManager.h"
+#endif
 
 //=============================================================================
 int main(int argc, char *argv[])
@@ -6,5 +25,54 @@ int main(int argc, char *argv[])
 {
     TestSerialPort port;
     QTest::qExec(&port, argc, argv);
+
+    TestMessageStream stream;
+    QTest::qExec(&stream, argc, argv);
+
+    TestHostResolver resolver;
+    QTest::qExec(&resolver, argc, argv);
+
+    TestTcpSocket tcp;
+    QTest::qExec(&tcp, argc, argv);
+
+    TestReliableUdpChannel reliable;
+    QTest::qExec(&reliable, argc, argv);
+
+    TestPacketFramer framer;
+    QTest::qExec(&framer, argc, argv);
+
+#ifndef WIN32
+    TestIoReactor reactor;
+    QTest::qExec(&reactor, argc, argv);
+
+    TestIoUring uring;
+    QTest::qExec(&uring, argc, argv);
+
+    TestTcpSendQueue sendQueue;
+    QTest::qExec(&sendQueue, argc, argv);
+
+    TestUdpSocket udp;
+    QTest::qExec(&udp, argc, argv);
+
+    TestLocalSocket local;
+    QTest::qExec(&local, argc, argv);
+
+#ifndef __ANDROID__
+    TestSharedMemoryPort shm;
+    QTest::qExec(&shm, argc, argv);
+#endif
+
+    TestPacketCapturePort capture;
+    QTest::qExec(&capture, argc, argv);
+
+    TestCanPort can;
+    QTest::qExec(&can, argc, argv);
+
+    TestModbusRtuMaster modbus;
+    QTest::qExec(&modbus, argc, argv);
+
+    TestEvdevJoystickManager joystick;
+    QTest::qExec(&joystick, argc, argv);
+#endif
 }
 
@@ -4,9 +4,22 @@ TARGET = TestIo
 include(../grapetests.pri)
 
 HEADERS += \
-    TestSerialPort.h
+    TestSerialPort.h \
+    TestMessageStream.h \
+    TestHostResolver.h \
+    TestTcpSocket.h \
+    TestReliableUdpChannel.h \
+    TestPacketFramer.h
 SOURCES += \
     TestSerialPort.cpp \
+    TestMessageStream.cpp \
+    TestHostResolver.cpp \
+    TestTcpSocket.cpp \
+    TestReliableUdpChannel.cpp \
+    TestPacketFramer.cpp \
     TestIo.cpp
 
-
+unix:HEADERS += PseudoTerminal.h TestIoReactor.h TestIoUring.h TestTcpSendQueue.h TestUdpSocket.h TestLocalSocket.h TestPacketCapturePort.h TestCanPort.h TestModbusRtuMaster.h TestEvdevJoystickManager.h
+unix:SOURCES += TestIoReactor.cpp TestIoUring.cpp TestTcpSendQueue.cpp TestUdpSocket.cpp TestLocalSocket.cpp TestPacketCapturePort.cpp TestCanPort.cpp TestModbusRtuMaster.cpp TestEvdevJoystickManager.cpp
+unix:!android:HEADERS += TestSharedMemoryPort.h
+unix:!android:SOURCES += TestSharedMemoryPort.cpp
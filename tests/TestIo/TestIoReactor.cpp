@@ -0,0 +1,160 @@
+#include "TestIoReactor.h"
+#include <arpa/inet.h>
+#include <string.h>
+
+static const int TEST_PORT = 43210;
+
+//=============================================================================
+/// \brief Counts events and optionally drains or unregisters the port
+//=============================================================================
+class CountingHandler : public grape::IoReactor::IHandler
+{
+public:
+    CountingHandler(grape::IDataPort& port, bool drain)
+        : pReactor(NULL), nEvents(0), nBytes(0), _port(port), _drain(drain) {}
+
+    void onEvent(int fd, unsigned int events)
+    {
+        ++nEvents;
+        if( _drain )
+        {
+            while( _port.availableToRead() )
+            {
+                nBytes += _port.readAll(_buffer);
+            }
+        }
+        if( pReactor )
+        {
+            pReactor->remove(fd);
+        }
+    }
+
+    grape::IoReactor* pReactor;
+    int nEvents;
+    unsigned int nBytes;
+private:
+    grape::IDataPort& _port;
+    bool _drain;
+    std::vector<unsigned char> _buffer;
+};
+
+//=============================================================================
+TestIoReactor::TestIoReactor()
+//=============================================================================
+{
+}
+
+//-----------------------------------------------------------------------------
+void TestIoReactor::initTestCase()
+//-----------------------------------------------------------------------------
+{
+    memset(&_serverAddr, 0, sizeof(_serverAddr));
+    _serverAddr.sin_family = AF_INET;
+    _serverAddr.sin_port = htons(TEST_PORT);
+    _serverAddr.sin_addr.s_addr = inet_addr("127.0.0.1");
+}
+
+//-----------------------------------------------------------------------------
+void TestIoReactor::cleanupTestCase()
+//-----------------------------------------------------------------------------
+{
+}
+
+//-----------------------------------------------------------------------------
+void TestIoReactor::addRemove()
+//-----------------------------------------------------------------------------
+{
+    grape::IoReactor reactor;
+    grape::UdpServer server(TEST_PORT);
+    CountingHandler handler(server, true);
+
+    reactor.add(server, &handler);
+    QVERIFY2(reactor.size() == 1, "size after add");
+
+    try
+    {
+        reactor.add(server, &handler);
+        QFAIL("duplicate registration accepted");
+    }
+    catch(grape::IoEventHandlingException&)
+    {
+    }
+
+    reactor.remove(server);
+    QVERIFY2(reactor.size() == 0, "size after remove");
+}
+
+//-----------------------------------------------------------------------------
+void TestIoReactor::timeout()
+//-----------------------------------------------------------------------------
+{
+    grape::IoReactor reactor;
+    grape::UdpServer server(TEST_PORT);
+    CountingHandler handler(server, true);
+    reactor.add(server, &handler);
+
+    QVERIFY2(reactor.dispatch(10) == 0, "events dispatched with no data");
+    QVERIFY2(handler.nEvents == 0, "handler called with no data");
+}
+
+//-----------------------------------------------------------------------------
+void TestIoReactor::readEvent()
+//-----------------------------------------------------------------------------
+{
+    grape::IoReactor reactor;
+    grape::UdpServer server(TEST_PORT);
+    grape::UdpSocket client;
+    CountingHandler handler(server, true);
+    reactor.add(server, &handler);
+
+    std::vector<unsigned char> msg(16, 0xAA);
+    client.writeTo(_serverAddr, msg);
+
+    QVERIFY2(reactor.dispatch(1000) == 1, "read event not dispatched");
+    QVERIFY2(handler.nEvents == 1, "handler not called");
+    QVERIFY2(handler.nBytes == msg.size(), "wrong number of bytes read");
+}
+
+//-----------------------------------------------------------------------------
+void TestIoReactor::edgeTriggered()
+//-----------------------------------------------------------------------------
+{
+    grape::IoReactor reactor;
+    grape::UdpServer server(TEST_PORT);
+    grape::UdpSocket client;
+    CountingHandler handler(server, false); // does not drain the port
+    reactor.add(server, &handler);
+
+    std::vector<unsigned char> msg(16, 0x55);
+    client.writeTo(_serverAddr, msg);
+
+    QVERIFY2(reactor.dispatch(1000) == 1, "read event not dispatched");
+    QVERIFY2(reactor.dispatch(10) == 0, "edge triggered event repeated");
+
+    // level triggered registration reports pending data again
+    reactor.modify(server, grape::IoReactor::READABLE | grape::IoReactor::LEVEL_TRIGGERED);
+    QVERIFY2(reactor.dispatch(1000) == 1, "level triggered event not dispatched");
+    QVERIFY2(reactor.dispatch(1000) == 1, "level triggered event not repeated");
+    QVERIFY2(handler.nEvents == 3, "unexpected number of handler calls");
+}
+
+//-----------------------------------------------------------------------------
+void TestIoReactor::removeInHandler()
+//-----------------------------------------------------------------------------
+{
+    grape::IoReactor reactor;
+    grape::UdpServer server(TEST_PORT);
+    grape::UdpSocket client;
+    CountingHandler handler(server, true);
+    handler.pReactor = &reactor;
+    reactor.add(server, &handler);
+
+    std::vector<unsigned char> msg(16, 0x11);
+    client.writeTo(_serverAddr, msg);
+
+    QVERIFY2(reactor.dispatch(1000) == 1, "read event not dispatched");
+    QVERIFY2(reactor.size() == 0, "port not removed by handler");
+
+    client.writeTo(_serverAddr, msg);
+    QVERIFY2(reactor.dispatch(10) == 0, "event dispatched for removed port");
+}
@@ -0,0 +1,26 @@
+#include <QString>
+#include <QtTest>
+#include <io/IoReactor.h>
+#include <io/UdpServer.h>
+
+//=============================================================================
+/// \brief Test class for IoReactor
+//=============================================================================
+class TestIoReactor : public QObject
+{
+    Q_OBJECT
+
+public:
+    TestIoReactor();
+
+private Q_SLOTS:
+    void cleanupTestCase();
+    void initTestCase();
+    void addRemove();
+    void timeout();
+    void readEvent();
+    void edgeTriggered();
+    void removeInHandler();
+private:
+    struct sockaddr_in _serverAddr;
+};
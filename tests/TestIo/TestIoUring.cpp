@@ -0,0 +1,193 @@
+#include "TestIoUring.h"
+#include <io/TcpSocket.h>
+
+static const int TEST_PORT = 43219;
+
+//-----------------------------------------------------------------------------
+/// A connected pair of TCP sockets over loopback
+class TcpPair
+//-----------------------------------------------------------------------------
+{
+public:
+    TcpPair() : pServer(NULL)
+    {
+        listener.allowPortReuse(true);
+        listener.bind(TEST_PORT);
+        listener.listen(1);
+        if( client.connect("127.0.0.1", TEST_PORT) )
+        {
+            pServer = listener.accept();
+        }
+    }
+    ~TcpPair() { delete pServer; }
+    grape::TcpSocket listener;
+    grape::TcpSocket client;
+    grape::TcpSocket* pServer;
+};
+
+//-----------------------------------------------------------------------------
+/// Submit queued requests and collect 'count' completions, indexed by tag
+static void complete(grape::IoUring& ring, unsigned int count, int* results)
+//-----------------------------------------------------------------------------
+{
+    unsigned int done = 0;
+    ring.submit(count);
+    while( done < count )
+    {
+        grape::IoUring::Completion c[8];
+        const unsigned int n = ring.reap(c, 8);
+        for(unsigned int i = 0; i < n; ++i)
+        {
+            results[c[i].tag] = c[i].result;
+        }
+        done += n;
+        if( (n == 0) && (done < count) )
+        {
+            ring.submit(1);
+        }
+    }
+}
+
+//=============================================================================
+TestIoUring::TestIoUring()
+//=============================================================================
+{
+}
+
+//-----------------------------------------------------------------------------
+void TestIoUring::initTestCase()
+//-----------------------------------------------------------------------------
+{
+}
+
+//-----------------------------------------------------------------------------
+void TestIoUring::cleanupTestCase()
+//-----------------------------------------------------------------------------
+{
+}
+
+//-----------------------------------------------------------------------------
+void TestIoUring::setupFailure()
+//-----------------------------------------------------------------------------
+{
+    // an invalid depth fails setup the same way as a kernel without io_uring.
+    // Callers fall back to plain reads and writes on IoException
+    bool thrown = false;
+    try
+    {
+        grape::IoUring ring(grape::IoUring::isSupported() ? 0 : 8);
+    }
+    catch(grape::IoException&)
+    {
+        thrown = true;
+    }
+    QVERIFY(thrown);
+}
+
+//-----------------------------------------------------------------------------
+void TestIoUring::sendRecv()
+//-----------------------------------------------------------------------------
+{
+    if( !grape::IoUring::isSupported() )
+    {
+        QSKIP("io_uring not supported by this kernel", SkipAll);
+    }
+
+    TcpPair pair;
+    QVERIFY(pair.pServer != NULL);
+    grape::IoUring ring(8);
+
+    // one way in each direction, in a single submission
+    const unsigned char ping[] = "ping";
+    const unsigned char pong[] = "pong!";
+    unsigned char rxServer[16] = {0};
+    unsigned char rxClient[16] = {0};
+    ring.submitRecv(*pair.pServer, rxServer, sizeof(rxServer), 0);
+    ring.submitRecv(pair.client, rxClient, sizeof(rxClient), 1);
+    ring.submitSend(pair.client, ping, sizeof(ping), 2);
+    ring.submitSend(*pair.pServer, pong, sizeof(pong), 3);
+    QCOMPARE(ring.pending(), 4U);
+
+    int results[4] = {0};
+    complete(ring, 4, results);
+    QCOMPARE(ring.pending(), 0U);
+    QCOMPARE(results[0], (int)sizeof(ping));
+    QCOMPARE(results[1], (int)sizeof(pong));
+    QCOMPARE(results[2], (int)sizeof(ping));
+    QCOMPARE(results[3], (int)sizeof(pong));
+    QVERIFY(memcmp(rxServer, ping, sizeof(ping)) == 0);
+    QVERIFY(memcmp(rxClient, pong, sizeof(pong)) == 0);
+
+    // errors are reported in the completion
+    pair.client.close();
+    ring.submitRecv(*pair.pServer, rxServer, sizeof(rxServer), 0);
+    complete(ring, 1, results);
+    QCOMPARE(results[0], 0); // orderly shutdown
+}
+
+//-----------------------------------------------------------------------------
+void TestIoUring::fixedSocketsAndBuffers()
+//-----------------------------------------------------------------------------
+{
+    if( !grape::IoUring::isSupported() )
+    {
+        QSKIP("io_uring not supported by this kernel", SkipAll);
+    }
+
+    grape::IoUring ring(8);
+    int results[2] = {0};
+    unsigned char memory[64] = "fixed buffer";
+    grape::IoUring::Buffer buffers[] = { {memory, 32}, {memory + 32, 32} };
+    ring.registerBuffers(buffers, 2);
+
+    TcpPair pair;
+    QVERIFY(pair.pServer != NULL);
+    grape::IpSocket* sockets[] = { &pair.client, pair.pServer };
+    ring.registerSockets(sockets, 2);
+
+    ring.submitReadFixed(*pair.pServer, 1, 0, 32, 0);
+    ring.submitWriteFixed(pair.client, 0, 0, 13, 1);
+    complete(ring, 2, results);
+    QCOMPARE(results[0], 13);
+    QCOMPARE(results[1], 13);
+    QVERIFY(memcmp(memory + 32, "fixed buffer", 13) == 0);
+
+    // requests outside a registered buffer are rejected up front
+    bool thrown = false;
+    try
+    {
+        ring.submitWriteFixed(pair.client, 0, 30, 8, 1);
+    }
+    catch(grape::IoException&)
+    {
+        thrown = true;
+    }
+    QVERIFY(thrown);
+
+    // a new socket that reuses the descriptor of a closed registered socket
+    // must not be routed to the old registered file
+    const int oldFd = pair.client.getFd();
+    pair.client.close();
+    grape::TcpSocket client;
+    QVERIFY(client.connect("127.0.0.1", TEST_PORT));
+    QCOMPARE(client.getFd(), oldFd);
+    grape::TcpSocket* pServer = pair.listener.accept();
+    QVERIFY(pServer != NULL);
+
+    const unsigned char msg[] = "new connection";
+    unsigned char rx[32] = {0};
+    ring.submitSend(client, msg, sizeof(msg), 1);
+    complete(ring, 1, results);
+    QCOMPARE(results[1], (int)sizeof(msg));
+    QCOMPARE(pServer->waitForRead(1000), grape::IDataPort::PORT_OK);
+    QCOMPARE(pServer->readn(rx, sizeof(rx)), (unsigned int)sizeof(msg));
+    QVERIFY(memcmp(rx, msg, sizeof(msg)) == 0);
+    delete pServer;
+
+    // unregistered sockets keep working through their plain descriptor
+    ring.unregisterSocket(*pair.pServer);
+    const unsigned char bye[] = "bye";
+    ring.submitSend(*pair.pServer, bye, sizeof(bye), 0);
+    complete(ring, 1, results);
+    QCOMPARE(results[0], (int)sizeof(bye));
+}
@@ -0,0 +1,21 @@
+#include <QString>
+#include <QtTest>
+#include <io/IoUring.h>
+
+//=============================================================================
+/// \brief Test class for IoUring
+//=============================================================================
+class TestIoUring : public QObject
+{
+    Q_OBJECT
+
+public:
+    TestIoUring();
+
+private Q_SLOTS:
+    void cleanupTestCase();
+    void initTestCase();
+    void setupFailure();
+    void sendRecv();
+    void fixedSocketsAndBuffers();
+};
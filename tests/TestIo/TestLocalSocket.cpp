@@ -0,0 +1,174 @@
+#include "TestLocalSocket.h"
+#include <unistd.h>
+#include <string.h>
+#include <stdio.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+
+static const char* STREAM_PATH = "/tmp/grape_test_stream.sock";
+static const char* SERVER_PATH = "@grape_test_dgram_server";
+static const char* CLIENT_PATH = "@grape_test_dgram_client";
+
+//=============================================================================
+TestLocalSocket::TestLocalSocket()
+//=============================================================================
+{
+}
+
+//-----------------------------------------------------------------------------
+void TestLocalSocket::initTestCase()
+//-----------------------------------------------------------------------------
+{
+}
+
+//-----------------------------------------------------------------------------
+void TestLocalSocket::cleanupTestCase()
+//-----------------------------------------------------------------------------
+{
+}
+
+//-----------------------------------------------------------------------------
+void TestLocalSocket::streamReadWrite()
+//-----------------------------------------------------------------------------
+{
+    grape::LocalStreamSocket server;
+    server.bind(STREAM_PATH);
+    server.listen(1);
+
+    grape::LocalStreamSocket client;
+    QVERIFY(client.connect(STREAM_PATH));
+    grape::LocalStreamSocket* pPeer = server.accept();
+
+    const unsigned char hdr[] = "head:";
+    const unsigned char body[] = "body";
+    grape::IDataPort::Buffer parts[2] = { {hdr, 5}, {body, 4} };
+    QCOMPARE(client.writev(parts, 2), 9u);
+
+    QVERIFY(pPeer->waitForRead(1000) == grape::IDataPort::PORT_OK);
+    unsigned char buf[16];
+    QCOMPARE(pPeer->readn(buf, sizeof(buf)), 9u);
+    QVERIFY(memcmp(buf, "head:body", 9) == 0);
+
+    // closed peer is reported as an error, not as readable
+    client.close();
+    QVERIFY(pPeer->waitForRead(1000) == grape::IDataPort::PORT_ERROR);
+    delete pPeer;
+
+    server.close();
+    QVERIFY2(access(STREAM_PATH, F_OK) != 0, "socket file not removed on close");
+}
+
+//-----------------------------------------------------------------------------
+void TestLocalSocket::datagramReadWrite()
+//-----------------------------------------------------------------------------
+{
+    grape::LocalDatagramSocket server;
+    server.bind(SERVER_PATH);
+    grape::LocalDatagramSocket client;
+    client.bind(CLIENT_PATH);
+    client.setRemotePeer(SERVER_PATH);
+
+    const unsigned char msg[] = "request";
+    QCOMPARE(client.write(msg, sizeof(msg)), (unsigned int)sizeof(msg));
+
+    unsigned char buf[32];
+    std::string from;
+    QCOMPARE(server.readFrom(buf, sizeof(buf), from), (unsigned int)sizeof(msg));
+    QCOMPARE(from, std::string(CLIENT_PATH));
+
+    const unsigned char reply[] = "reply";
+    QCOMPARE(server.writeTo(from, reply, sizeof(reply)), (unsigned int)sizeof(reply));
+    QCOMPARE(client.readn(buf, sizeof(buf)), (unsigned int)sizeof(reply));
+    QVERIFY(memcmp(buf, reply, sizeof(reply)) == 0);
+}
+
+//-----------------------------------------------------------------------------
+void TestLocalSocket::passDescriptor()
+//-----------------------------------------------------------------------------
+{
+    grape::LocalDatagramSocket server;
+    server.bind(SERVER_PATH);
+    grape::LocalDatagramSocket client;
+    client.setRemotePeer(SERVER_PATH);
+
+    int pipeFds[2];
+    QVERIFY(pipe(pipeFds) == 0);
+
+    const unsigned char tag = 'F';
+    QCOMPARE(client.writeWithFds(&tag, 1, &pipeFds[1], 1), 1u);
+    ::close(pipeFds[1]);
+
+    unsigned char buf[4];
+    int fds[2] = {-1, -1};
+    unsigned int nFds = 2;
+    QCOMPARE(server.readWithFds(buf, sizeof(buf), fds, nFds), 1u);
+    QCOMPARE(nFds, 1u);
+    QCOMPARE(buf[0], tag);
+
+    // the received descriptor writes into the same pipe
+    QVERIFY(::write(fds[0], "x", 1) == 1);
+    char c = 0;
+    QVERIFY(::read(pipeFds[0], &c, 1) == 1);
+    QCOMPARE(c, 'x');
+
+    ::close(fds[0]);
+    ::close(pipeFds[0]);
+}
+
+//-----------------------------------------------------------------------------
+void TestLocalSocket::bindExistingPath()
+//-----------------------------------------------------------------------------
+{
+    // a regular file is not replaced
+    FILE* pFile = fopen(STREAM_PATH, "w");
+    QVERIFY(pFile != NULL);
+    fclose(pFile);
+    bool thrown = false;
+    try
+    {
+        grape::LocalStreamSocket socket;
+        socket.bind(STREAM_PATH);
+    }
+    catch(grape::SocketException&)
+    {
+        thrown = true;
+    }
+    QVERIFY(thrown);
+    struct stat st;
+    QVERIFY((stat(STREAM_PATH, &st) == 0) && S_ISREG(st.st_mode));
+    unlink(STREAM_PATH);
+
+    // nor is a socket in use
+    grape::LocalStreamSocket server;
+    server.bind(STREAM_PATH);
+    server.listen(1);
+    thrown = false;
+    try
+    {
+        grape::LocalStreamSocket intruder;
+        intruder.bind(STREAM_PATH);
+    }
+    catch(grape::SocketException&)
+    {
+        thrown = true;
+    }
+    QVERIFY(thrown);
+    grape::LocalStreamSocket client;
+    QVERIFY(client.connect(STREAM_PATH));
+    server.close();
+
+    // a socket file left behind by a process that died is
+    int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+    struct sockaddr_un addr;
+    memset(&addr, 0, sizeof(addr));
+    addr.sun_family = AF_UNIX;
+    strcpy(addr.sun_path, STREAM_PATH);
+    QCOMPARE(::bind(fd, (struct sockaddr*)&addr, sizeof(addr)), 0);
+    ::close(fd);
+    QCOMPARE(access(STREAM_PATH, F_OK), 0);
+    grape::LocalStreamSocket restarted;
+    restarted.bind(STREAM_PATH);
+    restarted.listen(1);
+    grape::LocalStreamSocket client2;
+    QVERIFY(client2.connect(STREAM_PATH));
+}
@@ -0,0 +1,23 @@
+#include <QString>
+#include <QtTest>
+#include <io/LocalStreamSocket.h>
+#include <io/LocalDatagramSocket.h>
+
+//=============================================================================
+/// \brief Test class for LocalStreamSocket and LocalDatagramSocket
+//=============================================================================
+class TestLocalSocket : public QObject
+{
+    Q_OBJECT
+
+public:
+    TestLocalSocket();
+
+private Q_SLOTS:
+    void cleanupTestCase();
+    void initTestCase();
+    void streamReadWrite();
+    void datagramReadWrite();
+    void passDescriptor();
+    void bindExistingPath();
+};
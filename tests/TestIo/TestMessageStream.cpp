@@ -0,0 +1,232 @@
+#include "TestMessageStream.h"
+
+static const int TEST_PORT = 43212;
+
+//=============================================================================
+TestMessageStream::TestMessageStream()
+//=============================================================================
+    : _pServer(NULL), _pClient(NULL), _pPeer(NULL)
+{
+}
+
+//-----------------------------------------------------------------------------
+void TestMessageStream::initTestCase()
+//-----------------------------------------------------------------------------
+{
+    _pServer = new grape::TcpSocket;
+    _pServer->allowPortReuse(true);
+    _pServer->bind(TEST_PORT);
+    _pServer->listen(1);
+
+    _pClient = new grape::TcpSocket;
+    QVERIFY2(_pClient->connect("127.0.0.1", TEST_PORT), "connect failed");
+    _pPeer = _pServer->accept();
+}
+
+//-----------------------------------------------------------------------------
+void TestMessageStream::cleanupTestCase()
+//-----------------------------------------------------------------------------
+{
+    delete _pPeer;
+    delete _pClient;
+    delete _pServer;
+}
+
+//-----------------------------------------------------------------------------
+void TestMessageStream::sendReceive()
+//-----------------------------------------------------------------------------
+{
+    grape::MessageStream tx(*_pClient);
+    grape::MessageStream rx(*_pPeer, 1024);
+
+    // messages of varying size, including an empty message
+    for(unsigned int i = 0; i < 10; ++i)
+    {
+        std::vector<unsigned char> msg(i * 10, (unsigned char)i);
+        tx.send(msg.empty() ? NULL : &msg[0], msg.size());
+    }
+
+    const unsigned char a[] = "multi";
+    const unsigned char b[] = "part";
+    grape::IDataPort::Buffer parts[2] = {{a, 5}, {b, 4}};
+    tx.send(parts, 2);
+
+    unsigned int nReceived = 0;
+    grape::MessageStream::Message msg;
+    while( nReceived < 11 )
+    {
+        QVERIFY2(_pPeer->waitForRead(1000) == grape::IDataPort::PORT_OK, "timed out waiting for messages");
+        rx.receive();
+        while( rx.next(msg) )
+        {
+            if( nReceived < 10 )
+            {
+                QCOMPARE(msg.size, nReceived * 10);
+                for(unsigned int i = 0; i < msg.size; ++i)
+                {
+                    QVERIFY2(msg.pData[i] == nReceived, "payload mismatch");
+                }
+            }
+            else
+            {
+                QCOMPARE(msg.size, 9u);
+                QVERIFY2(memcmp(msg.pData, "multipart", 9) == 0, "multipart payload mismatch");
+            }
+            ++nReceived;
+        }
+    }
+    QCOMPARE(rx.pendingBytes(), 0u);
+}
+
+//-----------------------------------------------------------------------------
+void TestMessageStream::fragmentedReceive()
+//-----------------------------------------------------------------------------
+{
+    // small buffer forces the partial message to be moved to the front
+    grape::MessageStream rx(*_pPeer, 64, 96);
+
+    // write header and payload of several messages one byte at a time
+    static const unsigned int N_MSGS = 20;
+    static const unsigned int MSG_SIZE = 50;
+    std::vector<unsigned char> stream;
+    for(unsigned int i = 0; i < N_MSGS; ++i)
+    {
+        unsigned char header[4] = {0, 0, 0, (unsigned char)MSG_SIZE};
+        stream.insert(stream.end(), header, header + 4);
+        stream.insert(stream.end(), MSG_SIZE, (unsigned char)i);
+    }
+
+    unsigned int nReceived = 0;
+    grape::MessageStream::Message msg;
+    for(size_t i = 0; i < stream.size(); ++i)
+    {
+        QCOMPARE(_pClient->write(&stream[i], 1), 1u);
+        QVERIFY2(_pPeer->waitForRead(1000) == grape::IDataPort::PORT_OK, "timed out waiting for data");
+        rx.receive();
+        while( rx.next(msg) )
+        {
+            QCOMPARE(msg.size, MSG_SIZE);
+            QVERIFY2(msg.pData[0] == nReceived && msg.pData[MSG_SIZE - 1] == nReceived, "payload mismatch");
+            ++nReceived;
+        }
+    }
+    QCOMPARE(nReceived, N_MSGS);
+}
+
+//-----------------------------------------------------------------------------
+void TestMessageStream::oversizeMessage()
+//-----------------------------------------------------------------------------
+{
+    grape::MessageStream tx(*_pClient);
+    grape::MessageStream rx(*_pPeer, 16);
+
+    std::vector<unsigned char> msg(17, 0);
+    tx.send(&msg[0], msg.size());
+
+    QVERIFY2(_pPeer->waitForRead(1000) == grape::IDataPort::PORT_OK, "timed out waiting for data");
+    rx.receive();
+    grape::MessageStream::Message m;
+    try
+    {
+        rx.next(m);
+        QFAIL("oversize message accepted");
+    }
+    catch(grape::IoReadException&)
+    {
+    }
+}
+
+//-----------------------------------------------------------------------------
+void TestMessageStream::bogusHeader()
+//-----------------------------------------------------------------------------
+{
+    // a length near UINT_MAX must not wrap when the receive buffer is compacted
+    grape::MessageStream rx(*_pPeer, 16, 32);
+
+    const unsigned char filler[] = {0, 0, 0, 4, 'a', 'b', 'c', 'd'};
+    const unsigned char header[] = {0xff, 0xff, 0xff, 0xfe};
+    QCOMPARE(_pClient->write(filler, sizeof(filler)), (unsigned int)sizeof(filler));
+    QCOMPARE(_pClient->write(header, sizeof(header)), (unsigned int)sizeof(header));
+
+    grape::MessageStream::Message m;
+    bool thrown = false;
+    while( !thrown )
+    {
+        QVERIFY2(_pPeer->waitForRead(1000) == grape::IDataPort::PORT_OK, "timed out waiting for data");
+        rx.receive();
+        try
+        {
+            while( rx.next(m) )
+            {
+                QCOMPARE(m.size, 4u);
+            }
+        }
+        catch(grape::IoReadException&)
+        {
+            thrown = true;
+        }
+    }
+
+    // the bogus header stays pending, compacting it again must not crash
+    try
+    {
+        rx.receive();
+    }
+    catch(grape::IoException&)
+    {
+    }
+    rx.reset();
+}
+
+//-----------------------------------------------------------------------------
+void TestMessageStream::maxMessageSizeLimit()
+//-----------------------------------------------------------------------------
+{
+    bool thrown = false;
+    try
+    {
+        grape::MessageStream rx(*_pPeer, 0xfffffffeU);
+    }
+    catch(grape::IoException&)
+    {
+        thrown = true;
+    }
+    QVERIFY2(thrown, "maximum message size overflow accepted");
+}
+
+/// Port that never accepts any data
+class StalledPort : public grape::IDataPort
+{
+public:
+    void close() throw() {}
+    unsigned int readAll(std::vector<unsigned char>&) { return 0; }
+    unsigned int readn(std::vector<unsigned char>&, unsigned int) { return 0; }
+    unsigned int readn(unsigned char*, unsigned int) { return 0; }
+    unsigned int availableToRead() { return 0; }
+    Status waitForRead(int) { return PORT_TIMEOUT; }
+    void flushRx() {}
+    unsigned int write(const std::vector<unsigned char>&) { return 0; }
+    unsigned int write(const unsigned char*, unsigned int) { return 0; }
+    Status waitForWrite(int) { return PORT_OK; }
+    void flushTx() {}
+};
+
+//-----------------------------------------------------------------------------
+void TestMessageStream::stalledPort()
+//-----------------------------------------------------------------------------
+{
+    StalledPort port;
+    grape::MessageStream tx(port);
+
+    const unsigned char msg[] = "stalled";
+    bool thrown = false;
+    try
+    {
+        tx.send(msg, sizeof(msg));
+    }
+    catch(grape::IoWriteException&)
+    {
+        thrown = true;
+    }
+    QVERIFY2(thrown, "send did not fail on a port that accepts no data");
+}
@@ -0,0 +1,29 @@
+#include <QString>
+#include <QtTest>
+#include <io/MessageStream.h>
+#include <io/TcpSocket.h>
+
+//=============================================================================
+/// \brief Test class for MessageStream
+//=============================================================================
+class TestMessageStream : public QObject
+{
+    Q_OBJECT
+
+public:
+    TestMessageStream();
+
+private Q_SLOTS:
+    void cleanupTestCase();
+    void initTestCase();
+    void sendReceive();
+    void fragmentedReceive();
+    void oversizeMessage();
+    void bogusHeader();
+    void maxMessageSizeLimit();
+    void stalledPort();
+private:
+    grape::TcpSocket* _pServer;
+    grape::TcpSocket* _pClient;
+    grape::TcpSocket* _pPeer;
+};
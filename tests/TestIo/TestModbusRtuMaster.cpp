@@ -0,0 +1,252 @@
+#include "TestModbusRtuMaster.h"
+#include "PseudoTerminal.h"
+#include <pthread.h>
+
+//-----------------------------------------------------------------------------
+/// Modbus RTU slaves 1 and 2 on the master side of a pseudo terminal, each with
+/// 16 holding registers. Other addresses don't respond.
+class ModbusSlaveSimulator
+//-----------------------------------------------------------------------------
+{
+public:
+    static const unsigned int N_REGISTERS = 16;
+
+    ModbusSlaveSimulator() : _stop(false), _started(false)
+    {
+        memset(_registers, 0, sizeof(_registers));
+        if( _pty.isOpen() )
+        {
+            _started = (0 == pthread_create(&_thread, NULL, run, this));
+        }
+    }
+    ~ModbusSlaveSimulator()
+    {
+        _stop = true;
+        if( _started ) pthread_join(_thread, NULL);
+    }
+    bool isOpen() const { return _started; }
+    std::string slaveName() const { return _pty.slaveName(); }
+
+private:
+    static void* run(void* pArg) { ((ModbusSlaveSimulator*)pArg)->serve(); return NULL; }
+
+    void serve()
+    {
+        unsigned char rx[512];
+        unsigned int size = 0;
+        while( !_stop )
+        {
+            const size_t n = _pty.read(rx + size, sizeof(rx) - size, 20);
+            if( n == 0 ) continue;
+            size += (unsigned int)n;
+
+            // requests used here are 8 bytes, except write multiple registers
+            unsigned int frameSize = 8;
+            if( (size >= 7) && (rx[1] == grape::ModbusRtuMaster::WRITE_MULTIPLE_REGISTERS) )
+            {
+                frameSize = 9 + rx[6];
+            }
+            if( (size < frameSize) || (size < 7) ) continue;
+            respond(rx, frameSize);
+            size = 0;
+        }
+    }
+
+    void respond(const unsigned char* rq, unsigned int size)
+    {
+        const unsigned short crc = grape::ModbusRtuMaster::crc16(rq, size - 2);
+        if( (rq[size - 2] != (crc & 0xFF)) || (rq[size - 1] != (crc >> 8)) ) return;
+        if( (rq[0] < 1) || (rq[0] > 2) ) return;
+
+        unsigned short* regs = _registers[rq[0] - 1];
+        const unsigned int address = (rq[2] << 8) | rq[3];
+        const unsigned int count = (rq[1] == grape::ModbusRtuMaster::WRITE_SINGLE_REGISTER) ? 1 : ((rq[4] << 8) | rq[5]);
+        unsigned char tx[256] = { rq[0], rq[1] };
+        unsigned int txSize = 2;
+        if( address + count > N_REGISTERS )
+        {
+            tx[1] |= 0x80;
+            tx[txSize++] = 2; // illegal data address
+        }
+        else if( rq[1] == grape::ModbusRtuMaster::READ_HOLDING_REGISTERS )
+        {
+            tx[txSize++] = (unsigned char)(2 * count);
+            for(unsigned int i = 0; i < count; ++i)
+            {
+                tx[txSize++] = (unsigned char)(regs[address + i] >> 8);
+                tx[txSize++] = (unsigned char)regs[address + i];
+            }
+        }
+        else if( rq[1] == grape::ModbusRtuMaster::WRITE_SINGLE_REGISTER )
+        {
+            regs[address] = (unsigned short)((rq[4] << 8) | rq[5]);
+            memcpy(tx + txSize, rq + 2, 4);
+            txSize += 4;
+        }
+        else if( rq[1] == grape::ModbusRtuMaster::WRITE_MULTIPLE_REGISTERS )
+        {
+            for(unsigned int i = 0; i < count; ++i)
+            {
+                regs[address + i] = (unsigned short)((rq[7 + 2 * i] << 8) | rq[8 + 2 * i]);
+            }
+            memcpy(tx + txSize, rq + 2, 4);
+            txSize += 4;
+        }
+        else
+        {
+            tx[1] |= 0x80;
+            tx[txSize++] = 1; // illegal function
+        }
+        const unsigned short txCrc = grape::ModbusRtuMaster::crc16(tx, txSize);
+        tx[txSize++] = (unsigned char)(txCrc & 0xFF);
+        tx[txSize++] = (unsigned char)(txCrc >> 8);
+        // not PseudoTerminal::write(): QVERIFY is for the test thread only
+        if( ::write(_pty.fd(), tx, txSize) != (ssize_t)txSize ) return;
+    }
+
+private:
+    PseudoTerminal _pty;
+    volatile bool _stop;
+    bool _started;
+    pthread_t _thread;
+    unsigned short _registers[2][N_REGISTERS];
+};
+
+//=============================================================================
+TestModbusRtuMaster::TestModbusRtuMaster()
+//=============================================================================
+{
+}
+
+//-----------------------------------------------------------------------------
+void TestModbusRtuMaster::initTestCase()
+//-----------------------------------------------------------------------------
+{
+}
+
+//-----------------------------------------------------------------------------
+void TestModbusRtuMaster::cleanupTestCase()
+//-----------------------------------------------------------------------------
+{
+}
+
+//-----------------------------------------------------------------------------
+void TestModbusRtuMaster::frameTiming()
+//-----------------------------------------------------------------------------
+{
+    // example request from the Modbus specification
+    const unsigned char request[] = {0x01, 0x03, 0x00, 0x00, 0x00, 0x0A};
+    QCOMPARE((unsigned int)grape::ModbusRtuMaster::crc16(request, sizeof(request)), 0xCDC5U);
+
+    ModbusSlaveSimulator bus;
+    if( !bus.isOpen() )
+    {
+        QSKIP("pseudo terminals not available", SkipAll);
+    }
+    grape::SerialPort port;
+    port.setPortName(bus.slaveName());
+    port.open();
+
+    // 3.5 characters of 11 bits at 9600 baud, fixed above 19200
+    port.setBaudRate(grape::SerialPort::B9600);
+    grape::ModbusRtuMaster master(port);
+    QCOMPARE(master.getFrameGapUs(), 4010U);
+
+    port.setBaudRate(grape::SerialPort::B115200);
+    master.updateTiming();
+    QCOMPARE(master.getFrameGapUs(), 1750U);
+    QCOMPARE(master.getCharacterTimeNs(), 95487U);
+}
+
+//-----------------------------------------------------------------------------
+void TestModbusRtuMaster::pollTable()
+//-----------------------------------------------------------------------------
+{
+    ModbusSlaveSimulator bus;
+    if( !bus.isOpen() )
+    {
+        QSKIP("pseudo terminals not available", SkipAll);
+    }
+    grape::SerialPort port;
+    port.setPortName(bus.slaveName());
+    port.open();
+    port.setBaudRate(grape::SerialPort::B115200);
+    grape::ModbusRtuMaster master(port, 20);
+
+    // write, then poll it back along with a missing slave and a bad address
+    unsigned short written[4] = {0x1234, 0x5678, 0x9ABC, 0xDEF0};
+    grape::ModbusRtuMaster::Request write = {};
+    write.slave = 1;
+    write.function = grape::ModbusRtuMaster::WRITE_MULTIPLE_REGISTERS;
+    write.address = 2;
+    write.count = 4;
+    write.pData = written;
+    QCOMPARE(master.transact(write), grape::ModbusRtuMaster::OK);
+
+    unsigned short readBack[4] = {0};
+    unsigned short other[2] = {0};
+    unsigned short missing[1] = {0};
+    unsigned short outOfRange[2] = {0};
+    grape::ModbusRtuMaster::Request read = write;
+    read.function = grape::ModbusRtuMaster::READ_HOLDING_REGISTERS;
+    read.pData = readBack;
+    const unsigned int p0 = master.addPoll(read);
+    read.slave = 2;
+    read.count = 2;
+    read.pData = other;
+    const unsigned int p1 = master.addPoll(read);
+    read.slave = 3;
+    read.count = 1;
+    read.pData = missing;
+    const unsigned int p2 = master.addPoll(read);
+    read.slave = 2;
+    read.address = 15;
+    read.count = 2;
+    read.pData = outOfRange;
+    const unsigned int p3 = master.addPoll(read);
+    QCOMPARE(master.getPoll(p0).result, grape::ModbusRtuMaster::NOT_RUN);
+
+    static const int CYCLES = 5;
+    for(int i = 0; i < CYCLES; ++i)
+    {
+        QCOMPARE(master.pollCycle(), 2U);
+    }
+    QVERIFY(memcmp(readBack, written, sizeof(written)) == 0);
+    QCOMPARE(master.getPoll(p1).result, grape::ModbusRtuMaster::OK);
+    QCOMPARE(master.getPoll(p2).result, grape::ModbusRtuMaster::TIMEOUT);
+    QCOMPARE(master.getPoll(p3).result, grape::ModbusRtuMaster::EXCEPTION);
+    QCOMPARE((int)master.getPoll(p3).exceptionCode, 2);
+
+    const grape::ModbusRtuMaster::SlaveStatistics& s1 = master.getSlaveStatistics(1);
+    QCOMPARE(s1.requests, (unsigned long long)CYCLES + 1);
+    QCOMPARE(s1.responses, (unsigned long long)CYCLES + 1);
+    QVERIFY(s1.minLatencyUs > 0);
+    QVERIFY(s1.minLatencyUs <= s1.maxLatencyUs);
+    QCOMPARE(master.getSlaveStatistics(2).exceptions, (unsigned long long)CYCLES);
+    QCOMPARE(master.getSlaveStatistics(3).timeouts, (unsigned long long)CYCLES);
+    QVERIFY(master.getBusUtilisation() > 0);
+    QVERIFY(master.getBusUtilisation() <= 1.0);
+    bool outOfRange = false;
+    try
+    {
+        master.getSlaveStatistics(grape::ModbusRtuMaster::MAX_SLAVES);
+    }
+    catch(grape::IoException&)
+    {
+        outOfRange = true;
+    }
+    QVERIFY(outOfRange);
+
+    // invalid requests are rejected before anything is sent
+    read.count = 126;
+    bool thrown = false;
+    try
+    {
+        master.transact(read);
+    }
+    catch(grape::IoException&)
+    {
+        thrown = true;
+    }
+    QVERIFY(thrown);
+}
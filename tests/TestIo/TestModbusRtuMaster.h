@@ -0,0 +1,20 @@
+#include <QString>
+#include <QtTest>
+#include <io/ModbusRtuMaster.h>
+
+//=============================================================================
+/// \brief Test class for ModbusRtuMaster
+//=============================================================================
+class TestModbusRtuMaster : public QObject
+{
+    Q_OBJECT
+
+public:
+    TestModbusRtuMaster();
+
+private Q_SLOTS:
+    void cleanupTestCase();
+    void initTestCase();
+    void frameTiming();
+    void pollTable();
+};
@@ -0,0 +1,20 @@
+#include <QString>
+#include <QtTest>
+#include <io/PacketCapturePort.h>
+
+//=============================================================================
+/// \brief Test class for PacketCapturePort
+//=============================================================================
+class TestPacketCapturePort : public QObject
+{
+    Q_OBJECT
+
+public:
+    TestPacketCapturePort();
+
+private Q_SLOTS:
+    void cleanupTestCase();
+    void initTestCase();
+    void captureLoopback();
+    void blockSizeLimit();
+};
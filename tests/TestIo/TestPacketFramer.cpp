@@ -0,0 +1,160 @@
+#include "TestPacketFramer.h"
+#include <vector>
+
+/// Collects the frames passed to it by PacketFramer
+struct FrameCollector
+{
+    FrameCollector(const unsigned char* pChunk = 0, unsigned int chunkSize = 0)
+        : pChunk(pChunk), chunkSize(chunkSize), copies(0) {}
+
+    void operator()(const unsigned char* pFrame, unsigned int size)
+    {
+        frames.push_back(std::vector<unsigned char>(pFrame, pFrame + size));
+        if( (pFrame < pChunk) || (pFrame >= pChunk + chunkSize) )
+        {
+            ++copies;
+        }
+    }
+
+    const unsigned char* pChunk;
+    unsigned int chunkSize;
+    unsigned int copies;    //!< frames not delivered from within the chunk
+    std::vector< std::vector<unsigned char> > frames;
+};
+
+//=============================================================================
+TestPacketFramer::TestPacketFramer()
+//=============================================================================
+{
+}
+
+//-----------------------------------------------------------------------------
+void TestPacketFramer::initTestCase()
+//-----------------------------------------------------------------------------
+{
+}
+
+//-----------------------------------------------------------------------------
+void TestPacketFramer::cleanupTestCase()
+//-----------------------------------------------------------------------------
+{
+}
+
+//-----------------------------------------------------------------------------
+void TestPacketFramer::cobsSplitChunks()
+//-----------------------------------------------------------------------------
+{
+    // two frames with zeros and a run longer than a COBS block
+    std::vector<unsigned char> a(300);
+    for(unsigned int i = 0; i < a.size(); ++i)
+    {
+        a[i] = (unsigned char)(i % 7 ? i : 0);
+    }
+    const unsigned char b[] = {0, 1, 2, 0};
+
+    unsigned char stream[400];
+    unsigned int size = grape::CobsFraming::encode(&a[0], (unsigned int)a.size(), stream);
+    size += grape::CobsFraming::encode(b, sizeof(b), stream + size);
+
+    // split the stream at every position
+    for(unsigned int split = 0; split <= size; ++split)
+    {
+        unsigned char chunk[400];
+        memcpy(chunk, stream, size);
+
+        grape::PacketFramer<grape::CobsFraming, 512> framer;
+        FrameCollector collector(chunk, size);
+        unsigned int nFrames = framer.push(chunk, split, collector);
+        nFrames += framer.push(chunk + split, size - split, collector);
+
+        QCOMPARE(nFrames, 2U);
+        QVERIFY(collector.frames[0] == a);
+        QVERIFY(collector.frames[1] == std::vector<unsigned char>(b, b + sizeof(b)));
+        QVERIFY(framer.getStatistics().checksumErrors == 0);
+
+        // only a frame spanning the split needs the internal buffer
+        QVERIFY(collector.copies <= 1);
+        if( (split == 0) || (split == size) )
+        {
+            QVERIFY(collector.copies == 0);
+        }
+    }
+
+    // frame longer than MAX_FRAME is dropped, and the next one still received
+    grape::PacketFramer<grape::CobsFraming, 64> small;
+    FrameCollector collector;
+    for(unsigned int i = 0; i < size; i += 50)
+    {
+        small.push(stream + i, (i + 50 < size) ? 50 : size - i, collector);
+    }
+    QVERIFY(collector.frames.size() == 1);
+    QVERIFY(small.getStatistics().overruns == 1);
+}
+
+//-----------------------------------------------------------------------------
+void TestPacketFramer::slipEscapes()
+//-----------------------------------------------------------------------------
+{
+    const unsigned char payload[] = {0xC0, 0x01, 0xDB, 0xDC, 0xC0};
+    unsigned char stream[64];
+    const unsigned int size = grape::SlipFraming::encode(payload, sizeof(payload), stream);
+    QVERIFY(size == 2 + sizeof(payload) + 3);
+
+    // byte at a time
+    grape::PacketFramer<grape::SlipFraming> framer;
+    FrameCollector collector;
+    for(unsigned int i = 0; i < size; ++i)
+    {
+        framer.push(stream + i, 1, collector);
+    }
+    QVERIFY(collector.frames.size() == 1);
+    QVERIFY(collector.frames[0] == std::vector<unsigned char>(payload, payload + sizeof(payload)));
+
+    // invalid escape sequence
+    unsigned char bad[] = {0xC0, 0x01, 0xDB, 0x02, 0xC0};
+    framer.push(bad, sizeof(bad), collector);
+    QVERIFY(collector.frames.size() == 1);
+    QVERIFY(framer.getStatistics().checksumErrors == 1);
+}
+
+//-----------------------------------------------------------------------------
+void TestPacketFramer::lengthPrefixedResync()
+//-----------------------------------------------------------------------------
+{
+    typedef grape::LengthPrefixedFraming<0xAA, grape::Crc16Checksum> Framing;
+
+    // noise, a corrupted frame, then two valid frames
+    const unsigned char p1[] = {1, 2, 3, 0xAA, 5};
+    const unsigned char p2[] = {6, 7};
+    unsigned char stream[64] = {0x11, 0x22, 0x33};
+    unsigned int size = 3;
+    const unsigned int corrupt = size;
+    size += Framing::encode(p1, sizeof(p1), stream + size);
+    stream[corrupt + 3] ^= 0xFF;
+    size += Framing::encode(p1, sizeof(p1), stream + size);
+    size += Framing::encode(p2, sizeof(p2), stream + size);
+
+    // the whole stream in one chunk is processed in place
+    unsigned char chunk[64];
+    memcpy(chunk, stream, size);
+    grape::PacketFramer<Framing> framer;
+    FrameCollector collector(chunk, size);
+    QVERIFY(framer.push(chunk, size, collector) == 2);
+    QVERIFY(collector.copies == 0);
+    QVERIFY(collector.frames[0] == std::vector<unsigned char>(p1, p1 + sizeof(p1)));
+    QVERIFY(collector.frames[1] == std::vector<unsigned char>(p2, p2 + sizeof(p2)));
+    QVERIFY(framer.getStatistics().checksumErrors >= 1);
+
+    // same result when split at every position
+    for(unsigned int split = 0; split <= size; ++split)
+    {
+        grape::PacketFramer<Framing> splitFramer;
+        FrameCollector splitCollector;
+        memcpy(chunk, stream, size);
+        unsigned int nFrames = splitFramer.push(chunk, split, splitCollector);
+        nFrames += splitFramer.push(chunk + split, size - split, splitCollector);
+        QCOMPARE(nFrames, 2U);
+        QVERIFY(splitCollector.frames[0] == collector.frames[0]);
+        QVERIFY(splitCollector.frames[1] == collector.frames[1]);
+    }
+}
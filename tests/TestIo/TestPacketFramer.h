@@ -0,0 +1,21 @@
+#include <QString>
+#include <QtTest>
+#include <io/PacketFramer.h>
+
+//=============================================================================
+/// \brief Test class for PacketFramer
+//=============================================================================
+class TestPacketFramer : public QObject
+{
+    Q_OBJECT
+
+public:
+    TestPacketFramer();
+
+private Q_SLOTS:
+    void cleanupTestCase();
+    void initTestCase();
+    void cobsSplitChunks();
+    void slipEscapes();
+    void lengthPrefixedResync();
+};
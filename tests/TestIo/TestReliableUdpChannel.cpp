@@ -0,0 +1,225 @@
+#include "TestReliableUdpChannel.h"
+#include <io/UdpServer.h>
+
+static const int TEST_PORT = 43215;
+
+//-----------------------------------------------------------------------------
+static struct sockaddr_in loopback(int port)
+//-----------------------------------------------------------------------------
+{
+    struct sockaddr_in addr;
+    memset(&addr, 0, sizeof(addr));
+    addr.sin_family = AF_INET;
+    addr.sin_port = htons(port);
+    addr.sin_addr.s_addr = inet_addr("127.0.0.1");
+    return addr;
+}
+
+//=============================================================================
+TestReliableUdpChannel::TestReliableUdpChannel()
+//=============================================================================
+{
+}
+
+//-----------------------------------------------------------------------------
+void TestReliableUdpChannel::initTestCase()
+//-----------------------------------------------------------------------------
+{
+}
+
+//-----------------------------------------------------------------------------
+void TestReliableUdpChannel::cleanupTestCase()
+//-----------------------------------------------------------------------------
+{
+}
+
+//-----------------------------------------------------------------------------
+void TestReliableUdpChannel::recoverLostMessage()
+//-----------------------------------------------------------------------------
+{
+    grape::UdpServer socketA(TEST_PORT);
+    grape::UdpServer socketB(TEST_PORT + 1);
+    grape::ReliableUdpChannel a(socketA, loopback(TEST_PORT + 1), 8, 64);
+    grape::ReliableUdpChannel b(socketB, loopback(TEST_PORT), 8, 64);
+
+    const unsigned int N_MSGS = 3;
+    for(unsigned char i = 0; i < N_MSGS; ++i)
+    {
+        QVERIFY(a.sendReliable(&i, 1));
+    }
+    QCOMPARE(a.pending(), N_MSGS);
+
+    // lose the first message
+    unsigned char buffer[64];
+    struct sockaddr_in from;
+    QCOMPARE(socketB.waitForRead(1000), grape::IDataPort::PORT_OK);
+    socketB.readFrom(buffer, sizeof(buffer), from);
+
+    // later messages are held until the lost one is resent, then delivered in order
+    unsigned int received = 0;
+    for(int tries = 0; (tries < 200) && ((received < N_MSGS) || a.pending()); ++tries)
+    {
+        unsigned int length = 0;
+        if( b.receive(buffer, sizeof(buffer), length, 5) == grape::ReliableUdpChannel::RELIABLE )
+        {
+            QCOMPARE(length, 1U);
+            QCOMPARE((unsigned int)buffer[0], received);
+            ++received;
+        }
+        a.receive(buffer, sizeof(buffer), length, 5);
+    }
+
+    QCOMPARE(received, N_MSGS);
+    QCOMPARE(a.pending(), 0U);
+    QVERIFY(a.getStatistics().retransmits >= 1);
+    QCOMPARE(a.getStatistics().failed, 0ULL);
+    QCOMPARE(b.getStatistics().delivered, (unsigned long long)N_MSGS);
+}
+
+//-----------------------------------------------------------------------------
+void TestReliableUdpChannel::unreliableMessage()
+//-----------------------------------------------------------------------------
+{
+    grape::UdpServer socketA(TEST_PORT);
+    grape::UdpServer socketB(TEST_PORT + 1);
+    grape::ReliableUdpChannel a(socketA, loopback(TEST_PORT + 1));
+    grape::ReliableUdpChannel b(socketB, loopback(TEST_PORT));
+
+    const unsigned char msg[] = "telemetry";
+    a.sendUnreliable(msg, sizeof(msg));
+
+    unsigned char buffer[64];
+    unsigned int length = 0;
+    QCOMPARE(b.receive(buffer, sizeof(buffer), length, 1000), grape::ReliableUdpChannel::UNRELIABLE);
+    QCOMPARE(length, (unsigned int)sizeof(msg));
+    QVERIFY(memcmp(buffer, msg, sizeof(msg)) == 0);
+    QCOMPARE(a.pending(), 0U);
+    QCOMPARE(b.getStatistics().unreliableReceived, 1ULL);
+}
+
+//-----------------------------------------------------------------------------
+void TestReliableUdpChannel::duplicateMessage()
+//-----------------------------------------------------------------------------
+{
+    grape::UdpServer socketA(TEST_PORT);
+    grape::UdpServer socketB(TEST_PORT + 1);
+    grape::ReliableUdpChannel a(socketA, loopback(TEST_PORT + 1), 8, 64);
+    grape::ReliableUdpChannel b(socketB, loopback(TEST_PORT), 8, 64);
+    a.setRetransmitTimeout(5);
+
+    const unsigned char msg = 42;
+    QVERIFY(a.sendReliable(&msg, 1));
+
+    unsigned char buffer[64];
+    unsigned int length = 0;
+    QCOMPARE(b.receive(buffer, sizeof(buffer), length, 1000), grape::ReliableUdpChannel::RELIABLE);
+
+    // lose the acknowledgement, so the message is sent again
+    struct sockaddr_in from;
+    QCOMPARE(socketA.waitForRead(1000), grape::IDataPort::PORT_OK);
+    socketA.readFrom(buffer, sizeof(buffer), from);
+
+    // the copy is acknowledged again but not delivered twice
+    for(int tries = 0; (tries < 200) && a.pending(); ++tries)
+    {
+        QCOMPARE(b.receive(buffer, sizeof(buffer), length, 5), grape::ReliableUdpChannel::NONE);
+        a.receive(buffer, sizeof(buffer), length, 5);
+    }
+    QCOMPARE(a.pending(), 0U);
+    QVERIFY(a.getStatistics().retransmits >= 1);
+    QVERIFY(b.getStatistics().duplicates >= 1);
+    QCOMPARE(b.getStatistics().delivered, 1ULL);
+}
+
+//-----------------------------------------------------------------------------
+void TestReliableUdpChannel::fullWindow()
+//-----------------------------------------------------------------------------
+{
+    grape::UdpServer socketA(TEST_PORT);
+    grape::UdpServer socketB(TEST_PORT + 1);
+    grape::ReliableUdpChannel a(socketA, loopback(TEST_PORT + 1), 4, 64);
+    grape::ReliableUdpChannel b(socketB, loopback(TEST_PORT), 4, 64);
+
+    // the window holds 4 unacknowledged messages
+    for(unsigned char i = 0; i < 4; ++i)
+    {
+        QVERIFY(a.sendReliable(&i, 1));
+    }
+    unsigned char next = 4;
+    QVERIFY(!a.sendReliable(&next, 1));
+    QCOMPARE(a.pending(), 4U);
+
+    // acknowledgements make room again
+    unsigned char buffer[64];
+    unsigned int length = 0;
+    unsigned int received = 0;
+    for(int tries = 0; (tries < 200) && ((received < 4) || a.pending()); ++tries)
+    {
+        if( b.receive(buffer, sizeof(buffer), length, 5) == grape::ReliableUdpChannel::RELIABLE )
+        {
+            QCOMPARE((unsigned int)buffer[0], received);
+            ++received;
+        }
+        a.receive(buffer, sizeof(buffer), length, 5);
+    }
+    QCOMPARE(received, 4U);
+    QCOMPARE(a.pending(), 0U);
+    QVERIFY(a.sendReliable(&next, 1));
+    QCOMPARE(b.receive(buffer, sizeof(buffer), length, 1000), grape::ReliableUdpChannel::RELIABLE);
+    QCOMPARE((unsigned int)buffer[0], 4U);
+}
+
+//-----------------------------------------------------------------------------
+void TestReliableUdpChannel::abandonedMessage()
+//-----------------------------------------------------------------------------
+{
+    for(int ordered = 1; ordered >= 0; --ordered)
+    {
+        grape::UdpServer socketA(TEST_PORT);
+        grape::UdpServer socketB(TEST_PORT + 1);
+        grape::ReliableUdpChannel a(socketA, loopback(TEST_PORT + 1), 4, 64);
+        grape::ReliableUdpChannel b(socketB, loopback(TEST_PORT), 4, 64);
+        a.setOrdered(ordered != 0);
+        b.setOrdered(ordered != 0);
+        a.setRetransmitTimeout(2);
+        a.setMaxRetries(2);
+
+        // lose every transmission until the message is abandoned
+        const unsigned char lost = 1;
+        QVERIFY(a.sendReliable(&lost, 1));
+        unsigned char buffer[64];
+        unsigned int length = 0;
+        struct sockaddr_in from;
+        for(int tries = 0; (tries < 200) && (a.getStatistics().failed == 0); ++tries)
+        {
+            a.receive(buffer, sizeof(buffer), length, 2);
+            while( socketB.waitForRead(0) == grape::IDataPort::PORT_OK )
+            {
+                socketB.readFrom(buffer, sizeof(buffer), from);
+            }
+        }
+        QCOMPARE(a.getStatistics().failed, 1ULL);
+
+        // later messages are delivered past the gap
+        const unsigned int N_MSGS = 6;
+        unsigned int received = 0;
+        unsigned char next = 0;
+        for(int tries = 0; (tries < 500) && ((received < N_MSGS) || a.pending()); ++tries)
+        {
+            if( (next < N_MSGS) && a.sendReliable(&next, 1) )
+            {
+                ++next;
+            }
+            if( b.receive(buffer, sizeof(buffer), length, 2) == grape::ReliableUdpChannel::RELIABLE )
+            {
+                QCOMPARE(length, 1U);
+                QCOMPARE((unsigned int)buffer[0], received);
+                ++received;
+            }
+            a.receive(buffer, sizeof(buffer), length, 2);
+        }
+        QCOMPARE(received, N_MSGS);
+        QCOMPARE(a.pending(), 0U);
+        QCOMPARE(b.getStatistics().delivered, (unsigned long long)N_MSGS);
+    }
+}
@@ -0,0 +1,23 @@
+#include <QString>
+#include <QtTest>
+#include <io/ReliableUdpChannel.h>
+
+//=============================================================================
+/// \brief Test class for ReliableUdpChannel
+//=============================================================================
+class TestReliableUdpChannel : public QObject
+{
+    Q_OBJECT
+
+public:
+    TestReliableUdpChannel();
+
+private Q_SLOTS:
+    void cleanupTestCase();
+    void initTestCase();
+    void recoverLostMessage();
+    void unreliableMessage();
+    void duplicateMessage();
+    void fullWindow();
+    void abandonedMessage();
+};
@@ -1,4 +1,8 @@
 #include "TestSerialPort.h"
+#ifndef WIN32
+#include "PseudoTerminal.h"
+#include <time.h>
+#endif
 
 //=============================================================================
 TestSerialPort::TestSerialPort()
@@ -101,6 +105,224 @@ void TestSerialPort::dataFormat()
         }
     }
 }
+#ifndef WIN32
+//-----------------------------------------------------------------------------
+void TestSerialPort::readerThread()
+//-----------------------------------------------------------------------------
+{
+    PseudoTerminal pty;
+    if( !pty.isOpen() )
+    {
+        QSKIP("pseudo terminals not available", SkipAll);
+    }
+
+    grape::SerialPort sp;
+    sp.setPortName(pty.slaveName());
+    sp.open();
+    sp.startReaderThread(64); // small, to exercise wrap around and a full ring
+    QVERIFY(sp.isReaderThreadRunning());
+
+    // chunks arriving apart keep their own timestamps
+    unsigned char buf[256];
+    long long t1 = 0, t2 = 0;
+    pty.write("abc", 3);
+    QCOMPARE(sp.waitForRead(1000), grape::IDataPort::PORT_OK);
+    QCOMPARE(sp.readTimestamped(buf, sizeof(buf), t1), 3U);
+    QVERIFY(memcmp(buf, "abc", 3) == 0);
+    QTest::qSleep(20);
+    pty.write("defgh", 5);
+    unsigned int n = 0;
+    while( n < 5 )
+    {
+        QCOMPARE(sp.waitForRead(1000), grape::IDataPort::PORT_OK);
+        n += sp.readTimestamped(buf + n, sizeof(buf) - n, t2);
+    }
+    QVERIFY(memcmp(buf, "defgh", 5) == 0);
+    QVERIFY(t2 - t1 >= 10000000LL);
+
+    // a stream larger than the ring
+    static const unsigned int TOTAL = 1000;
+    unsigned char tx[TOTAL];
+    for(unsigned int i = 0; i < TOTAL; ++i)
+    {
+        tx[i] = (unsigned char)(i * 7);
+    }
+    pty.write(tx, TOTAL);
+    std::vector<unsigned char> rx;
+    while( rx.size() < TOTAL )
+    {
+        QCOMPARE(sp.waitForRead(1000), grape::IDataPort::PORT_OK);
+        unsigned int avail = sp.availableToRead();
+        QVERIFY(avail > 0);
+        rx.resize(rx.size() + avail);
+        QCOMPARE(sp.readn(&rx[rx.size() - avail], avail), avail);
+    }
+    QCOMPARE(rx.size(), (size_t)TOTAL);
+    QVERIFY(memcmp(&rx[0], tx, TOTAL) == 0);
+    QCOMPARE(sp.waitForRead(20), grape::IDataPort::PORT_TIMEOUT);
+
+    // writes are unaffected; waitForWrite returns once the driver has sent them
+    QCOMPARE(sp.write((const unsigned char*)"xyz", 3), 3U);
+    QCOMPARE(sp.waitForWrite(1000), grape::IDataPort::PORT_OK);
+    QCOMPARE(pty.read(buf, sizeof(buf), 1000), (size_t)3);
+
+    sp.close();
+    QVERIFY(!sp.isReaderThreadRunning());
+}
+
+//-----------------------------------------------------------------------------
+void TestSerialPort::readerThreadFd()
+//-----------------------------------------------------------------------------
+{
+    PseudoTerminal pty;
+    if( !pty.isOpen() )
+    {
+        QSKIP("pseudo terminals not available", SkipAll);
+    }
+
+    grape::SerialPort sp;
+    sp.setPortName(pty.slaveName());
+    sp.open();
+
+    bool thrown = false;
+    try
+    {
+        sp.startReaderThread(grape::SerialPort::MAX_READER_BUFFER_SIZE + 1);
+    }
+    catch(grape::SerialPortException&)
+    {
+        thrown = true;
+    }
+    QVERIFY2(thrown, "oversized ring accepted");
+
+    sp.startReaderThread();
+    grape::IDataPort* ports[1] = {&sp};
+    bool ready[1] = {false};
+    QCOMPARE(grape::IDataPort::waitForAny(ports, 1, ready, 0), 0U);
+
+    // the descriptor stays readable while data is buffered in the ring
+    pty.write("abcdef", 6);
+    QCOMPARE(grape::IDataPort::waitForAny(ports, 1, ready, 1000000000LL), 1U);
+    QVERIFY(ready[0]);
+    QCOMPARE(sp.waitForRead(1000), grape::IDataPort::PORT_OK);
+    QTest::qSleep(20);
+    unsigned char buf[16];
+    QCOMPARE(sp.readn(buf, 2), 2U);
+    QCOMPARE(grape::IDataPort::waitForAny(ports, 1, ready, 0), 1U);
+    QVERIFY(ready[0]);
+    QCOMPARE(sp.readn(buf + 2, sizeof(buf) - 2), 4U);
+    QVERIFY(memcmp(buf, "abcdef", 6) == 0);
+    QCOMPARE(grape::IDataPort::waitForAny(ports, 1, ready, 0), 0U);
+    QVERIFY(!ready[0]);
+
+    // and becomes readable again for the next data
+    pty.write("g", 1);
+    QCOMPARE(grape::IDataPort::waitForAny(ports, 1, ready, 1000000000LL), 1U);
+    QCOMPARE(sp.readn(buf, sizeof(buf)), 1U);
+    QCOMPARE(grape::IDataPort::waitForAny(ports, 1, ready, 0), 0U);
+
+    sp.stopReaderThread();
+    QVERIFY(sp.getFd() >= 0);
+    sp.close();
+}
+
+//-----------------------------------------------------------------------------
+static long long elapsedMs(const struct timespec& start)
+//-----------------------------------------------------------------------------
+{
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (now.tv_sec - start.tv_sec) * 1000LL + (now.tv_nsec - start.tv_nsec) / 1000000LL;
+}
+
+//-----------------------------------------------------------------------------
+void TestSerialPort::baudAndBlockingRead()
+//-----------------------------------------------------------------------------
+{
+    PseudoTerminal pty;
+    if( !pty.isOpen() )
+    {
+        QSKIP("pseudo terminals not available", SkipAll);
+    }
+
+    grape::SerialPort sp;
+    sp.setPortName(pty.slaveName());
+    sp.open();
+
+    sp.setBaudRate(grape::SerialPort::B921600);
+    QCOMPARE(sp.getBaudRate(), 921600U);
+    sp.setBaudRate(grape::SerialPort::B3000000);
+    QCOMPARE(sp.getBaudRate(), 3000000U);
+
+    // arbitrary rate, kept when other settings change
+    sp.setCustomBaudRate(250000);
+    QCOMPARE(sp.getBaudRate(), 250000U);
+    sp.setDataFormat(grape::SerialPort::D8N1);
+    QCOMPARE(sp.getBaudRate(), 250000U);
+
+    unsigned char buf[16];
+    struct timespec start;
+
+    // wait up to 200 ms for the first byte
+    sp.setBlockingRead(0, 2);
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    QCOMPARE(sp.readn(buf, sizeof(buf)), 0U);
+    QVERIFY(elapsedMs(start) >= 150);
+
+    // minimum count satisfied immediately
+    sp.setBlockingRead(4, 0);
+    pty.write("wxyz", 4);
+    QCOMPARE(sp.readn(buf, sizeof(buf)), 4U);
+
+    // short read ends after an inter-byte gap of 100 ms
+    sp.setBlockingRead(4, 1);
+    pty.write("ab", 2);
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    QCOMPARE(sp.readn(buf, sizeof(buf)), 2U);
+    QVERIFY(elapsedMs(start) >= 50);
+    QVERIFY(memcmp(buf, "ab", 2) == 0);
+}
+
+//-----------------------------------------------------------------------------
+void TestSerialPort::gatherWrite()
+//-----------------------------------------------------------------------------
+{
+    // more buffers than one system call takes
+    static const unsigned int N_BUFFERS = 2 * grape::IDataPort::MAX_WRITEV_BUFFERS + 3;
+
+    PseudoTerminal pty;
+    if( !pty.isOpen() )
+    {
+        QSKIP("pseudo terminals not available", SkipAll);
+    }
+
+    grape::SerialPort sp;
+    sp.setPortName(pty.slaveName());
+    sp.open();
+
+    unsigned char tx[N_BUFFERS][2];
+    grape::IDataPort::Buffer buffers[N_BUFFERS];
+    for(unsigned int i = 0; i < N_BUFFERS; ++i)
+    {
+        tx[i][0] = 'a' + (i % 26);
+        tx[i][1] = 'A' + (i % 26);
+        buffers[i].pData = tx[i];
+        buffers[i].size = sizeof(tx[i]);
+    }
+    QCOMPARE(sp.writev(buffers, N_BUFFERS), (unsigned int)sizeof(tx));
+
+    unsigned char rx[sizeof(tx)];
+    size_t received = 0;
+    while( received < sizeof(rx) )
+    {
+        size_t n = pty.read(rx + received, sizeof(rx) - received, 1000);
+        QVERIFY(n > 0);
+        received += n;
+    }
+    QVERIFY(memcmp(rx, tx, sizeof(tx)) == 0);
+}
+#endif
+
 /*
 //-----------------------------------------------------------------------------
 void TestSerialPort::readWrite()
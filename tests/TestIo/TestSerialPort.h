@@ -20,6 +20,12 @@ private Q_SLOTS:
     void baudRate();
     void dataFormat();
     //void readWrite();
+#ifndef WIN32
+    void readerThread();
+    void readerThreadFd();
+    void baudAndBlockingRead();
+    void gatherWrite();
+#endif
 private:
     std::string _portName;
 };
@@ -0,0 +1,245 @@
+#include "TestSharedMemoryPort.h"
+#include <sys/wait.h>
+#include <unistd.h>
+#include <string.h>
+
+static const char* REGION_NAME = "/grape_test_shm";
+
+//=============================================================================
+TestSharedMemoryPort::TestSharedMemoryPort()
+//=============================================================================
+{
+}
+
+//-----------------------------------------------------------------------------
+void TestSharedMemoryPort::initTestCase()
+//-----------------------------------------------------------------------------
+{
+}
+
+//-----------------------------------------------------------------------------
+void TestSharedMemoryPort::cleanupTestCase()
+//-----------------------------------------------------------------------------
+{
+}
+
+//-----------------------------------------------------------------------------
+void TestSharedMemoryPort::readWrite()
+//-----------------------------------------------------------------------------
+{
+    grape::SharedMemoryPort server;
+    server.create(REGION_NAME, 1000);
+    QCOMPARE(server.capacity(), 1024u);
+
+    grape::SharedMemoryPort client;
+    client.open(REGION_NAME);
+    QCOMPARE(client.capacity(), 1024u);
+
+    QVERIFY(client.waitForRead(10) == grape::IDataPort::PORT_TIMEOUT);
+
+    // fill more than the ring holds; the write is truncated
+    unsigned char tx[1500];
+    for(unsigned int i = 0; i < sizeof(tx); ++i)
+    {
+        tx[i] = (unsigned char)i;
+    }
+    QCOMPARE(server.write(tx, sizeof(tx)), 1024u);
+    QVERIFY(server.waitForWrite(10) == grape::IDataPort::PORT_TIMEOUT);
+    QCOMPARE(client.availableToRead(), 1024u);
+
+    // drain part, then write the rest so it wraps around the end of the ring
+    unsigned char rx[1500];
+    QCOMPARE(client.readn(rx, 1000), 1000u);
+    QCOMPARE(server.write(tx + 1024, sizeof(tx) - 1024), (unsigned int)(sizeof(tx) - 1024));
+    QCOMPARE(client.readn(rx + 1000, 1000), 500u);
+    QVERIFY(memcmp(rx, tx, sizeof(tx)) == 0);
+    QVERIFY(server.waitForWrite(0) == grape::IDataPort::PORT_OK);
+
+    // reverse direction is independent
+    const unsigned char reply[] = "ack";
+    QCOMPARE(client.write(reply, sizeof(reply)), (unsigned int)sizeof(reply));
+    QVERIFY(server.waitForRead(0) == grape::IDataPort::PORT_OK);
+    std::vector<unsigned char> buf;
+    QCOMPARE(server.readAll(buf), (unsigned int)sizeof(reply));
+    QVERIFY(memcmp(&buf[0], reply, sizeof(reply)) == 0);
+
+    server.close();
+    grape::SharedMemoryPort late;
+    bool thrown = false;
+    try
+    {
+        late.open(REGION_NAME);
+    }
+    catch(grape::IoOpenException&)
+    {
+        thrown = true;
+    }
+    QVERIFY2(thrown, "region not removed by creator");
+}
+
+//-----------------------------------------------------------------------------
+void TestSharedMemoryPort::crossProcessStream()
+//-----------------------------------------------------------------------------
+{
+    static const unsigned int TOTAL_BYTES = 4 * 1024 * 1024;
+
+    grape::SharedMemoryPort server;
+    server.create(REGION_NAME, 4096);
+
+    pid_t pid = fork();
+    QVERIFY(pid >= 0);
+    if( pid == 0 )
+    {
+        // child: stream a counting pattern, blocking when the ring is full
+        grape::SharedMemoryPort client;
+        client.open(REGION_NAME);
+        unsigned char chunk[777];
+        unsigned int sent = 0;
+        while( sent < TOTAL_BYTES )
+        {
+            unsigned int n = sizeof(chunk);
+            if( n > TOTAL_BYTES - sent )
+            {
+                n = TOTAL_BYTES - sent;
+            }
+            for(unsigned int i = 0; i < n; ++i)
+            {
+                chunk[i] = (unsigned char)((sent + i) % 251);
+            }
+            unsigned int done = 0;
+            while( done < n )
+            {
+                done += client.write(chunk + done, n - done);
+            }
+            sent += n;
+        }
+        client.waitForWrite(-1);
+        _exit(0);
+    }
+
+    unsigned char buf[1024];
+    unsigned int received = 0;
+    bool ok = true;
+    while( ok && (received < TOTAL_BYTES) )
+    {
+        if( server.waitForRead(5000) != grape::IDataPort::PORT_OK )
+        {
+            break;
+        }
+        unsigned int n = server.readn(buf, sizeof(buf));
+        for(unsigned int i = 0; i < n; ++i)
+        {
+            ok = ok && (buf[i] == (unsigned char)((received + i) % 251));
+        }
+        received += n;
+    }
+
+    int status = -1;
+    waitpid(pid, &status, 0);
+    QVERIFY2(ok, "data corrupted");
+    QCOMPARE(received, TOTAL_BYTES);
+    QVERIFY(WIFEXITED(status) && (WEXITSTATUS(status) == 0));
+}
+
+//-----------------------------------------------------------------------------
+void TestSharedMemoryPort::existingRegion()
+//-----------------------------------------------------------------------------
+{
+    grape::SharedMemoryPort first;
+    first.create(REGION_NAME, 1024);
+
+    // a region in use is not silently replaced
+    grape::SharedMemoryPort second;
+    bool thrown = false;
+    try
+    {
+        second.create(REGION_NAME, 1024);
+    }
+    catch(grape::IoOpenException&)
+    {
+        thrown = true;
+    }
+    QVERIFY(thrown);
+    QVERIFY(!second.isOpen());
+
+    // unless asked to, eg: to clean up after a crash
+    second.create(REGION_NAME, 2048, true);
+    QCOMPARE(second.capacity(), 2048u);
+    grape::SharedMemoryPort client;
+    client.open(REGION_NAME);
+    QCOMPARE(client.capacity(), 2048u);
+
+    thrown = false;
+    try
+    {
+        first.create("/grape_test_shm_big", grape::SharedMemoryPort::MAX_CAPACITY + 1);
+    }
+    catch(grape::IoOpenException&)
+    {
+        thrown = true;
+    }
+    QVERIFY(thrown);
+}
+
+//-----------------------------------------------------------------------------
+void TestSharedMemoryPort::deadPeer()
+//-----------------------------------------------------------------------------
+{
+    grape::SharedMemoryPort server;
+    server.create(REGION_NAME, 1024);
+
+    // no peer yet: an ordinary timeout
+    QVERIFY(server.waitForRead(10) == grape::IDataPort::PORT_TIMEOUT);
+
+    // a peer that closes the port wakes a blocked reader
+    grape::SharedMemoryPort client;
+    client.open(REGION_NAME);
+    const unsigned char msg[] = "last words";
+    QCOMPARE(client.write(msg, sizeof(msg)), (unsigned int)sizeof(msg));
+    client.close();
+    unsigned char buf[32];
+    QCOMPARE(server.readn(buf, sizeof(buf)), (unsigned int)sizeof(msg));
+    QVERIFY(server.waitForRead(-1) == grape::IDataPort::PORT_ERROR);
+    bool thrown = false;
+    try
+    {
+        server.readn(buf, sizeof(buf));
+    }
+    catch(grape::IoReadException&)
+    {
+        thrown = true;
+    }
+    QVERIFY(thrown);
+
+    // a peer process that dies without closing
+    pid_t pid = fork();
+    QVERIFY(pid >= 0);
+    if( pid == 0 )
+    {
+        grape::SharedMemoryPort child;
+        child.open(REGION_NAME);
+        child.write(msg, sizeof(msg));
+        _exit(0);
+    }
+    int status = -1;
+    waitpid(pid, &status, 0);
+    QVERIFY(server.waitForRead(-1) == grape::IDataPort::PORT_OK);
+    QCOMPARE(server.readn(buf, sizeof(buf)), (unsigned int)sizeof(msg));
+    QVERIFY(server.waitForRead(-1) == grape::IDataPort::PORT_ERROR);
+
+    // a full ring with nobody reading
+    unsigned char fill[1024];
+    memset(fill, 0, sizeof(fill));
+    QCOMPARE(server.write(fill, sizeof(fill)), 1024u);
+    QVERIFY(server.waitForWrite(-1) == grape::IDataPort::PORT_ERROR);
+    thrown = false;
+    try
+    {
+        server.write(fill, sizeof(fill));
+    }
+    catch(grape::IoWriteException&)
+    {
+        thrown = true;
+    }
+    QVERIFY(thrown);
+}
@@ -0,0 +1,22 @@
+#include <QString>
+#include <QtTest>
+#include <io/SharedMemoryPort.h>
+
+//=============================================================================
+/// \brief Test class for SharedMemoryPort
+//=============================================================================
+class TestSharedMemoryPort : public QObject
+{
+    Q_OBJECT
+
+public:
+    TestSharedMemoryPort();
+
+private Q_SLOTS:
+    void cleanupTestCase();
+    void initTestCase();
+    void readWrite();
+    void crossProcessStream();
+    void existingRegion();
+    void deadPeer();
+};
@@ -0,0 +1,184 @@
+#include "TestTcpSendQueue.h"
+
+static const int TEST_PORT = 43220;
+
+//-----------------------------------------------------------------------------
+/// A connected pair of TCP sockets over loopback
+class TcpConnection
+//-----------------------------------------------------------------------------
+{
+public:
+    TcpConnection() : pServer(NULL)
+    {
+        listener.allowPortReuse(true);
+        listener.bind(TEST_PORT);
+        listener.listen(1);
+        if( client.connect("127.0.0.1", TEST_PORT) )
+        {
+            pServer = listener.accept();
+        }
+    }
+    ~TcpConnection() { delete pServer; }
+
+    /// read exactly 'bytes' from the server end
+    bool receive(unsigned char* pBuffer, unsigned int bytes)
+    {
+        unsigned int n = 0;
+        while( n < bytes )
+        {
+            if( pServer->waitForRead(1000) != grape::IDataPort::PORT_OK )
+            {
+                return false;
+            }
+            n += pServer->readn(pBuffer + n, bytes - n);
+        }
+        return true;
+    }
+
+    grape::TcpSocket listener;
+    grape::TcpSocket client;
+    grape::TcpSocket* pServer;
+};
+
+//=============================================================================
+TestTcpSendQueue::TestTcpSendQueue()
+//=============================================================================
+{
+}
+
+//-----------------------------------------------------------------------------
+void TestTcpSendQueue::initTestCase()
+//-----------------------------------------------------------------------------
+{
+}
+
+//-----------------------------------------------------------------------------
+void TestTcpSendQueue::cleanupTestCase()
+//-----------------------------------------------------------------------------
+{
+}
+
+//-----------------------------------------------------------------------------
+void TestTcpSendQueue::wrapAround()
+//-----------------------------------------------------------------------------
+{
+    TcpConnection conn;
+    QVERIFY(conn.pServer != NULL);
+    grape::TcpSendQueue queue(conn.client, 50);
+    QCOMPARE(queue.capacity(), 64U);
+
+    unsigned char tx[80];
+    for(unsigned int i = 0; i < sizeof(tx); ++i)
+    {
+        tx[i] = (unsigned char)i;
+    }
+
+    // second message wraps past the end of the buffer, and goes out in one
+    // gather write of both regions
+    QVERIFY(queue.enqueue(tx, 40));
+    QCOMPARE(queue.flush(), 40U);
+    grape::IDataPort::Buffer parts[] = { {tx + 40, 10}, {tx + 50, 30} };
+    QVERIFY(queue.enqueue(parts, 2));
+    QCOMPARE(queue.depth(), 40U);
+    QCOMPARE(queue.flush(), 40U);
+    QVERIFY(queue.isEmpty());
+
+    unsigned char rx[80];
+    QVERIFY(conn.receive(rx, sizeof(rx)));
+    QVERIFY(memcmp(rx, tx, sizeof(tx)) == 0);
+
+    const grape::TcpSendQueue::Statistics stats = queue.getStatistics();
+    QCOMPARE(stats.bytesQueued, 80ULL);
+    QCOMPARE(stats.bytesSent, 80ULL);
+    QCOMPARE(stats.writeCalls, 2ULL);
+    QCOMPARE(stats.highWaterMark, 40U);
+    QCOMPARE(stats.rejected, 0ULL);
+}
+
+//-----------------------------------------------------------------------------
+void TestTcpSendQueue::fullSocket()
+//-----------------------------------------------------------------------------
+{
+    TcpConnection conn;
+    QVERIFY(conn.pServer != NULL);
+    static const unsigned int CHUNK = 64 * 1024;
+    grape::TcpSendQueue queue(conn.client, 64 * CHUNK);
+    std::vector<unsigned char> chunk(CHUNK, 0x5A);
+
+    // the peer doesn't read: the socket fills up, flush() writes only part of
+    // the queue, and the queue then rejects messages without blocking
+    unsigned int queued = 0;
+    while( queue.enqueue(&chunk[0], CHUNK) )
+    {
+        queued += CHUNK;
+        queue.flush();
+    }
+    QVERIFY(queue.depth() > 0);
+    grape::TcpSendQueue::Statistics stats = queue.getStatistics();
+    QCOMPARE(stats.rejected, 1ULL);
+    QCOMPARE(stats.bytesQueued, (unsigned long long)queued);
+    QCOMPARE(stats.bytesSent + stats.depth, (unsigned long long)queued);
+    QVERIFY(stats.highWaterMark > queue.capacity() - CHUNK);
+
+    // top up the socket directly until it stays full, as the kernel moves data
+    // to the receiver in the background
+    grape::IDataPort::Buffer part = { &chunk[0], CHUNK };
+    unsigned int direct = 0;
+    for(int i = 0; i < 10; ++i)
+    {
+        unsigned int n;
+        while( (n = conn.client.writevNoWait(&part, 1)) > 0 )
+        {
+            direct += n;
+        }
+        QTest::qSleep(10);
+    }
+    QCOMPARE(conn.client.writevNoWait(&part, 1), 0U);
+    QCOMPARE(queue.flush(), 0U);
+    QCOMPARE(conn.client.waitForWrite(50), grape::IDataPort::PORT_TIMEOUT);
+
+    // once the peer reads, the rest goes out
+    std::vector<unsigned char> rx(CHUNK);
+    unsigned int received = 0;
+    while( !queue.isEmpty() || (received < queued + direct) )
+    {
+        if( conn.pServer->waitForRead(1000) != grape::IDataPort::PORT_OK )
+        {
+            break;
+        }
+        received += conn.pServer->readn(&rx[0], CHUNK);
+        if( conn.client.waitForWrite(0) == grape::IDataPort::PORT_OK )
+        {
+            queue.flush();
+        }
+    }
+    QCOMPARE(received, queued + direct);
+    stats = queue.getStatistics();
+    QCOMPARE(stats.bytesSent, (unsigned long long)queued);
+    QVERIFY(stats.writeCalls > 1);
+
+    // discarded data is not counted as sent
+    QVERIFY(queue.enqueue(&chunk[0], 100));
+    queue.clear();
+    stats = queue.getStatistics();
+    QVERIFY(queue.isEmpty());
+    QCOMPARE(stats.bytesDiscarded, 100ULL);
+    QCOMPARE(stats.bytesSent, (unsigned long long)queued);
+}
+
+//-----------------------------------------------------------------------------
+void TestTcpSendQueue::capacityLimit()
+//-----------------------------------------------------------------------------
+{
+    grape::TcpSocket socket;
+    bool thrown = false;
+    try
+    {
+        grape::TcpSendQueue queue(socket, grape::TcpSendQueue::MAX_CAPACITY + 1);
+    }
+    catch(grape::SocketException&)
+    {
+        thrown = true;
+    }
+    QVERIFY(thrown);
+}
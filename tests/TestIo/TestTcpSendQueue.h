@@ -0,0 +1,21 @@
+#include <QString>
+#include <QtTest>
+#include <io/TcpSendQueue.h>
+
+//=============================================================================
+/// \brief Test class for TcpSendQueue
+//=============================================================================
+class TestTcpSendQueue : public QObject
+{
+    Q_OBJECT
+
+public:
+    TestTcpSendQueue();
+
+private Q_SLOTS:
+    void cleanupTestCase();
+    void initTestCase();
+    void wrapAround();
+    void fullSocket();
+    void capacityLimit();
+};
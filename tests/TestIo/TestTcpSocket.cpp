@@ -0,0 +1,158 @@
+#include "TestTcpSocket.h"
+#include <string.h>
+
+static const int TEST_PORT = 43214;
+
+//=============================================================================
+TestTcpSocket::TestTcpSocket()
+//=============================================================================
+{
+}
+
+//-----------------------------------------------------------------------------
+void TestTcpSocket::initTestCase()
+//-----------------------------------------------------------------------------
+{
+}
+
+//-----------------------------------------------------------------------------
+void TestTcpSocket::cleanupTestCase()
+//-----------------------------------------------------------------------------
+{
+}
+
+//-----------------------------------------------------------------------------
+void TestTcpSocket::acceptMany()
+//-----------------------------------------------------------------------------
+{
+    static const unsigned int N_CLIENTS = 5;
+
+    grape::TcpSocket server;
+    server.allowPortReuse(true);
+    server.bind(TEST_PORT);
+    server.listen(16);
+    server.setNonBlocking(true);
+
+    grape::TcpSocket::Pool pool(2);
+    std::vector<grape::TcpSocket*> accepted;
+    QCOMPARE(server.acceptMany(pool, accepted), 0u);
+
+    grape::TcpSocket clients[N_CLIENTS];
+    for(unsigned int i = 0; i < N_CLIENTS; ++i)
+    {
+        QVERIFY(clients[i].connect("127.0.0.1", TEST_PORT));
+    }
+
+    QCOMPARE(server.acceptMany(pool, accepted), N_CLIENTS);
+    QCOMPARE((unsigned int)accepted.size(), N_CLIENTS);
+    QCOMPARE(pool.inUse(), N_CLIENTS);
+    QCOMPARE(pool.idle(), 0u);
+
+    // accepted connections work, and are in blocking mode
+    const unsigned char msg[] = "hello";
+    QCOMPARE(clients[0].write(msg, sizeof(msg)), (unsigned int)sizeof(msg));
+    unsigned char buf[8];
+    QVERIFY(accepted[0]->waitForRead(1000) == grape::IDataPort::PORT_OK);
+    QCOMPARE(accepted[0]->readn(buf, sizeof(buf)), (unsigned int)sizeof(msg));
+
+    // released objects are reused
+    for(unsigned int i = 0; i < accepted.size(); ++i)
+    {
+        pool.release(accepted[i]);
+    }
+    accepted.clear();
+    QCOMPARE(pool.idle(), N_CLIENTS);
+
+    grape::TcpSocket late;
+    QVERIFY(late.connect("127.0.0.1", TEST_PORT));
+    QCOMPARE(server.acceptMany(pool, accepted, 1), 1u);
+    QCOMPARE(pool.idle(), N_CLIENTS - 1);
+    QCOMPARE(pool.inUse(), 1u);
+
+    // a socket from another pool, or one already released, is refused
+    grape::TcpSocket::Pool other;
+    bool thrown = false;
+    try
+    {
+        other.release(accepted[0]);
+    }
+    catch(grape::SocketException&)
+    {
+        thrown = true;
+    }
+    QVERIFY(thrown);
+    pool.release(accepted[0]);
+    thrown = false;
+    try
+    {
+        pool.release(accepted[0]);
+    }
+    catch(grape::SocketException&)
+    {
+        thrown = true;
+    }
+    QVERIFY(thrown);
+    QCOMPARE(pool.idle(), N_CLIENTS);
+    QCOMPARE(pool.inUse(), 0u);
+}
+
+//-----------------------------------------------------------------------------
+void TestTcpSocket::gatherWrite()
+//-----------------------------------------------------------------------------
+{
+    // more buffers than one system call takes
+    static const unsigned int N_BUFFERS = 3 * grape::IDataPort::MAX_WRITEV_BUFFERS + 5;
+
+    grape::TcpSocket server;
+    server.allowPortReuse(true);
+    server.bind(TEST_PORT);
+    server.listen(1);
+    grape::TcpSocket client;
+    QVERIFY(client.connect("127.0.0.1", TEST_PORT));
+    grape::TcpSocket* pPeer = server.accept();
+    QVERIFY(pPeer != NULL);
+
+    unsigned char tx[N_BUFFERS][4];
+    grape::IDataPort::Buffer buffers[N_BUFFERS];
+    for(unsigned int i = 0; i < N_BUFFERS; ++i)
+    {
+        memset(tx[i], (int)i, sizeof(tx[i]));
+        buffers[i].pData = tx[i];
+        buffers[i].size = 1 + (i % 4);
+    }
+    unsigned int total = 0;
+    for(unsigned int i = 0; i < N_BUFFERS; ++i)
+    {
+        total += buffers[i].size;
+    }
+    QCOMPARE(client.writev(buffers, N_BUFFERS), total);
+    QCOMPARE(client.writevNoWait(buffers, N_BUFFERS), total);
+
+    std::vector<unsigned char> rx(2 * total);
+    unsigned int received = 0;
+    while( received < rx.size() )
+    {
+        QVERIFY(pPeer->waitForRead(1000) == grape::IDataPort::PORT_OK);
+        received += pPeer->readn(&rx[received], rx.size() - received);
+    }
+    unsigned int offset = 0;
+    for(unsigned int n = 0; n < 2; ++n)
+    {
+        for(unsigned int i = 0; i < N_BUFFERS; ++i)
+        {
+            QVERIFY(memcmp(&rx[offset], tx[i], buffers[i].size) == 0);
+            offset += buffers[i].size;
+        }
+    }
+
+    // pointer overloads
+    const unsigned char msg[] = "pointer";
+    QCOMPARE(pPeer->write(msg, sizeof(msg)), (unsigned int)sizeof(msg));
+    unsigned char buf[16];
+    QVERIFY(client.waitForRead(1000) == grape::IDataPort::PORT_OK);
+    QCOMPARE(client.readn(buf, sizeof(buf)), (unsigned int)sizeof(msg));
+    QVERIFY(memcmp(buf, msg, sizeof(msg)) == 0);
+    QCOMPARE(client.writev(buffers, 0), 0U);
+
+    delete pPeer;
+}
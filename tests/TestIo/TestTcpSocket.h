@@ -0,0 +1,20 @@
+#include <QString>
+#include <QtTest>
+#include <io/TcpSocket.h>
+
+//=============================================================================
+/// \brief Test class for TcpSocket
+//=============================================================================
+class TestTcpSocket : public QObject
+{
+    Q_OBJECT
+
+public:
+    TestTcpSocket();
+
+private Q_SLOTS:
+    void cleanupTestCase();
+    void initTestCase();
+    void acceptMany();
+    void gatherWrite();
+};
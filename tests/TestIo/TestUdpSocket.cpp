@@ -0,0 +1,411 @@
+#include "TestUdpSocket.h"
+#include <arpa/inet.h>
+#include <sched.h>
+#include <string.h>
+#include <time.h>
+
+static const int TEST_PORT = 43211;
+
+//=============================================================================
+/// Counts datagrams received by a ShardedUdpServer
+class ShardCountingHandler : public grape::ShardedUdpServer::IHandler
+{
+public:
+    static const unsigned int MAX_SHARDS = 4;
+    ShardCountingHandler() : count(0), bytes(0) { memset(shardCount, 0, sizeof(shardCount)); }
+    void onReceive(unsigned int shard, const grape::UdpSocket::Datagram* datagrams, unsigned int n)
+    {
+        for(unsigned int i = 0; i < n; ++i)
+        {
+            __atomic_add_fetch(&bytes, datagrams[i].length, __ATOMIC_RELAXED);
+        }
+        __atomic_add_fetch(&count, n, __ATOMIC_RELAXED);
+        if( shard < MAX_SHARDS )
+        {
+            __atomic_add_fetch(&shardCount[shard], n, __ATOMIC_RELAXED);
+        }
+    }
+    unsigned int count;
+    unsigned int bytes;
+    unsigned int shardCount[MAX_SHARDS];   //!< datagrams received by each shard
+};
+
+//=============================================================================
+TestUdpSocket::TestUdpSocket()
+//=============================================================================
+{
+}
+
+//-----------------------------------------------------------------------------
+void TestUdpSocket::initTestCase()
+//-----------------------------------------------------------------------------
+{
+    memset(&_serverAddr, 0, sizeof(_serverAddr));
+    _serverAddr.sin_family = AF_INET;
+    _serverAddr.sin_port = htons(TEST_PORT);
+    _serverAddr.sin_addr.s_addr = inet_addr("127.0.0.1");
+}
+
+//-----------------------------------------------------------------------------
+void TestUdpSocket::cleanupTestCase()
+//-----------------------------------------------------------------------------
+{
+}
+
+//-----------------------------------------------------------------------------
+void TestUdpSocket::batchReadWrite()
+//-----------------------------------------------------------------------------
+{
+    static const unsigned int N_MSGS = 100; // more than one kernel batch
+    static const unsigned int MSG_SIZE = 32;
+
+    grape::UdpServer server(TEST_PORT);
+    server.setBufSize(256 * 1024);
+    grape::UdpSocket client;
+
+    unsigned char txData[N_MSGS][MSG_SIZE];
+    grape::UdpSocket::Datagram tx[N_MSGS];
+    for(unsigned int i = 0; i < N_MSGS; ++i)
+    {
+        memset(txData[i], (int)i, MSG_SIZE);
+        tx[i].pData = txData[i];
+        tx[i].capacity = MSG_SIZE;
+        tx[i].length = MSG_SIZE - (i % 4);
+        tx[i].address = _serverAddr;
+    }
+
+    QCOMPARE(client.writeBatch(tx, N_MSGS), N_MSGS);
+
+    unsigned char rxData[N_MSGS][MSG_SIZE];
+    grape::UdpSocket::Datagram rx[N_MSGS];
+    for(unsigned int i = 0; i < N_MSGS; ++i)
+    {
+        rx[i].pData = rxData[i];
+        rx[i].capacity = MSG_SIZE;
+    }
+
+    unsigned int nRead = 0;
+    while( nRead < N_MSGS )
+    {
+        QVERIFY2(server.waitForRead(1000) == grape::IDataPort::PORT_OK, "timed out waiting for datagrams");
+        nRead += server.readBatch(rx + nRead, N_MSGS - nRead);
+    }
+
+    for(unsigned int i = 0; i < N_MSGS; ++i)
+    {
+        QCOMPARE(rx[i].length, tx[i].length);
+        QVERIFY2(memcmp(rx[i].pData, tx[i].pData, rx[i].length) == 0, "data mismatch");
+        QVERIFY2(rx[i].address.sin_addr.s_addr == _serverAddr.sin_addr.s_addr, "wrong source address");
+    }
+}
+
+//-----------------------------------------------------------------------------
+void TestUdpSocket::multicastLoopback()
+//-----------------------------------------------------------------------------
+{
+    static const char* GROUP = "239.255.43.21";
+    static const char* IFACE = "127.0.0.1";
+
+    // two subscribers sharing the group port
+    grape::UdpServer sub1(TEST_PORT, GROUP, IFACE);
+    grape::UdpServer sub2(TEST_PORT, GROUP, IFACE);
+
+    grape::UdpSocket publisher;
+    publisher.setMulticastInterface(IFACE);
+    publisher.setMulticastTtl(1);
+    publisher.setMulticastLoopback(true);
+
+    struct sockaddr_in group = _serverAddr;
+    group.sin_addr.s_addr = inet_addr(GROUP);
+    const unsigned char msg[] = "multicast";
+    try
+    {
+        QCOMPARE(publisher.writeTo(group, msg, sizeof(msg)), (unsigned int)sizeof(msg));
+    }
+    catch(grape::SocketException&)
+    {
+        QSKIP("multicast is not routable on this host", SkipAll);
+    }
+
+    grape::UdpServer* subs[] = {&sub1, &sub2};
+    for(int i = 0; i < 2; ++i)
+    {
+        QVERIFY2(subs[i]->waitForRead(1000) == grape::IDataPort::PORT_OK, "subscriber did not receive");
+        unsigned char buf[32];
+        struct sockaddr_in from;
+        QCOMPARE(subs[i]->readFrom(buf, sizeof(buf), from), (unsigned int)sizeof(msg));
+        QVERIFY2(memcmp(buf, msg, sizeof(msg)) == 0, "data mismatch");
+    }
+
+    sub1.leaveMulticastGroup(GROUP, IFACE);
+}
+
+//-----------------------------------------------------------------------------
+void TestUdpSocket::timestamping()
+//-----------------------------------------------------------------------------
+{
+    grape::UdpServer server(TEST_PORT);
+    server.enableTimestamping(grape::UdpSocket::TIMESTAMP_RX_SOFTWARE);
+    grape::UdpSocket client;
+    client.enableTimestamping(grape::UdpSocket::TIMESTAMP_TX_SOFTWARE);
+    QTest::qSleep(10); // the kernel enables receive timestamping asynchronously
+
+    struct timespec now;
+    clock_gettime(CLOCK_REALTIME, &now);
+    long long before = (long long)now.tv_sec * 1000000000LL + now.tv_nsec;
+
+    const unsigned char msg[] = "stamped";
+    for(unsigned int i = 0; i < 2; ++i)
+    {
+        QCOMPARE(client.writeTo(_serverAddr, msg, sizeof(msg)), (unsigned int)sizeof(msg));
+    }
+
+    // receive timestamps
+    for(unsigned int i = 0; i < 2; ++i)
+    {
+        unsigned char buf[32];
+        struct sockaddr_in from;
+        grape::UdpSocket::Timestamp ts;
+        QCOMPARE(server.readFrom(buf, sizeof(buf), from, ts), (unsigned int)sizeof(msg));
+        QVERIFY2(ts.softwareNs >= before, "receive timestamp missing or too early");
+    }
+
+    // transmit timestamps, numbered in send order
+    for(unsigned int i = 0; i < 2; ++i)
+    {
+        grape::UdpSocket::Timestamp ts;
+        unsigned int id = 99;
+        int tries = 0;
+        while( !client.readTxTimestamp(ts, id) && (++tries < 1000) )
+        {
+            QTest::qSleep(1);
+        }
+        QVERIFY2(tries < 1000, "no transmit timestamp");
+        QCOMPARE(id, i);
+        QVERIFY2(ts.softwareNs >= before, "transmit timestamp missing or too early");
+    }
+    grape::UdpSocket::Timestamp ts;
+    unsigned int id;
+    QVERIFY(!client.readTxTimestamp(ts, id));
+}
+
+//-----------------------------------------------------------------------------
+void TestUdpSocket::waitForAny()
+//-----------------------------------------------------------------------------
+{
+    grape::UdpServer server1(TEST_PORT);
+    grape::UdpServer server2(TEST_PORT + 1);
+    grape::UdpSocket client;
+
+    grape::IDataPort* ports[] = {&server1, &server2};
+    bool ready[2] = {true, true};
+    QCOMPARE(grape::IDataPort::waitForAny(ports, 2, ready, 10000000LL), 0u);
+    QVERIFY(!ready[0] && !ready[1]);
+
+    struct sockaddr_in addr = _serverAddr;
+    addr.sin_port = htons(TEST_PORT + 1);
+    const unsigned char msg[] = "any";
+    client.writeTo(addr, msg, sizeof(msg));
+
+    QCOMPARE(grape::IDataPort::waitForAny(ports, 2, ready, 1000000000LL), 1u);
+    QVERIFY(!ready[0] && ready[1]);
+}
+
+//-----------------------------------------------------------------------------
+void TestUdpSocket::shardedServer()
+//-----------------------------------------------------------------------------
+{
+    static const unsigned int N_SHARDS = 2;
+    static const unsigned int N_CLIENTS = 32; // all hashing to one shard is a 1 in 2^31 chance
+    static const unsigned int N_MSGS = 8; // total fits in default socket buffers
+
+    ShardCountingHandler handler;
+    grape::ShardedUdpServer server(TEST_PORT, N_SHARDS, &handler, 16, 64);
+    QCOMPARE(server.shardCount(), N_SHARDS);
+    server.start();
+    QVERIFY(server.isRunning());
+
+    // several sources, so the address hash spreads them over the shards
+    grape::UdpSocket clients[N_CLIENTS];
+    const unsigned char msg[10] = {0};
+    for(unsigned int i = 0; i < N_MSGS; ++i)
+    {
+        for(unsigned int c = 0; c < N_CLIENTS; ++c)
+        {
+            clients[c].writeTo(_serverAddr, msg, sizeof(msg));
+        }
+    }
+
+    for(int tries = 0; (tries < 1000) && (__atomic_load_n(&handler.count, __ATOMIC_RELAXED) < N_MSGS * N_CLIENTS); ++tries)
+    {
+        QTest::qSleep(1);
+    }
+    server.stop();
+    QVERIFY(!server.isRunning());
+
+    QCOMPARE(handler.count, N_MSGS * N_CLIENTS);
+    QCOMPARE(handler.bytes, N_MSGS * N_CLIENTS * (unsigned int)sizeof(msg));
+    unsigned long long total = 0;
+    for(unsigned int i = 0; i < N_SHARDS; ++i)
+    {
+        // every shard gets a share, and reports it under its own index
+        grape::ShardedUdpServer::Statistics stats = server.getStatistics(i);
+        QCOMPARE(stats.errors, 0ULL);
+        QVERIFY2(handler.shardCount[i] > 0, "shard received nothing");
+        QCOMPARE(stats.datagrams, (unsigned long long)handler.shardCount[i]);
+        total += stats.datagrams;
+    }
+    QCOMPARE(total, (unsigned long long)(N_MSGS * N_CLIENTS));
+
+    // restartable
+    server.start();
+    server.stop();
+
+    // a core the threads can't run on fails start()
+    std::vector<int> cpus(N_SHARDS, -1);
+    cpus[N_SHARDS - 1] = CPU_SETSIZE - 1;
+    server.setCpus(cpus);
+    bool thrown = false;
+    try
+    {
+        server.start();
+    }
+    catch(grape::SocketException&)
+    {
+        thrown = true;
+    }
+    QVERIFY2(thrown, "start() ignored a failed thread pinning");
+    QVERIFY(!server.isRunning());
+}
+
+//-----------------------------------------------------------------------------
+void TestUdpSocket::busyPoll()
+//-----------------------------------------------------------------------------
+{
+    grape::UdpServer server(TEST_PORT);
+    server.setBusyPoll(1000);
+    grape::UdpSocket client;
+
+    // nothing to read: spin for the budget, then block until timeout
+    QVERIFY(server.waitForRead(5) == grape::IDataPort::PORT_TIMEOUT);
+
+    // queued datagram is found by spinning
+    const unsigned char msg[] = "poll";
+    client.writeTo(_serverAddr, msg, sizeof(msg));
+    QVERIFY(server.waitForRead(1000) == grape::IDataPort::PORT_OK);
+
+    grape::UdpSocket::BusyPollStatistics stats = server.getBusyPollStatistics();
+    QCOMPARE(stats.timeouts, 1ULL);
+    QCOMPARE(stats.spinHits + stats.blockingHits, 1ULL);
+
+    server.resetBusyPollStatistics();
+    QCOMPARE(server.getBusyPollStatistics().timeouts, 0ULL);
+}
+
+//-----------------------------------------------------------------------------
+void TestUdpSocket::segmentationOffload()
+//-----------------------------------------------------------------------------
+{
+    static const unsigned int SEGMENT = 1000;
+    static const unsigned int TOTAL = 10 * SEGMENT + 123; // last segment is short
+
+    grape::UdpServer server(TEST_PORT);
+    server.setBufSize(256 * 1024);
+    server.enableReceiveOffload(true);
+    grape::UdpSocket client;
+
+    std::vector<unsigned char> tx(TOTAL);
+    for(unsigned int i = 0; i < TOTAL; ++i)
+    {
+        tx[i] = (unsigned char)(i % 253);
+    }
+    QCOMPARE(client.writeSegmented(_serverAddr, &tx[0], TOTAL, SEGMENT), TOTAL);
+
+    // the receiver may see one coalesced run or individual datagrams; either way
+    // every segment but the last is SEGMENT bytes
+    std::vector<unsigned char> rx(65536);
+    unsigned int received = 0;
+    while( received < TOTAL )
+    {
+        QVERIFY2(server.waitForRead(1000) == grape::IDataPort::PORT_OK, "segments missing");
+        struct sockaddr_in from;
+        unsigned int segmentSize = 0;
+        unsigned int n = server.readCoalesced(&rx[0], rx.size(), from, segmentSize);
+        QVERIFY((segmentSize == SEGMENT) || (received + n == TOTAL));
+        QVERIFY2(memcmp(&rx[0], &tx[received], n) == 0, "data mismatch");
+        received += n;
+    }
+    QCOMPARE(received, TOTAL);
+}
+
+//-----------------------------------------------------------------------------
+void TestUdpSocket::scheduledTransmit()
+//-----------------------------------------------------------------------------
+{
+    grape::UdpServer server(TEST_PORT);
+    grape::UdpSocket client;
+    client.setRemotePeer(_serverAddr);
+    client.enableTxTime(grape::UdpSocket::TXTIME_MONOTONIC);
+
+    // the loopback qdisc does not hold datagrams, so this only checks that a
+    // scheduled datagram is accepted and delivered intact
+    const unsigned char msg[] = "set-point";
+    const long long deadline = grape::UdpSocket::txTimeNow(grape::UdpSocket::TXTIME_MONOTONIC) + 1000000LL;
+    QCOMPARE(client.writeAt(msg, sizeof(msg), deadline), (unsigned int)sizeof(msg));
+
+    unsigned char rx[64];
+    struct sockaddr_in from;
+    QCOMPARE(server.waitForRead(1000), grape::IDataPort::PORT_OK);
+    QCOMPARE(server.readFrom(rx, sizeof(rx), from), (unsigned int)sizeof(msg));
+    QVERIFY(memcmp(rx, msg, sizeof(msg)) == 0);
+
+    grape::UdpSocket::TxTimeError error;
+    QVERIFY(!client.readTxTimeError(error));
+}
+
+//-----------------------------------------------------------------------------
+void TestUdpSocket::gatherWrite()
+//-----------------------------------------------------------------------------
+{
+    grape::UdpServer server(TEST_PORT);
+    grape::UdpSocket client;
+    QVERIFY(client.setRemotePeer(_serverAddr));
+
+    // all buffers go out as one datagram
+    const unsigned char head[] = "head:";
+    const unsigned char body[] = "body";
+    grape::IDataPort::Buffer buffers[grape::IDataPort::MAX_WRITEV_BUFFERS + 1];
+    buffers[0].pData = head;
+    buffers[0].size = sizeof(head) - 1;
+    buffers[1].pData = body;
+    buffers[1].size = sizeof(body);
+    QCOMPARE(client.writev(buffers, 2), (unsigned int)(sizeof(head) - 1 + sizeof(body)));
+
+    unsigned char buf[32];
+    QVERIFY(server.waitForRead(1000) == grape::IDataPort::PORT_OK);
+    QCOMPARE(server.readn(buf, sizeof(buf)), (unsigned int)(sizeof(head) - 1 + sizeof(body)));
+    QVERIFY(memcmp(buf, "head:body", sizeof(body) + sizeof(head) - 1) == 0);
+
+    // pointer overloads
+    QCOMPARE(client.write(body, sizeof(body)), (unsigned int)sizeof(body));
+    QVERIFY(server.waitForRead(1000) == grape::IDataPort::PORT_OK);
+    QCOMPARE(server.readn(buf, sizeof(buf)), (unsigned int)sizeof(body));
+
+    // a datagram is never truncated: too many buffers are rejected
+    for(unsigned int i = 0; i <= grape::IDataPort::MAX_WRITEV_BUFFERS; ++i)
+    {
+        buffers[i].pData = body;
+        buffers[i].size = 1;
+    }
+    bool thrown = false;
+    try
+    {
+        client.writev(buffers, grape::IDataPort::MAX_WRITEV_BUFFERS + 1);
+    }
+    catch(grape::SocketException&)
+    {
+        thrown = true;
+    }
+    QVERIFY(thrown);
+    QCOMPARE(server.waitForRead(20), grape::IDataPort::PORT_TIMEOUT);
+}
@@ -0,0 +1,30 @@
+#include <QString>
+#include <QtTest>
+#include <io/UdpServer.h>
+#include <io/ShardedUdpServer.h>
+
+//=============================================================================
+/// \brief Test class for UdpSocket
+//=============================================================================
+class TestUdpSocket : public QObject
+{
+    Q_OBJECT
+
+public:
+    TestUdpSocket();
+
+private Q_SLOTS:
+    void cleanupTestCase();
+    void initTestCase();
+    void batchReadWrite();
+    void multicastLoopback();
+    void timestamping();
+    void waitForAny();
+    void shardedServer();
+    void busyPoll();
+    void segmentationOffload();
+    void scheduledTransmit();
+    void gatherWrite();
+private:
+    struct sockaddr_in _serverAddr;
+};